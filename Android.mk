@@ -12,6 +12,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/asyncfile.cc \
 	talk/base/asynchttprequest.cc \
 	talk/base/asyncsocket.cc \
+	talk/base/asyncstuntcpsocket.cc \
 	talk/base/asynctcpsocket.cc \
 	talk/base/asyncudpsocket.cc \
 	talk/base/autodetectproxy.cc \
@@ -21,6 +22,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/bytebuffer.cc \
 	talk/base/checks.cc \
 	talk/base/common.cc \
+	talk/base/cpufeatures.cc \
 	talk/base/cpumonitor.cc \
 	talk/base/crc32.cc \
 	talk/base/diskcache.cc \
@@ -29,6 +31,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/firewallsocketserver.cc \
 	talk/base/flags.cc \
 	talk/base/helpers.cc \
+	talk/base/histogram.cc \
 	talk/base/host.cc \
 	talk/base/httpbase.cc \
 	talk/base/httpclient.cc \
@@ -36,6 +39,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/httprequest.cc \
 	talk/base/httpserver.cc \
 	talk/base/ipaddress.cc \
+	talk/base/linkmodel.cc \
 	talk/base/logging.cc \
 	talk/base/md5.cc \
 	talk/base/messagedigest.cc \
@@ -50,6 +54,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/nssidentity.cc \
 	talk/base/nssstreamadapter.cc \
 	talk/base/optionsfile.cc \
+	talk/base/packettrace.cc \
 	talk/base/pathutils.cc \
 	talk/base/physicalsocketserver.cc \
 	talk/base/proxydetect.cc \
@@ -85,6 +90,7 @@ LOCAL_CORE_COMMON_SRC := \
 	talk/base/urlencode.cc \
 	talk/base/versionparsing.cc \
 	talk/base/virtualsocketserver.cc \
+	talk/base/windowedratetracker.cc \
 	talk/base/worker.cc \
 	talk/xmllite/qname.cc \
 	talk/xmllite/xmlbuilder.cc \
@@ -164,6 +170,7 @@ LOCAL_P2P_SRC := \
 	talk/p2p/base/dtlstransportchannel.cc \
 	talk/p2p/base/p2ptransport.cc \
 	talk/p2p/base/p2ptransportchannel.cc \
+	talk/p2p/base/packetpacer.cc \
 	talk/p2p/base/parsing.cc \
 	talk/p2p/base/port.cc \
 	talk/p2p/base/portallocator.cc \
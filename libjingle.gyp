@@ -190,6 +190,8 @@
         'talk/base/asyncpacketsocket.h',
         'talk/base/asyncsocket.cc',
         'talk/base/asyncsocket.h',
+        'talk/base/asyncstuntcpsocket.cc',
+        'talk/base/asyncstuntcpsocket.h',
         'talk/base/asynctcpsocket.cc',
         'talk/base/asynctcpsocket.h',
         'talk/base/asyncudpsocket.cc',
@@ -208,6 +210,8 @@
         'talk/base/checks.h',
         'talk/base/common.cc',
         'talk/base/common.h',
+        'talk/base/cpufeatures.cc',
+        'talk/base/cpufeatures.h',
         'talk/base/crc32.cc',
         'talk/base/crc32.h',
         'talk/base/criticalsection.h',
@@ -224,6 +228,8 @@
         'talk/base/flags.h',
         'talk/base/helpers.cc',
         'talk/base/helpers.h',
+        'talk/base/histogram.cc',
+        'talk/base/histogram.h',
         'talk/base/host.cc',
         'talk/base/host.h',
         'talk/base/httpbase.cc',
@@ -252,6 +258,8 @@
         'talk/base/network.cc',
         'talk/base/network.h',
         'talk/base/nullsocketserver.h',
+        'talk/base/packettrace.cc',
+        'talk/base/packettrace.h',
         'talk/base/pathutils.cc',
         'talk/base/pathutils.h',
         'talk/base/physicalsocketserver.cc',
@@ -266,6 +274,7 @@
         'talk/base/ratetracker.h',
         'talk/base/scoped_ptr.h',
         'talk/base/sec_buffer.h',
+        'talk/base/seqlock.h',
         'talk/base/sha1.cc',
         'talk/base/sha1.h',
         'talk/base/sha1digest.h',
@@ -312,6 +321,8 @@
         'talk/base/timing.h',
         'talk/base/urlencode.cc',
         'talk/base/urlencode.h',
+        'talk/base/windowedratetracker.cc',
+        'talk/base/windowedratetracker.h',
         'talk/base/worker.cc',
         'talk/base/worker.h',
         'talk/xmllite/qname.cc',
@@ -484,6 +495,8 @@
         'talk/p2p/base/sessionmanager.h',
         'talk/p2p/base/sessionmessages.cc',
         'talk/p2p/base/sessionmessages.h',
+        'talk/p2p/base/packetpacer.cc',
+        'talk/p2p/base/packetpacer.h',
         'talk/p2p/base/parsing.cc',
         'talk/p2p/base/parsing.h',
         'talk/p2p/base/stun.cc',
@@ -789,5 +802,19 @@
         '.',
       ],
     }, # target peerconnection_server
+    {
+      'target_name': 'peerconnection_server_loadgen',
+      'type': 'executable',
+      'sources': [
+        'talk/examples/peerconnection/server/data_socket.cc',
+        'talk/examples/peerconnection/server/data_socket.h',
+        'talk/examples/peerconnection/server/load_generator.cc',
+        'talk/examples/peerconnection/server/utils.cc',
+        'talk/examples/peerconnection/server/utils.h',
+      ],
+      'include_dirs': [
+        '.',
+      ],
+    }, # target peerconnection_server_loadgen
   ],
 }
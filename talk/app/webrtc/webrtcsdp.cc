@@ -116,6 +116,7 @@ static const char kAttributeCandidateRport[] = "rport";
 static const char kAttributeCandidateUsername[] = "username";
 static const char kAttributeCandidatePassword[] = "password";
 static const char kAttributeCandidateGeneration[] = "generation";
+static const char kAttributeCandidateTcptype[] = "tcptype";
 static const char kAttributeFingerprint[] = "fingerprint";
 static const char kAttributeRtpmap[] = "rtpmap";
 static const char kAttributeRtcp[] = "rtcp";
@@ -846,12 +847,17 @@ bool ParseCandidate(const std::string& message, Candidate* candidate) {
   // kept for backwards compatibility.
   std::string username;
   std::string password;
+  std::string tcptype;
   uint32 generation = 0;
   for (size_t i = current_position; i + 1 < fields.size(); ++i) {
     // RFC 5245
     // *(SP extension-att-name SP extension-att-value)
     if (fields[i] == kAttributeCandidateGeneration) {
       generation = talk_base::FromString<uint32>(fields[++i]);
+    } else if (fields[i] == kAttributeCandidateTcptype) {
+      // RFC 6544
+      // tcp-type-ext = "tcptype" SP tcp-type
+      tcptype = fields[++i];
     } else if (fields[i] == kAttributeCandidateUsername) {
       username = fields[++i];
     } else if (fields[i] == kAttributeCandidatePassword) {
@@ -869,6 +875,7 @@ bool ParseCandidate(const std::string& message, Candidate* candidate) {
       address, priority, username, password, candidate_type, network_name,
       generation, foundation);
   candidate->set_related_address(related_address);
+  candidate->set_tcptype(tcptype);
   return true;
 }
 
@@ -1229,6 +1236,9 @@ void BuildCandidate(const std::vector<Candidate>& candidates,
     }
 
     // Extensions
+    if (!it->tcptype().empty()) {
+      os << kAttributeCandidateTcptype << " " << it->tcptype() << " ";
+    }
     os << kAttributeCandidateGeneration << " " << it->generation();
 
     AddLine(os.str(), message);
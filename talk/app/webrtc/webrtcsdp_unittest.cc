@@ -1274,6 +1274,22 @@ TEST_F(WebRtcSdpTest, DeserializeCandidate) {
   EXPECT_TRUE(jcandidate.candidate().IsEquivalent(jcandidate_->candidate()));
 }
 
+TEST_F(WebRtcSdpTest, SerializeAndDeserializeCandidateWithTcptype) {
+  std::string sdp =
+      "a=candidate:a0+B/1 1 tcp 2130706432 192.168.1.5 9 typ host "
+      "tcptype active generation 2\r\n";
+  JsepIceCandidate jcandidate(kDummyMid, kDummyIndex);
+  EXPECT_TRUE(SdpDeserializeCandidate(sdp, &jcandidate));
+  EXPECT_EQ("active", jcandidate.candidate().tcptype());
+  EXPECT_EQ("tcp", jcandidate.candidate().protocol());
+  EXPECT_EQ(sdp, webrtc::SdpSerializeCandidate(jcandidate));
+
+  // Candidates without the extension have no tcptype.
+  JsepIceCandidate jcandidate2(kDummyMid, kDummyIndex);
+  EXPECT_TRUE(SdpDeserializeCandidate(kSdpOneCandidate, &jcandidate2));
+  EXPECT_EQ("", jcandidate2.candidate().tcptype());
+}
+
 TEST_F(WebRtcSdpTest, DeserializeSdpWithDataChannels) {
   AddDataChannel();
   JsepSessionDescription jdesc(kDummyString);
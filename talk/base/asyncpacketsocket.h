@@ -58,6 +58,20 @@ class AsyncPacketSocket : public sigslot::has_slots<> {
   // Send a packet.
   virtual int Send(const void *pv, size_t cb) = 0;
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr) = 0;
+  // Sends |count| buffers to |addr| as one packet, like Socket::SendToV().
+  // Sockets that can't gather copy them together and call SendTo().
+  virtual int SendToV(const IoVec* iov, size_t count,
+                      const SocketAddress& addr) {
+    if (count == 1) {
+      return SendTo(iov[0].data, iov[0].len, addr);
+    }
+    char stack_buffer[kGatherIoVecStackSize];
+    scoped_array<char> heap_buffer;
+    size_t total;
+    const char* data = GatherIoVec(iov, count, stack_buffer,
+                                   sizeof(stack_buffer), &heap_buffer, &total);
+    return SendTo(data, total, addr);
+  }
 
   // Close the socket.
   virtual int Close() = 0;
@@ -76,8 +90,8 @@ class AsyncPacketSocket : public sigslot::has_slots<> {
 
   // Emitted each time a packet is read. Used only for UDP and
   // connected TCP sockets.
-  sigslot::signal4<AsyncPacketSocket*, const char*, size_t,
-                   const SocketAddress&> SignalReadPacket;
+  sigslot::flat_signal4<AsyncPacketSocket*, const char*, size_t,
+                        const SocketAddress&> SignalReadPacket;
 
   // Emitted after address for the socket is allocated, i.e. binding
   // is finished. State of the socket is changed from BINDING to BOUND
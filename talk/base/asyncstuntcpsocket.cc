@@ -0,0 +1,147 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/asyncstuntcpsocket.h"
+
+#include <cstring>
+
+#include "talk/base/byteorder.h"
+#include "talk/base/common.h"
+#include "talk/base/logging.h"
+
+#ifdef POSIX
+#include <errno.h>
+#endif  // POSIX
+
+namespace talk_base {
+
+// Both message types start with a 16-bit type and a 16-bit length; a STUN
+// message has 16 more header bytes after that, which its length excludes.
+static const size_t kPacketLenOffset = 2;
+static const size_t kChannelDataHeaderSize = 4;
+static const size_t kStunHeaderSize = 20;
+// The two most significant bits of a STUN message type are zero; those of
+// a ChannelData channel number are 01.
+static const uint16 kTypeMask = 0xC000;
+static const uint16 kChannelDataType = 0x4000;
+
+static const size_t kMaxPacketSize = kStunHeaderSize + 0xFFFF;
+static const size_t kBufSize = kMaxPacketSize + 3;  // Room for padding.
+
+AsyncStunTCPSocket* AsyncStunTCPSocket::Create(
+    AsyncSocket* socket,
+    const SocketAddress& bind_address,
+    const SocketAddress& remote_address) {
+  scoped_ptr<AsyncSocket> owned_socket(socket);
+  if (socket->Bind(bind_address) < 0) {
+    LOG(LS_ERROR) << "Bind() failed with error " << socket->GetError();
+    return NULL;
+  }
+  if (socket->Connect(remote_address) < 0) {
+    LOG(LS_ERROR) << "Connect() failed with error " << socket->GetError();
+    return NULL;
+  }
+  return new AsyncStunTCPSocket(owned_socket.release(), false);
+}
+
+AsyncStunTCPSocket::AsyncStunTCPSocket(AsyncSocket* socket, bool listen)
+    : AsyncTCPSocket(socket, listen, kBufSize) {
+}
+
+int AsyncStunTCPSocket::Send(const void* pv, size_t cb) {
+  if (cb < kChannelDataHeaderSize || cb > kMaxPacketSize) {
+    SetError(EMSGSIZE);
+    return -1;
+  }
+
+  size_t pad = 0;
+  size_t expected = GetExpectedLength(static_cast<const char*>(pv), &pad);
+  if (expected != cb) {
+    LOG(LS_ERROR) << "Packet length " << cb << " doesn't match the "
+                  << expected << " given in its header";
+    SetError(EINVAL);
+    return -1;
+  }
+
+  // Send the padding straight after the packet.
+  static const char kPadding[3] = { 0, 0, 0 };
+  IoVec iov[2];
+  iov[0].data = pv;
+  iov[0].len = cb;
+  iov[1].data = kPadding;
+  iov[1].len = pad;
+  int res = SendPacketV(iov, pad ? 2 : 1);
+  if (res <= 0) {
+    return res;
+  }
+  return static_cast<int>(cb);
+}
+
+void AsyncStunTCPSocket::ProcessInput(char* data, size_t& len) {
+  SocketAddress remote_addr(GetRemoteAddress());
+
+  while (len >= kChannelDataHeaderSize) {
+    size_t pad = 0;
+    size_t expected = GetExpectedLength(data, &pad);
+    if (len < expected + pad)
+      return;
+
+    SignalReadPacket(this, data, expected, remote_addr);
+
+    data += expected + pad;
+    len -= expected + pad;
+  }
+}
+
+size_t AsyncStunTCPSocket::GetPacketLength(const char* data,
+                                           size_t len) const {
+  if (len < kChannelDataHeaderSize)
+    return 0;
+  size_t pad = 0;
+  return GetExpectedLength(data, &pad) + pad;
+}
+
+AsyncPacketSocket* AsyncStunTCPSocket::CreateAcceptedSocket(
+    AsyncSocket* socket) {
+  return new AsyncStunTCPSocket(socket, false);
+}
+
+size_t AsyncStunTCPSocket::GetExpectedLength(const char* data, size_t* pad) {
+  uint16 type = GetBE16(data);
+  size_t len = GetBE16(data + kPacketLenOffset);
+  if ((type & kTypeMask) == kChannelDataType) {
+    len += kChannelDataHeaderSize;
+    *pad = (4 - len % 4) % 4;
+  } else {
+    len += kStunHeaderSize;
+    *pad = 0;
+  }
+  return len;
+}
+
+}  // namespace talk_base
@@ -0,0 +1,69 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_BASE_ASYNCSTUNTCPSOCKET_H_
+#define TALK_BASE_ASYNCSTUNTCPSOCKET_H_
+
+#include "talk/base/asynctcpsocket.h"
+
+namespace talk_base {
+
+// Carries STUN messages and TURN ChannelData messages over TCP, framed as
+// RFC 5766 section 11.5 describes: each packet is delimited by the length
+// in its own header rather than by a separate length prefix, and
+// ChannelData messages are padded to a multiple of four bytes on the wire.
+// Packets are delivered without that padding.
+class AsyncStunTCPSocket : public AsyncTCPSocket {
+ public:
+  // Binds and connects |socket| and creates AsyncStunTCPSocket for
+  // it. Takes ownership of |socket|. Returns NULL if bind() or
+  // connect() fail (|socket| is destroyed in that case).
+  static AsyncStunTCPSocket* Create(AsyncSocket* socket,
+                                    const SocketAddress& bind_address,
+                                    const SocketAddress& remote_address);
+  AsyncStunTCPSocket(AsyncSocket* socket, bool listen);
+  virtual ~AsyncStunTCPSocket() {}
+
+  virtual int Send(const void* pv, size_t cb);
+
+ protected:
+  virtual void ProcessInput(char* data, size_t& len);
+  virtual size_t GetPacketLength(const char* data, size_t len) const;
+  virtual AsyncPacketSocket* CreateAcceptedSocket(AsyncSocket* socket);
+
+ private:
+  // Returns the size of the packet starting at |data| without its padding,
+  // and sets |pad| to the number of padding bytes that follow it.
+  static size_t GetExpectedLength(const char* data, size_t* pad);
+
+  DISALLOW_EVIL_CONSTRUCTORS(AsyncStunTCPSocket);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_ASYNCSTUNTCPSOCKET_H_
@@ -0,0 +1,189 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string>
+#include <vector>
+
+#include "talk/base/asyncstuntcpsocket.h"
+#include "talk/base/byteorder.h"
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/socketserver.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+static const int kTimeout = 5000;
+
+class AsyncStunTCPSocketTest : public testing::Test,
+                               public sigslot::has_slots<> {
+ protected:
+  AsyncStunTCPSocketTest() : ss_(Thread::Current()->socketserver()) {
+  }
+
+  // Connects stun_ to raw_, a plain socket accepted from a listener.
+  virtual void SetUp() {
+    const SocketAddress loopback("127.0.0.1", 0);
+    listener_.reset(ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM));
+    ASSERT_EQ(0, listener_->Bind(loopback));
+    ASSERT_EQ(0, listener_->Listen(5));
+    listener_->SignalReadEvent.connect(this,
+                                       &AsyncStunTCPSocketTest::OnAccept);
+    stun_.reset(AsyncStunTCPSocket::Create(
+        ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM), loopback,
+        listener_->GetLocalAddress()));
+    ASSERT_TRUE(stun_.get() != NULL);
+    stun_->SignalReadPacket.connect(this, &AsyncStunTCPSocketTest::OnPacket);
+    ASSERT_TRUE_WAIT(raw_.get() != NULL, kTimeout);
+  }
+
+  void OnAccept(AsyncSocket* socket) {
+    raw_.reset(socket->Accept(NULL));
+  }
+
+  void OnPacket(AsyncPacketSocket* socket, const char* data, size_t len,
+                const SocketAddress& remote_addr) {
+    packets_.push_back(std::string(data, len));
+  }
+
+  // Builds a STUN message with |len| bytes of attributes.
+  static std::string StunMessage(uint16 type, size_t len) {
+    std::string msg(20 + len, 's');
+    SetBE16(&msg[0], type);
+    SetBE16(&msg[2], static_cast<uint16>(len));
+    return msg;
+  }
+
+  // Builds a ChannelData message carrying |payload|, without padding.
+  static std::string ChannelData(uint16 channel, const std::string& payload) {
+    std::string msg(4, '\0');
+    SetBE16(&msg[0], channel);
+    SetBE16(&msg[2], static_cast<uint16>(payload.size()));
+    return msg + payload;
+  }
+
+  // Writes all of |data| to the raw socket, processing I/O while it blocks.
+  void SendRaw(const std::string& data) {
+    size_t sent = 0;
+    uint32 start = Time();
+    while (sent < data.size() && TimeSince(start) < kTimeout) {
+      int res = raw_->Send(data.data() + sent, data.size() - sent);
+      if (res > 0) {
+        sent += res;
+      }
+      ss_->Wait(0, true);
+    }
+    EXPECT_EQ(data.size(), sent);
+  }
+
+  // Reads |size| bytes from the raw socket.
+  std::string RecvRaw(size_t size) {
+    std::string received;
+    char buffer[4096];
+    uint32 start = Time();
+    while (received.size() < size && TimeSince(start) < kTimeout) {
+      int res = raw_->Recv(buffer, sizeof(buffer));
+      if (res > 0) {
+        received.append(buffer, res);
+      }
+      ss_->Wait(0, true);
+    }
+    return received;
+  }
+
+  SocketServer* ss_;
+  scoped_ptr<AsyncSocket> listener_;
+  scoped_ptr<AsyncSocket> raw_;
+  scoped_ptr<AsyncStunTCPSocket> stun_;
+  std::vector<std::string> packets_;
+};
+
+// STUN and ChannelData messages are split by their own lengths, and the
+// padding after a ChannelData message is dropped.
+TEST_F(AsyncStunTCPSocketTest, ReadsStunAndChannelData) {
+  const std::string stun1 = StunMessage(0x0101, 8);
+  const std::string data1 = ChannelData(0x4000, "abcde");
+  const std::string data2 = ChannelData(0x4001, "abcd");
+  const std::string stun2 = StunMessage(0x0113, 0);
+  SendRaw(stun1 + data1 + std::string(3, '\0') + data2 + stun2);
+  ASSERT_EQ_WAIT(4u, packets_.size(), kTimeout);
+  EXPECT_EQ(stun1, packets_[0]);
+  EXPECT_EQ(data1, packets_[1]);
+  EXPECT_EQ(data2, packets_[2]);
+  EXPECT_EQ(stun2, packets_[3]);
+}
+
+// Messages split across reads, including in their padding, are put back
+// together.
+TEST_F(AsyncStunTCPSocketTest, ReadsSplitMessages) {
+  const std::string data = ChannelData(0x4000, "hello");
+  const std::string stun = StunMessage(0x0003, 40);
+  const std::string stream = data + std::string(3, '\0') + stun;
+  SendRaw(stream.substr(0, 2));
+  SendRaw(stream.substr(2, 8));
+  SendRaw(stream.substr(10, 2));
+  ASSERT_EQ_WAIT(1u, packets_.size(), kTimeout);
+  EXPECT_EQ(data, packets_[0]);
+  SendRaw(stream.substr(12, 20));
+  SendRaw(stream.substr(32));
+  ASSERT_EQ_WAIT(2u, packets_.size(), kTimeout);
+  EXPECT_EQ(stun, packets_[1]);
+}
+
+// A message larger than the 2-byte-framed maximum still fits.
+TEST_F(AsyncStunTCPSocketTest, ReadsLargeMessages) {
+  const std::string stun = StunMessage(0x0101, 0xFFFC);
+  const std::string data = ChannelData(0x4000, std::string(0xFFFF, 'd'));
+  SendRaw(stun + data + std::string(1, '\0') + stun);
+  ASSERT_EQ_WAIT(3u, packets_.size(), kTimeout);
+  EXPECT_TRUE(stun == packets_[0]);
+  EXPECT_TRUE(data == packets_[1]);
+  EXPECT_TRUE(stun == packets_[2]);
+}
+
+// Send() pads ChannelData messages and writes STUN messages as they are.
+TEST_F(AsyncStunTCPSocketTest, SendsPaddedChannelData) {
+  const std::string data = ChannelData(0x4000, "abcdefg");
+  const std::string stun = StunMessage(0x0001, 12);
+  EXPECT_EQ(static_cast<int>(data.size()),
+            stun_->Send(data.data(), data.size()));
+  EXPECT_EQ(static_cast<int>(stun.size()),
+            stun_->Send(stun.data(), stun.size()));
+  const std::string expected = data + std::string(1, '\0') + stun;
+  EXPECT_TRUE(expected == RecvRaw(expected.size()));
+}
+
+// Send() rejects buffers that don't match the length in their header.
+TEST_F(AsyncStunTCPSocketTest, RejectsBadLength) {
+  const std::string stun = StunMessage(0x0001, 12);
+  EXPECT_EQ(-1, stun_->Send(stun.data(), stun.size() - 4));
+  EXPECT_EQ(-1, stun_->Send(stun.data(), 2));
+}
+
+}  // namespace talk_base
@@ -71,9 +71,28 @@ AsyncTCPSocket::AsyncTCPSocket(AsyncSocket* socket, bool listen)
     : socket_(socket),
       listen_(listen),
       insize_(BUF_SIZE),
+      instart_(0),
       inpos_(0),
       outsize_(BUF_SIZE),
+      outstart_(0),
       outpos_(0) {
+  Init();
+}
+
+AsyncTCPSocket::AsyncTCPSocket(AsyncSocket* socket, bool listen,
+                               size_t buffer_size)
+    : socket_(socket),
+      listen_(listen),
+      insize_(buffer_size),
+      instart_(0),
+      inpos_(0),
+      outsize_(buffer_size),
+      outstart_(0),
+      outpos_(0) {
+  Init();
+}
+
+void AsyncTCPSocket::Init() {
   inbuf_ = new char[insize_];
   outbuf_ = new char[outsize_];
 
@@ -109,19 +128,16 @@ int AsyncTCPSocket::Send(const void *pv, size_t cb) {
     return -1;
   }
 
-  // If we are blocking on send, then silently drop this packet
-  if (outpos_)
-    return static_cast<int>(cb);
-
+  // Send the length and the packet together, straight from the caller's
+  // buffer.
   PacketLength pkt_len = HostToNetwork16(static_cast<PacketLength>(cb));
-  memcpy(outbuf_, &pkt_len, PKT_LEN_SIZE);
-  memcpy(outbuf_ + PKT_LEN_SIZE, pv, cb);
-  outpos_ = PKT_LEN_SIZE + cb;
-
-  int res = Flush();
+  IoVec iov[2];
+  iov[0].data = &pkt_len;
+  iov[0].len = PKT_LEN_SIZE;
+  iov[1].data = pv;
+  iov[1].len = cb;
+  int res = SendPacketV(iov, 2);
   if (res <= 0) {
-    // drop packet if we made no progress
-    outpos_ = 0;
     return res;
   }
 
@@ -178,24 +194,74 @@ void AsyncTCPSocket::SetError(int error) {
 }
 
 int AsyncTCPSocket::SendRaw(const void * pv, size_t cb) {
-  if (outpos_ + cb > outsize_) {
+  if (outpos_ - outstart_ + cb > outsize_) {
     socket_->SetError(EMSGSIZE);
     return -1;
   }
 
+  if (outpos_ + cb > outsize_) {
+    memmove(outbuf_, outbuf_ + outstart_, outpos_ - outstart_);
+    outpos_ -= outstart_;
+    outstart_ = 0;
+  }
   memcpy(outbuf_ + outpos_, pv, cb);
   outpos_ += cb;
 
   return Flush();
 }
 
+int AsyncTCPSocket::SendPacketV(const IoVec* iov, size_t count) {
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i) {
+    total += iov[i].len;
+  }
+  if (total > outsize_) {
+    socket_->SetError(EMSGSIZE);
+    return -1;
+  }
+
+  // If we are blocking on send, then silently drop this packet
+  if (outpos_ > outstart_)
+    return static_cast<int>(total);
+
+  int res = socket_->SendV(iov, count);
+  if (res <= 0) {
+    // drop packet if we made no progress
+    return res;
+  }
+
+  // Only copy what's left, to be sent when the socket is writable.
+  size_t skip = static_cast<size_t>(res);
+  outstart_ = outpos_ = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (skip >= iov[i].len) {
+      skip -= iov[i].len;
+      continue;
+    }
+    memcpy(outbuf_ + outpos_, static_cast<const char*>(iov[i].data) + skip,
+           iov[i].len - skip);
+    outpos_ += iov[i].len - skip;
+    skip = 0;
+  }
+  return static_cast<int>(total);
+}
+
+size_t AsyncTCPSocket::GetPacketLength(const char* data, size_t len) const {
+  if (len < PKT_LEN_SIZE)
+    return 0;
+  PacketLength pkt_len;
+  memcpy(&pkt_len, data, PKT_LEN_SIZE);
+  return PKT_LEN_SIZE + NetworkToHost16(pkt_len);
+}
+
+AsyncPacketSocket* AsyncTCPSocket::CreateAcceptedSocket(AsyncSocket* socket) {
+  return new AsyncTCPSocket(socket, false);
+}
+
 void AsyncTCPSocket::ProcessInput(char * data, size_t& len) {
   SocketAddress remote_addr(GetRemoteAddress());
 
-  while (true) {
-    if (len < PKT_LEN_SIZE)
-      return;
-
+  while (len >= PKT_LEN_SIZE) {
     PacketLength pkt_len;
     memcpy(&pkt_len, data, PKT_LEN_SIZE);
     pkt_len = NetworkToHost16(pkt_len);
@@ -205,26 +271,25 @@ void AsyncTCPSocket::ProcessInput(char * data, size_t& len) {
 
     SignalReadPacket(this, data + PKT_LEN_SIZE, pkt_len, remote_addr);
 
+    data += PKT_LEN_SIZE + pkt_len;
     len -= PKT_LEN_SIZE + pkt_len;
-    if (len > 0) {
-      memmove(data, data + PKT_LEN_SIZE + pkt_len, len);
-    }
   }
 }
 
 int AsyncTCPSocket::Flush() {
-  int res = socket_->Send(outbuf_, outpos_);
+  const size_t pending = outpos_ - outstart_;
+  int res = socket_->Send(outbuf_ + outstart_, pending);
   if (res <= 0) {
     return res;
   }
-  if (static_cast<size_t>(res) <= outpos_) {
-    outpos_ -= res;
+  if (static_cast<size_t>(res) <= pending) {
+    outstart_ += res;
   } else {
     ASSERT(false);
     return -1;
   }
-  if (outpos_ > 0) {
-    memmove(outbuf_, outbuf_ + res, outpos_);
+  if (outstart_ == outpos_) {
+    outstart_ = outpos_ = 0;
   }
   return res;
 }
@@ -246,7 +311,7 @@ void AsyncTCPSocket::OnReadEvent(AsyncSocket* socket) {
       return;
     }
 
-    SignalNewConnection(this, new AsyncTCPSocket(new_socket, false));
+    SignalNewConnection(this, CreateAcceptedSocket(new_socket));
 
     // Prime a read event in case data is waiting.
     new_socket->SignalReadEvent(new_socket);
@@ -262,12 +327,30 @@ void AsyncTCPSocket::OnReadEvent(AsyncSocket* socket) {
 
     inpos_ += len;
 
-    ProcessInput(inbuf_, inpos_);
+    size_t remaining = inpos_ - instart_;
+    ProcessInput(inbuf_ + instart_, remaining);
+    instart_ = inpos_ - remaining;
+
+    if (remaining == 0) {
+      instart_ = inpos_ = 0;
+    } else if (instart_ > 0) {
+      // Move the partial packet to the front only if the rest of it
+      // won't fit after it.
+      size_t needed = GetPacketLength(inbuf_ + instart_, remaining);
+      if (needed == 0) {
+        needed = insize_;
+      }
+      if (instart_ + needed > insize_) {
+        memmove(inbuf_, inbuf_ + instart_, remaining);
+        instart_ = 0;
+        inpos_ = remaining;
+      }
+    }
 
     if (inpos_ >= insize_) {
       LOG(LS_ERROR) << "input buffer overflow";
       ASSERT(false);
-      inpos_ = 0;
+      instart_ = inpos_ = 0;
     }
   }
 }
@@ -275,7 +358,7 @@ void AsyncTCPSocket::OnReadEvent(AsyncSocket* socket) {
 void AsyncTCPSocket::OnWriteEvent(AsyncSocket* socket) {
   ASSERT(socket_.get() == socket);
 
-  if (outpos_ > 0) {
+  if (outpos_ > outstart_) {
     Flush();
   }
 }
@@ -61,10 +61,27 @@ class AsyncTCPSocket : public AsyncPacketSocket {
   virtual void SetError(int error);
 
  protected:
+  // For subclasses with their own framing; |buffer_size| is the size of
+  // each of the input and output buffers, and so the largest framed packet.
+  AsyncTCPSocket(AsyncSocket* socket, bool listen, size_t buffer_size);
+
   int SendRaw(const void* pv, size_t cb);
+  // Sends the |count| buffers as one framed packet, buffering whatever the
+  // socket doesn't take. Returns the total size, or -1 on error. The packet
+  // is dropped, as with Send, if earlier output is still pending.
+  int SendPacketV(const IoVec* iov, size_t count);
+  // Returns the framed size of the packet starting at |data|, or 0 if the
+  // |len| bytes available aren't enough to tell.
+  virtual size_t GetPacketLength(const char* data, size_t len) const;
+  // Wraps a socket accepted by a listening socket.
+  virtual AsyncPacketSocket* CreateAcceptedSocket(AsyncSocket* socket);
+  // Delivers the complete packets at the start of |data|, in place.  On
+  // return |len| is the number of bytes left over at the end of |data|,
+  // which are passed in again, followed by more input, on the next call.
   virtual void ProcessInput(char* data, size_t& len);
 
  private:
+  void Init();
   int Flush();
 
   // Called by the underlying socket
@@ -75,8 +92,11 @@ class AsyncTCPSocket : public AsyncPacketSocket {
 
   scoped_ptr<AsyncSocket> socket_;
   bool listen_;
+  // Unprocessed input is inbuf_[instart_, inpos_) and unsent output is
+  // outbuf_[outstart_, outpos_). Both are moved back to the start of their
+  // buffer only when more room is needed.
   char* inbuf_, * outbuf_;
-  size_t insize_, inpos_, outsize_, outpos_;
+  size_t insize_, instart_, inpos_, outsize_, outstart_, outpos_;
 
   DISALLOW_EVIL_CONSTRUCTORS(AsyncTCPSocket);
 };
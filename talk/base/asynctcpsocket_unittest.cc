@@ -0,0 +1,201 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string>
+#include <vector>
+
+#include "talk/base/asynctcpsocket.h"
+#include "talk/base/byteorder.h"
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/socketserver.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+static const int kTimeout = 5000;
+
+class AsyncTCPSocketTest : public testing::Test,
+                           public sigslot::has_slots<> {
+ protected:
+  AsyncTCPSocketTest()
+      : ss_(Thread::Current()->socketserver()), received_bytes_(0) {
+  }
+
+  // Connects tcp_ to raw_, a plain socket accepted from a listener.
+  virtual void SetUp() {
+    const SocketAddress loopback("127.0.0.1", 0);
+    listener_.reset(ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM));
+    ASSERT_EQ(0, listener_->Bind(loopback));
+    ASSERT_EQ(0, listener_->Listen(5));
+    listener_->SignalReadEvent.connect(this, &AsyncTCPSocketTest::OnAccept);
+    tcp_.reset(AsyncTCPSocket::Create(
+        ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM), loopback,
+        listener_->GetLocalAddress()));
+    ASSERT_TRUE(tcp_.get() != NULL);
+    tcp_->SignalReadPacket.connect(this, &AsyncTCPSocketTest::OnPacket);
+    ASSERT_TRUE_WAIT(raw_.get() != NULL, kTimeout);
+  }
+
+  void OnAccept(AsyncSocket* socket) {
+    raw_.reset(socket->Accept(NULL));
+  }
+
+  void OnPacket(AsyncPacketSocket* socket, const char* data, size_t len,
+                const SocketAddress& remote_addr) {
+    packets_.push_back(std::string(data, len));
+    received_bytes_ += len;
+  }
+
+  void CountPackets(AsyncPacketSocket* socket) {
+    socket->SignalReadPacket.connect(this, &AsyncTCPSocketTest::OnCountPacket);
+  }
+
+  void OnCountPacket(AsyncPacketSocket* socket, const char* data, size_t len,
+                     const SocketAddress& remote_addr) {
+    received_bytes_ += len;
+  }
+
+  static std::string Frame(const std::string& packet) {
+    uint16 len = HostToNetwork16(static_cast<uint16>(packet.size()));
+    return std::string(reinterpret_cast<char*>(&len), sizeof(len)) + packet;
+  }
+
+  // Writes all of |data| to the raw socket, processing I/O while it blocks.
+  void SendRaw(const std::string& data) {
+    size_t sent = 0;
+    uint32 start = Time();
+    while (sent < data.size() && TimeSince(start) < kTimeout) {
+      int res = raw_->Send(data.data() + sent, data.size() - sent);
+      if (res > 0) {
+        sent += res;
+      }
+      ss_->Wait(0, true);
+    }
+    EXPECT_EQ(data.size(), sent);
+  }
+
+  SocketServer* ss_;
+  scoped_ptr<AsyncSocket> listener_;
+  scoped_ptr<AsyncSocket> raw_;
+  scoped_ptr<AsyncTCPSocket> tcp_;
+  std::vector<std::string> packets_;
+  size_t received_bytes_;
+};
+
+// Several packets in one read are all delivered, and packets split across
+// reads are put back together, including a split length.
+TEST_F(AsyncTCPSocketTest, ReadsFramedPackets) {
+  SendRaw(Frame("foo") + Frame("hello") + Frame("barr").substr(0, 4));
+  ASSERT_EQ_WAIT(2u, packets_.size(), kTimeout);
+  EXPECT_EQ("foo", packets_[0]);
+  EXPECT_EQ("hello", packets_[1]);
+
+  SendRaw("rr" + Frame("hi").substr(0, 1));
+  ASSERT_EQ_WAIT(3u, packets_.size(), kTimeout);
+  EXPECT_EQ("barr", packets_[2]);
+
+  SendRaw(Frame("hi").substr(1) + Frame(""));
+  ASSERT_EQ_WAIT(5u, packets_.size(), kTimeout);
+  EXPECT_EQ("hi", packets_[3]);
+  EXPECT_EQ("", packets_[4]);
+}
+
+// Large packets that keep running past the end of the input buffer arrive
+// intact.
+TEST_F(AsyncTCPSocketTest, ReadsLargePackets) {
+  const size_t kCount = 20;
+  std::string stream;
+  std::vector<std::string> sent;
+  for (size_t i = 0; i < kCount; ++i) {
+    sent.push_back(std::string(20000 + i * 2000, static_cast<char>('a' + i)));
+    stream += Frame(sent.back());
+  }
+  SendRaw(stream);
+  ASSERT_EQ_WAIT(kCount, packets_.size(), kTimeout);
+  for (size_t i = 0; i < kCount; ++i) {
+    EXPECT_TRUE(sent[i] == packets_[i]) << "packet " << i;
+  }
+}
+
+// Send() writes the length and the packet in one piece.
+TEST_F(AsyncTCPSocketTest, SendsFramedPackets) {
+  const std::string packet(5000, 'x');
+  EXPECT_EQ(static_cast<int>(packet.size()),
+            tcp_->Send(packet.data(), packet.size()));
+  EXPECT_EQ(3, tcp_->Send("abc", 3));
+
+  const std::string expected = Frame(packet) + Frame("abc");
+  std::string received;
+  char buffer[4096];
+  uint32 start = Time();
+  while (received.size() < expected.size() && TimeSince(start) < kTimeout) {
+    int res = raw_->Recv(buffer, sizeof(buffer));
+    if (res > 0) {
+      received.append(buffer, res);
+    }
+    ss_->Wait(0, true);
+  }
+  EXPECT_TRUE(expected == received);
+}
+
+// Measures how fast packets go through a pair of AsyncTCPSockets. Packets
+// that are sent while the socket is blocked are dropped, as with UDP.
+TEST_F(AsyncTCPSocketTest, DISABLED_Perf) {
+  AsyncTCPSocket server(raw_.release(), false);
+  CountPackets(&server);
+
+  const size_t kPacketSize = 1200;
+  const size_t kPacketCount = 100000;
+  const std::string packet(kPacketSize, 'p');
+  uint32 start = Time();
+  for (size_t i = 0; i < kPacketCount; ++i) {
+    tcp_->Send(packet.data(), packet.size());
+    if (i % 64 == 63) {
+      ss_->Wait(0, true);
+    }
+  }
+  // Wait for whatever is still in flight.
+  uint32 finish = Time();
+  size_t last_received = 0;
+  while (TimeSince(finish) < 100) {
+    ss_->Wait(10, true);
+    if (received_bytes_ != last_received) {
+      last_received = received_bytes_;
+      finish = Time();
+    }
+  }
+  uint32 elapsed = _max(TimeDiff(finish, start), 1);
+  EXPECT_GT(received_bytes_, 0u);
+  LOG(LS_INFO) << "Received " << received_bytes_ / kPacketSize << " of "
+               << kPacketCount << " packets in " << elapsed << " ms ("
+               << received_bytes_ * 8 / elapsed << " Kbps)";
+}
+
+}  // namespace talk_base
@@ -27,6 +27,7 @@
 
 #include "talk/base/asyncudpsocket.h"
 #include "talk/base/logging.h"
+#include "talk/base/packettrace.h"
 
 namespace talk_base {
 
@@ -75,12 +76,26 @@ SocketAddress AsyncUDPSocket::GetRemoteAddress() const {
 }
 
 int AsyncUDPSocket::Send(const void *pv, size_t cb) {
-  return socket_->Send(pv, cb);
+  PacketTrace::Mark(PS_SEND_PORT);
+  int sent = socket_->Send(pv, cb);
+  PacketTrace::Mark(PS_SEND_SOCKET);
+  return sent;
 }
 
 int AsyncUDPSocket::SendTo(
     const void *pv, size_t cb, const SocketAddress& addr) {
-  return socket_->SendTo(pv, cb, addr);
+  PacketTrace::Mark(PS_SEND_PORT);
+  int sent = socket_->SendTo(pv, cb, addr);
+  PacketTrace::Mark(PS_SEND_SOCKET);
+  return sent;
+}
+
+int AsyncUDPSocket::SendToV(
+    const IoVec* iov, size_t count, const SocketAddress& addr) {
+  PacketTrace::Mark(PS_SEND_PORT);
+  int sent = socket_->SendToV(iov, count, addr);
+  PacketTrace::Mark(PS_SEND_SOCKET);
+  return sent;
 }
 
 int AsyncUDPSocket::Close() {
@@ -110,8 +125,10 @@ void AsyncUDPSocket::SetError(int error) {
 void AsyncUDPSocket::OnReadEvent(AsyncSocket* socket) {
   ASSERT(socket_.get() == socket);
 
+  PacketTraceScope trace(PP_RECV);
   SocketAddress remote_addr;
   int len = socket_->RecvFrom(buf_, size_, &remote_addr);
+  PacketTrace::Mark(PS_RECV_SOCKET);
   if (len < 0) {
     // An error here typically means we got an ICMP error in response to our
     // send datagram, indicating the remote address was unreachable.
@@ -54,6 +54,8 @@ class AsyncUDPSocket : public AsyncPacketSocket {
   virtual SocketAddress GetRemoteAddress() const;
   virtual int Send(const void *pv, size_t cb);
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr);
+  virtual int SendToV(const IoVec* iov, size_t count,
+                      const SocketAddress& addr);
   virtual int Close();
 
   virtual State GetState() const;
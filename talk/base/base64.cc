@@ -11,6 +11,7 @@
 //* Enhancements by Stanley Yamane:
 //*     o reverse lookup table for the decode function
 //*     o reserve string buffer space in advance
+//*     o SSSE3 and AVX2 versions of the encode and decode loops
 //*
 //*********************************************************************
 
@@ -19,6 +20,12 @@
 #include <string.h>
 
 #include "talk/base/common.h"
+#include "talk/base/cpufeatures.h"
+
+#ifdef HAVE_X86_INTRINSICS
+#include <immintrin.h>
+#include <tmmintrin.h>
+#endif
 
 using std::string;
 using std::vector;
@@ -96,42 +103,236 @@ bool Base64::IsBase64Encoded(const std::string& str) {
   return true;
 }
 
-void Base64::EncodeFromArray(const void* data, size_t len, string* result) {
-  ASSERT(NULL != result);
-  result->clear();
-  result->reserve(((len + 2) / 3) * 4);
+#ifdef HAVE_X86_INTRINSICS
+// The vector encoders and decoders work on whole 4-character quanta and fall
+// back to the table-driven code for the tail, or as soon as they see anything
+// but base64 characters.  The algorithms are those of Wojciech Mula and
+// Daniel Lemire, "Faster Base64 Encoding and Decoding Using AVX2
+// Instructions".  The AVX2 versions run the same steps on both 128-bit lanes.
+
+// Spreads 12 input bytes into 16 6-bit values, and maps them to the alphabet
+// by adding a per-range offset.
+X86_TARGET("ssse3")
+static inline __m128i EncodeBlockSsse3(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+                                          7, 6, 8, 7, 10, 9, 11, 10));
+  __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  __m128i values = _mm_or_si128(t1, t3);
+
+  __m128i index = _mm_subs_epu8(values, _mm_set1_epi8(51));
+  index = _mm_sub_epi8(index, _mm_cmpgt_epi8(values, _mm_set1_epi8(25)));
+  __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+                                  -4, -4, -4, -4, -19, -16, 0, 0);
+  return _mm_add_epi8(values, _mm_shuffle_epi8(offsets, index));
+}
+
+// Maps 16 characters back to 6-bit values and packs them into 12 bytes.
+// Returns false if any character is not in the alphabet.
+X86_TARGET("ssse3")
+static inline bool DecodeBlockSsse3(__m128i in, __m128i* out) {
+  const __m128i mask_2f = _mm_set1_epi8(0x2F);
+  __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+  __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+  __m128i hi = _mm_shuffle_epi8(
+      _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10),
+      hi_nibbles);
+  __m128i lo = _mm_shuffle_epi8(
+      _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A),
+      lo_nibbles);
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                                       _mm_setzero_si128())) != 0) {
+    return false;
+  }
+  __m128i roll = _mm_shuffle_epi8(
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0),
+      _mm_add_epi8(_mm_cmpeq_epi8(in, mask_2f), hi_nibbles));
+  __m128i values = _mm_add_epi8(in, roll);
+
+  __m128i ab_bc = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  __m128i abc = _mm_madd_epi16(ab_bc, _mm_set1_epi32(0x00011000));
+  *out = _mm_shuffle_epi8(abc, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+                                             8, 14, 13, 12, -1, -1, -1, -1));
+  return true;
+}
+
+X86_TARGET("avx2")
+static inline __m256i EncodeBlockAvx2(__m256i in) {
+  in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+  __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+  __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+  __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+  __m256i values = _mm256_or_si256(t1, t3);
+
+  __m256i index = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+  index = _mm256_sub_epi8(index,
+                          _mm256_cmpgt_epi8(values, _mm256_set1_epi8(25)));
+  __m256i offsets = _mm256_setr_epi8(
+      65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+      65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  return _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, index));
+}
+
+X86_TARGET("avx2")
+static inline bool DecodeBlockAvx2(__m256i in, __m256i* out) {
+  const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+  __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_2f);
+  __m256i lo_nibbles = _mm256_and_si256(in, mask_2f);
+  __m256i hi = _mm256_shuffle_epi8(_mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10), hi_nibbles);
+  __m256i lo = _mm256_shuffle_epi8(_mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A), lo_nibbles);
+  if (!_mm256_testz_si256(lo, hi)) {
+    return false;
+  }
+  __m256i roll = _mm256_shuffle_epi8(_mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0),
+      _mm256_add_epi8(_mm256_cmpeq_epi8(in, mask_2f), hi_nibbles));
+  __m256i values = _mm256_add_epi8(in, roll);
+
+  __m256i ab_bc = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+  __m256i abc = _mm256_madd_epi16(ab_bc, _mm256_set1_epi32(0x00011000));
+  *out = _mm256_shuffle_epi8(abc, _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  return true;
+}
+
+// Encodes 12 bytes at a time while 16 are readable.  Returns the number of
+// bytes consumed; |*out| is advanced past the characters written.
+X86_TARGET("ssse3")
+static size_t EncodeSsse3(const unsigned char* data, size_t len, char** out) {
+  size_t i = 0;
+  for (; len - i >= 16; i += 12, *out += 16) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(*out), EncodeBlockSsse3(in));
+  }
+  return i;
+}
+
+// Like EncodeSsse3, but encodes 24 bytes at a time while 28 are readable.
+X86_TARGET("avx2")
+static size_t EncodeAvx2(const unsigned char* data, size_t len, char** out) {
+  size_t i = 0;
+  for (; len - i >= 28; i += 24, *out += 32) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    __m128i hi = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(data + i + 12));
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(*out), EncodeBlockAvx2(in));
+  }
+  return i;
+}
+
+// Decodes 16 characters at a time into 12 bytes, stopping at the first block
+// that isn't entirely base64 characters.  |out| must have room for 4 bytes
+// more than are decoded.  Returns the number of characters consumed.
+X86_TARGET("ssse3")
+static size_t DecodeSsse3(const char* data, size_t len, unsigned char* out) {
+  size_t i = 0;
+  for (; len - i >= 16; i += 16, out += 12) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    __m128i bytes;
+    if (!DecodeBlockSsse3(in, &bytes))
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), bytes);
+  }
+  return i;
+}
+
+// Like DecodeSsse3, but decodes 32 characters at a time into 24 bytes.
+X86_TARGET("avx2")
+static size_t DecodeAvx2(const char* data, size_t len, unsigned char* out) {
+  size_t i = 0;
+  for (; len - i >= 32; i += 32, out += 24) {
+    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    __m256i bytes;
+    if (!DecodeBlockAvx2(in, &bytes))
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm256_castsi256_si128(bytes));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12),
+                     _mm256_extracti128_si256(bytes, 1));
+  }
+  return i;
+}
+#endif  // HAVE_X86_INTRINSICS
+
+size_t Base64::GetEncodedSize(size_t len) {
+  return ((len + 2) / 3) * 4;
+}
+
+size_t Base64::EncodeToBuffer(const void* data, size_t len,
+                              char* buffer, size_t buflen) {
+  size_t needed = GetEncodedSize(len);
+  if (buflen < needed)
+    return 0;
+
   const unsigned char* byte_data = static_cast<const unsigned char*>(data);
+  char* out = buffer;
+  size_t i = 0;
+#ifdef HAVE_X86_INTRINSICS
+  if (CpuFeatures::Has(CpuFeatures::kAVX2)) {
+    i += EncodeAvx2(byte_data, len, &out);
+  }
+  if (CpuFeatures::Has(CpuFeatures::kSSSE3)) {
+    i += EncodeSsse3(byte_data + i, len - i, &out);
+  }
+#endif
 
   unsigned char c;
-  size_t i = 0;
   while (i < len) {
     c = (byte_data[i] >> 2) & 0x3f;
-    result->push_back(Base64Table[c]);
+    *out++ = Base64Table[c];
 
     c = (byte_data[i] << 4) & 0x3f;
     if (++i < len) {
       c |= (byte_data[i] >> 4) & 0x0f;
     }
-    result->push_back(Base64Table[c]);
+    *out++ = Base64Table[c];
 
     if (i < len) {
       c = (byte_data[i] << 2) & 0x3f;
       if (++i < len) {
         c |= (byte_data[i] >> 6) & 0x03;
       }
-      result->push_back(Base64Table[c]);
+      *out++ = Base64Table[c];
     } else {
-      result->push_back(kPad);
+      *out++ = kPad;
     }
 
     if (i < len) {
       c = byte_data[i] & 0x3f;
-      result->push_back(Base64Table[c]);
+      *out++ = Base64Table[c];
       ++i;
     } else {
-      result->push_back(kPad);
+      *out++ = kPad;
     }
   }
+  ASSERT(static_cast<size_t>(out - buffer) == needed);
+  return needed;
+}
+
+void Base64::EncodeFromArray(const void* data, size_t len, string* result) {
+  ASSERT(NULL != result);
+  result->resize(GetEncodedSize(len));
+  if (!result->empty()) {
+    EncodeToBuffer(data, len, &(*result)[0], result->size());
+  }
 }
 
 size_t Base64::GetNextQuantum(DecodeFlags parse_flags, bool illegal_pads,
@@ -199,6 +400,28 @@ bool Base64::DecodeFromArray(const char* data, size_t len, DecodeFlags flags,
                                                 data_used);
 }
 
+template<typename T>
+size_t Base64::DecodeBlocks(const char* data, size_t len, T* result) {
+#ifdef HAVE_X86_INTRINSICS
+  // The vector decoders stop at the first block containing padding,
+  // whitespace or illegal characters, and otherwise decode exactly what
+  // GetNextQuantum would, so the scalar loop can pick up where they stop.
+  if (len >= 16 && CpuFeatures::Has(CpuFeatures::kSSSE3)) {
+    ASSERT(result->empty());
+    result->resize(len / 16 * 12 + 4);
+    unsigned char* out = reinterpret_cast<unsigned char*>(&(*result)[0]);
+    size_t dpos = 0;
+    if (CpuFeatures::Has(CpuFeatures::kAVX2)) {
+      dpos = DecodeAvx2(data, len, out);
+    }
+    dpos += DecodeSsse3(data + dpos, len - dpos, out + dpos / 4 * 3);
+    result->resize(dpos / 4 * 3);
+    return dpos;
+  }
+#endif
+  return 0;
+}
+
 template<typename T>
 bool Base64::DecodeFromArrayTemplate(const char* data, size_t len,
                                      DecodeFlags flags, T* result,
@@ -217,7 +440,7 @@ bool Base64::DecodeFromArrayTemplate(const char* data, size_t len,
   result->clear();
   result->reserve(len);
 
-  size_t dpos = 0;
+  size_t dpos = DecodeBlocks(data, len, result);
   bool success = true, padded;
   unsigned char c, qbuf[4];
   while (dpos < len) {
@@ -57,6 +57,13 @@ public:
   // encoded characters.
   static bool IsBase64Encoded(const std::string& str);
 
+  // Returns the number of characters needed to encode |len| bytes.
+  static size_t GetEncodedSize(size_t len);
+  // Encodes |len| bytes of |data| into |buffer|, without a terminating null.
+  // Returns the number of characters written, or 0 if |buflen| is less than
+  // GetEncodedSize(len).
+  static size_t EncodeToBuffer(const void* data, size_t len,
+                               char* buffer, size_t buflen);
   static void EncodeFromArray(const void* data, size_t len,
                               std::string* result);
   static bool DecodeFromArray(const char* data, size_t len, DecodeFlags flags,
@@ -93,6 +100,11 @@ private:
   static size_t GetNextQuantum(DecodeFlags parse_flags, bool illegal_pads,
                                const char* data, size_t len, size_t* dpos,
                                unsigned char qbuf[4], bool* padded);
+  // Decodes the leading run of whole quanta without padding, whitespace or
+  // illegal characters, when a vectorized decoder is available.  Returns the
+  // number of characters consumed.
+  template<typename T>
+  static size_t DecodeBlocks(const char* data, size_t len, T* result);
   template<typename T>
   static bool DecodeFromArrayTemplate(const char* data, size_t len,
                                       DecodeFlags flags, T* result,
@@ -27,10 +27,12 @@
 
 #include "talk/base/common.h"
 #include "talk/base/base64.h"
+#include "talk/base/cpufeatures.h"
 #include "talk/base/gunit.h"
 #include "talk/base/logging.h"
 #include "talk/base/stringutils.h"
 #include "talk/base/stream.h"
+#include "talk/base/timeutils.h"
 
 #include "talk/base/testbase64.h"
 
@@ -1016,3 +1018,106 @@ TEST(Base64, GetNextBase64Char) {
   EXPECT_FALSE(Base64::GetNextBase64Char('&', &next_char));
   EXPECT_FALSE(Base64::GetNextBase64Char('Z', NULL));
 }
+
+TEST(Base64, EncodeToBuffer) {
+  char buffer[8];
+  EXPECT_EQ(8u, Base64::GetEncodedSize(4));
+  EXPECT_EQ(0u, Base64::EncodeToBuffer("abcd", 4, buffer, 7));
+  EXPECT_EQ(8u, Base64::EncodeToBuffer("abcd", 4, buffer, sizeof(buffer)));
+  EXPECT_EQ("YWJjZA==", string(buffer, sizeof(buffer)));
+  EXPECT_EQ(0u, Base64::EncodeToBuffer("", 0, buffer, 0));
+}
+
+// Encodes and decodes every length up to a few vector blocks, with and
+// without the vectorized code, and with bad characters at every position so
+// the decoders have to hand over to the table-driven code mid-stream.
+static void TestImplementationsMatch(int features) {
+  string data;
+  for (int i = 0; i < 200; ++i) {
+    data.push_back(static_cast<char>(i * 37 + 11));
+  }
+  for (size_t len = 0; len <= data.size(); ++len) {
+    CpuFeatures::MaskForTest(0);
+    string expected = Base64::Encode(data.substr(0, len));
+    CpuFeatures::MaskForTest(features);
+    string encoded = Base64::Encode(data.substr(0, len));
+    ASSERT_EQ(expected, encoded) << "len " << len;
+    string decoded;
+    size_t used;
+    EXPECT_TRUE(Base64::DecodeFromArray(encoded.data(), encoded.size(),
+                                        Base64::DO_STRICT, &decoded, &used));
+    EXPECT_EQ(encoded.size(), used);
+    ASSERT_EQ(data.substr(0, len), decoded) << "len " << len;
+  }
+
+  string encoded = Base64::Encode(data);
+  for (size_t pos = 0; pos < encoded.size(); ++pos) {
+    for (int bad = 0; bad < 3; ++bad) {
+      string damaged = encoded;
+      damaged[pos] = " *="[bad];
+      for (int flags = 0; flags < 2; ++flags) {
+        Base64::DecodeFlags f = flags ? Base64::DO_LAX : Base64::DO_STRICT;
+        vector<char> expected, decoded;
+        size_t expected_used, used;
+        CpuFeatures::MaskForTest(0);
+        bool expected_ok = Base64::DecodeFromArray(
+            damaged.data(), damaged.size(), f, &expected, &expected_used);
+        CpuFeatures::MaskForTest(features);
+        bool ok = Base64::DecodeFromArray(
+            damaged.data(), damaged.size(), f, &decoded, &used);
+        EXPECT_EQ(expected_ok, ok);
+        EXPECT_EQ(expected_used, used);
+        ASSERT_TRUE(expected == decoded) << "pos " << pos << " bad " << bad;
+      }
+    }
+  }
+  CpuFeatures::MaskForTest(CpuFeatures::kAll);
+}
+
+TEST(Base64, Ssse3MatchesPortable) {
+  if (!CpuFeatures::Has(CpuFeatures::kSSSE3)) {
+    LOG(LS_INFO) << "SSSE3 not supported, skipping";
+    return;
+  }
+  TestImplementationsMatch(CpuFeatures::kSSSE3);
+}
+
+TEST(Base64, Avx2MatchesPortable) {
+  if (!CpuFeatures::Has(CpuFeatures::kSSSE3 | CpuFeatures::kAVX2)) {
+    LOG(LS_INFO) << "AVX2 not supported, skipping";
+    return;
+  }
+  TestImplementationsMatch(CpuFeatures::kAll);
+}
+
+// Test the throughput of encoding and decoding 1KB to 1MB inputs.
+TEST(Base64, DISABLED_Perf) {
+  for (size_t size = 1024; size <= 1024 * 1024; size *= 32) {
+    string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<char>(i * 7);
+    }
+    const int kIterations = static_cast<int>(32 * 1024 * 1024 / size);
+    for (int accelerated = 0; accelerated < 2; ++accelerated) {
+      CpuFeatures::MaskForTest(accelerated ? CpuFeatures::kAll : 0);
+      string encoded, decoded;
+      uint32 start = Time();
+      for (int i = 0; i < kIterations; ++i) {
+        Base64::EncodeFromArray(data.data(), data.size(), &encoded);
+      }
+      int encode_ms = TimeSince(start);
+      start = Time();
+      for (int i = 0; i < kIterations; ++i) {
+        Base64::DecodeFromArray(encoded.data(), encoded.size(),
+                                Base64::DO_STRICT, &decoded, NULL);
+      }
+      int decode_ms = TimeSince(start);
+      EXPECT_EQ(data, decoded);
+      LOG(LS_INFO) << "Base64 of 32 MB in " << size << " byte blocks, "
+                   << (accelerated ? "best available" : "portable")
+                   << ": encode " << encode_ms << " ms, decode "
+                   << decode_ms << " ms";
+    }
+  }
+  CpuFeatures::MaskForTest(CpuFeatures::kAll);
+}
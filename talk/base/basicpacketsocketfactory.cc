@@ -28,9 +28,11 @@
 #include "talk/base/basicpacketsocketfactory.h"
 
 #include "talk/base/asyncudpsocket.h"
+#include "talk/base/asyncstuntcpsocket.h"
 #include "talk/base/asynctcpsocket.h"
 #include "talk/base/logging.h"
 #include "talk/base/socketadapters.h"
+#include "talk/base/ssladapter.h"
 #include "talk/base/thread.h"
 
 namespace talk_base {
@@ -73,7 +75,15 @@ AsyncPacketSocket* BasicPacketSocketFactory::CreateUdpSocket(
 }
 
 AsyncPacketSocket* BasicPacketSocketFactory::CreateServerTcpSocket(
-    const SocketAddress& local_address, int min_port, int max_port, bool ssl) {
+    const SocketAddress& local_address, int min_port, int max_port,
+    int opts) {
+  // There is no server side TLS adapter.
+  if (opts & OPT_TLS) {
+    LOG(LS_ERROR) << "TLS isn't supported for server TCP sockets.";
+    return NULL;
+  }
+
+
   talk_base::AsyncSocket* socket =
       socket_factory()->CreateAsyncSocket(local_address.family(),
                                           SOCK_STREAM);
@@ -89,7 +99,7 @@ AsyncPacketSocket* BasicPacketSocketFactory::CreateServerTcpSocket(
   }
 
   // If using SSLTCP, wrap the TCP socket in a pseudo-SSL socket.
-  if (ssl) {
+  if (opts & OPT_SSLTCP) {
     socket = new talk_base::AsyncSSLSocket(socket);
   }
 
@@ -97,12 +107,15 @@ AsyncPacketSocket* BasicPacketSocketFactory::CreateServerTcpSocket(
   // See http://go/gtalktcpnodelayexperiment
   socket->SetOption(talk_base::Socket::OPT_NODELAY, 1);
 
+  if (opts & OPT_STUN) {
+    return new talk_base::AsyncStunTCPSocket(socket, true);
+  }
   return new talk_base::AsyncTCPSocket(socket, true);
 }
 
 AsyncPacketSocket* BasicPacketSocketFactory::CreateClientTcpSocket(
     const SocketAddress& local_address, const SocketAddress& remote_address,
-    const ProxyInfo& proxy_info, const std::string& user_agent, bool ssl) {
+    const ProxyInfo& proxy_info, const std::string& user_agent, int opts) {
   talk_base::AsyncSocket* socket =
       socket_factory()->CreateAsyncSocket(local_address.family(), SOCK_STREAM);
   if (!socket) {
@@ -126,9 +139,26 @@ AsyncPacketSocket* BasicPacketSocketFactory::CreateClientTcpSocket(
         proxy_info.username, proxy_info.password);
   }
 
-  // If using SSLTCP, wrap the TCP socket in a pseudo-SSL socket.
-  if (ssl) {
+  // If using SSLTCP, wrap the TCP socket in a pseudo-SSL socket. If using
+  // TLS, start a real TLS handshake as soon as the socket connects.
+  if (opts & OPT_SSLTCP) {
     socket = new talk_base::AsyncSSLSocket(socket);
+  } else if (opts & OPT_TLS) {
+    talk_base::SSLAdapter* ssl_adapter = talk_base::SSLAdapter::Create(socket);
+    if (!ssl_adapter) {
+      LOG(LS_ERROR) << "TLS isn't available.";
+      delete socket;
+      return NULL;
+    }
+    socket = ssl_adapter;
+    const std::string hostname = remote_address.hostname().empty() ?
+        remote_address.ipaddr().ToString() : remote_address.hostname();
+    if (ssl_adapter->StartSSL(hostname.c_str(), false) != 0) {
+      LOG(LS_ERROR) << "TLS start failed with error "
+                    << socket->GetError();
+      delete socket;
+      return NULL;
+    }
   }
 
   if (socket->Connect(remote_address) < 0) {
@@ -139,8 +169,12 @@ AsyncPacketSocket* BasicPacketSocketFactory::CreateClientTcpSocket(
   }
 
   // Finally, wrap that socket in a TCP packet socket.
-  talk_base::AsyncTCPSocket* tcp_socket =
-      new talk_base::AsyncTCPSocket(socket, false);
+  talk_base::AsyncTCPSocket* tcp_socket;
+  if (opts & OPT_STUN) {
+    tcp_socket = new talk_base::AsyncStunTCPSocket(socket, false);
+  } else {
+    tcp_socket = new talk_base::AsyncTCPSocket(socket, false);
+  }
 
   // Set TCP_NODELAY (via OPT_NODELAY) for improved performance.
   // See http://go/gtalktcpnodelayexperiment
@@ -46,10 +46,12 @@ class BasicPacketSocketFactory : public PacketSocketFactory {
   virtual AsyncPacketSocket* CreateUdpSocket(
       const SocketAddress& local_address, int min_port, int max_port);
   virtual AsyncPacketSocket* CreateServerTcpSocket(
-      const SocketAddress& local_address, int min_port, int max_port, bool ssl);
+      const SocketAddress& local_address, int min_port, int max_port,
+      int opts);
   virtual AsyncPacketSocket* CreateClientTcpSocket(
       const SocketAddress& local_address, const SocketAddress& remote_address,
-      const ProxyInfo& proxy_info, const std::string& user_agent, bool ssl);
+      const ProxyInfo& proxy_info, const std::string& user_agent,
+      int opts);
 
  private:
   int BindSocket(AsyncSocket* socket, const SocketAddress& local_address,
@@ -0,0 +1,120 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/cpufeatures.h"
+
+#if defined(_MSC_VER) && defined(CPU_X86)
+#include <intrin.h>
+#endif
+
+namespace talk_base {
+
+#if defined(CPU_X86)
+#if defined(_MSC_VER)
+static void CpuId(int cpu_info[4], int leaf) {
+  __cpuidex(cpu_info, leaf, 0);
+}
+
+static uint64 GetXcr0() {
+  return _xgetbv(0);
+}
+#else
+static void CpuId(int cpu_info[4], int leaf) {
+#if defined(__pic__) && defined(__i386__)
+  // 32 bit fpic requires ebx be preserved.
+  __asm__ volatile (  // NOLINT
+    "mov %%ebx, %%edi\n"
+    "cpuid\n"
+    "xchg %%edi, %%ebx\n"
+    : "=a"(cpu_info[0]), "=D"(cpu_info[1]), "=c"(cpu_info[2]), "=d"(cpu_info[3])
+    : "a"(leaf), "c"(0)
+  );  // NOLINT
+#else
+  __asm__ volatile (  // NOLINT
+    "cpuid\n"
+    : "=a"(cpu_info[0]), "=b"(cpu_info[1]), "=c"(cpu_info[2]), "=d"(cpu_info[3])
+    : "a"(leaf), "c"(0)
+  );  // NOLINT
+#endif
+}
+
+static uint64 GetXcr0() {
+  uint32 eax, edx;
+  // xgetbv, spelled out for assemblers that don't know it.
+  __asm__ volatile (".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64>(edx) << 32) | eax;
+}
+#endif  // !_MSC_VER
+#endif  // CPU_X86
+
+static const int kUninitialized = 0;
+static const int kInitialized = 0x40000000;  // Not a feature flag.
+static int cpu_flags = kUninitialized;
+static int cpu_flags_mask = CpuFeatures::kAll;
+
+bool CpuFeatures::Has(int flags) {
+  // Racing initializations compute the same value, so no lock is needed.
+  int detected = cpu_flags;
+  if (detected == kUninitialized) {
+    detected = cpu_flags = Detect();
+  }
+  return (detected & cpu_flags_mask & flags) == flags;
+}
+
+void CpuFeatures::MaskForTest(int enable_flags) {
+  cpu_flags_mask = enable_flags;
+}
+
+int CpuFeatures::Detect() {
+  int flags = kInitialized;
+#if defined(CPU_X86)
+  int info[4];
+  CpuId(info, 0);
+  int max_leaf = info[0];
+  CpuId(info, 1);
+  if (info[3] & (1 << 26)) flags |= kSSE2;
+  if (info[2] & (1 << 9)) flags |= kSSSE3;
+  if (info[2] & (1 << 19)) flags |= kSSE41;
+  if (info[2] & (1 << 1)) flags |= kPCLMUL;
+  // AVX2 is only usable if the OS saves the YMM registers (OSXSAVE + XCR0).
+  bool os_saves_ymm = (info[2] & (1 << 27)) && ((GetXcr0() & 6) == 6);
+  if (max_leaf >= 7) {
+    CpuId(info, 7);
+    if ((info[1] & (1 << 5)) && os_saves_ymm) flags |= kAVX2;
+    if (info[1] & (1 << 29)) flags |= kSHA;
+  }
+  CpuId(info, 0x80000000);
+  if (static_cast<uint32>(info[0]) >= 0x80000007) {
+    CpuId(info, 0x80000007);
+    if (info[3] & (1 << 8)) flags |= kInvariantTSC;
+  }
+#endif
+  return flags;
+}
+
+}  // namespace talk_base
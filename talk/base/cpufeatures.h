@@ -0,0 +1,79 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_BASE_CPUFEATURES_H_
+#define TALK_BASE_CPUFEATURES_H_
+
+#include "talk/base/basictypes.h"  // For CPU_X86, DISALLOW_IMPLICIT_...
+
+// Accelerated functions are compiled with a per-function target attribute,
+// so the rest of the build doesn't need flags like -msse4.1, and are only
+// called after checking CpuFeatures::Has().  MSVC doesn't need the attribute.
+#if defined(CPU_X86) && (defined(_MSC_VER) || defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ * 100 + __GNUC_MINOR__ >= 409)))
+#define HAVE_X86_INTRINSICS 1
+#if defined(_MSC_VER)
+#define X86_TARGET(features)
+#else
+#define X86_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+namespace talk_base {
+
+// Runtime detection of instruction set extensions, for choosing between the
+// portable and the accelerated versions of hot loops (digests, checksums and
+// string encodings).  All flags are false on non-x86 processors.
+class CpuFeatures {
+ public:
+  static const int kSSE2 = 0x1;
+  static const int kSSSE3 = 0x2;
+  static const int kSSE41 = 0x4;
+  static const int kPCLMUL = 0x8;
+  static const int kAVX2 = 0x10;  // Also requires OS support for YMM state.
+  static const int kSHA = 0x20;
+  static const int kInvariantTSC = 0x40;  // TSC rate ignores P- and C-states.
+  static const int kAll = -1;
+
+  // Returns true if the CPU supports all of the features in |flags|.
+  static bool Has(int flags);
+
+  // For testing, hides all features not in |enable_flags|, so that the
+  // portable implementations can be compared with the accelerated ones.
+  // Pass kAll to restore the detected features.
+  static void MaskForTest(int enable_flags);
+
+ private:
+  static int Detect();
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(CpuFeatures);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_CPUFEATURES_H_
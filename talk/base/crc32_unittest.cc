@@ -25,8 +25,11 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "talk/base/cpufeatures.h"
 #include "talk/base/crc32.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/timeutils.h"
 
 #include <string>
 
@@ -49,4 +52,82 @@ TEST(Crc32Test, TestMultipleUpdates) {
   EXPECT_EQ(0x171A3F5FU, c);
 }
 
+// Bit-at-a-time CRC32, for checking the table-driven implementations.
+static uint32 ReferenceCrc32(const uint8* buf, size_t len) {
+  uint32 c = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    c ^= buf[i];
+    for (int j = 0; j < 8; ++j) {
+      c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+    }
+  }
+  return c ^ 0xFFFFFFFF;
+}
+
+// Checks all lengths and alignments around the block sizes used by the
+// slice-by-8 and carry-less multiplication paths.
+static void TestAgainstReference() {
+  uint8 data[512 + 16];
+  for (size_t i = 0; i < sizeof(data); ++i) {
+    data[i] = static_cast<uint8>(i * 131 + 7);
+  }
+  for (size_t offset = 0; offset < 16; offset += 5) {
+    for (size_t len = 0; len <= 512; ++len) {
+      EXPECT_EQ(ReferenceCrc32(data + offset, len),
+                ComputeCrc32(data + offset, len))
+          << "offset " << offset << " len " << len;
+    }
+  }
+  // Splitting the input must not change the result.
+  uint32 c = UpdateCrc32(0, data, 100);
+  c = UpdateCrc32(c, data + 100, 300);
+  EXPECT_EQ(ReferenceCrc32(data, 400), c);
+}
+
+TEST(Crc32Test, TestPortableImplementation) {
+  CpuFeatures::MaskForTest(0);
+  TestAgainstReference();
+  CpuFeatures::MaskForTest(CpuFeatures::kAll);
+}
+
+TEST(Crc32Test, TestAcceleratedImplementation) {
+  if (!CpuFeatures::Has(CpuFeatures::kPCLMUL | CpuFeatures::kSSE41)) {
+    LOG(LS_INFO) << "PCLMULQDQ not supported, skipping";
+    return;
+  }
+  TestAgainstReference();
+}
+
+// Compares the throughput of the implementations over 100 MB of input.
+TEST(Crc32Test, DISABLED_Perf) {
+  const size_t kSize = 1024 * 1024;
+  const int kIterations = 100;
+  std::string data(kSize, 'x');
+
+  uint32 start = Time();
+  uint32 c = 0;
+  for (int i = 0; i < kIterations / 10; ++i) {
+    c = ReferenceCrc32(reinterpret_cast<const uint8*>(data.data()), kSize);
+  }
+  int bitwise_ms = TimeSince(start) * 10;
+
+  CpuFeatures::MaskForTest(0);
+  start = Time();
+  for (int i = 0; i < kIterations; ++i) {
+    EXPECT_EQ(c, ComputeCrc32(data));
+  }
+  int portable_ms = TimeSince(start);
+  CpuFeatures::MaskForTest(CpuFeatures::kAll);
+
+  start = Time();
+  for (int i = 0; i < kIterations; ++i) {
+    EXPECT_EQ(c, ComputeCrc32(data));
+  }
+  int accelerated_ms = TimeSince(start);
+
+  LOG(LS_INFO) << "CRC32 of " << kIterations << " MB: bitwise "
+               << bitwise_ms << " ms, slice-by-8 " << portable_ms
+               << " ms, best available " << accelerated_ms << " ms";
+}
+
 }  // namespace talk_base
@@ -183,6 +183,11 @@ class AtomicOps {
   static int Decrement(int* i) {
     return ::InterlockedDecrement(reinterpret_cast<LONG*>(i));
   }
+  // Keeps the compiler and the processor from moving loads and stores
+  // across the call.
+  static void Barrier() {
+    MemoryBarrier();
+  }
 #else
   static int Increment(int* i) {
     // Could be faster, and less readable:
@@ -200,6 +205,10 @@ class AtomicOps {
     return --(*i);
   }
 
+  static void Barrier() {
+    __sync_synchronize();
+  }
+
  private:
   static CriticalSection* StaticCrit() {
     static CriticalSection* crit = new CriticalSection();
@@ -27,10 +27,14 @@
 
 #include <time.h>
 
+#include <algorithm>
+#include <vector>
+
 #ifdef WIN32
 #include "talk/base/win32.h"
 #endif
 
+#include "talk/base/bytebuffer.h"
 #include "talk/base/common.h"
 #include "talk/base/diskcache.h"
 #include "talk/base/fileutils.h"
@@ -38,6 +42,7 @@
 #include "talk/base/stream.h"
 #include "talk/base/stringencode.h"
 #include "talk/base/stringutils.h"
+#include "talk/base/thread.h"
 
 #ifdef _DEBUG
 #define TRANSPARENT_CACHE_NAMES 1
@@ -47,6 +52,11 @@
 
 namespace talk_base {
 
+// The index file name has no numeric extension, so FilenameToId ignores it.
+static const char kIndexFilename[] = "diskcache.idx";
+static const uint32 kIndexMagic = 0x4A444358;  // 'JDCX'
+static const uint32 kIndexVersion = 1;
+
 class DiskCache;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -55,30 +65,60 @@ class DiskCache;
 
 class DiskCacheAdapter : public StreamAdapterInterface {
 public:
+  // If |io_thread| is given, |stream| writes on it, and it is closed there
+  // too; otherwise the last of the data would be written by whichever thread
+  // happened to close it.
   DiskCacheAdapter(const DiskCache* cache, const std::string& id, size_t index,
-                   StreamInterface* stream)
-  : StreamAdapterInterface(stream), cache_(cache), id_(id), index_(index)
+                   StreamInterface* stream, Thread* io_thread = NULL)
+  : StreamAdapterInterface(stream), cache_(cache), id_(id), index_(index),
+    io_thread_(io_thread)
   { }
   virtual ~DiskCacheAdapter() {
     Close();
     cache_->ReleaseResource(id_, index_);
   }
 
+  // Waits for the I/O thread to write out what is left, so that the resource
+  // is complete by the time it is released.
+  virtual void Close() {
+    if (io_thread_ && !io_thread_->IsCurrent()) {
+      io_thread_->Send(this, MSG_CLOSE);
+    } else {
+      StreamAdapterInterface::Close();
+    }
+  }
+
+protected:
+  virtual void OnMessage(Message* msg) {
+    if (MSG_CLOSE == msg->message_id) {
+      StreamAdapterInterface::Close();
+    } else {
+      StreamAdapterInterface::OnMessage(msg);
+    }
+  }
+
 private:
+  enum { MSG_CLOSE = MSG_MAX + 1 };
+
   const DiskCache* cache_;
   std::string id_;
   size_t index_;
+  Thread* io_thread_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 // DiskCache
 ///////////////////////////////////////////////////////////////////////////////
 
-DiskCache::DiskCache() : max_cache_(0), total_size_(0), total_accessors_(0) {
+DiskCache::DiskCache()
+    : max_cache_(0), total_size_(0), total_accessors_(0), io_thread_(NULL) {
 }
 
 DiskCache::~DiskCache() {
   ASSERT(0 == total_accessors_);
+  if (!folder_.empty()) {
+    SaveIndex();
+  }
 }
 
 bool DiskCache::Initialize(const std::string& folder, size_t size) {
@@ -89,8 +129,11 @@ bool DiskCache::Initialize(const std::string& folder, size_t size) {
   max_cache_ = size;
   ASSERT(0 == total_size_);
 
-  if (!InitializeEntries())
-    return false;
+  if (!LoadIndex()) {
+    if (!InitializeEntries())
+      return false;
+    SortByLastModified();
+  }
 
   return CheckLimit();
 }
@@ -108,9 +151,46 @@ bool DiskCache::Purge() {
     return false;
 
   map_.clear();
+  lru_.clear();
+  total_size_ = 0;
   return true;
 }
 
+bool DiskCache::SaveIndex() {
+  if (folder_.empty())
+    return false;
+
+  if (total_accessors_ > 0) {
+    LOG_F(LS_WARNING) << "Cache files open";
+    return false;
+  }
+
+  ByteBuffer buf;
+  buf.WriteUInt32(kIndexMagic);
+  buf.WriteUInt32(kIndexVersion);
+  buf.WriteUInt32(static_cast<uint32>(map_.size()));
+  for (LruList::const_iterator it = lru_.begin(); it != lru_.end(); ++it) {
+    const Entry* entry = GetEntry(*it);
+    ASSERT(NULL != entry);
+    if (LS_UNLOCKED != entry->lock_state) {
+      LOG_F(LS_WARNING) << "Cache resources locked";
+      return false;
+    }
+    buf.WriteUInt16(static_cast<uint16>(it->length()));
+    buf.WriteString(*it);
+    buf.WriteUInt64(entry->size);
+    buf.WriteUInt32(static_cast<uint32>(entry->streams));
+    buf.WriteUInt64(static_cast<uint64>(entry->last_modified));
+  }
+
+  FileStream file;
+  if (!file.Open(IndexFilename(), "wb", NULL)) {
+    LOG_F(LS_ERROR) << "Couldn't create cache index";
+    return false;
+  }
+  return (SR_SUCCESS == file.WriteAll(buf.Data(), buf.Length(), NULL, NULL));
+}
+
 bool DiskCache::LockResource(const std::string& id) {
   Entry* entry = GetOrCreateEntry(id, true);
   if (LS_LOCKED == entry->lock_state)
@@ -122,6 +202,7 @@ bool DiskCache::LockResource(const std::string& id) {
     return false;
   }
   entry->lock_state = LS_LOCKED;
+  Touch(entry);
   return true;
 }
 
@@ -138,7 +219,7 @@ StreamInterface* DiskCache::WriteResource(const std::string& id, size_t index) {
     previous_size = entry->size;
   }
 
-  scoped_ptr<FileStream> file(new FileStream);
+  scoped_ptr<FileStream> file(CreateFileStream());
   if (!file->Open(filename, "wb", NULL)) {
     LOG_F(LS_ERROR) << "Couldn't create cache file";
     return NULL;
@@ -150,9 +231,19 @@ StreamInterface* DiskCache::WriteResource(const std::string& id, size_t index) {
 
   entry->accessors += 1;
   total_accessors_ += 1;
+  if (io_thread_) {
+    return new DiskCacheAdapter(this, id, index,
+                                new AsyncWriteStream(file.release(),
+                                                     io_thread_),
+                                io_thread_);
+  }
   return new DiskCacheAdapter(this, id, index, file.release());
 }
 
+FileStream* DiskCache::CreateFileStream() const {
+  return new FileStream;
+}
+
 bool DiskCache::UnlockResource(const std::string& id) {
   Entry* entry = GetOrCreateEntry(id, false);
   if (LS_LOCKED != entry->lock_state)
@@ -180,6 +271,7 @@ StreamInterface* DiskCache::ReadResource(const std::string& id,
   if (!file->Open(IdToFilename(id, index), "rb", NULL))
     return NULL;
 
+  Touch(entry);
   entry->accessors += 1;
   total_accessors_ += 1;
   return new DiskCacheAdapter(this, id, index, file.release());
@@ -222,6 +314,7 @@ bool DiskCache::DeleteResource(const std::string& id) {
   }
 
   total_size_ -= entry->size;
+  lru_.erase(entry->lru);
   map_.erase(id);
   return success;
 }
@@ -236,26 +329,23 @@ bool DiskCache::CheckLimit() {
   ASSERT(cache_size == total_size_);
 #endif  // _DEBUG
 
-  // TODO: Replace this with a non-brain-dead algorithm for clearing out the
-  // oldest resources... something that isn't O(n^2)
+  // Evict from the least recently used end.  Resources in use are skipped,
+  // which is rare, so this is normally O(1) per eviction.
+  LruList::iterator it = lru_.begin();
   while (total_size_ > max_cache_) {
-    EntryMap::iterator oldest = map_.end();
-    for (EntryMap::iterator it = map_.begin(); it != map_.end(); ++it) {
-      if ((LS_UNLOCKED != it->second.lock_state) || (it->second.accessors > 0))
-        continue;
-      oldest = it;
-      break;
+    while (it != lru_.end()) {
+      const Entry* entry = GetEntry(*it);
+      if ((LS_UNLOCKED == entry->lock_state) && (0 == entry->accessors))
+        break;
+      ++it;
     }
-    if (oldest == map_.end()) {
+    if (it == lru_.end()) {
       LOG_F(LS_WARNING) << "All resources are locked!";
       return false;
     }
-    for (EntryMap::iterator it = oldest++; it != map_.end(); ++it) {
-      if (it->second.last_modified < oldest->second.last_modified) {
-        oldest = it;
-      }
-    }
-    if (!DeleteResource(oldest->first)) {
+    // DeleteResource erases the list node, so step past it first.
+    std::string id(*it++);
+    if (!DeleteResource(id)) {
       LOG_F(LS_ERROR) << "Couldn't delete from cache!";
       return false;
     }
@@ -263,6 +353,86 @@ bool DiskCache::CheckLimit() {
   return true;
 }
 
+static bool CompareLastModified(const std::pair<time_t, std::string>& a,
+                                const std::pair<time_t, std::string>& b) {
+  return a.first < b.first;
+}
+
+void DiskCache::SortByLastModified() {
+  std::vector<std::pair<time_t, std::string> > order;
+  order.reserve(map_.size());
+  for (EntryMap::const_iterator it = map_.begin(); it != map_.end(); ++it) {
+    order.push_back(std::make_pair(it->second.last_modified, it->first));
+  }
+  std::stable_sort(order.begin(), order.end(), CompareLastModified);
+  for (size_t i = 0; i < order.size(); ++i) {
+    Entry* entry = GetOrCreateEntry(order[i].second, false);
+    lru_.splice(lru_.end(), lru_, entry->lru);
+  }
+}
+
+void DiskCache::Touch(const Entry* entry) const {
+  lru_.splice(lru_.end(), lru_, entry->lru);
+}
+
+std::string DiskCache::IndexFilename() const {
+  Pathname pathname;
+  pathname.SetFolder(folder_);
+  pathname.SetFilename(kIndexFilename);
+  return pathname.pathname();
+}
+
+bool DiskCache::LoadIndex() {
+  std::string filename(IndexFilename());
+  size_t length = 0;
+  if (!FileExists(filename) || !FileStream::GetSize(filename, &length))
+    return false;
+
+  FileStream file;
+  if (!file.Open(filename, "rb", NULL))
+    return false;
+  scoped_array<char> data(new char[length]);
+  if (SR_SUCCESS != file.ReadAll(data.get(), length, NULL, NULL))
+    return false;
+  file.Close();
+
+  // The index describes the folder as of the last SaveIndex.  Remove it now,
+  // so that if we exit without saving, the next run rescans the folder rather
+  // than trusting a stale index.
+  DeleteFile(filename);
+
+  ByteBuffer buf(data.get(), length);
+  uint32 magic, version, count;
+  if (!buf.ReadUInt32(&magic) || (kIndexMagic != magic) ||
+      !buf.ReadUInt32(&version) || (kIndexVersion != version) ||
+      !buf.ReadUInt32(&count)) {
+    LOG_F(LS_WARNING) << "Ignoring unrecognized cache index";
+    return false;
+  }
+
+  for (uint32 i = 0; i < count; ++i) {
+    uint16 id_length;
+    std::string id;
+    uint64 size, last_modified;
+    uint32 streams;
+    if (!buf.ReadUInt16(&id_length) || !buf.ReadString(&id, id_length) ||
+        !buf.ReadUInt64(&size) || !buf.ReadUInt32(&streams) ||
+        !buf.ReadUInt64(&last_modified) || (NULL != GetEntry(id))) {
+      LOG_F(LS_WARNING) << "Corrupt cache index";
+      map_.clear();
+      lru_.clear();
+      total_size_ = 0;
+      return false;
+    }
+    Entry* entry = GetOrCreateEntry(id, true);
+    entry->size = static_cast<size_t>(size);
+    entry->streams = streams;
+    entry->last_modified = static_cast<time_t>(last_modified);
+    total_size_ += entry->size;
+  }
+  return true;
+}
+
 std::string DiskCache::IdToFilename(const std::string& id, size_t index) const {
 #ifdef TRANSPARENT_CACHE_NAMES
   // This escapes colons and other filesystem characters, so the user can't open
@@ -324,6 +494,7 @@ DiskCache::Entry* DiskCache::GetOrCreateEntry(const std::string& id,
   e.size = 0;
   e.streams = 0;
   e.last_modified = time(0);
+  e.lru = lru_.insert(lru_.end(), id);
   it = map_.insert(EntryMap::value_type(id, e)).first;
   return &it->second;
 }
@@ -28,6 +28,7 @@
 #ifndef TALK_BASE_DISKCACHE_H__
 #define TALK_BASE_DISKCACHE_H__
 
+#include <list>
 #include <map>
 #include <string>
 
@@ -37,7 +38,9 @@
 
 namespace talk_base {
 
+class FileStream;
 class StreamInterface;
+class Thread;
 
 ///////////////////////////////////////////////////////////////////////////////
 // DiskCache - An LRU cache of streams, stored on disk.
@@ -49,6 +52,12 @@ class StreamInterface;
 // DiskCache is designed to persist across executions of the program.  It is
 // safe for use from an arbitrary number of users on a single thread, but not
 // from multiple threads or other processes.
+// The set of resources and their recency is saved to an index file in the
+// cache folder by SaveIndex (and on destruction), so that the next Initialize
+// can skip scanning the folder.  Resources are evicted in least-recently-used
+// order; both reading and writing a resource count as a use.
+// If an I/O thread is provided, writes to resource streams are buffered and
+// performed on that thread.
 ///////////////////////////////////////////////////////////////////////////////
 
 class DiskCache {
@@ -59,6 +68,20 @@ public:
   bool Initialize(const std::string& folder, size_t size);
   bool Purge();
 
+  // Writes the current entries to the index file, so that a subsequent
+  // Initialize doesn't have to enumerate the folder.  Fails if any resource
+  // is locked or open.
+  bool SaveIndex();
+
+  // Streams returned by WriteResource will write on |thread| instead of the
+  // calling thread.  Closing one waits for |thread| to write out the rest of
+  // the data.  The thread is not owned, and must outlive the streams.
+  void set_io_thread(Thread* thread) { io_thread_ = thread; }
+  Thread* io_thread() const { return io_thread_; }
+
+  size_t size() const { return total_size_; }
+  size_t max_size() const { return max_cache_; }
+
   bool LockResource(const std::string& id);
   StreamInterface* WriteResource(const std::string& id, size_t index);
   bool UnlockResource(const std::string& id);
@@ -75,20 +98,35 @@ public:
 
   virtual bool FileExists(const std::string& filename) const = 0;
   virtual bool DeleteFile(const std::string& filename) const = 0;
+  // Creates the stream that a resource is written through, before it is
+  // opened.  Overridable for tests.
+  virtual FileStream* CreateFileStream() const;
 
   enum LockState { LS_UNLOCKED, LS_LOCKED, LS_UNLOCKING };
+  // Ids ordered from least to most recently used.
+  typedef std::list<std::string> LruList;
   struct Entry {
     LockState lock_state;
     mutable size_t accessors;
     size_t size;
     size_t streams;
     time_t last_modified;
+    LruList::iterator lru;
   };
   typedef std::map<std::string, Entry> EntryMap;
   friend class DiskCacheAdapter;
 
   bool CheckLimit();
 
+  // Orders the LRU list by last_modified.  Implementations of
+  // InitializeEntries don't need to create entries in any particular order.
+  void SortByLastModified();
+  // Moves the entry to the most recently used end of the LRU list.
+  void Touch(const Entry* entry) const;
+
+  std::string IndexFilename() const;
+  bool LoadIndex();
+
   std::string IdToFilename(const std::string& id, size_t index) const;
   bool FilenameToId(const std::string& filename, std::string* id,
                     size_t* index) const;
@@ -103,7 +141,9 @@ public:
   std::string folder_;
   size_t max_cache_, total_size_;
   EntryMap map_;
+  mutable LruList lru_;
   mutable size_t total_accessors_;
+  Thread* io_thread_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,298 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string>
+
+#include "talk/base/diskcache.h"
+#include "talk/base/fileutils.h"
+#include "talk/base/gunit.h"
+#include "talk/base/pathutils.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/stream.h"
+#include "talk/base/stringencode.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+static const size_t kCacheSize = 100;
+
+// A FileStream that remembers which thread last wrote to it.
+class ThreadRecordingFileStream : public FileStream {
+ public:
+  explicit ThreadRecordingFileStream(Thread** write_thread)
+      : write_thread_(write_thread) {}
+  virtual StreamResult Write(const void* data, size_t data_len,
+                             size_t* written, int* error) {
+    *write_thread_ = Thread::Current();
+    return FileStream::Write(data, data_len, written, error);
+  }
+
+ private:
+  Thread** write_thread_;
+};
+
+// A DiskCache that discovers its entries through the Filesystem interface.
+class TestDiskCache : public DiskCache {
+ public:
+  TestDiskCache() : scans_(0), write_thread_(NULL) {}
+  int scans() const { return scans_; }
+  Thread* write_thread() const { return write_thread_; }
+
+ protected:
+  virtual bool InitializeEntries() {
+    ++scans_;
+    DirectoryIterator it;
+    if (!it.Iterate(Pathname(folder_)))
+      return true;
+    do {
+      size_t index;
+      std::string id;
+      if (it.IsDirectory() || !FilenameToId(it.Name(), &id, &index))
+        continue;
+      Entry* entry = GetOrCreateEntry(id, true);
+      entry->size += it.FileSize();
+      total_size_ += it.FileSize();
+      entry->streams = _max(entry->streams, index + 1);
+      entry->last_modified = it.FileModifyTime();
+    } while (it.Next());
+    return true;
+  }
+  virtual bool PurgeFiles() {
+    return Filesystem::DeleteFolderContents(Pathname(folder_));
+  }
+  virtual bool FileExists(const std::string& filename) const {
+    return Filesystem::IsFile(Pathname(filename));
+  }
+  virtual bool DeleteFile(const std::string& filename) const {
+    return Filesystem::DeleteFile(Pathname(filename));
+  }
+  virtual FileStream* CreateFileStream() const {
+    return new ThreadRecordingFileStream(&write_thread_);
+  }
+
+ private:
+  int scans_;
+  mutable Thread* write_thread_;
+};
+
+class DiskCacheTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    Pathname temp;
+    ASSERT_TRUE(Filesystem::GetTemporaryFolder(temp, true, NULL));
+    // TempFilename creates a placeholder file with the name we want.
+    std::string name = Filesystem::TempFilename(temp, "diskcache");
+    Filesystem::DeleteFile(Pathname(name));
+    folder_.SetFolder(name);
+  }
+  virtual void TearDown() {
+    Filesystem::DeleteFolderAndContents(folder_);
+  }
+
+  static bool Write(DiskCache* cache, const std::string& id,
+                    const std::string& data) {
+    CacheLock lock(cache, id, true);
+    if (!lock.IsLocked())
+      return false;
+    scoped_ptr<StreamInterface> stream(cache->WriteResource(id, 0));
+    if (!stream || SR_SUCCESS != stream->WriteAll(data.data(), data.length(),
+                                                  NULL, NULL)) {
+      return false;
+    }
+    stream.reset();
+    lock.Commit();
+    return true;
+  }
+
+  static std::string Read(DiskCache* cache, const std::string& id) {
+    scoped_ptr<StreamInterface> stream(cache->ReadResource(id, 0));
+    std::string data;
+    if (stream) {
+      char buffer[64];
+      size_t read;
+      while (SR_SUCCESS == stream->Read(buffer, sizeof(buffer), &read, NULL)) {
+        data.append(buffer, read);
+      }
+    }
+    return data;
+  }
+
+  Pathname folder_;
+};
+
+TEST_F(DiskCacheTest, WriteAndRead) {
+  TestDiskCache cache;
+  ASSERT_TRUE(cache.Initialize(folder_.pathname(), kCacheSize));
+  EXPECT_FALSE(cache.HasResource("a"));
+  EXPECT_TRUE(Write(&cache, "a", "hello"));
+  EXPECT_TRUE(cache.HasResource("a"));
+  EXPECT_TRUE(cache.HasResourceStream("a", 0));
+  EXPECT_FALSE(cache.HasResourceStream("a", 1));
+  EXPECT_EQ(5U, cache.size());
+  EXPECT_EQ("hello", Read(&cache, "a"));
+  EXPECT_TRUE(cache.DeleteResource("a"));
+  EXPECT_FALSE(cache.HasResource("a"));
+  EXPECT_EQ(0U, cache.size());
+}
+
+TEST_F(DiskCacheTest, EvictsLeastRecentlyUsed) {
+  TestDiskCache cache;
+  ASSERT_TRUE(cache.Initialize(folder_.pathname(), 30));
+  std::string data(10, 'x');
+  EXPECT_TRUE(Write(&cache, "a", data));
+  EXPECT_TRUE(Write(&cache, "b", data));
+  EXPECT_TRUE(Write(&cache, "c", data));
+  // Reading "a" makes "b" the least recently used.
+  EXPECT_EQ(data, Read(&cache, "a"));
+  EXPECT_TRUE(Write(&cache, "d", data));
+  EXPECT_TRUE(cache.HasResource("a"));
+  EXPECT_FALSE(cache.HasResource("b"));
+  EXPECT_TRUE(cache.HasResource("c"));
+  EXPECT_TRUE(cache.HasResource("d"));
+  EXPECT_EQ(30U, cache.size());
+}
+
+TEST_F(DiskCacheTest, OpenResourcesAreNotEvicted) {
+  TestDiskCache cache;
+  ASSERT_TRUE(cache.Initialize(folder_.pathname(), 20));
+  std::string data(10, 'x');
+  EXPECT_TRUE(Write(&cache, "a", data));
+  EXPECT_TRUE(Write(&cache, "b", data));
+  scoped_ptr<StreamInterface> reader(cache.ReadResource("a", 0));
+  ASSERT_TRUE(reader.get() != NULL);
+  // "a" is older, but it is open, so "b" must go instead.
+  Read(&cache, "b");
+  EXPECT_TRUE(Write(&cache, "c", data));
+  EXPECT_TRUE(cache.HasResource("a"));
+  EXPECT_FALSE(cache.HasResource("b"));
+  EXPECT_TRUE(cache.HasResource("c"));
+}
+
+TEST_F(DiskCacheTest, IndexPersistsEntriesAndOrder) {
+  std::string data(10, 'x');
+  {
+    TestDiskCache cache;
+    ASSERT_TRUE(cache.Initialize(folder_.pathname(), 30));
+    EXPECT_TRUE(Write(&cache, "a", data));
+    EXPECT_TRUE(Write(&cache, "b", data));
+    EXPECT_TRUE(Write(&cache, "c", data));
+    EXPECT_EQ(data, Read(&cache, "a"));
+    EXPECT_TRUE(cache.SaveIndex());
+  }
+
+  TestDiskCache cache;
+  ASSERT_TRUE(cache.Initialize(folder_.pathname(), 30));
+  EXPECT_EQ(0, cache.scans());
+  EXPECT_EQ(30U, cache.size());
+  EXPECT_TRUE(cache.HasResourceStream("c", 0));
+  EXPECT_TRUE(Write(&cache, "d", data));
+  EXPECT_TRUE(cache.HasResource("a"));
+  EXPECT_FALSE(cache.HasResource("b"));
+}
+
+TEST_F(DiskCacheTest, RescansWithoutIndex) {
+  {
+    TestDiskCache cache;
+    ASSERT_TRUE(cache.Initialize(folder_.pathname(), kCacheSize));
+    EXPECT_TRUE(Write(&cache, "a", "hello"));
+  }
+  // Simulate a crash, where the index is never written.
+  Filesystem::DeleteFile(Pathname(folder_.pathname(), "diskcache.idx"));
+
+  TestDiskCache cache;
+  ASSERT_TRUE(cache.Initialize(folder_.pathname(), kCacheSize));
+  EXPECT_EQ(1, cache.scans());
+  EXPECT_EQ(5U, cache.size());
+  EXPECT_EQ("hello", Read(&cache, "a"));
+}
+
+TEST_F(DiskCacheTest, WritesOnIoThread) {
+  Thread io_thread;
+  io_thread.Start();
+  TestDiskCache cache;
+  cache.set_io_thread(&io_thread);
+  ASSERT_TRUE(cache.Initialize(folder_.pathname(), kCacheSize));
+  std::string data(50, 'y');
+  EXPECT_TRUE(Write(&cache, "a", data));
+  EXPECT_EQ(50U, cache.size());
+  EXPECT_EQ(data, Read(&cache, "a"));
+  EXPECT_EQ(&io_thread, cache.write_thread());
+
+  // Without an I/O thread, the write happens on the caller's.
+  cache.set_io_thread(NULL);
+  EXPECT_TRUE(Write(&cache, "b", data));
+  EXPECT_EQ(Thread::Current(), cache.write_thread());
+}
+
+// Measures startup and lookup cost with a large cache.  Run manually with
+// --gtest_also_run_disabled_tests.
+TEST_F(DiskCacheTest, DISABLED_Perf) {
+  const int kResources = 100000;
+  const std::string data("0123456789");
+  {
+    TestDiskCache cache;
+    ASSERT_TRUE(cache.Initialize(folder_.pathname(), kResources * 10));
+    for (int i = 0; i < kResources; ++i) {
+      ASSERT_TRUE(Write(&cache, ToString(i), data));
+    }
+    Filesystem::DeleteFile(Pathname(folder_.pathname(), "diskcache.idx"));
+  }
+
+  uint32 start = Time();
+  TestDiskCache scanned;
+  ASSERT_TRUE(scanned.Initialize(folder_.pathname(), kResources * 10));
+  uint32 scan_time = TimeSince(start);
+  ASSERT_TRUE(scanned.SaveIndex());
+
+  start = Time();
+  TestDiskCache indexed;
+  ASSERT_TRUE(indexed.Initialize(folder_.pathname(), kResources * 10));
+  uint32 index_time = TimeSince(start);
+  EXPECT_EQ(0, indexed.scans());
+
+  start = Time();
+  for (int i = 0; i < kResources; ++i) {
+    EXPECT_TRUE(indexed.HasResource(ToString(i)));
+  }
+  uint32 lookup_time = TimeSince(start);
+
+  start = Time();
+  for (int i = 0; i < kResources / 10; ++i) {
+    EXPECT_TRUE(Write(&indexed, ToString(kResources + i), data));
+  }
+  uint32 evict_time = TimeSince(start);
+
+  LOG(LS_INFO) << "Startup with scan: " << scan_time << " ms, with index: "
+               << index_time << " ms";
+  LOG(LS_INFO) << "Average lookup: " << lookup_time * 1000.0 / kResources
+               << " us, average write with eviction: "
+               << evict_time * 10000.0 / kResources << " us";
+}
+
+}  // namespace talk_base
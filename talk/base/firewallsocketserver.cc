@@ -68,6 +68,28 @@ class FirewallSocket : public AsyncSocketAdapter {
     }
     return AsyncSocketAdapter::SendTo(pv, cb, addr);
   }
+  // Passes vectored sends straight through, so that they are still gathered
+  // by the wrapped socket rather than copied by the Socket fallback.
+  virtual int SendV(const IoVec* iov, size_t count) {
+    return SendToV(iov, count, GetRemoteAddress());
+  }
+  virtual int SendToV(const IoVec* iov, size_t count,
+                      const SocketAddress& addr) {
+    if (type_ == SOCK_DGRAM) {
+      if (!server_->Check(FP_UDP, GetLocalAddress(), addr)) {
+        LOG(LS_VERBOSE) << "FirewallSocket outbound UDP packet from "
+                        << GetLocalAddress().ToString() << " to "
+                        << addr.ToString() << " dropped";
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+          total += iov[i].len;
+        }
+        return static_cast<int>(total);
+      }
+      return socket_->SendToV(iov, count, addr);
+    }
+    return socket_->SendV(iov, count);
+  }
   virtual int Recv(void* pv, size_t cb) {
     SocketAddress addr;
     return RecvFrom(pv, cb, &addr);
@@ -0,0 +1,146 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/histogram.h"
+
+#include <string.h>
+
+#include "talk/base/common.h"
+
+namespace talk_base {
+
+const int Histogram::kSubBucketBits;
+const int Histogram::kSubBucketCount;
+const int Histogram::kBucketCount;
+
+// Returns the position of the highest bit set in |value|, which must not be 0.
+static int HighestBit(uint32 value) {
+  int bit = 0;
+  for (int step = 16; step > 0; step >>= 1) {
+    if (value >> step) {
+      value >>= step;
+      bit += step;
+    }
+  }
+  return bit;
+}
+
+Histogram::Histogram() {
+  Reset();
+}
+
+void Histogram::AddSample(uint32 value) {
+  ++counts_[BucketIndex(value)];
+  if (count_ == 0 || value < min_) {
+    min_ = value;
+  }
+  if (value > max_) {
+    max_ = value;
+  }
+  ++count_;
+  sum_ += value;
+}
+
+void Histogram::Merge(const Histogram& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  for (int i = 0; i < kBucketCount; ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  if (count_ == 0 || other.min_ < min_) {
+    min_ = other.min_;
+  }
+  if (other.max_ > max_) {
+    max_ = other.max_;
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+}
+
+void Histogram::Reset() {
+  memset(counts_, 0, sizeof(counts_));
+  count_ = 0;
+  min_ = 0;
+  max_ = 0;
+  sum_ = 0;
+}
+
+double Histogram::ComputeMean() const {
+  return count_ ? static_cast<double>(sum_) / count_ : 0.0;
+}
+
+uint32 Histogram::ComputePercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  // The rank of the sample we are after, counting from 1.
+  uint64 rank = static_cast<uint64>(percentile * count_ / 100 + 0.5);
+  rank = _max<uint64>(1, _min<uint64>(count_, rank));
+  // The ends are known exactly.
+  if (rank == 1) {
+    return min_;
+  } else if (rank == count_) {
+    return max_;
+  }
+  uint64 seen = 0;
+  for (int i = 0; i < kBucketCount; ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      // Report the middle of the bucket, kept within the samples we saw.
+      uint32 start = BucketStart(i);
+      uint32 end = (i + 1 < kBucketCount) ? BucketStart(i + 1) - 1 : 0xFFFFFFFF;
+      uint32 value = start + (end - start) / 2;
+      return _max(min_, _min(max_, value));
+    }
+  }
+  return max_;
+}
+
+int Histogram::BucketIndex(uint32 value) {
+  if (value < static_cast<uint32>(kSubBucketCount)) {
+    return static_cast<int>(value);
+  }
+  // Keep the top kSubBucketBits + 1 bits of the value; the highest of them is
+  // implied by which power of two we are in.
+  int shift = HighestBit(value) - kSubBucketBits;
+  int sub_bucket = static_cast<int>(value >> shift) - kSubBucketCount;
+  return (shift + 1) * kSubBucketCount + sub_bucket;
+}
+
+uint32 Histogram::BucketStart(int index) {
+  ASSERT(index >= 0 && index < kBucketCount);
+  if (index < kSubBucketCount) {
+    return static_cast<uint32>(index);
+  }
+  int shift = index / kSubBucketCount - 1;
+  uint32 sub_bucket = static_cast<uint32>(index % kSubBucketCount);
+  return (sub_bucket + kSubBucketCount) << shift;
+}
+
+}  // namespace talk_base
@@ -0,0 +1,81 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_BASE_HISTOGRAM_H_
+#define TALK_BASE_HISTOGRAM_H_
+
+#include "talk/base/basictypes.h"
+
+namespace talk_base {
+
+// Counts samples in buckets whose width grows with the value, so that any
+// value from 0 to 2^32 - 1 is kept to within 1/32 of itself in a fixed
+// amount of memory.  Percentiles can then be read back with the same
+// precision, which is what latency statistics need: 3 ms and 3000 ms both
+// matter, but 3000 ms and 3050 ms rarely do.  Adding a sample is a handful of
+// shifts and an increment, and the whole thing can be copied with plain
+// assignment, so it can be published to other threads through a SeqLock.
+class Histogram {
+ public:
+  // Each power of two is split into 2^kSubBucketBits buckets.
+  static const int kSubBucketBits = 5;
+  static const int kSubBucketCount = 1 << kSubBucketBits;
+  static const int kBucketCount = (33 - kSubBucketBits) * kSubBucketCount;
+
+  Histogram();
+
+  void AddSample(uint32 value);
+  // Adds in all the samples from |other|.
+  void Merge(const Histogram& other);
+  void Reset();
+
+  uint32 count() const { return count_; }
+  // The smallest and largest samples added; 0 if there are none.
+  uint32 min() const { return count_ ? min_ : 0; }
+  uint32 max() const { return max_; }
+
+  double ComputeMean() const;
+  // Returns the value that |percentile| percent of the samples are less than
+  // or equal to, e.g. 50 for the median.  Returns 0 if there are no samples.
+  uint32 ComputePercentile(double percentile) const;
+
+  // Maps a value to its bucket, and a bucket to the smallest value in it.
+  static int BucketIndex(uint32 value);
+  static uint32 BucketStart(int index);
+
+ private:
+  uint32 counts_[kBucketCount];
+  uint32 count_;
+  uint32 min_;
+  uint32 max_;
+  uint64 sum_;
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_HISTOGRAM_H_
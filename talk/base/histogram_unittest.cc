@@ -0,0 +1,128 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/gunit.h"
+#include "talk/base/histogram.h"
+
+namespace talk_base {
+
+TEST(HistogramTest, TestEmpty) {
+  Histogram histogram;
+  EXPECT_EQ(0U, histogram.count());
+  EXPECT_EQ(0U, histogram.min());
+  EXPECT_EQ(0U, histogram.max());
+  EXPECT_EQ(0.0, histogram.ComputeMean());
+  EXPECT_EQ(0U, histogram.ComputePercentile(50));
+}
+
+// Small values each get a bucket of their own, so they come back exactly.
+TEST(HistogramTest, TestSmallValues) {
+  Histogram histogram;
+  for (uint32 i = 1; i <= 20; ++i) {
+    histogram.AddSample(i);
+  }
+  EXPECT_EQ(20U, histogram.count());
+  EXPECT_EQ(1U, histogram.min());
+  EXPECT_EQ(20U, histogram.max());
+  EXPECT_DOUBLE_EQ(10.5, histogram.ComputeMean());
+  EXPECT_EQ(10U, histogram.ComputePercentile(50));
+  EXPECT_EQ(19U, histogram.ComputePercentile(95));
+  EXPECT_EQ(20U, histogram.ComputePercentile(100));
+  EXPECT_EQ(1U, histogram.ComputePercentile(0));
+
+  histogram.Reset();
+  EXPECT_EQ(0U, histogram.count());
+  EXPECT_EQ(0U, histogram.ComputePercentile(50));
+}
+
+// Every value maps to a bucket that contains it, and the buckets run in
+// order with no gaps up to the largest value.
+TEST(HistogramTest, TestBuckets) {
+  for (int i = 0; i < Histogram::kBucketCount; ++i) {
+    uint32 start = Histogram::BucketStart(i);
+    EXPECT_EQ(i, Histogram::BucketIndex(start));
+    if (i > 0) {
+      EXPECT_EQ(i - 1, Histogram::BucketIndex(start - 1));
+      // A bucket is never wider than 1/32 of the values in it.
+      EXPECT_LE((start - Histogram::BucketStart(i - 1)) * 32,
+                Histogram::BucketStart(i - 1) + 32);
+    }
+  }
+  EXPECT_EQ(Histogram::kBucketCount - 1, Histogram::BucketIndex(0xFFFFFFFF));
+}
+
+// Percentiles of large values are good to within the bucket width.
+TEST(HistogramTest, TestPercentiles) {
+  Histogram histogram;
+  for (uint32 i = 1; i <= 10000; ++i) {
+    histogram.AddSample(i * 10);
+  }
+  EXPECT_EQ(10U, histogram.min());
+  EXPECT_EQ(100000U, histogram.max());
+  EXPECT_DOUBLE_EQ(50005.0, histogram.ComputeMean());
+  EXPECT_NEAR(50000, histogram.ComputePercentile(50), 50000 / 32);
+  EXPECT_NEAR(95000, histogram.ComputePercentile(95), 95000 / 32);
+  EXPECT_NEAR(99000, histogram.ComputePercentile(99), 99000 / 32);
+  EXPECT_EQ(100000U, histogram.ComputePercentile(100));
+}
+
+// A histogram is a plain value that can be copied.
+TEST(HistogramTest, TestCopy) {
+  Histogram histogram;
+  histogram.AddSample(1000);
+  histogram.AddSample(3000);
+  Histogram copy = histogram;
+  histogram.AddSample(5000);
+  EXPECT_EQ(2U, copy.count());
+  EXPECT_EQ(3000U, copy.max());
+  EXPECT_EQ(3U, histogram.count());
+}
+
+TEST(HistogramTest, TestMerge) {
+  Histogram histogram1, histogram2, empty;
+  histogram1.AddSample(10);
+  histogram1.AddSample(20);
+  histogram2.AddSample(5);
+  histogram2.AddSample(30);
+  histogram1.Merge(empty);
+  EXPECT_EQ(2U, histogram1.count());
+  EXPECT_EQ(10U, histogram1.min());
+
+  histogram1.Merge(histogram2);
+  EXPECT_EQ(4U, histogram1.count());
+  EXPECT_EQ(5U, histogram1.min());
+  EXPECT_EQ(30U, histogram1.max());
+  EXPECT_DOUBLE_EQ(16.25, histogram1.ComputeMean());
+  EXPECT_EQ(10U, histogram1.ComputePercentile(50));
+
+  empty.Merge(histogram2);
+  EXPECT_EQ(2U, empty.count());
+  EXPECT_EQ(5U, empty.min());
+}
+
+}  // namespace talk_base
@@ -0,0 +1,304 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/linkmodel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "talk/base/common.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+// CoDel doesn't drop when no more than a packet is queued.
+static const size_t kCodelMaxPacket = 1500;
+
+LinkModel::LinkModel()
+    : bandwidth(0), queue_size(0), queue_discipline(DROP_TAIL),
+      codel_target(5), codel_interval(100), delay_mean(0), delay_stddev(0),
+      loss_good_to_bad(0), loss_bad_to_good(0), loss_in_good(0),
+      loss_in_bad(0), reorder_probability(0), reorder_delay(0), seed(1) {
+}
+
+LinkStats::LinkStats()
+    : packets_sent(0), packets_delivered(0), packets_lost(0),
+      packets_queue_drop(0), packets_reordered(0), bytes_delivered(0),
+      max_queue_size(0) {
+}
+
+const char* LinkScenarioName(LinkScenario scenario) {
+  switch (scenario) {
+    case LINK_SCENARIO_DSL: return "dsl";
+    case LINK_SCENARIO_CABLE: return "cable";
+    case LINK_SCENARIO_WIFI: return "wifi";
+    case LINK_SCENARIO_3G: return "3g";
+    case LINK_SCENARIO_LTE: return "lte";
+    case LINK_SCENARIO_SATELLITE: return "satellite";
+    case LINK_SCENARIO_CONGESTED: return "congested";
+    default: return "unknown";
+  }
+}
+
+void GetLinkScenario(LinkScenario scenario, LinkModel* uplink,
+                     LinkModel* downlink) {
+  LinkModel up, down;
+  down.seed = 2;
+  switch (scenario) {
+    case LINK_SCENARIO_DSL:
+      up.bandwidth = 125000;
+      down.bandwidth = 1000000;
+      up.queue_size = down.queue_size = 64 * 1024;
+      up.delay_mean = down.delay_mean = 10;
+      up.delay_stddev = down.delay_stddev = 1;
+      break;
+    case LINK_SCENARIO_CABLE:
+      up.bandwidth = 1250000;
+      down.bandwidth = 6250000;
+      up.queue_size = down.queue_size = 256 * 1024;
+      up.delay_mean = down.delay_mean = 5;
+      up.delay_stddev = down.delay_stddev = 1;
+      break;
+    case LINK_SCENARIO_WIFI:
+      up.bandwidth = down.bandwidth = 2500000;
+      up.queue_size = down.queue_size = 128 * 1024;
+      up.delay_mean = down.delay_mean = 3;
+      up.delay_stddev = down.delay_stddev = 2;
+      up.loss_good_to_bad = down.loss_good_to_bad = 0.01;
+      up.loss_bad_to_good = down.loss_bad_to_good = 0.3;
+      up.loss_in_good = down.loss_in_good = 0.001;
+      up.loss_in_bad = down.loss_in_bad = 0.5;
+      up.reorder_probability = down.reorder_probability = 0.01;
+      up.reorder_delay = down.reorder_delay = 10;
+      break;
+    case LINK_SCENARIO_3G:
+      up.bandwidth = 48000;
+      down.bandwidth = 250000;
+      up.queue_size = down.queue_size = 32 * 1024;
+      up.delay_mean = down.delay_mean = 50;
+      up.delay_stddev = down.delay_stddev = 15;
+      up.loss_good_to_bad = down.loss_good_to_bad = 0.005;
+      up.loss_bad_to_good = down.loss_bad_to_good = 0.2;
+      up.loss_in_bad = down.loss_in_bad = 0.3;
+      break;
+    case LINK_SCENARIO_LTE: {
+      // Capacity changes every second, as a UE moves between cells.
+      static const uint32 kRates[] = { 1500000, 500000, 2000000, 250000 };
+      for (int i = 0; i < ARRAY_SIZE(kRates); ++i) {
+        down.bandwidth_trace.push_back(std::make_pair(1000u, kRates[i]));
+        up.bandwidth_trace.push_back(std::make_pair(1000u, kRates[i] / 4));
+      }
+      up.queue_size = down.queue_size = 256 * 1024;
+      up.queue_discipline = down.queue_discipline = LinkModel::CODEL;
+      up.delay_mean = down.delay_mean = 20;
+      up.delay_stddev = down.delay_stddev = 5;
+      break;
+    }
+    case LINK_SCENARIO_SATELLITE:
+      up.bandwidth = 250000;
+      down.bandwidth = 1250000;
+      up.queue_size = down.queue_size = 512 * 1024;
+      up.delay_mean = down.delay_mean = 150;
+      up.delay_stddev = down.delay_stddev = 5;
+      up.loss_in_good = down.loss_in_good = 0.001;
+      break;
+    case LINK_SCENARIO_CONGESTED:
+      up.bandwidth = down.bandwidth = 125000;
+      up.queue_size = down.queue_size = 128 * 1024;
+      up.queue_discipline = down.queue_discipline = LinkModel::CODEL;
+      up.delay_mean = down.delay_mean = 15;
+      up.delay_stddev = down.delay_stddev = 3;
+      up.loss_in_good = down.loss_in_good = 0.01;
+      break;
+    default:
+      ASSERT(false);
+      break;
+  }
+  *uplink = up;
+  *downlink = down;
+}
+
+EmulatedLink::EmulatedLink(const LinkModel& model)
+    : model_(model),
+      random_state_((static_cast<uint64>(model.seed) << 1) | 1),
+      bad_state_(false), queue_size_(0), busy_until_(0), last_arrival_(0),
+      trace_start_(-1), trace_length_(0), codel_dropping_(false),
+      codel_count_(0), codel_first_above_(-1), codel_drop_next_(0) {
+  for (size_t i = 0; i < model_.bandwidth_trace.size(); ++i) {
+    ASSERT(model_.bandwidth_trace[i].second != 0);
+    trace_length_ += model_.bandwidth_trace[i].first * kNumMicrosecsPerMillisec;
+  }
+}
+
+int64 EmulatedLink::Transmit(int64 now, size_t size, bool reliable) {
+  ++stats_.packets_sent;
+
+  if (!reliable) {
+    if (bad_state_) {
+      if (RandomUniform() < model_.loss_bad_to_good)
+        bad_state_ = false;
+    } else if (RandomUniform() < model_.loss_good_to_bad) {
+      bad_state_ = true;
+    }
+    double loss = bad_state_ ? model_.loss_in_bad : model_.loss_in_good;
+    if (loss > 0 && RandomUniform() < loss) {
+      ++stats_.packets_lost;
+      return -1;
+    }
+  }
+
+  int64 departure = now;
+  if (model_.bandwidth != 0 || trace_length_ != 0) {
+    if (trace_start_ < 0) {
+      trace_start_ = now;
+    }
+    QueueSize(now);
+    if (!reliable && model_.queue_size != 0 &&
+        queue_size_ + size > model_.queue_size) {
+      ++stats_.packets_queue_drop;
+      return -1;
+    }
+    // The bottleneck is FIFO, so we know when this packet will leave the
+    // queue as soon as it arrives; CoDel's dequeue-time decision is made here
+    // from that sojourn time.
+    int64 start = std::max(now, busy_until_);
+    if (!reliable && model_.queue_discipline == LinkModel::CODEL &&
+        CodelShouldDrop(now, start - now)) {
+      ++stats_.packets_queue_drop;
+      return -1;
+    }
+    departure = start + static_cast<int64>(size) * kNumMicrosecsPerSec /
+        RateAt(start);
+    busy_until_ = departure;
+    QueueEntry entry = { departure, size };
+    queue_.push_back(entry);
+    queue_size_ += size;
+    stats_.max_queue_size = std::max(stats_.max_queue_size,
+                                     static_cast<uint32>(queue_size_));
+  }
+
+  int64 delay = model_.delay_mean * kNumMicrosecsPerMillisec;
+  if (model_.delay_stddev != 0) {
+    double ms = model_.delay_mean + model_.delay_stddev * RandomNormal();
+    delay = static_cast<int64>(std::max(ms, 0.0) * kNumMicrosecsPerMillisec);
+  }
+  int64 arrival = departure + delay;
+  if (!reliable && model_.reorder_probability > 0 &&
+      RandomUniform() < model_.reorder_probability) {
+    arrival += model_.reorder_delay * kNumMicrosecsPerMillisec;
+    ++stats_.packets_reordered;
+  } else {
+    arrival = std::max(arrival, last_arrival_);
+    last_arrival_ = arrival;
+  }
+
+  ++stats_.packets_delivered;
+  stats_.bytes_delivered += size;
+  return arrival;
+}
+
+size_t EmulatedLink::QueueSize(int64 now) {
+  while (!queue_.empty() && queue_.front().departure <= now) {
+    queue_size_ -= queue_.front().size;
+    queue_.pop_front();
+  }
+  return queue_size_;
+}
+
+uint32 EmulatedLink::RateAt(int64 time) const {
+  if (trace_length_ == 0) {
+    return model_.bandwidth;
+  }
+  int64 offset = (time - trace_start_) % trace_length_;
+  for (size_t i = 0; i < model_.bandwidth_trace.size(); ++i) {
+    offset -= model_.bandwidth_trace[i].first * kNumMicrosecsPerMillisec;
+    if (offset < 0) {
+      return model_.bandwidth_trace[i].second;
+    }
+  }
+  return model_.bandwidth_trace.back().second;
+}
+
+bool EmulatedLink::CodelShouldDrop(int64 now, int64 sojourn) {
+  const int64 target = model_.codel_target * kNumMicrosecsPerMillisec;
+  const int64 interval = model_.codel_interval * kNumMicrosecsPerMillisec;
+
+  bool ok_to_drop = false;
+  if (sojourn < target || queue_size_ <= kCodelMaxPacket) {
+    codel_first_above_ = -1;
+  } else if (codel_first_above_ < 0) {
+    codel_first_above_ = now + interval;
+  } else if (now >= codel_first_above_) {
+    ok_to_drop = true;
+  }
+
+  if (codel_dropping_) {
+    if (!ok_to_drop) {
+      codel_dropping_ = false;
+    } else if (now >= codel_drop_next_) {
+      ++codel_count_;
+      codel_drop_next_ += static_cast<int64>(interval / sqrt(
+          static_cast<double>(codel_count_)));
+      return true;
+    }
+    return false;
+  }
+  if (ok_to_drop) {
+    // Resume near the previous drop rate if we only just left drop state.
+    codel_count_ = (codel_count_ > 2 && now - codel_drop_next_ < 8 * interval) ?
+        codel_count_ - 2 : 1;
+    codel_dropping_ = true;
+    codel_drop_next_ = now + static_cast<int64>(interval / sqrt(
+        static_cast<double>(codel_count_)));
+    return true;
+  }
+  return false;
+}
+
+// xorshift64*; small, fast and good enough for a network model.
+uint32 EmulatedLink::NextRandom() {
+  random_state_ ^= random_state_ >> 12;
+  random_state_ ^= random_state_ << 25;
+  random_state_ ^= random_state_ >> 27;
+  return static_cast<uint32>((random_state_ * UINT64_C(2685821657736338717))
+                             >> 32);
+}
+
+double EmulatedLink::RandomUniform() {
+  return NextRandom() / 4294967296.0;
+}
+
+double EmulatedLink::RandomNormal() {
+  // Box-Muller; 1 - u keeps the log argument in (0, 1].
+  static const double kTwoPi = 8 * std::atan(1.0);
+  double u1 = 1.0 - RandomUniform();
+  double u2 = RandomUniform();
+  return std::sqrt(-2 * std::log(u1)) * std::cos(kTwoPi * u2);
+}
+
+}  // namespace talk_base
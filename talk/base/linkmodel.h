@@ -0,0 +1,171 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_BASE_LINKMODEL_H_
+#define TALK_BASE_LINKMODEL_H_
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+
+namespace talk_base {
+
+// Describes one direction of an emulated network path: a bottleneck with a
+// (possibly time-varying) rate and a bounded queue, followed by a transit
+// delay, with bursty random loss and occasional reordering.  Everything
+// defaults to off, i.e. an instant, lossless link.
+struct LinkModel {
+  enum QueueDiscipline {
+    DROP_TAIL,  // Drops arriving packets once the queue is full.
+    CODEL,      // Also drops to keep queueing delay near |codel_target|.
+  };
+
+  LinkModel();
+
+  // Bottleneck rate in bytes per second; 0 means unlimited.
+  uint32 bandwidth;
+  // If not empty, replaces |bandwidth| with a repeating schedule of
+  // (duration in ms, bytes per second) steps, starting with the first packet.
+  // Rates in the schedule must not be 0.
+  std::vector<std::pair<uint32, uint32> > bandwidth_trace;
+
+  // Bottleneck queue size in bytes; 0 means unlimited.
+  uint32 queue_size;
+  QueueDiscipline queue_discipline;
+  // CoDel parameters, in milliseconds.  Defaults are the RFC's 5 and 100.
+  uint32 codel_target;
+  uint32 codel_interval;
+
+  // Transit delay after the bottleneck, normally distributed, in ms.
+  uint32 delay_mean;
+  uint32 delay_stddev;
+
+  // Gilbert-Elliott loss: a two-state Markov chain, stepped once per packet,
+  // which drops packets with |loss_in_good| or |loss_in_bad| probability
+  // depending on its state.  Setting only |loss_in_good| gives uniform loss.
+  double loss_good_to_bad;
+  double loss_bad_to_good;
+  double loss_in_good;
+  double loss_in_bad;
+
+  // Probability that a packet is held back by an extra |reorder_delay| ms,
+  // letting the packets behind it overtake it.  Otherwise the link is FIFO.
+  double reorder_probability;
+  uint32 reorder_delay;
+
+  // Seed for the link's own random number generator, so that runs with the
+  // same seed and traffic see exactly the same losses and delays.
+  uint32 seed;
+};
+
+// Counters kept by an EmulatedLink.
+struct LinkStats {
+  LinkStats();
+
+  uint32 packets_sent;
+  uint32 packets_delivered;
+  uint32 packets_lost;        // Dropped by the loss model.
+  uint32 packets_queue_drop;  // Dropped by the bottleneck queue.
+  uint32 packets_reordered;
+  uint64 bytes_delivered;
+  uint32 max_queue_size;      // High water mark of the queue, in bytes.
+};
+
+// A library of typical access links, for benchmarks.  Each has an uplink
+// (client to server) and a downlink model; the numbers are representative
+// rather than measurements of any particular network.
+enum LinkScenario {
+  LINK_SCENARIO_DSL,        // 8/1 Mbps, 20 ms, deep drop-tail buffer.
+  LINK_SCENARIO_CABLE,      // 50/10 Mbps, 10 ms.
+  LINK_SCENARIO_WIFI,       // 20 Mbps, 5 ms with jitter, bursty loss.
+  LINK_SCENARIO_3G,         // 2 Mbps/384 kbps, 100 ms with heavy jitter.
+  LINK_SCENARIO_LTE,        // Trace-driven 2-16 Mbps, 40 ms, CoDel.
+  LINK_SCENARIO_SATELLITE,  // 10/2 Mbps, 300 ms.
+  LINK_SCENARIO_CONGESTED,  // 1 Mbps, 30 ms, CoDel, random loss.
+  LINK_SCENARIO_COUNT
+};
+
+const char* LinkScenarioName(LinkScenario scenario);
+void GetLinkScenario(LinkScenario scenario, LinkModel* uplink,
+                     LinkModel* downlink);
+
+// Runs packets through a LinkModel.  Times are in microseconds on any
+// monotonic clock, and must not go backwards between calls.
+class EmulatedLink {
+ public:
+  explicit EmulatedLink(const LinkModel& model);
+
+  const LinkModel& model() const { return model_; }
+  const LinkStats& stats() const { return stats_; }
+
+  // Sends a packet of |size| bytes at |now|.  Returns the time at which it
+  // arrives at the far end, or -1 if it was dropped.  Reliable packets, i.e.
+  // TCP segments, which the virtual network can't retransmit, are never
+  // dropped or reordered, but still wait for the bottleneck and the delay.
+  int64 Transmit(int64 now, size_t size, bool reliable);
+
+  // Bytes waiting for, or in, the bottleneck at |now|.
+  size_t QueueSize(int64 now);
+
+ private:
+  struct QueueEntry {
+    int64 departure;
+    size_t size;
+  };
+
+  uint32 RateAt(int64 time) const;
+  bool CodelShouldDrop(int64 now, int64 sojourn);
+  uint32 NextRandom();
+  double RandomUniform();
+  double RandomNormal();
+
+  LinkModel model_;
+  LinkStats stats_;
+  uint64 random_state_;
+  bool bad_state_;
+  std::deque<QueueEntry> queue_;
+  size_t queue_size_;
+  int64 busy_until_;
+  int64 last_arrival_;
+  int64 trace_start_;
+  int64 trace_length_;
+  // CoDel state, as in RFC 8289.
+  bool codel_dropping_;
+  uint32 codel_count_;
+  int64 codel_first_above_;
+  int64 codel_drop_next_;
+
+  DISALLOW_COPY_AND_ASSIGN(EmulatedLink);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_LINKMODEL_H_
@@ -0,0 +1,197 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/gunit.h"
+#include "talk/base/linkmodel.h"
+#include "talk/base/logging.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+static const int64 kStart = 1000 * kNumMicrosecsPerSec;
+static const int64 kMs = kNumMicrosecsPerMillisec;
+
+TEST(LinkModelTest, DefaultIsInstant) {
+  EmulatedLink link((LinkModel()));
+  EXPECT_EQ(kStart, link.Transmit(kStart, 1000, false));
+  EXPECT_EQ(kStart + 1, link.Transmit(kStart + 1, 1000, true));
+  EXPECT_EQ(2u, link.stats().packets_delivered);
+  EXPECT_EQ(2000u, link.stats().bytes_delivered);
+}
+
+TEST(LinkModelTest, BottleneckSerializesPackets) {
+  LinkModel model;
+  model.bandwidth = 100000;
+  model.delay_mean = 20;
+  EmulatedLink link(model);
+  // 1000 bytes take 10 ms at 100 KB/s, and queue behind each other.
+  EXPECT_EQ(kStart + 30 * kMs, link.Transmit(kStart, 1000, false));
+  EXPECT_EQ(kStart + 40 * kMs, link.Transmit(kStart, 1000, false));
+  EXPECT_EQ(1000u, link.QueueSize(kStart + 15 * kMs));
+  EXPECT_EQ(0u, link.QueueSize(kStart + 20 * kMs));
+  // An idle link sends straight away.
+  EXPECT_EQ(kStart + 130 * kMs, link.Transmit(kStart + 100 * kMs, 1000, false));
+}
+
+TEST(LinkModelTest, DropTail) {
+  LinkModel model;
+  model.bandwidth = 100000;
+  model.queue_size = 5000;
+  EmulatedLink link(model);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_LT(0, link.Transmit(kStart, 1000, false));
+  }
+  EXPECT_EQ(-1, link.Transmit(kStart, 1000, false));
+  // TCP segments aren't dropped.
+  EXPECT_LT(0, link.Transmit(kStart, 1000, true));
+  EXPECT_EQ(1u, link.stats().packets_queue_drop);
+  EXPECT_EQ(6000u, link.stats().max_queue_size);
+  // Once a packet has left, there is room again.
+  EXPECT_LT(0, link.Transmit(kStart + 20 * kMs, 1000, false));
+}
+
+// Offer twice the bottleneck rate for a while.  A deep drop-tail queue
+// fills up and stays full; CoDel keeps the queueing delay low.
+TEST(LinkModelTest, CodelControlsQueueDelay) {
+  LinkModel model;
+  model.bandwidth = 100000;
+  model.queue_size = 100000;
+  int64 delay[2];
+  for (int codel = 0; codel < 2; ++codel) {
+    model.queue_discipline = codel ? LinkModel::CODEL : LinkModel::DROP_TAIL;
+    EmulatedLink link(model);
+    // Average over the last of ten seconds, once things have settled.
+    int64 total_delay = 0;
+    int samples = 0;
+    for (int64 t = kStart; t < kStart + 10000 * kMs; t += 5 * kMs) {
+      int64 arrival = link.Transmit(t, 1000, false);
+      if (arrival >= 0 && t >= kStart + 9000 * kMs) {
+        total_delay += arrival - t;
+        ++samples;
+      }
+    }
+    delay[codel] = total_delay / samples;
+    LOG(LS_INFO) << (codel ? "CoDel" : "Drop tail") << " queue delay: "
+                 << delay[codel] / kMs << " ms";
+    EXPECT_LT(0u, link.stats().packets_queue_drop);
+  }
+  EXPECT_LT(900 * kMs, delay[0]);
+  EXPECT_GT(100 * kMs, delay[1]);
+}
+
+// With a long bad state, losses come in bursts averaging 1 / loss_bad_to_good
+// packets.
+TEST(LinkModelTest, GilbertElliottLossIsBursty) {
+  LinkModel model;
+  model.loss_good_to_bad = 0.01;
+  model.loss_bad_to_good = 0.25;
+  model.loss_in_bad = 1.0;
+  EmulatedLink link(model);
+  int bursts = 0;
+  bool lost_previous = false;
+  for (int i = 0; i < 100000; ++i) {
+    bool lost = link.Transmit(kStart, 100, false) < 0;
+    if (lost && !lost_previous) {
+      ++bursts;
+    }
+    lost_previous = lost;
+  }
+  uint32 lost = link.stats().packets_lost;
+  // Steady state loss is p / (p + r), about 3.8%.
+  EXPECT_NEAR(3846, lost, 500);
+  EXPECT_NEAR(4.0, static_cast<double>(lost) / bursts, 0.5);
+}
+
+TEST(LinkModelTest, Reordering) {
+  LinkModel model;
+  model.delay_mean = 10;
+  model.reorder_probability = 0.1;
+  model.reorder_delay = 50;
+  EmulatedLink link(model);
+  int overtaken = 0;
+  int64 latest = 0;
+  for (int i = 0; i < 1000; ++i) {
+    int64 arrival = link.Transmit(kStart + i * kMs, 100, false);
+    if (arrival < latest) {
+      ++overtaken;
+    }
+    latest = std::max(latest, arrival);
+  }
+  EXPECT_NEAR(100, static_cast<int>(link.stats().packets_reordered), 40);
+  EXPECT_LT(0, overtaken);
+  // TCP segments stay in order.
+  latest = 0;
+  for (int i = 0; i < 1000; ++i) {
+    int64 arrival = link.Transmit(kStart + (1000 + i) * kMs, 100, true);
+    EXPECT_LE(latest, arrival);
+    latest = arrival;
+  }
+}
+
+TEST(LinkModelTest, BandwidthTrace) {
+  LinkModel model;
+  model.bandwidth_trace.push_back(std::make_pair(100u, 100000u));
+  model.bandwidth_trace.push_back(std::make_pair(100u, 10000u));
+  EmulatedLink link(model);
+  EXPECT_EQ(kStart + 10 * kMs, link.Transmit(kStart, 1000, false));
+  EXPECT_EQ(kStart + 200 * kMs, link.Transmit(kStart + 100 * kMs, 1000,
+                                              false));
+  // The trace repeats.
+  EXPECT_EQ(kStart + 210 * kMs, link.Transmit(kStart + 200 * kMs, 1000,
+                                              false));
+}
+
+TEST(LinkModelTest, SameSeedSameResults) {
+  LinkModel model;
+  GetLinkScenario(LINK_SCENARIO_WIFI, &model, &model);
+  EmulatedLink link1(model), link2(model);
+  model.seed = 7;
+  EmulatedLink link3(model);
+  bool differs = false;
+  for (int i = 0; i < 10000; ++i) {
+    int64 now = kStart + i * kMs;
+    int64 arrival = link1.Transmit(now, 1200, false);
+    EXPECT_EQ(arrival, link2.Transmit(now, 1200, false));
+    differs |= (arrival != link3.Transmit(now, 1200, false));
+  }
+  EXPECT_TRUE(differs);
+}
+
+TEST(LinkModelTest, Scenarios) {
+  for (int i = 0; i < LINK_SCENARIO_COUNT; ++i) {
+    LinkScenario scenario = static_cast<LinkScenario>(i);
+    LinkModel up, down;
+    GetLinkScenario(scenario, &up, &down);
+    EXPECT_STRNE("unknown", LinkScenarioName(scenario));
+    EXPECT_NE(up.seed, down.seed);
+    EXPECT_TRUE(up.bandwidth != 0 || !up.bandwidth_trace.empty());
+    EXPECT_TRUE(down.bandwidth != 0 || !down.bandwidth_trace.empty());
+  }
+}
+
+}  // namespace talk_base
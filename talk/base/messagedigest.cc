@@ -49,7 +49,8 @@ const char DIGEST_SHA_256[] = "sha-256";
 const char DIGEST_SHA_384[] = "sha-384";
 const char DIGEST_SHA_512[] = "sha-512";
 
-static const size_t kBlockSize = 64;  // valid for SHA-256 and down
+// Hmac handles digests with a 64-byte block size, i.e. SHA-256 and down.
+static const size_t kMaxHmacDigestSize = 32;
 
 MessageDigest* MessageDigestFactory::Create(const std::string& alg) {
 #if SSL_USE_OPENSSL
@@ -108,52 +109,94 @@ std::string ComputeDigest(const std::string& alg, const std::string& input) {
 }
 
 // Compute a RFC 2104 HMAC: H(K XOR opad, H(K XOR ipad, text))
-size_t ComputeHmac(MessageDigest* digest,
-                   const void* key, size_t key_len,
-                   const void* input, size_t in_len,
-                   void* output, size_t out_len) {
-  // We only handle algorithms with a 64-byte blocksize.
+Hmac::Hmac(MessageDigest* digest, const void* key, size_t key_len)
+    : digest_(digest), owned_digest_(NULL), started_(false) {
+  Init(key, key_len);
+}
+
+Hmac::Hmac(const std::string& alg, const void* key, size_t key_len)
+    : digest_(MessageDigestFactory::Create(alg)), owned_digest_(digest_),
+      started_(false) {
+  Init(key, key_len);
+}
+
+void Hmac::Init(const void* key, size_t key_len) {
   // TODO: Add BlockSize() method to MessageDigest.
-  size_t block_len = kBlockSize;
-  if (digest->Size() > 32) {
-    return 0;
+  if (!digest_ || digest_->Size() > kMaxHmacDigestSize) {
+    digest_ = NULL;
+    return;
   }
   // Copy the key to a block-sized buffer to simplify padding.
   // If the key is longer than a block, hash it and use the result instead.
-  scoped_array<uint8> new_key(new uint8[block_len]);
-  if (key_len > block_len) {
-    ComputeDigest(digest, key, key_len, new_key.get(), block_len);
-    memset(new_key.get() + digest->Size(), 0, block_len - digest->Size());
+  uint8 new_key[kBlockSize];
+  if (key_len > kBlockSize) {
+    ComputeDigest(digest_, key, key_len, new_key, kBlockSize);
+    memset(new_key + digest_->Size(), 0, kBlockSize - digest_->Size());
   } else {
-    memcpy(new_key.get(), key, key_len);
-    memset(new_key.get() + key_len, 0, block_len - key_len);
+    memcpy(new_key, key, key_len);
+    memset(new_key + key_len, 0, kBlockSize - key_len);
   }
   // Set up the padding from the key, salting appropriately for each padding.
-  scoped_array<uint8> o_pad(new uint8[block_len]), i_pad(new uint8[block_len]);
-  for (size_t i = 0; i < block_len; ++i) {
-    o_pad[i] = 0x5c ^ new_key[i];
-    i_pad[i] = 0x36 ^ new_key[i];
+  for (size_t i = 0; i < kBlockSize; ++i) {
+    o_pad_[i] = 0x5c ^ new_key[i];
+    i_pad_[i] = 0x36 ^ new_key[i];
   }
-  // Inner hash; hash the inner padding, and then the input buffer.
-  scoped_array<uint8> inner(new uint8[digest->Size()]);
-  digest->Update(i_pad.get(), block_len);
-  digest->Update(input, in_len);
-  digest->Finish(inner.get(), digest->Size());
+}
+
+size_t Hmac::Size() const {
+  return digest_ ? digest_->Size() : 0;
+}
+
+void Hmac::Update(const void* buf, size_t len) {
+  if (!digest_)
+    return;
+  // Inner hash; hash the inner padding, and then the input.
+  if (!started_) {
+    digest_->Update(i_pad_, kBlockSize);
+    started_ = true;
+  }
+  digest_->Update(buf, len);
+}
+
+size_t Hmac::Finish(void* buf, size_t len) {
+  if (!digest_)
+    return 0;
+  if (len < digest_->Size()) {
+    // Drop the message, so that the next one doesn't continue it.
+    if (started_) {
+      uint8 discard[kMaxHmacDigestSize];
+      digest_->Finish(discard, digest_->Size());
+      started_ = false;
+    }
+    return 0;
+  }
+  if (!started_) {
+    digest_->Update(i_pad_, kBlockSize);
+  }
+  started_ = false;
+  uint8 inner[kMaxHmacDigestSize];
+  digest_->Finish(inner, digest_->Size());
   // Outer hash; hash the outer padding, and then the result of the inner hash.
-  digest->Update(o_pad.get(), block_len);
-  digest->Update(inner.get(), digest->Size());
-  return digest->Finish(output, out_len);
+  digest_->Update(o_pad_, kBlockSize);
+  digest_->Update(inner, digest_->Size());
+  return digest_->Finish(buf, len);
+}
+
+size_t ComputeHmac(MessageDigest* digest,
+                   const void* key, size_t key_len,
+                   const void* input, size_t in_len,
+                   void* output, size_t out_len) {
+  Hmac hmac(digest, key, key_len);
+  hmac.Update(input, in_len);
+  return hmac.Finish(output, out_len);
 }
 
 size_t ComputeHmac(const std::string& alg, const void* key, size_t key_len,
                    const void* input, size_t in_len,
                    void* output, size_t out_len) {
-  scoped_ptr<MessageDigest> digest(MessageDigestFactory::Create(alg));
-  if (!digest) {
-    return 0;
-  }
-  return ComputeHmac(digest.get(), key, key_len,
-                     input, in_len, output, out_len);
+  Hmac hmac(alg, key, key_len);
+  hmac.Update(input, in_len);
+  return hmac.Finish(output, out_len);
 }
 
 std::string ComputeHmac(MessageDigest* digest, const std::string& key,
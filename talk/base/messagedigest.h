@@ -30,6 +30,10 @@
 
 #include <string>
 
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/scoped_ptr.h"
+
 namespace talk_base {
 
 // Definitions for the digest algorithms.
@@ -89,6 +93,43 @@ inline std::string MD5(const std::string& input) {
   return ComputeDigest(DIGEST_MD5, input);
 }
 
+// Computes RFC 2104 HMACs incrementally.  The key is processed once, when
+// the object is created, so one Hmac can be reused for any number of messages
+// under the same key, and a message can be supplied in pieces.
+class Hmac {
+ public:
+  // Uses, but doesn't take ownership of, |digest|.
+  Hmac(MessageDigest* digest, const void* key, size_t key_len);
+  // Creates a digest implementation based on the desired digest name |alg|,
+  // e.g. DIGEST_SHA_1.
+  Hmac(const std::string& alg, const void* key, size_t key_len);
+
+  // Returns false if |alg| is unknown or has an unsupported block size.
+  bool IsValid() const { return digest_ != NULL; }
+  // Returns the HMAC output size, i.e. the digest size.
+  size_t Size() const;
+  // Updates the HMAC with |len| bytes from |buf|.
+  void Update(const void* buf, size_t len);
+  // Outputs the HMAC to |buf| with length |len|, and resets for the next
+  // message.  Returns the number of bytes written, or 0 if |len| was too
+  // small, in which case the message is dropped.
+  size_t Finish(void* buf, size_t len);
+
+ private:
+  // We only handle algorithms with a 64-byte block size.
+  enum { kBlockSize = 64 };
+
+  void Init(const void* key, size_t key_len);
+
+  MessageDigest* digest_;
+  scoped_ptr<MessageDigest> owned_digest_;
+  bool started_;
+  uint8 i_pad_[kBlockSize];
+  uint8 o_pad_[kBlockSize];
+
+  DISALLOW_COPY_AND_ASSIGN(Hmac);
+};
+
 // Functions to compute RFC 2104 HMACs.
 
 // Computes the HMAC of |in_len| bytes of |input|, using the |digest| hash
@@ -165,4 +165,43 @@ TEST(MessageDigestTest, TestBadHmac) {
   EXPECT_EQ("", ComputeHmac("sha-9000", "key", "abc"));
 }
 
+// Test that an Hmac can be reused, and that input can be split.
+TEST(MessageDigestTest, TestHmacContext) {
+  std::string key(20, '\x0b');
+  Hmac hmac(DIGEST_SHA_1, key.c_str(), key.size());
+  ASSERT_TRUE(hmac.IsValid());
+  EXPECT_EQ(20U, hmac.Size());
+
+  char output[20];
+  for (int i = 0; i < 2; ++i) {
+    hmac.Update("Hi ", 3);
+    hmac.Update("There", 5);
+    EXPECT_EQ(sizeof(output), hmac.Finish(output, sizeof(output)));
+    EXPECT_EQ("b617318655057264e28bc0b6fb378c8ef146be00",
+              hex_encode(output, sizeof(output)));
+  }
+
+  // An empty message.
+  EXPECT_EQ(sizeof(output), hmac.Finish(output, sizeof(output)));
+  EXPECT_EQ(ComputeHmac(DIGEST_SHA_1, key, ""),
+            hex_encode(output, sizeof(output)));
+
+  // Too small a buffer drops the message rather than leaving it half done.
+  hmac.Update("junk", 4);
+  EXPECT_EQ(0U, hmac.Finish(output, sizeof(output) - 1));
+  hmac.Update("Hi There", 8);
+  EXPECT_EQ(sizeof(output), hmac.Finish(output, sizeof(output)));
+  EXPECT_EQ("b617318655057264e28bc0b6fb378c8ef146be00",
+            hex_encode(output, sizeof(output)));
+}
+
+TEST(MessageDigestTest, TestBadHmacContext) {
+  Hmac hmac("sha-9000", "key", 3);
+  EXPECT_FALSE(hmac.IsValid());
+  EXPECT_EQ(0U, hmac.Size());
+  char output[20];
+  hmac.Update("data", 4);
+  EXPECT_EQ(0U, hmac.Finish(output, sizeof(output)));
+}
+
 }  // namespace talk_base
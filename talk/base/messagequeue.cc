@@ -173,8 +173,8 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
 
   int cmsTotal = cmsWait;
   int cmsElapsed = 0;
-  uint32 msStart = Time();
-  uint32 msCurrent = msStart;
+  int64 msStart = TimeMillis();
+  int64 msCurrent = msStart;
   while (true) {
     // Check for sent messages
 
@@ -190,8 +190,9 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
       // Calc the next trigger too
 
       while (!dmsgq_.empty()) {
-        if (TimeIsLater(msCurrent, dmsgq_.top().msTrigger_)) {
-          cmsDelayNext = TimeDiff(dmsgq_.top().msTrigger_, msCurrent);
+        if (msCurrent < dmsgq_.top().msTrigger_) {
+          cmsDelayNext =
+              static_cast<int>(dmsgq_.top().msTrigger_ - msCurrent);
           break;
         }
         msgq_.push_back(dmsgq_.top().msg_);
@@ -202,7 +203,7 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
       while (!msgq_.empty()) {
         *pmsg = msgq_.front();
         if (pmsg->ts_sensitive) {
-          long delay = TimeDiff(msCurrent, pmsg->ts_sensitive);
+          int64 delay = msCurrent - pmsg->ts_sensitive;
           if (delay > 0) {
             LOG_F(LS_WARNING) << "id: " << pmsg->message_id << "  delay: "
                               << (delay + kMaxMsgLatency) << "ms";
@@ -237,8 +238,8 @@ bool MessageQueue::Get(Message *pmsg, int cmsWait, bool process_io) {
 
     // If the specified timeout expired, return
 
-    msCurrent = Time();
-    cmsElapsed = TimeDiff(msCurrent, msStart);
+    msCurrent = TimeMillis();
+    cmsElapsed = static_cast<int>(msCurrent - msStart);
     if (cmsWait != kForever) {
       if (cmsElapsed >= cmsWait)
         return false;
@@ -267,13 +268,13 @@ void MessageQueue::Post(MessageHandler *phandler, uint32 id,
   msg.message_id = id;
   msg.pdata = pdata;
   if (time_sensitive) {
-    msg.ts_sensitive = Time() + kMaxMsgLatency;
+    msg.ts_sensitive = TimeMillis() + kMaxMsgLatency;
   }
   msgq_.push_back(msg);
   ss_->WakeUp();
 }
 
-void MessageQueue::DoDelayPost(int cmsDelay, uint32 tstamp,
+void MessageQueue::DoDelayPost(int cmsDelay, int64 tstamp,
     MessageHandler *phandler, uint32 id, MessageData* pdata) {
   // Keep thread safe
   CritScope cs(&crit_);
@@ -305,15 +306,25 @@ int MessageQueue::GetDelay() {
     return 0;
 
   if (!dmsgq_.empty()) {
-    int delay = TimeUntil(dmsgq_.top().msTrigger_);
+    int64 delay = dmsgq_.top().msTrigger_ - TimeMillis();
     if (delay < 0)
       delay = 0;
-    return delay;
+    return static_cast<int>(delay);
   }
 
   return kForever;
 }
 
+void MessageQueue::ShiftDelayedMessages(int64 delta) {
+  CritScope cs(&crit_);
+  // Moving every trigger time by the same amount keeps the heap order.
+  PriorityQueue::container_type& delayed = dmsgq_.container();
+  for (PriorityQueue::container_type::iterator it = delayed.begin();
+       it != delayed.end(); ++it) {
+    it->msTrigger_ += delta;
+  }
+}
+
 void MessageQueue::Clear(MessageHandler *phandler, uint32 id,
                          MessageList* removed) {
   CritScope cs(&crit_);
@@ -146,17 +146,18 @@ struct Message {
   MessageHandler *phandler;
   uint32 message_id;
   MessageData *pdata;
-  uint32 ts_sensitive;
+  int64 ts_sensitive;  // TimeMillis() deadline, or 0.
 };
 
 typedef std::list<Message> MessageList;
 
 // DelayedMessage goes into a priority queue, sorted by trigger time.  Messages
-// with the same trigger time are processed in num_ (FIFO) order.
+// with the same trigger time are processed in num_ (FIFO) order.  Trigger
+// times are 64-bit TimeMillis() values, so they can be compared directly.
 
 class DelayedMessage {
  public:
-  DelayedMessage(int delay, uint32 trigger, uint32 num, const Message& msg)
+  DelayedMessage(int delay, int64 trigger, uint32 num, const Message& msg)
   : cmsDelay_(delay), msTrigger_(trigger), num_(num), msg_(msg) { }
 
   bool operator< (const DelayedMessage& dmsg) const {
@@ -165,7 +166,7 @@ class DelayedMessage {
   }
 
   int cmsDelay_;  // for debugging
-  uint32 msTrigger_;
+  int64 msTrigger_;
   uint32 num_;
   Message msg_;
 };
@@ -199,11 +200,15 @@ class MessageQueue {
                     MessageData *pdata = NULL, bool time_sensitive = false);
   virtual void PostDelayed(int cmsDelay, MessageHandler *phandler,
                            uint32 id = 0, MessageData *pdata = NULL) {
-    return DoDelayPost(cmsDelay, TimeAfter(cmsDelay), phandler, id, pdata);
+    return DoDelayPost(cmsDelay, TimeMillis() + cmsDelay, phandler, id, pdata);
   }
   virtual void PostAt(uint32 tstamp, MessageHandler *phandler,
                       uint32 id = 0, MessageData *pdata = NULL) {
-    return DoDelayPost(TimeUntil(tstamp), tstamp, phandler, id, pdata);
+    // Time() is the low 32 bits of TimeMillis(), so one clock read converts
+    // |tstamp| exactly.
+    int64 now = TimeMillis();
+    int delay = TimeDiff(tstamp, static_cast<uint32>(now));
+    return DoDelayPost(delay, now + delay, phandler, id, pdata);
   }
   virtual void Clear(MessageHandler *phandler, uint32 id = MQID_ANY,
                      MessageList* removed = NULL);
@@ -213,6 +218,10 @@ class MessageQueue {
   // Amount of time until the next message can be retrieved
   virtual int GetDelay();
 
+  // Moves the trigger time of every delayed message by |delta| ms, for when
+  // TimeMillis() switches to a clock that reads a different time.
+  void ShiftDelayedMessages(int64 delta);
+
   bool empty() const { return size() == 0u; }
   size_t size() const {
     CritScope cs(&crit_);  // msgq_.size() is not thread safe.
@@ -238,7 +247,7 @@ class MessageQueue {
   };
 
   void EnsureActive();
-  void DoDelayPost(int cmsDelay, uint32 tstamp, MessageHandler *phandler,
+  void DoDelayPost(int cmsDelay, int64 tstamp, MessageHandler *phandler,
                    uint32 id, MessageData* pdata);
 
   // The SocketServer is not owned by MessageQueue.
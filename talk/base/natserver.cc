@@ -28,16 +28,34 @@
 #include "talk/base/natsocketfactory.h"
 #include "talk/base/natserver.h"
 #include "talk/base/logging.h"
+#include "talk/base/timeutils.h"
 
 namespace talk_base {
 
-RouteCmp::RouteCmp(NAT* nat) : symmetric(nat->IsSymmetric()) {
+static const size_t kInitialBuckets = 64;
+
+enum {
+  MSG_EXPIRE_MAPPINGS
+};
+
+// The address hashes are plain XORs, so spread them out before taking the
+// low bits.
+static inline size_t Bucket(size_t hash, size_t buckets) {
+  uint64 h = static_cast<uint64>(hash) * UINT64_C(0x9E3779B97F4A7C15);
+  return static_cast<size_t>(h >> 32) & (buckets - 1);
+}
+
+RouteCmp::RouteCmp(NAT* nat)
+    : use_dest_ip(nat->MappingBehavior() != NAT_ENDPOINT_INDEPENDENT),
+      use_dest_port(nat->MappingBehavior() == NAT_ADDRESS_AND_PORT_DEPENDENT) {
 }
 
 size_t RouteCmp::operator()(const SocketAddressPair& r) const {
   size_t h = r.source().Hash();
-  if (symmetric)
-    h ^= r.destination().Hash();
+  if (use_dest_ip)
+    h ^= HashIP(r.destination().ipaddr()) * 31;
+  if (use_dest_port)
+    h ^= r.destination().port() << 8;
   return h;
 }
 
@@ -47,9 +65,13 @@ bool RouteCmp::operator()(
     return true;
   if (r2.source() < r1.source())
     return false;
-  if (symmetric && (r1.destination() < r2.destination()))
+  if (use_dest_ip && (r1.destination().ipaddr() < r2.destination().ipaddr()))
+    return true;
+  if (use_dest_ip && (r2.destination().ipaddr() < r1.destination().ipaddr()))
+    return false;
+  if (use_dest_port && (r1.destination().port() < r2.destination().port()))
     return true;
-  if (symmetric && (r2.destination() < r1.destination()))
+  if (use_dest_port && (r2.destination().port() < r1.destination().port()))
     return false;
   return false;
 }
@@ -83,26 +105,67 @@ bool AddrCmp::operator()(
 NATServer::NATServer(
     NATType type, SocketFactory* internal, const SocketAddress& internal_addr,
     SocketFactory* external, const SocketAddress& external_ip)
-    : external_(external), external_ip_(external_ip.ipaddr(), 0) {
-  nat_ = NAT::Create(type);
+    : nat_(NAT::Create(type)), route_cmp_(nat_), external_(external),
+      external_ip_(external_ip.ipaddr(), 0) {
+  Init(internal, internal_addr);
+}
+
+NATServer::NATServer(
+    NAT* nat, SocketFactory* internal, const SocketAddress& internal_addr,
+    SocketFactory* external, const SocketAddress& external_ip)
+    : nat_(nat), route_cmp_(nat_), external_(external),
+      external_ip_(external_ip.ipaddr(), 0) {
+  Init(internal, internal_addr);
+}
 
+void NATServer::Init(SocketFactory* internal,
+                     const SocketAddress& internal_addr) {
   server_socket_ = AsyncUDPSocket::Create(internal, internal_addr);
   server_socket_->SignalReadPacket.connect(this, &NATServer::OnInternalPacket);
 
-  int_map_ = new InternalMap(RouteCmp(nat_));
-  ext_map_ = new ExternalMap();
+  int_table_.resize(kInitialBuckets);
+  ext_table_.resize(kInitialBuckets);
+  entry_count_ = 0;
+  mapping_timeout_ = 0;
+  expiry_thread_ = NULL;
+  buffer_size_ = 0;
 }
 
 NATServer::~NATServer() {
-  for (InternalMap::iterator iter = int_map_->begin();
-       iter != int_map_->end();
-       iter++)
-    delete iter->second;
+  if (expiry_thread_)
+    expiry_thread_->Clear(this);
+
+  for (size_t i = 0; i < ext_table_.size(); ++i) {
+    TransEntry* entry = ext_table_[i];
+    while (entry) {
+      TransEntry* next = entry->ext_next;
+      delete entry;
+      entry = next;
+    }
+  }
 
   delete nat_;
   delete server_socket_;
-  delete int_map_;
-  delete ext_map_;
+}
+
+void NATServer::set_mapping_timeout(int timeout) {
+  mapping_timeout_ = timeout;
+  if (expiry_thread_) {
+    expiry_thread_->Clear(this, MSG_EXPIRE_MAPPINGS);
+    expiry_thread_ = NULL;
+  }
+  if (mapping_timeout_ > 0) {
+    expiry_thread_ = Thread::Current();
+    expiry_thread_->PostDelayed(_max(mapping_timeout_ / 2, 1), this,
+                                MSG_EXPIRE_MAPPINGS);
+  }
+}
+
+void NATServer::OnMessage(Message* msg) {
+  ASSERT(msg->message_id == MSG_EXPIRE_MAPPINGS);
+  ExpireMappings();
+  expiry_thread_->PostDelayed(_max(mapping_timeout_ / 2, 1), this,
+                              MSG_EXPIRE_MAPPINGS);
 }
 
 void NATServer::OnInternalPacket(
@@ -115,32 +178,47 @@ void NATServer::OnInternalPacket(
 
   // Find the translation for these addresses (allocating one if necessary).
   SocketAddressPair route(addr, dest_addr);
-  InternalMap::iterator iter = int_map_->find(route);
-  if (iter == int_map_->end()) {
-    Translate(route);
-    iter = int_map_->find(route);
+  TransEntry* entry = LookupInternal(route);
+  uint32 now = Time();
+  if (entry && IsExpired(entry, now)) {
+    Remove(entry);
+    delete entry;
+    entry = NULL;
+  }
+  if (!entry) {
+    entry = Translate(route);
+    if (!entry)
+      return;
   }
-  ASSERT(iter != int_map_->end());
+  entry->last_sent = now;
 
   // Allow the destination to send packets back to the source.
-  iter->second->whitelist->insert(dest_addr);
+  entry->whitelist->insert(dest_addr);
 
-  // Send the packet to its intended destination.
-  iter->second->socket->SendTo(buf + length, size - length, dest_addr);
+  // Send the packet to its intended destination, straight out of the
+  // received buffer.
+  entry->socket->SendTo(buf + length, size - length, dest_addr);
 }
 
 void NATServer::OnExternalPacket(
     AsyncPacketSocket* socket, const char* buf, size_t size,
     const SocketAddress& remote_addr) {
 
-  SocketAddress local_addr = socket->GetLocalAddress();
-
-  // Find the translation for this addresses.
-  ExternalMap::iterator iter = ext_map_->find(local_addr);
-  ASSERT(iter != ext_map_->end());
+  // Find the translation for this socket.
+  TransEntry* entry = LookupExternal(socket);
+  ASSERT(entry != NULL);
+  if (!entry)
+    return;
+  if (IsExpired(entry, Time())) {
+    // Drop the mapping now rather than at the next sweep. Its socket is the
+    // one signalling us, so it is deleted once that has returned.
+    Remove(entry);
+    Thread::Current()->Dispose(entry);
+    return;
+  }
 
   // Allow the NAT to reject this packet.
-  if (Filter(iter->second, remote_addr)) {
+  if (Filter(entry, remote_addr)) {
     LOG(LS_INFO) << "Packet from " << remote_addr.ToString()
                  << " was filtered out by the NAT.";
     return;
@@ -148,28 +226,122 @@ void NATServer::OnExternalPacket(
 
   // Forward this packet to the internal address.
   // First prepend the address in a quasi-STUN format.
-  scoped_array<char> real_buf(new char[size + kNATEncodedIPv6AddressSize]);
-  size_t addrlength = PackAddressForNAT(real_buf.get(),
-                                        size + kNATEncodedIPv6AddressSize,
+  size_t needed = size + kNATEncodedIPv6AddressSize;
+  if (buffer_size_ < needed) {
+    buffer_.reset(new char[needed]);
+    buffer_size_ = needed;
+  }
+  size_t addrlength = PackAddressForNAT(buffer_.get(), buffer_size_,
                                         remote_addr);
   // Copy the data part after the address.
-  std::memcpy(real_buf.get() + addrlength, buf, size);
-  server_socket_->SendTo(real_buf.get(), size + addrlength,
-                         iter->second->route.source());
+  std::memcpy(buffer_.get() + addrlength, buf, size);
+  server_socket_->SendTo(buffer_.get(), size + addrlength,
+                         entry->route.source());
 }
 
-void NATServer::Translate(const SocketAddressPair& route) {
+NATServer::TransEntry* NATServer::Translate(const SocketAddressPair& route) {
   AsyncUDPSocket* socket = AsyncUDPSocket::Create(external_, external_ip_);
 
   if (!socket) {
     LOG(LS_ERROR) << "Couldn't find a free port!";
-    return;
+    return NULL;
   }
 
   TransEntry* entry = new TransEntry(route, socket, nat_);
-  (*int_map_)[route] = entry;
-  (*ext_map_)[socket->GetLocalAddress()] = entry;
+  Insert(entry);
   socket->SignalReadPacket.connect(this, &NATServer::OnExternalPacket);
+  return entry;
+}
+
+NATServer::TransEntry* NATServer::LookupInternal(
+    const SocketAddressPair& route) const {
+  TransEntry* entry =
+      int_table_[Bucket(route_cmp_(route), int_table_.size())];
+  while (entry && (route_cmp_(route, entry->route) ||
+                   route_cmp_(entry->route, route))) {
+    entry = entry->int_next;
+  }
+  return entry;
+}
+
+NATServer::TransEntry* NATServer::LookupExternal(
+    const AsyncPacketSocket* socket) const {
+  TransEntry* entry = ext_table_[Bucket(reinterpret_cast<size_t>(socket),
+                                        ext_table_.size())];
+  while (entry && entry->socket != socket) {
+    entry = entry->ext_next;
+  }
+  return entry;
+}
+
+void NATServer::Insert(TransEntry* entry) {
+  if (entry_count_ >= int_table_.size()) {
+    Resize(int_table_.size() * 2);
+  }
+  size_t i = Bucket(route_cmp_(entry->route), int_table_.size());
+  entry->int_next = int_table_[i];
+  int_table_[i] = entry;
+  size_t e = Bucket(reinterpret_cast<size_t>(entry->socket), ext_table_.size());
+  entry->ext_next = ext_table_[e];
+  ext_table_[e] = entry;
+  ++entry_count_;
+}
+
+void NATServer::Remove(TransEntry* entry) {
+  TransEntry** link =
+      &int_table_[Bucket(route_cmp_(entry->route), int_table_.size())];
+  while (*link != entry) {
+    link = &(*link)->int_next;
+  }
+  *link = entry->int_next;
+  link = &ext_table_[Bucket(reinterpret_cast<size_t>(entry->socket),
+                            ext_table_.size())];
+  while (*link != entry) {
+    link = &(*link)->ext_next;
+  }
+  *link = entry->ext_next;
+  --entry_count_;
+}
+
+void NATServer::Resize(size_t buckets) {
+  HashTable old_table(buckets);
+  old_table.swap(ext_table_);
+  int_table_.assign(buckets, NULL);
+  entry_count_ = 0;
+  for (size_t i = 0; i < old_table.size(); ++i) {
+    TransEntry* entry = old_table[i];
+    while (entry) {
+      TransEntry* next = entry->ext_next;
+      size_t b = Bucket(route_cmp_(entry->route), buckets);
+      entry->int_next = int_table_[b];
+      int_table_[b] = entry;
+      b = Bucket(reinterpret_cast<size_t>(entry->socket), buckets);
+      entry->ext_next = ext_table_[b];
+      ext_table_[b] = entry;
+      ++entry_count_;
+      entry = next;
+    }
+  }
+}
+
+void NATServer::ExpireMappings() {
+  uint32 now = Time();
+  for (size_t i = 0; i < ext_table_.size(); ++i) {
+    TransEntry* entry = ext_table_[i];
+    while (entry) {
+      TransEntry* next = entry->ext_next;
+      if (IsExpired(entry, now)) {
+        Remove(entry);
+        delete entry;
+      }
+      entry = next;
+    }
+  }
+}
+
+bool NATServer::IsExpired(const TransEntry* entry, uint32 now) const {
+  return mapping_timeout_ > 0 &&
+      TimeDiff(now, entry->last_sent) >= mapping_timeout_;
 }
 
 bool NATServer::Filter(TransEntry* entry, const SocketAddress& ext_addr) {
@@ -178,7 +350,7 @@ bool NATServer::Filter(TransEntry* entry, const SocketAddress& ext_addr) {
 
 NATServer::TransEntry::TransEntry(
     const SocketAddressPair& r, AsyncUDPSocket* s, NAT* nat)
-    : route(r), socket(s) {
+    : route(r), socket(s), last_sent(0), int_next(NULL), ext_next(NULL) {
   whitelist = new AddressSet(AddrCmp(nat));
 }
 
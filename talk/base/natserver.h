@@ -28,10 +28,12 @@
 #ifndef TALK_BASE_NATSERVER_H_
 #define TALK_BASE_NATSERVER_H_
 
-#include <map>
 #include <set>
+#include <vector>
 
 #include "talk/base/asyncudpsocket.h"
+#include "talk/base/messagehandler.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/socketaddresspair.h"
 #include "talk/base/thread.h"
 #include "talk/base/socketfactory.h"
@@ -48,7 +50,9 @@ struct RouteCmp {
   bool operator()(
       const SocketAddressPair& r1, const SocketAddressPair& r2) const;
 
-  bool symmetric;
+  // Whether the destination's IP and port select the mapping.
+  bool use_dest_ip;
+  bool use_dest_port;
 };
 
 // Changes how addresses are compared based on the filtering rules of the NAT.
@@ -66,17 +70,31 @@ struct AddrCmp {
 
 const int NAT_SERVER_PORT = 4237;
 
-class NATServer : public sigslot::has_slots<> {
+class NATServer : public MessageHandler, public sigslot::has_slots<> {
  public:
   NATServer(
       NATType type, SocketFactory* internal, const SocketAddress& internal_addr,
       SocketFactory* external, const SocketAddress& external_ip);
+  // Takes ownership of |nat|; see NAT::Create(NATBehavior, NATBehavior).
+  NATServer(
+      NAT* nat, SocketFactory* internal, const SocketAddress& internal_addr,
+      SocketFactory* external, const SocketAddress& external_ip);
   ~NATServer();
 
   SocketAddress internal_address() const {
     return server_socket_->GetLocalAddress();
   }
 
+  // Mappings which haven't sent anything for this many milliseconds are
+  // removed, and the next outbound packet gets a new one; inbound packets
+  // don't keep a mapping alive (RFC 4787, REQ-5 and REQ-6).  0, the default,
+  // keeps mappings forever.  Expiry runs on the current thread.
+  int mapping_timeout() const { return mapping_timeout_; }
+  void set_mapping_timeout(int timeout);
+
+  // The number of live mappings.
+  size_t mapping_count() const { return entry_count_; }
+
   // Packets received on one of the networks.
   void OnInternalPacket(AsyncPacketSocket* socket, const char* buf,
                         size_t size, const SocketAddress& addr);
@@ -94,25 +112,55 @@ class NATServer : public sigslot::has_slots<> {
     SocketAddressPair route;
     AsyncUDPSocket* socket;
     AddressSet* whitelist;
+    uint32 last_sent;
+    // Chains in the internal and external hash tables.
+    TransEntry* int_next;
+    TransEntry* ext_next;
   };
 
-  typedef std::map<SocketAddressPair, TransEntry*, RouteCmp> InternalMap;
-  typedef std::map<SocketAddress, TransEntry*> ExternalMap;
+  // Translations are found through two hash tables of power-of-two size,
+  // chained through the entries: by route, as compared by |route_cmp_|, for
+  // outbound packets, and by external socket for inbound ones.
+  typedef std::vector<TransEntry*> HashTable;
+
+  void Init(SocketFactory* internal, const SocketAddress& internal_addr);
+
+  virtual void OnMessage(Message* msg);
 
   /* Creates a new entry that translates the given route. */
-  void Translate(const SocketAddressPair& route);
+  TransEntry* Translate(const SocketAddressPair& route);
+
+  /* Finds the entries for a route or an external socket. */
+  TransEntry* LookupInternal(const SocketAddressPair& route) const;
+  TransEntry* LookupExternal(const AsyncPacketSocket* socket) const;
+
+  /* Adds, removes and rehashes entries in both tables. */
+  void Insert(TransEntry* entry);
+  void Remove(TransEntry* entry);
+  void Resize(size_t buckets);
+
+  /* Removes all of the entries that have timed out. */
+  void ExpireMappings();
+  bool IsExpired(const TransEntry* entry, uint32 now) const;
 
   /* Determines whether the NAT would filter out a packet from this address. */
   bool Filter(TransEntry* entry, const SocketAddress& ext_addr);
 
   NAT* nat_;
+  RouteCmp route_cmp_;
   SocketFactory* internal_;
   SocketFactory* external_;
   SocketAddress external_ip_;
   AsyncUDPSocket* server_socket_;
   AsyncSocket* tcp_server_socket_;
-  InternalMap* int_map_;
-  ExternalMap* ext_map_;
+  HashTable int_table_;
+  HashTable ext_table_;
+  size_t entry_count_;
+  int mapping_timeout_;
+  Thread* expiry_thread_;
+  // Reused to prepend the source address to inbound packets.
+  scoped_array<char> buffer_;
+  size_t buffer_size_;
   DISALLOW_EVIL_CONSTRUCTORS(NATServer);
 };
 
@@ -59,6 +59,20 @@ public:
   bool FiltersPort() { return true; }
 };
 
+class BehaviorNAT : public NAT {
+public:
+  BehaviorNAT(NATBehavior mapping, NATBehavior filtering)
+      : mapping_(mapping), filtering_(filtering) { }
+  bool IsSymmetric() { return mapping_ != NAT_ENDPOINT_INDEPENDENT; }
+  bool FiltersIP() { return filtering_ != NAT_ENDPOINT_INDEPENDENT; }
+  bool FiltersPort() { return filtering_ == NAT_ADDRESS_AND_PORT_DEPENDENT; }
+  NATBehavior MappingBehavior() { return mapping_; }
+
+private:
+  NATBehavior mapping_;
+  NATBehavior filtering_;
+};
+
 NAT* NAT::Create(NATType type) {
   switch (type) {
   case NAT_OPEN_CONE:       return new OpenConeNAT();
@@ -69,4 +83,8 @@ NAT* NAT::Create(NATType type) {
   }
 }
 
+NAT* NAT::Create(NATBehavior mapping, NATBehavior filtering) {
+  return new BehaviorNAT(mapping, filtering);
+}
+
 } // namespace talk_base
@@ -38,6 +38,15 @@ enum NATType {
   NAT_SYMMETRIC
 };
 
+// The mapping and filtering behaviors of RFC 4787, sections 4.1 and 5.  The
+// classic NAT types are combinations of these; for example, a symmetric NAT
+// has address and port dependent mapping and filtering.
+enum NATBehavior {
+  NAT_ENDPOINT_INDEPENDENT,
+  NAT_ADDRESS_DEPENDENT,
+  NAT_ADDRESS_AND_PORT_DEPENDENT
+};
+
 // Implements the rules for each specific type of NAT.
 class NAT {
 public:
@@ -55,8 +64,19 @@ public:
   // the one last sent to.
   virtual bool FiltersPort() = 0;
 
+  // Determines which parts of the destination select the mapping.  By
+  // default, a symmetric NAT maps per address and port.
+  virtual NATBehavior MappingBehavior() {
+    return IsSymmetric() ? NAT_ADDRESS_AND_PORT_DEPENDENT :
+                           NAT_ENDPOINT_INDEPENDENT;
+  }
+
   // Returns an implementation of the given type of NAT.
   static NAT* Create(NATType type);
+  // Returns a NAT with the given RFC 4787 behaviors, which can be combined
+  // in ways the NATType presets can't, e.g. address dependent mapping with
+  // port restricted filtering.
+  static NAT* Create(NATBehavior mapping, NATBehavior filtering);
 };
 
 } // namespace talk_base
@@ -36,6 +36,17 @@ class AsyncPacketSocket;
 
 class PacketSocketFactory {
  public:
+  // Flags for the |opts| of the TCP socket methods.
+  enum Options {
+    // Wraps the connection in the pseudo-SSL handshake used by SSLTCP.
+    OPT_SSLTCP = 0x01,
+    // Runs TLS over the connection. Supported for client sockets only.
+    OPT_TLS = 0x02,
+    // Frames packets as STUN and TURN ChannelData messages (RFC 5766
+    // section 11.5) instead of with a 2-byte length prefix.
+    OPT_STUN = 0x04,
+  };
+
   PacketSocketFactory() { }
   virtual ~PacketSocketFactory() { }
 
@@ -43,13 +54,14 @@ class PacketSocketFactory {
       const SocketAddress& address, int min_port, int max_port) = 0;
   virtual AsyncPacketSocket* CreateServerTcpSocket(
       const SocketAddress& local_address, int min_port, int max_port,
-      bool ssl) = 0;
+      int opts) = 0;
 
   // TODO: |proxy_info| and |user_agent| should be set
   // per-factory and not when socket is created.
   virtual AsyncPacketSocket* CreateClientTcpSocket(
       const SocketAddress& local_address, const SocketAddress& remote_address,
-      const ProxyInfo& proxy_info, const std::string& user_agent, bool ssl) = 0;
+      const ProxyInfo& proxy_info, const std::string& user_agent,
+      int opts) = 0;
 
  private:
   DISALLOW_EVIL_CONSTRUCTORS(PacketSocketFactory);
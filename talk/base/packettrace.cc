@@ -0,0 +1,211 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/packettrace.h"
+
+#ifdef POSIX
+#include <pthread.h>
+#endif
+
+#include <sstream>
+#include <vector>
+
+#include "talk/base/common.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/seqlock.h"
+
+namespace talk_base {
+
+static const char* const kStageNames[PS_COUNT] = {
+  "recv.socket",
+  "recv.port",
+  "recv.connection",
+  "recv.transport",
+  "recv.srtp",
+  "recv.media",
+  "send.queue",
+  "send.srtp",
+  "send.transport",
+  "send.port",
+  "send.socket",
+};
+
+// The timing state of one thread.  Only that thread writes to it.  It is
+// never freed, so that the packets a thread timed still count after it has
+// gone.
+struct PacketTrace::ThreadTrace {
+  ThreadTrace() : generation(0) {
+    for (int i = 0; i < PP_COUNT; ++i) {
+      marks[i] = 0;
+    }
+  }
+
+  volatile int generation;
+  uint64 marks[PP_COUNT];
+  SeqLock<Histogram> stages[PS_COUNT];
+};
+
+volatile bool PacketTrace::enabled_ = false;
+CriticalSection PacketTrace::crit_;
+std::vector<PacketTrace::ThreadTrace*> PacketTrace::traces_;
+
+// Bumping the generation tells each thread to empty its histograms the next
+// time it marks a packet; until then, readers leave them out.
+static volatile int g_generation = 0;
+#ifdef WIN32
+static DWORD g_key = TLS_OUT_OF_INDEXES;
+#else
+static pthread_key_t g_key;
+static bool g_key_created = false;
+#endif
+
+void PacketTrace::Enable(bool enable) {
+  CritScope cs(&crit_);
+  if (enable && !enabled_) {
+#ifdef WIN32
+    if (g_key == TLS_OUT_OF_INDEXES) {
+      g_key = TlsAlloc();
+    }
+#else
+    if (!g_key_created) {
+      pthread_key_create(&g_key, NULL);
+      g_key_created = true;
+    }
+#endif
+    ++g_generation;
+    AtomicOps::Barrier();
+  }
+  enabled_ = enable;
+}
+
+void PacketTrace::Reset() {
+  CritScope cs(&crit_);
+  ++g_generation;
+}
+
+const char* PacketTrace::StageName(PacketStage stage) {
+  ASSERT(stage >= 0 && stage < PS_COUNT);
+  return kStageNames[stage];
+}
+
+Histogram PacketTrace::GetHistogram(PacketStage stage) {
+  ASSERT(stage >= 0 && stage < PS_COUNT);
+  Histogram histogram;
+  CritScope cs(&crit_);
+  for (size_t i = 0; i < traces_.size(); ++i) {
+    if (traces_[i]->generation == g_generation) {
+      histogram.Merge(traces_[i]->stages[stage].Read());
+    }
+  }
+  return histogram;
+}
+
+std::string PacketTrace::ToJson() {
+  std::ostringstream ost;
+  ost << "{\"enabled\":" << (enabled_ ? "true" : "false")
+      << ",\"unit\":\"ns\",\"stages\":[";
+  for (int i = 0; i < PS_COUNT; ++i) {
+    PacketStage stage = static_cast<PacketStage>(i);
+    Histogram histogram = GetHistogram(stage);
+    if (i > 0) {
+      ost << ",";
+    }
+    ost << "{\"name\":\"" << StageName(stage) << "\""
+        << ",\"count\":" << histogram.count()
+        << ",\"min\":" << histogram.min()
+        << ",\"mean\":" << histogram.ComputeMean()
+        << ",\"p50\":" << histogram.ComputePercentile(50)
+        << ",\"p90\":" << histogram.ComputePercentile(90)
+        << ",\"p99\":" << histogram.ComputePercentile(99)
+        << ",\"max\":" << histogram.max() << "}";
+  }
+  ost << "]}";
+  return ost.str();
+}
+
+PacketTrace::ThreadTrace* PacketTrace::CurrentThreadTrace() {
+#ifdef WIN32
+  ThreadTrace* trace = static_cast<ThreadTrace*>(TlsGetValue(g_key));
+#else
+  ThreadTrace* trace = static_cast<ThreadTrace*>(pthread_getspecific(g_key));
+#endif
+  if (!trace) {
+    trace = new ThreadTrace();
+#ifdef WIN32
+    TlsSetValue(g_key, trace);
+#else
+    pthread_setspecific(g_key, trace);
+#endif
+    CritScope cs(&crit_);
+    traces_.push_back(trace);
+  }
+
+  int generation = g_generation;
+  if (trace->generation != generation) {
+    // Empty the histograms before owning up to the new generation, so that
+    // readers never count the old samples in with the new.
+    for (int i = 0; i < PS_COUNT; ++i) {
+      trace->stages[i].BeginWrite()->Reset();
+      trace->stages[i].EndWrite();
+    }
+    for (int i = 0; i < PP_COUNT; ++i) {
+      trace->marks[i] = 0;
+    }
+    AtomicOps::Barrier();
+    trace->generation = generation;
+  }
+  return trace;
+}
+
+void PacketTrace::SetMark(PacketPath path, uint64 mark) {
+  CurrentThreadTrace()->marks[path] = mark;
+}
+
+uint64 PacketTrace::TakeMark(PacketPath path) {
+  ThreadTrace* trace = CurrentThreadTrace();
+  uint64 mark = trace->marks[path];
+  trace->marks[path] = 0;
+  return mark;
+}
+
+void PacketTrace::AddMark(PacketStage stage) {
+  ThreadTrace* trace = CurrentThreadTrace();
+  PacketPath path = (stage < PS_SEND_QUEUE) ? PP_RECV : PP_SEND;
+  uint64 last = trace->marks[path];
+  if (!last) {
+    return;
+  }
+  uint64 now = TimeNanos();
+  uint64 elapsed = (now > last) ? now - last : 0;
+  trace->stages[stage].BeginWrite()->AddSample(
+      static_cast<uint32>(_min<uint64>(elapsed, 0xFFFFFFFF)));
+  trace->stages[stage].EndWrite();
+  trace->marks[path] = now;
+}
+
+}  // namespace talk_base
@@ -0,0 +1,158 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_BASE_PACKETTRACE_H_
+#define TALK_BASE_PACKETTRACE_H_
+
+#include <string>
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+#include "talk/base/histogram.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+// The stages a media packet goes through between a UDP socket and the media
+// engine.  Each stage is timed from the end of the one before it.
+enum PacketStage {
+  // Receiving, in the order the packet gets to them.
+  PS_RECV_SOCKET,      // Reading the packet from the socket.
+  PS_RECV_PORT,        // Finding the connection it arrived on.
+  PS_RECV_CONNECTION,  // Checking it on the connection.
+  PS_RECV_TRANSPORT,   // The transport channel, and DTLS if any.
+  PS_RECV_SRTP,        // Demuxing, checking and unprotecting it.
+  PS_RECV_MEDIA,       // Handing it to the media engine.
+  // Sending.
+  PS_SEND_QUEUE,       // Waiting for the worker thread, if sent from another.
+  PS_SEND_SRTP,        // Checking and protecting it.
+  PS_SEND_TRANSPORT,   // The transport channel, and DTLS if any.
+  PS_SEND_PORT,        // The connection and port.
+  PS_SEND_SOCKET,      // Writing it to the socket.
+  PS_COUNT
+};
+
+enum PacketPath {
+  PP_RECV,
+  PP_SEND,
+  PP_COUNT
+};
+
+// Optional timing of the packet path, for finding out where the time goes
+// between the socket and the media engine.  It is off until Enable() is
+// called, and while it is off each call on the packet path costs a test of
+// one flag.
+//
+// A packet is timed from Begin() on, on one thread; each Mark() then adds the
+// time since the previous mark to the histogram of that stage, in
+// nanoseconds.  Detach() and Attach() carry the time across a hop to another
+// thread.  Each thread keeps its own histograms, so timing a packet never
+// takes a lock or waits on a reader, and GetHistogram() and ToJson() may be
+// called from any thread at any time.
+class PacketTrace {
+ public:
+  static bool enabled() { return enabled_; }
+  // Turning timing on starts all the histograms afresh.
+  static void Enable(bool enable);
+  // Empties the histograms, on all threads.
+  static void Reset();
+
+  static void Begin(PacketPath path) {
+    if (enabled_) {
+      SetMark(path, TimeNanos());
+    }
+  }
+  static void Mark(PacketStage stage) {
+    if (enabled_) {
+      AddMark(stage);
+    }
+  }
+  static void End(PacketPath path) {
+    if (enabled_) {
+      SetMark(path, 0);
+    }
+  }
+  // Stops timing |path| on this thread and returns the time of its last
+  // mark, or 0 if it wasn't being timed, to be passed to Attach() on the
+  // thread that carries on with the packet.
+  static uint64 Detach(PacketPath path) {
+    return enabled_ ? TakeMark(path) : 0;
+  }
+  static void Attach(PacketPath path, uint64 mark) {
+    if (enabled_ && mark) {
+      SetMark(path, mark);
+    }
+  }
+
+  // Returns e.g. "recv.srtp" for PS_RECV_SRTP.
+  static const char* StageName(PacketStage stage);
+  // The times of |stage| on all threads since timing was last reset.
+  static Histogram GetHistogram(PacketStage stage);
+  // All the stages as a JSON object, e.g.
+  // {"enabled":true,"unit":"ns","stages":[{"name":"recv.socket","count":10,
+  //  "min":2100,"mean":2800.5,"p50":2700,"p90":3500,"p99":4100,
+  //  "max":4150},...]}
+  static std::string ToJson();
+
+ private:
+  struct ThreadTrace;
+
+  static ThreadTrace* CurrentThreadTrace();
+  static void SetMark(PacketPath path, uint64 mark);
+  static uint64 TakeMark(PacketPath path);
+  static void AddMark(PacketStage stage);
+
+  static volatile bool enabled_;
+  // Guards the list of threads and the creation of the thread local key.
+  static CriticalSection crit_;
+  static std::vector<ThreadTrace*> traces_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(PacketTrace);
+};
+
+// Times |path| for as long as it is in scope.
+class PacketTraceScope {
+ public:
+  explicit PacketTraceScope(PacketPath path) : path_(path) {
+    PacketTrace::Begin(path_);
+  }
+  ~PacketTraceScope() {
+    PacketTrace::End(path_);
+  }
+
+ private:
+  PacketPath path_;
+
+  DISALLOW_COPY_AND_ASSIGN(PacketTraceScope);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_PACKETTRACE_H_
@@ -0,0 +1,165 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string>
+
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/packettrace.h"
+#include "talk/base/thread.h"
+
+namespace talk_base {
+
+class PacketTraceTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    PacketTrace::Enable(true);
+  }
+  virtual void TearDown() {
+    PacketTrace::Enable(false);
+  }
+};
+
+TEST_F(PacketTraceTest, TestDisabled) {
+  PacketTrace::Enable(false);
+  EXPECT_FALSE(PacketTrace::enabled());
+  {
+    PacketTraceScope trace(PP_RECV);
+    PacketTrace::Mark(PS_RECV_SOCKET);
+  }
+  EXPECT_EQ(0U, PacketTrace::Detach(PP_SEND));
+
+  // Nothing counted while disabled is kept once enabled again.
+  PacketTrace::Enable(true);
+  EXPECT_EQ(0U, PacketTrace::GetHistogram(PS_RECV_SOCKET).count());
+}
+
+TEST_F(PacketTraceTest, TestMarks) {
+  for (int i = 0; i < 10; ++i) {
+    PacketTraceScope trace(PP_RECV);
+    PacketTrace::Mark(PS_RECV_SOCKET);
+    Thread::SleepMs(1);
+    PacketTrace::Mark(PS_RECV_PORT);
+    // A mark on the other path doesn't count, since it wasn't begun.
+    PacketTrace::Mark(PS_SEND_SOCKET);
+  }
+  // Nor do marks once the scope has ended.
+  PacketTrace::Mark(PS_RECV_MEDIA);
+
+  Histogram socket = PacketTrace::GetHistogram(PS_RECV_SOCKET);
+  Histogram port = PacketTrace::GetHistogram(PS_RECV_PORT);
+  EXPECT_EQ(10U, socket.count());
+  EXPECT_EQ(10U, port.count());
+  EXPECT_LT(socket.max(), 1000000U);
+  EXPECT_GE(port.min(), 1000000U);
+  EXPECT_EQ(0U, PacketTrace::GetHistogram(PS_SEND_SOCKET).count());
+  EXPECT_EQ(0U, PacketTrace::GetHistogram(PS_RECV_MEDIA).count());
+
+  PacketTrace::Reset();
+  EXPECT_EQ(0U, PacketTrace::GetHistogram(PS_RECV_PORT).count());
+  {
+    PacketTraceScope trace(PP_RECV);
+    PacketTrace::Mark(PS_RECV_PORT);
+  }
+  EXPECT_EQ(1U, PacketTrace::GetHistogram(PS_RECV_PORT).count());
+}
+
+// Carries a packet's time over to another thread, as BaseChannel does when
+// a packet is sent from outside the worker thread.
+class PacketTraceReceiver : public MessageHandler {
+ public:
+  struct MarkData : public MessageData {
+    explicit MarkData(uint64 m) : mark(m) {}
+    uint64 mark;
+  };
+
+  virtual void OnMessage(Message* msg) {
+    MarkData* data = static_cast<MarkData*>(msg->pdata);
+    PacketTrace::Attach(PP_SEND, data->mark);
+    PacketTrace::Mark(PS_SEND_QUEUE);
+    PacketTrace::End(PP_SEND);
+    delete data;
+  }
+};
+
+TEST_F(PacketTraceTest, TestHop) {
+  Thread worker;
+  worker.Start();
+  PacketTraceReceiver receiver;
+  for (int i = 0; i < 5; ++i) {
+    PacketTraceScope trace(PP_SEND);
+    worker.Post(&receiver, 0, new PacketTraceReceiver::MarkData(
+        PacketTrace::Detach(PP_SEND)));
+  }
+  // The samples are added on the worker thread.
+  EXPECT_EQ_WAIT(5U, PacketTrace::GetHistogram(PS_SEND_QUEUE).count(), 1000);
+  worker.Stop();
+}
+
+TEST_F(PacketTraceTest, TestJson) {
+  {
+    PacketTraceScope trace(PP_SEND);
+    PacketTrace::Mark(PS_SEND_SRTP);
+  }
+  std::string json = PacketTrace::ToJson();
+  EXPECT_EQ(0U, json.find("{\"enabled\":true,\"unit\":\"ns\",\"stages\":["));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\":\"recv.socket\",\"count\":0,"));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\":\"send.srtp\",\"count\":1,"));
+  EXPECT_EQ('}', json[json.size() - 1]);
+  for (int i = 0; i < PS_COUNT; ++i) {
+    EXPECT_NE(std::string::npos,
+              json.find(PacketTrace::StageName(static_cast<PacketStage>(i))));
+  }
+}
+
+// Measures what the marks cost on the packet path, with timing on and off.
+TEST_F(PacketTraceTest, DISABLED_Perf) {
+  static const int kPackets = 100000;
+  for (int enabled = 0; enabled < 2; ++enabled) {
+    PacketTrace::Enable(enabled != 0);
+    uint64 start = TimeNanos();
+    for (int i = 0; i < kPackets; ++i) {
+      PacketTraceScope trace(PP_RECV);
+      PacketTrace::Mark(PS_RECV_SOCKET);
+      PacketTrace::Mark(PS_RECV_PORT);
+      PacketTrace::Mark(PS_RECV_CONNECTION);
+      PacketTrace::Mark(PS_RECV_TRANSPORT);
+      PacketTrace::Mark(PS_RECV_SRTP);
+      PacketTrace::Mark(PS_RECV_MEDIA);
+    }
+    uint64 elapsed = TimeNanos() - start;
+    LOG(LS_INFO) << "Packet trace " << (enabled ? "on" : "off") << ": "
+                 << elapsed / kPackets << " ns per packet";
+  }
+  EXPECT_EQ(static_cast<uint32>(kPackets),
+            PacketTrace::GetHistogram(PS_RECV_MEDIA).count());
+}
+
+}  // namespace talk_base
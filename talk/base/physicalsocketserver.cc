@@ -36,6 +36,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <signal.h>
 #endif
@@ -69,6 +70,9 @@
 #ifdef POSIX
 #include <netinet/tcp.h>  // for TCP_NODELAY
 #define IP_MTU 14 // Until this is integrated from linux/in.h to netinet/in.h
+#if defined(LINUX) && !defined(SO_MAX_PACING_RATE)
+#define SO_MAX_PACING_RATE 47  // From asm-generic/socket.h, Linux 3.13.
+#endif
 typedef void* SockOptArg;
 #endif  // POSIX
 
@@ -269,6 +273,8 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
 #ifdef LINUX
       value = (value) ? IP_PMTUDISC_DO : IP_PMTUDISC_DONT;
 #endif
+    } else if (opt == OPT_PACING_RATE && value == 0) {
+      value = -1;  // ~0U is unlimited; 0 would stop the socket sending.
     }
     return ::setsockopt(s_, slevel, sopt, (SockOptArg)&value, sizeof(value));
   }
@@ -295,6 +301,77 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
     return sent;
   }
 
+#ifdef POSIX
+  virtual int SendV(const IoVec* iov, size_t count) {
+    static const size_t kMaxVecs = 16;
+    if (count > kMaxVecs) {
+      return AsyncSocket::SendV(iov, count);
+    }
+    iovec vecs[kMaxVecs];
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+      vecs[i].iov_base = const_cast<void*>(iov[i].data);
+      vecs[i].iov_len = iov[i].len;
+      total += iov[i].len;
+    }
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = vecs;
+    msg.msg_iovlen = count;
+    int sent = ::sendmsg(s_, &msg,
+#ifdef LINUX
+        // Suppress SIGPIPE. See Send() for explanation.
+        MSG_NOSIGNAL
+#else
+        0
+#endif
+        );
+    UpdateLastError();
+    ASSERT(sent <= static_cast<int>(total));
+    if ((sent < 0) && IsBlockingError(error_)) {
+      enabled_events_ |= DE_WRITE;
+    }
+    return sent;
+  }
+
+  virtual int SendToV(const IoVec* iov, size_t count,
+                      const SocketAddress& addr) {
+    static const size_t kMaxVecs = 16;
+    if (count > kMaxVecs) {
+      return AsyncSocket::SendToV(iov, count, addr);
+    }
+    iovec vecs[kMaxVecs];
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+      vecs[i].iov_base = const_cast<void*>(iov[i].data);
+      vecs[i].iov_len = iov[i].len;
+      total += iov[i].len;
+    }
+    sockaddr_storage saddr;
+    size_t len = addr.ToSockAddrStorage(&saddr);
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &saddr;
+    msg.msg_namelen = static_cast<socklen_t>(len);
+    msg.msg_iov = vecs;
+    msg.msg_iovlen = count;
+    int sent = ::sendmsg(s_, &msg,
+#ifdef LINUX
+        // Suppress SIGPIPE. See Send() for explanation.
+        MSG_NOSIGNAL
+#else
+        0
+#endif
+        );
+    UpdateLastError();
+    ASSERT(sent <= static_cast<int>(total));
+    if ((sent < 0) && IsBlockingError(error_)) {
+      enabled_events_ |= DE_WRITE;
+    }
+    return sent;
+  }
+#endif  // POSIX
+
   int SendTo(const void* buffer, size_t length, const SocketAddress& addr) {
     sockaddr_storage saddr;
     size_t len = addr.ToSockAddrStorage(&saddr);
@@ -515,6 +592,16 @@ class PhysicalSocket : public AsyncSocket, public sigslot::has_slots<> {
         *slevel = IPPROTO_TCP;
         *sopt = TCP_NODELAY;
         break;
+      case OPT_PACING_RATE:
+#if defined(LINUX)
+        // Enforced by the fq queueing discipline, where it is in use.
+        *slevel = SOL_SOCKET;
+        *sopt = SO_MAX_PACING_RATE;
+        break;
+#else
+        LOG(LS_WARNING) << "Socket::OPT_PACING_RATE not supported.";
+        return -1;
+#endif
       default:
         ASSERT(false);
         return -1;
@@ -0,0 +1,96 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_BASE_SEQLOCK_H_
+#define TALK_BASE_SEQLOCK_H_
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+
+namespace talk_base {
+
+// Holds a value that one thread updates and any number of other threads
+// read, without either side ever waiting on a lock.  The writer bumps a
+// sequence number before and after each change; a reader copies the value
+// and retries if the sequence number was odd (a write was in progress) or
+// moved while it was copying.  Reads are therefore only cheap when the value
+// is small and writes are short, which suits counters and statistics that
+// are updated on a packet path and polled by someone else.
+//
+// T must be copyable by plain assignment and must not own memory, since a
+// reader may copy it while it is half way through being changed.
+template <class T>
+class SeqLock {
+ public:
+  SeqLock() : sequence_(0), value_() {}
+  explicit SeqLock(const T& value) : sequence_(0), value_(value) {}
+
+  // Writer side.  Only one thread may write, and each BeginWrite() must be
+  // matched by an EndWrite(); the returned pointer may be used to change the
+  // value in place between the two.
+  T* BeginWrite() {
+    ++sequence_;
+    AtomicOps::Barrier();
+    return &value_;
+  }
+  void EndWrite() {
+    AtomicOps::Barrier();
+    ++sequence_;
+  }
+  void Write(const T& value) {
+    *BeginWrite() = value;
+    EndWrite();
+  }
+
+  // The current value, for use on the writer thread only.
+  const T& value() const { return value_; }
+
+  // Reader side.  Returns a consistent copy of the value as of some write.
+  T Read() const {
+    T snapshot;
+    uint32 begin;
+    do {
+      begin = sequence_;
+      AtomicOps::Barrier();
+      snapshot = value_;
+      AtomicOps::Barrier();
+    } while ((begin & 1) != 0 || begin != sequence_);
+    return snapshot;
+  }
+
+ private:
+  volatile uint32 sequence_;
+  T value_;
+
+  DISALLOW_COPY_AND_ASSIGN(SeqLock);
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_SEQLOCK_H_
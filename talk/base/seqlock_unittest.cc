@@ -0,0 +1,117 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/gunit.h"
+#include "talk/base/seqlock.h"
+#include "talk/base/thread.h"
+
+namespace talk_base {
+
+// Two fields that the writer always keeps equal, so a torn read shows up as
+// a mismatch.
+struct Pair {
+  uint32 first;
+  uint32 second;
+};
+
+class SeqLockReader : public Thread {
+ public:
+  static const uint32 kWrites = 1000000;
+
+  explicit SeqLockReader(const SeqLock<Pair>* lock)
+      : lock_(lock), reads_(0), torn_reads_(0), backward_reads_(0) {}
+  virtual ~SeqLockReader() { Stop(); }
+
+  // Reads until the writer's last value shows up.
+  virtual void Run() {
+    uint32 last = 0;
+    while (last < kWrites) {
+      Pair pair = lock_->Read();
+      ++reads_;
+      if (pair.first != pair.second) {
+        ++torn_reads_;
+      }
+      if (pair.first < last) {
+        ++backward_reads_;
+      }
+      last = pair.first;
+    }
+  }
+
+  int reads() const { return reads_; }
+  int torn_reads() const { return torn_reads_; }
+  int backward_reads() const { return backward_reads_; }
+
+ private:
+  const SeqLock<Pair>* lock_;
+  int reads_;
+  int torn_reads_;
+  int backward_reads_;
+};
+
+const uint32 SeqLockReader::kWrites;
+
+TEST(SeqLockTest, TestReadWrite) {
+  SeqLock<Pair> lock;
+  EXPECT_EQ(0U, lock.Read().first);
+
+  Pair pair = { 1, 2 };
+  lock.Write(pair);
+  EXPECT_EQ(1U, lock.Read().first);
+  EXPECT_EQ(2U, lock.Read().second);
+
+  lock.BeginWrite()->second = 3;
+  lock.EndWrite();
+  EXPECT_EQ(1U, lock.value().first);
+  EXPECT_EQ(3U, lock.Read().second);
+}
+
+// Readers on other threads must never see a value the writer is half way
+// through changing, nor go back to an older one.
+TEST(SeqLockTest, TestConcurrentReaders) {
+  SeqLock<Pair> lock;
+  SeqLockReader reader1(&lock), reader2(&lock);
+  reader1.Start();
+  reader2.Start();
+  for (uint32 i = 1; i <= SeqLockReader::kWrites; ++i) {
+    Pair* pair = lock.BeginWrite();
+    pair->first = i;
+    pair->second = i;
+    lock.EndWrite();
+  }
+  reader1.Stop();
+  reader2.Stop();
+  EXPECT_GT(reader1.reads(), 0);
+  EXPECT_EQ(0, reader1.torn_reads());
+  EXPECT_EQ(0, reader1.backward_reads());
+  EXPECT_GT(reader2.reads(), 0);
+  EXPECT_EQ(0, reader2.torn_reads());
+  EXPECT_EQ(0, reader2.backward_reads());
+}
+
+}  // namespace talk_base
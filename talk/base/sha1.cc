@@ -91,6 +91,10 @@
  *   84983E44 1C3BD26E BAAE4AA1 F95129E5 E54670F1
  * A million repetitions of "a"
  *   34AA973C D4C4DAA4 F61EEB2B DBAD2731 6534016F
+ * -----------------
+ * Modified 2013
+ * Use a stack workspace so SHA1Transform is thread safe, process runs of
+ * whole blocks at once, and use the SHA extensions when the CPU has them.
  */
 
 // Enabling SHA1HANDSOFF preserves the caller's data buffer.
@@ -102,6 +106,15 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "talk/base/cpufeatures.h"
+
+#ifdef HAVE_X86_INTRINSICS
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <smmintrin.h>
+#include <tmmintrin.h>
+#endif
+
 void SHA1Transform(uint32 state[5], const uint8 buffer[64]);
 
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
@@ -155,7 +168,7 @@ void SHA1Transform(uint32 state[5], const uint8 buffer[64]) {
     uint32 l[16];
   };
 #ifdef SHA1HANDSOFF
-  static uint8 workspace[64];
+  uint8 workspace[64];
   memcpy(workspace, buffer, 64);
   CHAR64LONG16* block = reinterpret_cast<CHAR64LONG16*>(workspace);
 #else
@@ -204,6 +217,102 @@ void SHA1Transform(uint32 state[5], const uint8 buffer[64]) {
   state[4] += e;
 }
 
+#ifdef HAVE_X86_INTRINSICS
+// Hashes |blocks| 512-bit blocks with the SHA extensions.  Based on the
+// public domain SHA-Intrinsics code by Jeffrey Walton and Sean Gulley.
+// Each step does 4 rounds while the message schedule for the following
+// steps is computed in the 4 message registers.
+#define SHA1_STEP(e_in, e_out, msg, func) \
+    e_in = _mm_sha1nexte_epu32(e_in, msg); \
+    e_out = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_in, func);
+#define SHA1_SCHEDULE(m0, m1, m2, m3) \
+    m1 = _mm_sha1msg2_epu32(m1, m0); \
+    m3 = _mm_sha1msg1_epu32(m3, m0); \
+    m2 = _mm_xor_si128(m2, m0);
+
+X86_TARGET("sha,sse4.1")
+static void SHA1TransformShaNi(uint32 state[5], const uint8* data,
+                               size_t blocks) {
+  const __m128i kByteSwap = _mm_set_epi64x(0x0001020304050607ULL,
+                                           0x08090a0b0c0d0e0fULL);
+  __m128i abcd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+  __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+  __m128i e1;
+
+  for (; blocks > 0; --blocks, data += 64) {
+    const __m128i* p = reinterpret_cast<const __m128i*>(data);
+    __m128i abcd_save = abcd;
+    __m128i e0_save = e0;
+    __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(p + 0), kByteSwap);
+    __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(p + 1), kByteSwap);
+    __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(p + 2), kByteSwap);
+    __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(p + 3), kByteSwap);
+
+    // Rounds 0-15 consume the message block directly.
+    e0 = _mm_add_epi32(e0, m0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    SHA1_STEP(e1, e0, m1, 0);
+    m0 = _mm_sha1msg1_epu32(m0, m1);
+    SHA1_STEP(e0, e1, m2, 0);
+    m1 = _mm_sha1msg1_epu32(m1, m2);
+    m0 = _mm_xor_si128(m0, m2);
+    SHA1_STEP(e1, e0, m3, 0);
+    SHA1_SCHEDULE(m3, m0, m1, m2);
+
+    // Rounds 16-67.
+    SHA1_STEP(e0, e1, m0, 0); SHA1_SCHEDULE(m0, m1, m2, m3);
+    SHA1_STEP(e1, e0, m1, 1); SHA1_SCHEDULE(m1, m2, m3, m0);
+    SHA1_STEP(e0, e1, m2, 1); SHA1_SCHEDULE(m2, m3, m0, m1);
+    SHA1_STEP(e1, e0, m3, 1); SHA1_SCHEDULE(m3, m0, m1, m2);
+    SHA1_STEP(e0, e1, m0, 1); SHA1_SCHEDULE(m0, m1, m2, m3);
+    SHA1_STEP(e1, e0, m1, 1); SHA1_SCHEDULE(m1, m2, m3, m0);
+    SHA1_STEP(e0, e1, m2, 2); SHA1_SCHEDULE(m2, m3, m0, m1);
+    SHA1_STEP(e1, e0, m3, 2); SHA1_SCHEDULE(m3, m0, m1, m2);
+    SHA1_STEP(e0, e1, m0, 2); SHA1_SCHEDULE(m0, m1, m2, m3);
+    SHA1_STEP(e1, e0, m1, 2); SHA1_SCHEDULE(m1, m2, m3, m0);
+    SHA1_STEP(e0, e1, m2, 2); SHA1_SCHEDULE(m2, m3, m0, m1);
+    SHA1_STEP(e1, e0, m3, 3); SHA1_SCHEDULE(m3, m0, m1, m2);
+
+    SHA1_STEP(e0, e1, m0, 3); SHA1_SCHEDULE(m0, m1, m2, m3);
+
+    // Rounds 68-79 only need the tail of the schedule.
+    SHA1_STEP(e1, e0, m1, 3);
+    m2 = _mm_sha1msg2_epu32(m2, m1);
+    m3 = _mm_xor_si128(m3, m1);
+    SHA1_STEP(e0, e1, m2, 3);
+    m3 = _mm_sha1msg2_epu32(m3, m2);
+    SHA1_STEP(e1, e0, m3, 3);
+
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1B);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), abcd);
+  state[4] = _mm_extract_epi32(e0, 3);
+}
+#undef SHA1_STEP
+#undef SHA1_SCHEDULE
+#endif  // HAVE_X86_INTRINSICS
+
+// Hash |blocks| consecutive 512-bit blocks.
+static void SHA1TransformBlocks(uint32 state[5], const uint8* data,
+                                size_t blocks) {
+#ifdef HAVE_X86_INTRINSICS
+  if (talk_base::CpuFeatures::Has(talk_base::CpuFeatures::kSHA |
+                                  talk_base::CpuFeatures::kSSE41)) {
+    SHA1TransformShaNi(state, data, blocks);
+    return;
+  }
+#endif
+  for (; blocks > 0; --blocks, data += 64) {
+    SHA1Transform(state, data);
+  }
+}
+
 // SHA1Init - Initialize new context.
 void SHA1Init(SHA1_CTX* context) {
   // SHA1 initialization constants.
@@ -239,10 +348,10 @@ void SHA1Update(SHA1_CTX* context, const uint8* data, size_t input_len) {
   if ((index + input_len) > 63) {
     i = 64 - index;
     memcpy(&context->buffer[index], data, i);
-    SHA1Transform(context->state, context->buffer);
-    for (; i + 63 < input_len; i += 64) {
-      SHA1Transform(context->state, data + i);
-    }
+    SHA1TransformBlocks(context->state, context->buffer, 1);
+    size_t blocks = (input_len - i) / 64;
+    SHA1TransformBlocks(context->state, data + i, blocks);
+    i += blocks * 64;
     index = 0;
   }
   memcpy(&context->buffer[index], &data[i], input_len - i);
@@ -260,10 +369,11 @@ void SHA1Final(SHA1_CTX* context, uint8 digest[SHA1_DIGEST_SIZE]) {
     finalcount[i] = static_cast<uint8>(
         (context->count[(i >= 4 ? 0 : 1)] >> ((3 - (i & 3)) * 8) ) & 255);
   }
-  SHA1Update(context, reinterpret_cast<const uint8*>("\200"), 1);
-  while ((context->count[0] & 504) != 448) {
-    SHA1Update(context, reinterpret_cast<const uint8*>("\0"), 1);
-  }
+  // Pad with 0x80 and then zeros to 56 mod 64 bytes, in one update.
+  static const uint8 kPadding[64] = { 0x80 };
+  size_t index = (context->count[0] >> 3) & 63;
+  size_t pad_len = (index < 56) ? (56 - index) : (120 - index);
+  SHA1Update(context, kPadding, pad_len);
   SHA1Update(context, finalcount, 8);  // Should cause a SHA1Transform().
   for (int i = 0; i < SHA1_DIGEST_SIZE; ++i) {
     digest[i] = static_cast<uint8>(
@@ -275,8 +385,4 @@ void SHA1Final(SHA1_CTX* context, uint8 digest[SHA1_DIGEST_SIZE]) {
   memset(context->state, 0, 20);
   memset(context->count, 0, 8);
   memset(finalcount, 0, 8);   // SWR
-
-#ifdef SHA1HANDSOFF  // Make SHA1Transform overwrite its own static vars.
-  SHA1Transform(context->state, context->buffer);
-#endif
 }
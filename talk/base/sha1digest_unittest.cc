@@ -25,9 +25,12 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "talk/base/cpufeatures.h"
 #include "talk/base/sha1digest.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
 #include "talk/base/stringencode.h"
+#include "talk/base/timeutils.h"
 
 namespace talk_base {
 
@@ -96,4 +99,58 @@ TEST(Sha1DigestTest, TestBufferConst) {
   }
 }
 
+// The portable and SHA extension implementations must agree for all lengths
+// around the block size, and regardless of how the input is split.
+TEST(Sha1DigestTest, TestImplementationsMatch) {
+  std::string input(300, '\0');
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = static_cast<char>(i * 37 + 11);
+  }
+  for (size_t len = 0; len <= input.size(); ++len) {
+    CpuFeatures::MaskForTest(0);
+    std::string portable = Sha1(input.substr(0, len));
+    CpuFeatures::MaskForTest(CpuFeatures::kAll);
+    EXPECT_EQ(portable, Sha1(input.substr(0, len))) << "len " << len;
+
+    Sha1Digest sha1;
+    char output[Sha1Digest::kSize];
+    sha1.Update(input.data(), len / 3);
+    sha1.Update(input.data() + len / 3, len - len / 3);
+    sha1.Finish(output, sizeof(output));
+    EXPECT_EQ(portable, hex_encode(output, sizeof(output))) << "len " << len;
+  }
+}
+
+// Compares the throughput of the implementations, for bulk data and for
+// STUN-sized messages.
+TEST(Sha1DigestTest, DISABLED_Perf) {
+  const size_t kBulkSize = 1024 * 1024;
+  const int kBulkIterations = 32;
+  const size_t kSmallSize = 100;
+  const int kSmallIterations = 100000;
+  std::string bulk(kBulkSize, 'x');
+  std::string small(kSmallSize, 'x');
+  char output[Sha1Digest::kSize];
+  Sha1Digest sha1;
+
+  for (int pass = 0; pass < 2; ++pass) {
+    CpuFeatures::MaskForTest(pass == 0 ? 0 : CpuFeatures::kAll);
+    uint32 start = Time();
+    for (int i = 0; i < kBulkIterations; ++i) {
+      ComputeDigest(&sha1, bulk.data(), bulk.size(), output, sizeof(output));
+    }
+    int bulk_ms = TimeSince(start);
+    start = Time();
+    for (int i = 0; i < kSmallIterations; ++i) {
+      ComputeDigest(&sha1, small.data(), small.size(), output, sizeof(output));
+    }
+    int small_ms = TimeSince(start);
+    LOG(LS_INFO) << (pass == 0 ? "Portable" : "Best available")
+                 << " SHA-1: " << kBulkIterations << " MB in " << bulk_ms
+                 << " ms, " << kSmallIterations << " " << kSmallSize
+                 << "-byte messages in " << small_ms << " ms";
+  }
+  CpuFeatures::MaskForTest(CpuFeatures::kAll);
+}
+
 }  // namespace talk_base
@@ -83,13 +83,22 @@
 // to connect or disconnect to signalx concurrently or data race may occur.
 // If signalx is single threaded the user must ensure that disconnect, connect
 // or signal is not happening concurrently or data race may occur.
+//
+// flat_signal0 ... flat_signal4 are drop-in replacements for signal0 ...
+// signal4 intended for hot paths such as packet delivery. They keep their
+// connections in a vector instead of a list, skip locking entirely when the
+// signal is single_threaded and call a lone connection directly. Connecting,
+// disconnecting and deleting the signal from inside a slot behave as they do
+// for signalx.
 
 #ifndef TALK_BASE_SIGSLOT_H__
 #define TALK_BASE_SIGSLOT_H__
 
+#include <algorithm>
 #include <list>
 #include <set>
 #include <stdlib.h>
+#include <vector>
 
 // On our copy of sigslot.h, we set single threading as default.
 #define SIGSLOT_DEFAULT_MT_POLICY single_threaded
@@ -2845,6 +2854,458 @@ namespace sigslot {
 		}
 	};
 
+	// Takes the signal's lock for the duration of an emission, unless the
+	// signal is single_threaded, in which case there's nothing to take.
+	template<class mt_policy>
+	class _emit_lock : public lock_block<mt_policy>
+	{
+	public:
+		_emit_lock(mt_policy *mtx)
+			: lock_block<mt_policy>(mtx)
+		{
+			;
+		}
+	};
+
+	template<>
+	class _emit_lock<single_threaded>
+	{
+	public:
+		_emit_lock(single_threaded *)
+		{
+			;
+		}
+	};
+
+	// Connection bookkeeping shared by the flat_signalx classes. Connections
+	// live in a vector. While an emission is walking the vector, removed
+	// entries are set to NULL rather than erased and the vector is compacted
+	// once the outermost emission finishes.
+	template<class connection_base, class mt_policy>
+	class _flat_signal_base : public _signal_base<mt_policy>
+	{
+	public:
+		typedef std::vector<connection_base *> connections_vector;
+
+		_flat_signal_base()
+			: m_emit_frame(NULL), m_dirty(false)
+		{
+			;
+		}
+
+		_flat_signal_base(const _flat_signal_base& s)
+			: _signal_base<mt_policy>(s), m_emit_frame(NULL), m_dirty(false)
+		{
+			lock_block<mt_policy> lock(this);
+			for(size_t i = 0; i < s.m_connected_slots.size(); ++i)
+			{
+				if(s.m_connected_slots[i])
+				{
+					s.m_connected_slots[i]->getdest()->signal_connect(this);
+					m_connected_slots.push_back(s.m_connected_slots[i]->clone());
+				}
+			}
+		}
+
+		~_flat_signal_base()
+		{
+			disconnect_all();
+
+			// Let any emission in progress know it must not touch us again.
+			for(_emit_frame* frame = m_emit_frame; frame; frame = frame->prev)
+			{
+				frame->destroyed = true;
+			}
+		}
+
+		void slot_duplicate(const has_slots_interface* oldtarget, has_slots_interface* newtarget)
+		{
+			lock_block<mt_policy> lock(this);
+			size_t count = m_connected_slots.size();
+			for(size_t i = 0; i < count; ++i)
+			{
+				if(m_connected_slots[i] && m_connected_slots[i]->getdest() == oldtarget)
+				{
+					m_connected_slots.push_back(m_connected_slots[i]->duplicate(newtarget));
+				}
+			}
+		}
+
+		bool is_empty()
+		{
+			lock_block<mt_policy> lock(this);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i])
+					return false;
+			}
+			return true;
+		}
+
+		void disconnect_all()
+		{
+			lock_block<mt_policy> lock(this);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i])
+				{
+					m_connected_slots[i]->getdest()->signal_disconnect(this);
+					delete m_connected_slots[i];
+					m_connected_slots[i] = NULL;
+				}
+			}
+
+			if(m_emit_frame)
+			{
+				m_dirty = true;
+			}
+			else
+			{
+				m_connected_slots.clear();
+			}
+		}
+
+#ifdef _DEBUG
+		bool connected(has_slots_interface* pclass)
+		{
+			lock_block<mt_policy> lock(this);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i] && m_connected_slots[i]->getdest() == pclass)
+					return true;
+			}
+			return false;
+		}
+#endif
+
+		void disconnect(has_slots_interface* pclass)
+		{
+			lock_block<mt_policy> lock(this);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i] && m_connected_slots[i]->getdest() == pclass)
+				{
+					delete m_connected_slots[i];
+					remove_slot(i);
+					pclass->signal_disconnect(this);
+					return;
+				}
+			}
+		}
+
+		void slot_disconnect(has_slots_interface* pslot)
+		{
+			lock_block<mt_policy> lock(this);
+			size_t i = 0;
+			while(i < m_connected_slots.size())
+			{
+				if(m_connected_slots[i] && m_connected_slots[i]->getdest() == pslot)
+				{
+					delete m_connected_slots[i];
+					if(remove_slot(i))
+						continue;
+				}
+
+				++i;
+			}
+		}
+
+	protected:
+		// One per emission in progress, linked from the innermost outwards.
+		struct _emit_frame
+		{
+			_emit_frame* prev;
+			bool destroyed;
+		};
+
+		void push_frame(_emit_frame* frame)
+		{
+			frame->prev = m_emit_frame;
+			frame->destroyed = false;
+			m_emit_frame = frame;
+		}
+
+		void pop_frame(_emit_frame* frame)
+		{
+			m_emit_frame = frame->prev;
+			if(!m_emit_frame && m_dirty)
+			{
+				m_connected_slots.erase(std::remove(m_connected_slots.begin(),
+					m_connected_slots.end(), static_cast<connection_base *>(NULL)),
+					m_connected_slots.end());
+				m_dirty = false;
+			}
+		}
+
+		// Returns true if the entry was erased, i.e. |i| now refers to the
+		// next connection.
+		bool remove_slot(size_t i)
+		{
+			if(m_emit_frame)
+			{
+				m_connected_slots[i] = NULL;
+				m_dirty = true;
+				return false;
+			}
+
+			m_connected_slots.erase(m_connected_slots.begin() + i);
+			return true;
+		}
+
+		connections_vector m_connected_slots;
+		_emit_frame* m_emit_frame;
+		bool m_dirty;
+	};
+
+	template<class mt_policy = SIGSLOT_DEFAULT_MT_POLICY>
+	class flat_signal0 : public _flat_signal_base<_connection_base0<mt_policy>, mt_policy>
+	{
+	public:
+		typedef _flat_signal_base<_connection_base0<mt_policy>, mt_policy> base;
+		typedef typename base::_emit_frame _emit_frame;
+		using base::m_connected_slots;
+		using base::m_emit_frame;
+
+		template<class desttype>
+			void connect(desttype* pclass, void (desttype::*pmemfun)())
+		{
+			lock_block<mt_policy> lock(this);
+			m_connected_slots.push_back(
+				new _connection0<desttype, mt_policy>(pclass, pmemfun));
+			pclass->signal_connect(this);
+		}
+
+		void emit()
+		{
+			_emit_lock<mt_policy> lock(this);
+			if(!m_emit_frame && m_connected_slots.size() == 1)
+			{
+				m_connected_slots[0]->emit();
+				return;
+			}
+
+			_emit_frame frame;
+			this->push_frame(&frame);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i])
+				{
+					m_connected_slots[i]->emit();
+					if(frame.destroyed)
+						return;
+				}
+			}
+			this->pop_frame(&frame);
+		}
+
+		void operator()()
+		{
+			emit();
+		}
+	};
+
+	template<class arg1_type, class mt_policy = SIGSLOT_DEFAULT_MT_POLICY>
+	class flat_signal1 : public _flat_signal_base<_connection_base1<arg1_type,
+		mt_policy>, mt_policy>
+	{
+	public:
+		typedef _flat_signal_base<_connection_base1<arg1_type, mt_policy>,
+			mt_policy> base;
+		typedef typename base::_emit_frame _emit_frame;
+		using base::m_connected_slots;
+		using base::m_emit_frame;
+
+		template<class desttype>
+			void connect(desttype* pclass, void (desttype::*pmemfun)(arg1_type))
+		{
+			lock_block<mt_policy> lock(this);
+			m_connected_slots.push_back(
+				new _connection1<desttype, arg1_type, mt_policy>(pclass, pmemfun));
+			pclass->signal_connect(this);
+		}
+
+		void emit(arg1_type a1)
+		{
+			_emit_lock<mt_policy> lock(this);
+			if(!m_emit_frame && m_connected_slots.size() == 1)
+			{
+				m_connected_slots[0]->emit(a1);
+				return;
+			}
+
+			_emit_frame frame;
+			this->push_frame(&frame);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i])
+				{
+					m_connected_slots[i]->emit(a1);
+					if(frame.destroyed)
+						return;
+				}
+			}
+			this->pop_frame(&frame);
+		}
+
+		void operator()(arg1_type a1)
+		{
+			emit(a1);
+		}
+	};
+
+	template<class arg1_type, class arg2_type, class mt_policy = SIGSLOT_DEFAULT_MT_POLICY>
+	class flat_signal2 : public _flat_signal_base<_connection_base2<arg1_type,
+		arg2_type, mt_policy>, mt_policy>
+	{
+	public:
+		typedef _flat_signal_base<_connection_base2<arg1_type, arg2_type,
+			mt_policy>, mt_policy> base;
+		typedef typename base::_emit_frame _emit_frame;
+		using base::m_connected_slots;
+		using base::m_emit_frame;
+
+		template<class desttype>
+			void connect(desttype* pclass, void (desttype::*pmemfun)(arg1_type,
+			arg2_type))
+		{
+			lock_block<mt_policy> lock(this);
+			m_connected_slots.push_back(
+				new _connection2<desttype, arg1_type, arg2_type, mt_policy>(
+				pclass, pmemfun));
+			pclass->signal_connect(this);
+		}
+
+		void emit(arg1_type a1, arg2_type a2)
+		{
+			_emit_lock<mt_policy> lock(this);
+			if(!m_emit_frame && m_connected_slots.size() == 1)
+			{
+				m_connected_slots[0]->emit(a1, a2);
+				return;
+			}
+
+			_emit_frame frame;
+			this->push_frame(&frame);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i])
+				{
+					m_connected_slots[i]->emit(a1, a2);
+					if(frame.destroyed)
+						return;
+				}
+			}
+			this->pop_frame(&frame);
+		}
+
+		void operator()(arg1_type a1, arg2_type a2)
+		{
+			emit(a1, a2);
+		}
+	};
+
+	template<class arg1_type, class arg2_type, class arg3_type, class mt_policy = SIGSLOT_DEFAULT_MT_POLICY>
+	class flat_signal3 : public _flat_signal_base<_connection_base3<arg1_type,
+		arg2_type, arg3_type, mt_policy>, mt_policy>
+	{
+	public:
+		typedef _flat_signal_base<_connection_base3<arg1_type, arg2_type,
+			arg3_type, mt_policy>, mt_policy> base;
+		typedef typename base::_emit_frame _emit_frame;
+		using base::m_connected_slots;
+		using base::m_emit_frame;
+
+		template<class desttype>
+			void connect(desttype* pclass, void (desttype::*pmemfun)(arg1_type,
+			arg2_type, arg3_type))
+		{
+			lock_block<mt_policy> lock(this);
+			m_connected_slots.push_back(
+				new _connection3<desttype, arg1_type, arg2_type, arg3_type,
+				mt_policy>(pclass, pmemfun));
+			pclass->signal_connect(this);
+		}
+
+		void emit(arg1_type a1, arg2_type a2, arg3_type a3)
+		{
+			_emit_lock<mt_policy> lock(this);
+			if(!m_emit_frame && m_connected_slots.size() == 1)
+			{
+				m_connected_slots[0]->emit(a1, a2, a3);
+				return;
+			}
+
+			_emit_frame frame;
+			this->push_frame(&frame);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i])
+				{
+					m_connected_slots[i]->emit(a1, a2, a3);
+					if(frame.destroyed)
+						return;
+				}
+			}
+			this->pop_frame(&frame);
+		}
+
+		void operator()(arg1_type a1, arg2_type a2, arg3_type a3)
+		{
+			emit(a1, a2, a3);
+		}
+	};
+
+	template<class arg1_type, class arg2_type, class arg3_type, class arg4_type, class mt_policy = SIGSLOT_DEFAULT_MT_POLICY>
+	class flat_signal4 : public _flat_signal_base<_connection_base4<arg1_type,
+		arg2_type, arg3_type, arg4_type, mt_policy>, mt_policy>
+	{
+	public:
+		typedef _flat_signal_base<_connection_base4<arg1_type, arg2_type,
+			arg3_type, arg4_type, mt_policy>, mt_policy> base;
+		typedef typename base::_emit_frame _emit_frame;
+		using base::m_connected_slots;
+		using base::m_emit_frame;
+
+		template<class desttype>
+			void connect(desttype* pclass, void (desttype::*pmemfun)(arg1_type,
+			arg2_type, arg3_type, arg4_type))
+		{
+			lock_block<mt_policy> lock(this);
+			m_connected_slots.push_back(
+				new _connection4<desttype, arg1_type, arg2_type, arg3_type,
+				arg4_type, mt_policy>(pclass, pmemfun));
+			pclass->signal_connect(this);
+		}
+
+		void emit(arg1_type a1, arg2_type a2, arg3_type a3, arg4_type a4)
+		{
+			_emit_lock<mt_policy> lock(this);
+			if(!m_emit_frame && m_connected_slots.size() == 1)
+			{
+				m_connected_slots[0]->emit(a1, a2, a3, a4);
+				return;
+			}
+
+			_emit_frame frame;
+			this->push_frame(&frame);
+			for(size_t i = 0; i < m_connected_slots.size(); ++i)
+			{
+				if(m_connected_slots[i])
+				{
+					m_connected_slots[i]->emit(a1, a2, a3, a4);
+					if(frame.destroyed)
+						return;
+				}
+			}
+			this->pop_frame(&frame);
+		}
+
+		void operator()(arg1_type a1, arg2_type a2, arg3_type a3, arg4_type a4)
+		{
+			emit(a1, a2, a3, a4);
+		}
+	};
+
 }; // namespace sigslot
 
 #endif // TALK_BASE_SIGSLOT_H__
@@ -28,6 +28,8 @@
 #include "talk/base/sigslot.h"
 
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/timeutils.h"
 
 // This function, when passed a has_slots or signalx, will break the build if
 // its threading requirement is not single threaded
@@ -265,3 +267,248 @@ TEST(DestructionOrder, SlotFirst) {
   (*signal)();
   delete signal;
 }
+
+// Receiver for flat_signal1 that can rearrange the signal from inside its slot.
+class FlatReceiver : public sigslot::has_slots<> {
+ public:
+  typedef sigslot::flat_signal1<int> Signal;
+
+  FlatReceiver()
+      : count_(0), last_value_(0), disconnect_self_(NULL),
+        disconnect_other_(NULL), connect_other_(NULL), delete_signal_(NULL) {
+  }
+
+  void Connect(Signal* signal) {
+    signal->connect(this, &FlatReceiver::OnSignal);
+  }
+
+  void OnSignal(int value) {
+    ++count_;
+    last_value_ = value;
+    if (disconnect_self_)
+      disconnect_self_->disconnect(this);
+    if (disconnect_other_)
+      disconnect_other_->signal->disconnect(disconnect_other_->receiver);
+    if (connect_other_)
+      connect_other_->receiver->Connect(connect_other_->signal);
+    if (delete_signal_) {
+      Signal* signal = delete_signal_;
+      delete_signal_ = NULL;
+      delete signal;
+    }
+  }
+
+  struct Target {
+    Signal* signal;
+    FlatReceiver* receiver;
+  };
+
+  int count_;
+  int last_value_;
+  Signal* disconnect_self_;
+  Target* disconnect_other_;
+  Target* connect_other_;
+  Signal* delete_signal_;
+};
+
+TEST(FlatSignalTest, EmitsToEverySlot) {
+  FlatReceiver::Signal signal;
+  EXPECT_TRUE(signal.is_empty());
+  FlatReceiver r1, r2, r3;
+  r1.Connect(&signal);
+  EXPECT_FALSE(signal.is_empty());
+  signal(1);
+  EXPECT_EQ(1, r1.count_);
+  EXPECT_EQ(1, r1.last_value_);
+
+  r2.Connect(&signal);
+  r3.Connect(&signal);
+  signal(2);
+  EXPECT_EQ(2, r1.count_);
+  EXPECT_EQ(1, r2.count_);
+  EXPECT_EQ(1, r3.count_);
+  EXPECT_EQ(2, r3.last_value_);
+
+  signal.disconnect(&r2);
+  signal.emit(3);
+  EXPECT_EQ(3, r1.count_);
+  EXPECT_EQ(1, r2.count_);
+  EXPECT_EQ(2, r3.count_);
+
+  signal.disconnect_all();
+  EXPECT_TRUE(signal.is_empty());
+  signal(4);
+  EXPECT_EQ(3, r1.count_);
+}
+
+TEST(FlatSignalTest, SlotDisconnectsItself) {
+  FlatReceiver::Signal signal;
+  FlatReceiver r1, r2, r3;
+  r1.Connect(&signal);
+  r2.Connect(&signal);
+  r3.Connect(&signal);
+  r1.disconnect_self_ = &signal;
+  r2.disconnect_self_ = &signal;
+  signal(1);
+  EXPECT_EQ(1, r1.count_);
+  EXPECT_EQ(1, r2.count_);
+  EXPECT_EQ(1, r3.count_);
+  signal(2);
+  EXPECT_EQ(1, r1.count_);
+  EXPECT_EQ(1, r2.count_);
+  EXPECT_EQ(2, r3.count_);
+
+  // The single slot path.
+  r3.disconnect_self_ = &signal;
+  signal(3);
+  EXPECT_EQ(3, r3.count_);
+  EXPECT_TRUE(signal.is_empty());
+}
+
+TEST(FlatSignalTest, SlotDisconnectsAnother) {
+  FlatReceiver::Signal signal;
+  FlatReceiver r1, r2, r3;
+  r1.Connect(&signal);
+  r2.Connect(&signal);
+  r3.Connect(&signal);
+  FlatReceiver::Target target = { &signal, &r2 };
+  r1.disconnect_other_ = &target;
+  signal(1);
+  EXPECT_EQ(1, r1.count_);
+  EXPECT_EQ(0, r2.count_);
+  EXPECT_EQ(1, r3.count_);
+}
+
+TEST(FlatSignalTest, SlotConnectsAnother) {
+  FlatReceiver::Signal signal;
+  FlatReceiver r1, r2;
+  r1.Connect(&signal);
+  FlatReceiver::Target target = { &signal, &r2 };
+  r1.connect_other_ = &target;
+  signal(1);
+  r1.connect_other_ = NULL;
+  signal(2);
+  EXPECT_EQ(2, r1.count_);
+  EXPECT_EQ(2, r2.last_value_);
+}
+
+TEST(FlatSignalTest, SlotDeletesSignal) {
+  FlatReceiver r1, r2;
+  FlatReceiver::Signal* signal = new FlatReceiver::Signal;
+  r1.Connect(signal);
+  r2.Connect(signal);
+  r1.delete_signal_ = signal;
+  (*signal)(1);
+  EXPECT_EQ(1, r1.count_);
+  EXPECT_EQ(0, r2.count_);
+
+  // The single slot path.
+  signal = new FlatReceiver::Signal;
+  r1.Connect(signal);
+  r1.delete_signal_ = signal;
+  (*signal)(2);
+  EXPECT_EQ(2, r1.count_);
+}
+
+TEST(FlatSignalTest, SlotDestroyedFirst) {
+  FlatReceiver::Signal signal;
+  FlatReceiver* r1 = new FlatReceiver;
+  FlatReceiver r2;
+  r1->Connect(&signal);
+  r2.Connect(&signal);
+  delete r1;
+  signal(1);
+  EXPECT_EQ(1, r2.count_);
+  signal.disconnect(&r2);
+  EXPECT_TRUE(signal.is_empty());
+}
+
+TEST(FlatSignalTest, Copy) {
+  FlatReceiver::Signal signal;
+  FlatReceiver r1;
+  r1.Connect(&signal);
+  FlatReceiver::Signal copy(signal);
+  signal(1);
+  copy(2);
+  EXPECT_EQ(2, r1.count_);
+  EXPECT_EQ(2, r1.last_value_);
+}
+
+TEST(FlatSignalTest, LocksUnlessSingleThreaded) {
+  sigslot::flat_signal0<multi_threaded_local_fake> signal;
+  SigslotReceiver<> receiver;
+  signal.connect(&receiver, &SigslotReceiver<>::OnSignal);
+  int lock_count = signal.lock_count();
+  signal();
+  EXPECT_EQ(1, receiver.signal_count());
+  EXPECT_EQ(lock_count + 1, signal.lock_count());
+  EXPECT_FALSE(signal.InCriticalSection());
+}
+
+// One hop of a packet path: re-emits whatever it receives, the way a socket
+// hands a packet to a port, the port to a connection and so on.
+template<class Signal>
+class PacketHop : public sigslot::has_slots<> {
+ public:
+  void OnPacket(void* from, const char* data, size_t len, int flags) {
+    SignalPacket(this, data, len, flags);
+  }
+  Signal SignalPacket;
+};
+
+class PacketSink : public sigslot::has_slots<> {
+ public:
+  PacketSink() : bytes_(0) {}
+  void OnPacket(void* from, const char* data, size_t len, int flags) {
+    bytes_ += len;
+  }
+  size_t bytes_;
+};
+
+static const int kPerfHops = 5;
+static const int kPerfPackets = 1000000;
+static const size_t kPerfPacketSize = 100;
+
+// Returns the cost of one emission in nanoseconds, measured over a chain of
+// |kPerfHops| signals of type |Signal|, and the number of bytes that came out
+// of the end of the chain in |bytes|.
+template<class Signal>
+static double MeasureEmitCost(size_t* bytes) {
+  PacketHop<Signal> hops[kPerfHops];
+  PacketSink sink;
+  for (int i = 0; i < kPerfHops - 1; ++i)
+    hops[i].SignalPacket.connect(&hops[i + 1], &PacketHop<Signal>::OnPacket);
+  hops[kPerfHops - 1].SignalPacket.connect(&sink, &PacketSink::OnPacket);
+
+  char packet[kPerfPacketSize] = {0};
+  uint64 start = talk_base::TimeNanos();
+  for (int i = 0; i < kPerfPackets; ++i)
+    hops[0].OnPacket(NULL, packet, sizeof(packet), 0);
+  uint64 elapsed = talk_base::TimeNanos() - start;
+  *bytes = sink.bytes_;
+  return static_cast<double>(elapsed) / (kPerfPackets * kPerfHops);
+}
+
+// Compares the per hop emission cost of the list and flat signals.
+TEST(FlatSignalTest, DISABLED_Perf) {
+  typedef sigslot::signal4<void*, const char*, size_t, int> ListSignal;
+  typedef sigslot::signal4<void*, const char*, size_t, int,
+                           sigslot::multi_threaded_local> LockedListSignal;
+  typedef sigslot::flat_signal4<void*, const char*, size_t, int> FlatSignal;
+  // Measured outside of LOG(), which skips its arguments entirely when the
+  // severity isn't logged.
+  size_t locked_list_bytes, list_bytes, flat_bytes;
+  double locked_list_cost =
+      MeasureEmitCost<LockedListSignal>(&locked_list_bytes);
+  double list_cost = MeasureEmitCost<ListSignal>(&list_bytes);
+  double flat_cost = MeasureEmitCost<FlatSignal>(&flat_bytes);
+
+  const size_t kExpectedBytes = kPerfPacketSize * kPerfPackets;
+  EXPECT_EQ(kExpectedBytes, locked_list_bytes);
+  EXPECT_EQ(kExpectedBytes, list_bytes);
+  EXPECT_EQ(kExpectedBytes, flat_bytes);
+  LOG(LS_INFO) << "signal4 (multi_threaded_local): " << locked_list_cost
+               << " ns/hop";
+  LOG(LS_INFO) << "signal4: " << list_cost << " ns/hop";
+  LOG(LS_INFO) << "flat_signal4: " << flat_cost << " ns/hop";
+}
@@ -29,6 +29,7 @@
 #define TALK_BASE_SOCKET_H__
 
 #include <errno.h>
+#include <string.h>
 
 #ifdef POSIX
 #include <sys/types.h>
@@ -43,6 +44,7 @@
 #endif
 
 #include "talk/base/basictypes.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/socketaddress.h"
 
 // Rather than converting errors into a private namespace,
@@ -140,6 +142,41 @@ inline bool IsBlockingError(int e) {
   return (e == EWOULDBLOCK) || (e == EAGAIN) || (e == EINPROGRESS);
 }
 
+// One of the buffers passed to Socket::SendV, like a struct iovec.
+struct IoVec {
+  const void* data;
+  size_t len;
+};
+
+// Buffers that total at most this many bytes are gathered on the stack by
+// the SendV() fallbacks, which covers any packet that fits in an MTU.
+const size_t kGatherIoVecStackSize = 2048;
+
+// Copies |count| buffers into one and returns it, with its length in |total|.
+// The copy goes to |stack_buffer| if it fits in |stack_size| bytes, and to a
+// new |heap_buffer| otherwise.  This is the fallback for sockets that can't
+// gather natively.
+inline const char* GatherIoVec(const IoVec* iov, size_t count,
+                               char* stack_buffer, size_t stack_size,
+                               scoped_array<char>* heap_buffer,
+                               size_t* total) {
+  *total = 0;
+  for (size_t i = 0; i < count; ++i) {
+    *total += iov[i].len;
+  }
+  char* buffer = stack_buffer;
+  if (*total > stack_size) {
+    heap_buffer->reset(new char[*total]);
+    buffer = heap_buffer->get();
+  }
+  char* p = buffer;
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(p, iov[i].data, iov[i].len);
+    p += iov[i].len;
+  }
+  return buffer;
+}
+
 // General interface for the socket implementations of various networks.  The
 // methods match those of normal UNIX sockets very closely.
 class Socket {
@@ -158,6 +195,34 @@ class Socket {
   virtual int Connect(const SocketAddress& addr) = 0;
   virtual int Send(const void *pv, size_t cb) = 0;
   virtual int SendTo(const void *pv, size_t cb, const SocketAddress& addr) = 0;
+  // Sends |count| buffers as though they were one, like writev(), and
+  // returns what Send() would.  This copies them together, on the stack for
+  // packet-sized totals, and calls Send(); sockets that can gather natively,
+  // and wrappers that pass sends straight through, override it.
+  virtual int SendV(const IoVec* iov, size_t count) {
+    if (count == 1) {
+      return Send(iov[0].data, iov[0].len);
+    }
+    char stack_buffer[kGatherIoVecStackSize];
+    scoped_array<char> heap_buffer;
+    size_t total;
+    const char* data = GatherIoVec(iov, count, stack_buffer,
+                                   sizeof(stack_buffer), &heap_buffer, &total);
+    return Send(data, total);
+  }
+  // The SendTo() counterpart of SendV().
+  virtual int SendToV(const IoVec* iov, size_t count,
+                      const SocketAddress& addr) {
+    if (count == 1) {
+      return SendTo(iov[0].data, iov[0].len, addr);
+    }
+    char stack_buffer[kGatherIoVecStackSize];
+    scoped_array<char> heap_buffer;
+    size_t total;
+    const char* data = GatherIoVec(iov, count, stack_buffer,
+                                   sizeof(stack_buffer), &heap_buffer, &total);
+    return SendTo(data, total, addr);
+  }
   virtual int Recv(void *pv, size_t cb) = 0;
   virtual int RecvFrom(void *pv, size_t cb, SocketAddress *paddr) = 0;
   virtual int Listen(int backlog) = 0;
@@ -184,7 +249,8 @@ class Socket {
     OPT_RCVBUF,      // receive buffer size
     OPT_SNDBUF,      // send buffer size
     OPT_NODELAY,     // whether Nagle algorithm is enabled
-    OPT_IPV6_V6ONLY  // Whether the socket is IPv6 only.
+    OPT_IPV6_V6ONLY, // Whether the socket is IPv6 only.
+    OPT_PACING_RATE  // max send rate in bytes/sec, 0 for unlimited
   };
   virtual int GetOption(Option opt, int* value) = 0;
   virtual int SetOption(Option opt, int value) = 0;
@@ -892,6 +892,17 @@ void SocketTest::UdpInternal(const IPAddress& loopback) {
 
     addr2 = addr4;
   }
+
+  // A gathering send arrives as a single datagram.
+  AsyncUDPSocket* socket3 = AsyncUDPSocket::Create(ss_, empty);
+  scoped_ptr<TestClient> client3(new TestClient(socket3));
+  IoVec iov[2];
+  iov[0].data = "biz";
+  iov[0].len = 3;
+  iov[1].data = "baz";
+  iov[1].len = 3;
+  EXPECT_EQ(6, socket3->SendToV(iov, 2, addr1));
+  EXPECT_TRUE(client1->CheckNextPacket("bizbaz", 6, NULL));
 }
 
 void SocketTest::GetSetOptionsInternal(const IPAddress& loopback) {
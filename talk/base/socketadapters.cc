@@ -56,9 +56,8 @@
 namespace talk_base {
 
 BufferedReadAdapter::BufferedReadAdapter(AsyncSocket* socket, size_t size)
-    : AsyncSocketAdapter(socket), buffer_size_(size),
+    : AsyncSocketAdapter(socket), buffer_(NULL), buffer_size_(size),
       data_len_(0), buffering_(false) {
-  buffer_ = new char[buffer_size_];
 }
 
 BufferedReadAdapter::~BufferedReadAdapter() {
@@ -74,36 +73,57 @@ int BufferedReadAdapter::Send(const void *pv, size_t cb) {
   return AsyncSocketAdapter::Send(pv, cb);
 }
 
-int BufferedReadAdapter::Recv(void *pv, size_t cb) {
+int BufferedReadAdapter::SendV(const IoVec* iov, size_t count) {
   if (buffering_) {
     socket_->SetError(EWOULDBLOCK);
     return -1;
   }
+  return socket_->SendV(iov, count);
+}
 
-  size_t read = 0;
+int BufferedReadAdapter::Recv(void *pv, size_t cb) {
+  if (buffering_) {
+    socket_->SetError(EWOULDBLOCK);
+    return -1;
+  }
 
-  if (data_len_) {
-    read = _min(cb, data_len_);
-    memcpy(pv, buffer_, read);
-    data_len_ -= read;
-    if (data_len_ > 0) {
-      memmove(buffer_, buffer_ + read, data_len_);
+  // Once the handshake is over and its leftovers have been consumed, reads go
+  // straight into the caller's buffer and the handshake buffer is released.
+  if (!data_len_) {
+    if (buffer_) {
+      delete [] buffer_;
+      buffer_ = NULL;
     }
-    pv = static_cast<char *>(pv) + read;
-    cb -= read;
+    return AsyncSocketAdapter::Recv(pv, cb);
+  }
+
+  size_t read = _min(cb, data_len_);
+  memcpy(pv, buffer_, read);
+  data_len_ -= read;
+  if (data_len_ > 0) {
+    memmove(buffer_, buffer_ + read, data_len_);
   }
+  pv = static_cast<char *>(pv) + read;
+  cb -= read;
 
   // FIX: If cb == 0, we won't generate another read event
 
   int res = AsyncSocketAdapter::Recv(pv, cb);
-  if (res < 0)
+  if (res < 0) {
+    // Don't lose the buffered bytes if the socket has nothing more for us.
+    if (read > 0 && IsBlocking())
+      return static_cast<int>(read);
     return res;
+  }
 
   return res + static_cast<int>(read);
 }
 
 void BufferedReadAdapter::BufferInput(bool on) {
   buffering_ = on;
+  if (buffering_ && !buffer_) {
+    buffer_ = new char[buffer_size_];
+  }
 }
 
 void BufferedReadAdapter::OnReadEvent(AsyncSocket * socket) {
@@ -44,13 +44,17 @@ class ByteBuffer;
 
 // Implements a socket adapter that can buffer and process data internally,
 // as in the case of connecting to a proxy, where you must speak the proxy
-// protocol before commencing normal socket behavior.
+// protocol before commencing normal socket behavior. The buffer only exists
+// while the handshake needs it; afterwards reads pass straight through.
 class BufferedReadAdapter : public AsyncSocketAdapter {
  public:
   BufferedReadAdapter(AsyncSocket* socket, size_t buffer_size);
   virtual ~BufferedReadAdapter();
 
   virtual int Send(const void* pv, size_t cb);
+  // Nothing is added to the stream once the handshake is done, so gathered
+  // sends go straight to the wrapped socket instead of being copied together.
+  virtual int SendV(const IoVec* iov, size_t count);
   virtual int Recv(void* pv, size_t cb);
 
  protected:
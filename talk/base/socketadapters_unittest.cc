@@ -0,0 +1,184 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string>
+
+#include "talk/base/asynctcpsocket.h"
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/socketadapters.h"
+#include "talk/base/socketserver.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+static const int kTimeout = 5000;
+
+// Runs the fake SSL handshake over loopback between an AsyncSSLSocket client
+// and an AsyncSSLServerSocket accepted from a listener.
+class SocketAdaptersTest : public testing::Test,
+                           public sigslot::has_slots<> {
+ protected:
+  SocketAdaptersTest()
+      : ss_(Thread::Current()->socketserver()), client_connected_(false),
+        received_bytes_(0) {
+  }
+
+  virtual void SetUp() {
+    listener_.reset(ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM));
+    ASSERT_EQ(0, listener_->Bind(SocketAddress("127.0.0.1", 0)));
+    ASSERT_EQ(0, listener_->Listen(5));
+    listener_->SignalReadEvent.connect(this, &SocketAdaptersTest::OnAccept);
+  }
+
+  void OnAccept(AsyncSocket* socket) {
+    server_.reset(new AsyncSSLServerSocket(socket->Accept(NULL)));
+  }
+
+  void WatchConnect(AsyncSocket* socket) {
+    socket->SignalConnectEvent.connect(
+        this, &SocketAdaptersTest::OnClientConnect);
+  }
+
+  void OnClientConnect(AsyncSocket* socket) {
+    client_connected_ = true;
+  }
+
+  void WatchConnect(AsyncPacketSocket* socket) {
+    socket->SignalConnect.connect(
+        this, &SocketAdaptersTest::OnPacketSocketConnect);
+  }
+
+  void OnPacketSocketConnect(AsyncPacketSocket* socket) {
+    client_connected_ = true;
+  }
+
+  void CountPackets(AsyncPacketSocket* socket) {
+    socket->SignalReadPacket.connect(this, &SocketAdaptersTest::OnPacket);
+  }
+
+  void OnPacket(AsyncPacketSocket* socket, const char* data, size_t len,
+                const SocketAddress& remote_addr) {
+    received_bytes_ += len;
+  }
+
+  // Reads from |socket| until |size| bytes have arrived or we time out.
+  std::string ReadAll(AsyncSocket* socket, size_t size) {
+    std::string received;
+    char buffer[4096];
+    uint32 start = Time();
+    while (received.size() < size && TimeSince(start) < kTimeout) {
+      int res = socket->Recv(buffer, sizeof(buffer));
+      if (res > 0) {
+        received.append(buffer, res);
+      }
+      ss_->Wait(0, true);
+    }
+    return received;
+  }
+
+  SocketServer* ss_;
+  scoped_ptr<AsyncSocket> listener_;
+  scoped_ptr<AsyncSocket> server_;
+  bool client_connected_;
+  size_t received_bytes_;
+};
+
+// Data can't be sent until the handshake is done, and flows both ways after.
+TEST_F(SocketAdaptersTest, SslTcpPassesDataAfterHandshake) {
+  scoped_ptr<AsyncSSLSocket> client(
+      new AsyncSSLSocket(ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM)));
+  WatchConnect(client.get());
+  client->Connect(listener_->GetLocalAddress());
+  EXPECT_EQ(-1, client->Send("early", 5));
+  EXPECT_TRUE(client->IsBlocking());
+
+  ASSERT_TRUE_WAIT(client_connected_, kTimeout);
+  ASSERT_TRUE(server_.get() != NULL);
+
+  EXPECT_EQ(5, client->Send("hello", 5));
+  EXPECT_EQ("hello", ReadAll(server_.get(), 5));
+  EXPECT_EQ(5, server_->Send("world", 5));
+  EXPECT_EQ("world", ReadAll(client.get(), 5));
+
+  const std::string large(100000, 'x');
+  size_t sent = 0;
+  uint32 start = Time();
+  while (sent < large.size() && TimeSince(start) < kTimeout) {
+    int res = client->Send(large.data() + sent, large.size() - sent);
+    if (res > 0) {
+      sent += res;
+    }
+    ss_->Wait(0, true);
+  }
+  EXPECT_TRUE(large == ReadAll(server_.get(), large.size()));
+}
+
+// Measures how fast packets go through a pair of AsyncTCPSockets running on
+// top of the ssltcp adapters. Packets sent while the socket is blocked are
+// dropped, as with UDP.
+TEST_F(SocketAdaptersTest, DISABLED_SslTcpPerf) {
+  scoped_ptr<AsyncTCPSocket> client(AsyncTCPSocket::Create(
+      new AsyncSSLSocket(ss_->CreateAsyncSocket(AF_INET, SOCK_STREAM)),
+      SocketAddress("127.0.0.1", 0), listener_->GetLocalAddress()));
+  ASSERT_TRUE(client.get() != NULL);
+  WatchConnect(client.get());
+  ASSERT_TRUE_WAIT(client_connected_, kTimeout);
+  ASSERT_TRUE(server_.get() != NULL);
+  AsyncTCPSocket server(server_.release(), false);
+  CountPackets(&server);
+
+  const size_t kPacketSize = 1200;
+  const size_t kPacketCount = 100000;
+  const std::string packet(kPacketSize, 'p');
+  uint32 start = Time();
+  for (size_t i = 0; i < kPacketCount; ++i) {
+    client->Send(packet.data(), packet.size());
+    if (i % 64 == 63) {
+      ss_->Wait(0, true);
+    }
+  }
+  // Wait for whatever is still in flight.
+  uint32 finish = Time();
+  size_t last_received = 0;
+  while (TimeSince(finish) < 100) {
+    ss_->Wait(10, true);
+    if (received_bytes_ != last_received) {
+      last_received = received_bytes_;
+      finish = Time();
+    }
+  }
+  uint32 elapsed = _max(TimeDiff(finish, start), 1);
+  EXPECT_GT(received_bytes_, 0u);
+  LOG(LS_INFO) << "Received " << received_bytes_ / kPacketSize << " of "
+               << kPacketCount << " packets in " << elapsed << " ms ("
+               << received_bytes_ * 8 / elapsed << " Kbps)";
+}
+
+}  // namespace talk_base
@@ -67,6 +67,11 @@ class ProxySocketAdapter : public AsyncSocketAdapter {
     detect_->Start();
     return SOCKET_ERROR;
   }
+  // Once connected this adapter only passes sends through, so let the socket
+  // it wraps gather vectored sends itself.
+  virtual int SendV(const IoVec* iov, size_t count) {
+    return socket_->SendV(iov, count);
+  }
   virtual int GetError() const {
     if (socket_) {
       return socket_->GetError();
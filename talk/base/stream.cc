@@ -27,6 +27,8 @@
 
 #if defined(POSIX)
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif  // POSIX
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -814,19 +816,77 @@ void ExternalMemoryStream::SetData(void* data, size_t length) {
 // FifoBuffer
 ///////////////////////////////////////////////////////////////////////////////
 
+#if defined(LINUX)
+// Returns the size of the mapping that MapMirrored() makes for a buffer of
+// |length| bytes: |length| rounded up to a multiple of the page size.
+static size_t MirroredLength(size_t length) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  return (length + page_size - 1) / page_size * page_size;
+}
+
+// Maps |length| bytes of shared memory twice, back to back, so that
+// p[i] and p[i + length] are the same byte. |length| must be a multiple of
+// the page size.
+static char* MapMirrored(size_t length) {
+  if (length == 0) {
+    return NULL;
+  }
+  ASSERT(length == MirroredLength(length));
+  void* p = mmap(NULL, 2 * length, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    LOG_ERR(LS_WARNING) << "mmap";
+    return NULL;
+  }
+  // Asking mremap to grow a shared mapping from zero bytes makes a second
+  // mapping of the same pages; put it over the upper half.
+  char* first = static_cast<char*>(p);
+  void* second = mremap(first, 0, length, MREMAP_MAYMOVE | MREMAP_FIXED,
+                        first + length);
+  if (second != first + length) {
+    LOG_ERR(LS_WARNING) << "mremap";
+    munmap(p, 2 * length);
+    return NULL;
+  }
+  return first;
+}
+
+static void UnmapMirrored(char* p, size_t length) {
+  munmap(p, 2 * length);
+}
+#else
+static size_t MirroredLength(size_t length) {
+  return length;
+}
+
+static char* MapMirrored(size_t length) {
+  return NULL;
+}
+
+static void UnmapMirrored(char* p, size_t length) {
+}
+#endif  // LINUX
+
 FifoBuffer::FifoBuffer(size_t size)
-    : state_(SS_OPEN), buffer_(new char[size]), buffer_length_(size),
-      data_length_(0), read_position_(0), owner_(Thread::Current()) {
+    : state_(SS_OPEN), buffer_(new char[size]), data_(buffer_.get()),
+      mirrored_(false), buffer_length_(size), ring_length_(size),
+      data_length_(0),
+      read_position_(0), owner_(Thread::Current()) {
   // all events are done on the owner_ thread
 }
 
 FifoBuffer::FifoBuffer(size_t size, Thread* owner)
-    : state_(SS_OPEN), buffer_(new char[size]), buffer_length_(size),
-      data_length_(0), read_position_(0), owner_(owner) {
+    : state_(SS_OPEN), buffer_(new char[size]), data_(buffer_.get()),
+      mirrored_(false), buffer_length_(size), ring_length_(size),
+      data_length_(0),
+      read_position_(0), owner_(owner) {
   // all events are done on the owner_ thread
 }
 
 FifoBuffer::~FifoBuffer() {
+  if (mirrored_) {
+    UnmapMirrored(data_, ring_length_);
+  }
 }
 
 bool FifoBuffer::GetBuffered(size_t* size) const {
@@ -842,15 +902,49 @@ bool FifoBuffer::SetCapacity(size_t size) {
   }
 
   if (size != buffer_length_) {
-    char* buffer = new char[size];
-    const size_t copy = data_length_;
-    const size_t tail_copy = _min(copy, buffer_length_ - read_position_);
-    memcpy(buffer, &buffer_[read_position_], tail_copy);
-    memcpy(buffer + tail_copy, &buffer_[0], copy - tail_copy);
-    buffer_.reset(buffer);
-    read_position_ = 0;
-    buffer_length_ = size;
+    return ReallocateLocked(size, mirrored_);
+  }
+  return true;
+}
+
+bool FifoBuffer::SetMirrored(bool mirrored) {
+  CritScope cs(&crit_);
+  if (mirrored == mirrored_) {
+    return true;
   }
+  return ReallocateLocked(buffer_length_, mirrored) && mirrored_ == mirrored;
+}
+
+bool FifoBuffer::ReallocateLocked(size_t size, bool mirrored) {
+  // A mirrored mapping is a whole number of pages, so it may be a little
+  // larger than the capacity; positions then wrap at the mapping's end.
+  size_t ring_length = mirrored ? MirroredLength(size) : size;
+  char* data = mirrored ? MapMirrored(ring_length) : NULL;
+  if (mirrored && !data && size == buffer_length_) {
+    // Nothing to gain from a plain copy of the buffer we already have.
+    return false;
+  }
+  scoped_array<char> buffer;
+  if (!data) {
+    ring_length = size;
+    buffer.reset(new char[size]);
+    data = buffer.get();
+  }
+
+  const size_t copy = data_length_;
+  const size_t tail_copy = ContiguousLength(read_position_, copy);
+  memcpy(data, &data_[read_position_], tail_copy);
+  memcpy(data + tail_copy, &data_[0], copy - tail_copy);
+
+  if (mirrored_) {
+    UnmapMirrored(data_, ring_length_);
+  }
+  buffer_.swap(buffer);
+  data_ = data;
+  mirrored_ = (buffer_.get() == NULL);
+  read_position_ = 0;
+  buffer_length_ = size;
+  ring_length_ = ring_length;
   return true;
 }
 
@@ -880,7 +974,7 @@ StreamResult FifoBuffer::Read(void* buffer, size_t bytes,
   if (result == SR_SUCCESS) {
     // If read was successful then adjust the read position and number of
     // bytes buffered.
-    read_position_ = (read_position_ + copy) % buffer_length_;
+    read_position_ = (read_position_ + copy) % ring_length_;
     data_length_ -= copy;
     if (bytes_read) {
       *bytes_read = copy;
@@ -924,16 +1018,25 @@ void FifoBuffer::Close() {
 
 const void* FifoBuffer::GetReadData(size_t* size) {
   CritScope cs(&crit_);
-  *size = (read_position_ + data_length_ <= buffer_length_) ?
-      data_length_ : buffer_length_ - read_position_;
-  return &buffer_[read_position_];
+  *size = ContiguousLength(read_position_, data_length_);
+  return &data_[read_position_];
+}
+
+size_t FifoBuffer::GetReadDataSpans(const void** data1, size_t* len1,
+                                    const void** data2, size_t* len2) {
+  CritScope cs(&crit_);
+  *data1 = &data_[read_position_];
+  *len1 = ContiguousLength(read_position_, data_length_);
+  *len2 = data_length_ - *len1;
+  *data2 = (*len2 > 0) ? &data_[0] : NULL;
+  return data_length_;
 }
 
 void FifoBuffer::ConsumeReadData(size_t size) {
   CritScope cs(&crit_);
   ASSERT(size <= data_length_);
   const bool was_writable = data_length_ < buffer_length_;
-  read_position_ = (read_position_ + size) % buffer_length_;
+  read_position_ = (read_position_ + size) % ring_length_;
   data_length_ -= size;
   if (!was_writable && size > 0) {
     PostEvent(owner_, SE_WRITE, 0);
@@ -953,10 +1056,34 @@ void* FifoBuffer::GetWriteBuffer(size_t* size) {
   }
 
   const size_t write_position = (read_position_ + data_length_)
-      % buffer_length_;
-  *size = (write_position > read_position_ || data_length_ == 0) ?
-      buffer_length_ - write_position : read_position_ - write_position;
-  return &buffer_[write_position];
+      % ring_length_;
+  *size = ContiguousLength(write_position, buffer_length_ - data_length_);
+  return &data_[write_position];
+}
+
+size_t FifoBuffer::GetWriteBufferSpans(void** data1, size_t* len1,
+                                       void** data2, size_t* len2) {
+  CritScope cs(&crit_);
+  if (state_ == SS_CLOSED) {
+    *data1 = *data2 = NULL;
+    *len1 = *len2 = 0;
+    return 0;
+  }
+
+  // if empty, reset the write position to the beginning, so we can get
+  // the biggest possible block
+  if (data_length_ == 0) {
+    read_position_ = 0;
+  }
+
+  const size_t write_position = (read_position_ + data_length_)
+      % ring_length_;
+  const size_t available = buffer_length_ - data_length_;
+  *data1 = &data_[write_position];
+  *len1 = ContiguousLength(write_position, available);
+  *len2 = available - *len1;
+  *data2 = (*len2 > 0) ? &data_[0] : NULL;
+  return available;
 }
 
 void FifoBuffer::ConsumeWriteBuffer(size_t size) {
@@ -984,12 +1111,12 @@ StreamResult FifoBuffer::ReadOffsetLocked(void* buffer,
   }
 
   const size_t available = data_length_ - offset;
-  const size_t read_position = (read_position_ + offset) % buffer_length_;
+  const size_t read_position = (read_position_ + offset) % ring_length_;
   const size_t copy = _min(bytes, available);
-  const size_t tail_copy = _min(copy, buffer_length_ - read_position);
+  const size_t tail_copy = ContiguousLength(read_position, copy);
   char* const p = static_cast<char*>(buffer);
-  memcpy(p, &buffer_[read_position], tail_copy);
-  memcpy(p + tail_copy, &buffer_[0], copy - tail_copy);
+  memcpy(p, &data_[read_position], tail_copy);
+  memcpy(p + tail_copy, &data_[0], copy - tail_copy);
 
   if (bytes_read) {
     *bytes_read = copy;
@@ -1011,12 +1138,12 @@ StreamResult FifoBuffer::WriteOffsetLocked(const void* buffer,
 
   const size_t available = buffer_length_ - data_length_ - offset;
   const size_t write_position = (read_position_ + data_length_ + offset)
-      % buffer_length_;
+      % ring_length_;
   const size_t copy = _min(bytes, available);
-  const size_t tail_copy = _min(copy, buffer_length_ - write_position);
+  const size_t tail_copy = ContiguousLength(write_position, copy);
   const char* const p = static_cast<const char*>(buffer);
-  memcpy(&buffer_[write_position], p, tail_copy);
-  memcpy(&buffer_[0], p + tail_copy, copy - tail_copy);
+  memcpy(&data_[write_position], p, tail_copy);
+  memcpy(&data_[0], p + tail_copy, copy - tail_copy);
 
   if (bytes_written) {
     *bytes_written = copy;
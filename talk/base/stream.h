@@ -623,6 +623,27 @@ class FifoBuffer : public StreamInterface {
   // Resizes the buffer to the specified capacity. Fails if data_length_ > size
   bool SetCapacity(size_t length);
 
+  // Maps the buffer twice, back to back, so that data which wraps around the
+  // end of the buffer is also contiguous.  GetReadData() and GetWriteBuffer()
+  // then return the whole readable/writable region, and reads and writes
+  // always copy in one piece.  The mapping is rounded up to a multiple of
+  // the page size; the capacity stays as it was.  Only possible on Linux;
+  // returns false and keeps the plain buffer otherwise.  The mapping is kept
+  // across SetCapacity().
+  bool SetMirrored(bool mirrored);
+  bool mirrored() const { return mirrored_; }
+
+  // Like GetReadData() and GetWriteBuffer(), but return the region as two
+  // spans, the second being the part that wraps around to the start of the
+  // buffer (NULL and 0 if there is none), so that all of it can be used
+  // without copying, e.g. with Socket::SendV().  Return the total length;
+  // GetWriteBufferSpans() returns 0 if the stream is closed.  Call
+  // ConsumeReadData() or ConsumeWriteBuffer() with the amount used.
+  size_t GetReadDataSpans(const void** data1, size_t* len1,
+                          const void** data2, size_t* len2);
+  size_t GetWriteBufferSpans(void** data1, size_t* len1,
+                             void** data2, size_t* len2);
+
   // Read into |buffer| with an offset from the current read position, offset
   // is specified in number of bytes.
   // This method doesn't adjust read position nor the number of available
@@ -661,9 +682,22 @@ class FifoBuffer : public StreamInterface {
   StreamResult WriteOffsetLocked(const void* buffer, size_t bytes,
                                  size_t offset, size_t* bytes_written);
 
+  // Moves the buffered data to a new buffer of |size| bytes, mirrored if
+  // |mirrored| and possible. Caller must acquire a lock.
+  bool ReallocateLocked(size_t size, bool mirrored);
+
+  // Length of a region of |length| bytes at |position| that doesn't need to
+  // wrap around the end of the buffer.
+  size_t ContiguousLength(size_t position, size_t length) const {
+    return mirrored_ ? length : _min(length, ring_length_ - position);
+  }
+
   StreamState state_;  // keeps the opened/closed state of the stream
-  scoped_array<char> buffer_;  // the allocated buffer
-  size_t buffer_length_;  // size of the allocated buffer
+  scoped_array<char> buffer_;  // the allocated buffer, unless mirrored
+  char* data_;  // the start of the buffer, allocated or mirrored
+  bool mirrored_;  // whether data_ is a mirrored mapping
+  size_t buffer_length_;  // capacity of the buffer
+  size_t ring_length_;  // size of the allocated buffer, where positions wrap
   size_t data_length_;  // amount of readable data in the buffer
   size_t read_position_;  // offset to the readable data
   Thread* owner_;  // stream callbacks are dispatched on this thread
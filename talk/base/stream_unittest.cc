@@ -25,6 +25,10 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifdef POSIX
+#include <unistd.h>
+#endif
+
 #include "talk/base/gunit.h"
 #include "talk/base/stream.h"
 
@@ -451,6 +455,130 @@ TEST(FifoBufferTest, WriteOffsetAndReadOffset) {
   EXPECT_EQ(SR_BLOCK, buf.ReadOffset(out, 10, 16, NULL));
 }
 
+TEST(FifoBufferTest, ReadAndWriteSpans) {
+  const size_t kSize = 16;
+  const char in[kSize + 1] = "0123456789ABCDEF";
+  char out[kSize];
+  FifoBuffer buf(kSize);
+
+  // Leave 4 bytes buffered at offset 10, so writes wrap around.
+  EXPECT_EQ(SR_SUCCESS, buf.Write(in, 14, NULL, NULL));
+  buf.ConsumeReadData(10);
+
+  void* w1;
+  void* w2;
+  size_t wlen1, wlen2;
+  EXPECT_EQ(12u, buf.GetWriteBufferSpans(&w1, &wlen1, &w2, &wlen2));
+  EXPECT_EQ(2u, wlen1);
+  EXPECT_EQ(10u, wlen2);
+  memcpy(w1, in, wlen1);
+  memcpy(w2, in + wlen1, wlen2);
+  buf.ConsumeWriteBuffer(wlen1 + wlen2);
+
+  const void* r1;
+  const void* r2;
+  size_t rlen1, rlen2;
+  EXPECT_EQ(16u, buf.GetReadDataSpans(&r1, &rlen1, &r2, &rlen2));
+  EXPECT_EQ(6u, rlen1);
+  EXPECT_EQ(10u, rlen2);
+  EXPECT_EQ(0, memcmp(r1, "ABCD01", rlen1));
+  EXPECT_EQ(0, memcmp(r2, in + 2, rlen2));
+  buf.ConsumeReadData(rlen1 + rlen2);
+
+  // Spans that don't wrap leave the second one empty.
+  EXPECT_EQ(SR_SUCCESS, buf.Write(in, 4, NULL, NULL));
+  EXPECT_EQ(4u, buf.GetReadDataSpans(&r1, &rlen1, &r2, &rlen2));
+  EXPECT_EQ(4u, rlen1);
+  EXPECT_EQ(0u, rlen2);
+  EXPECT_TRUE(r2 == NULL);
+  EXPECT_EQ(SR_SUCCESS, buf.Read(out, 4, NULL, NULL));
+
+  buf.Close();
+  EXPECT_EQ(0u, buf.GetWriteBufferSpans(&w1, &wlen1, &w2, &wlen2));
+  EXPECT_TRUE(w1 == NULL);
+}
+
+TEST(FifoBufferTest, Mirrored) {
+  // Mirroring needs a multiple of the page size, which isn't always 4K.
+#ifdef POSIX
+  const size_t kSize = sysconf(_SC_PAGESIZE);
+#else
+  const size_t kSize = 4096;
+#endif
+  FifoBuffer buf(kSize);
+#if defined(LINUX)
+  // Not a multiple of the page size: the mapping is rounded up, but the
+  // capacity is unchanged.
+  FifoBuffer odd(kSize + 1);
+  ASSERT_TRUE(odd.SetMirrored(true));
+  scoped_array<char> odd_in(new char[kSize + 1]);
+  for (size_t i = 0; i < kSize + 1; ++i) {
+    odd_in[i] = static_cast<char>(i * 3);
+  }
+  size_t odd_size;
+  // The mapping is two pages, so filling it from the middle wraps.
+  EXPECT_EQ(SR_SUCCESS, odd.Write(odd_in.get(), kSize, NULL, NULL));
+  odd.ConsumeReadData(kSize);
+  EXPECT_EQ(SR_SUCCESS, odd.Write(odd_in.get(), kSize + 1, &odd_size, NULL));
+  EXPECT_EQ(kSize + 1, odd_size);
+  EXPECT_EQ(SR_BLOCK, odd.Write(odd_in.get(), 1, NULL, NULL));
+  const void* odd_data = odd.GetReadData(&odd_size);
+  EXPECT_EQ(kSize + 1, odd_size);
+  EXPECT_EQ(0, memcmp(odd_data, odd_in.get(), kSize + 1));
+
+  ASSERT_TRUE(buf.SetMirrored(true));
+#else
+  if (!buf.SetMirrored(true)) {
+    LOG(LS_INFO) << "Mirrored FifoBuffer not supported, skipping";
+    return;
+  }
+#endif
+  EXPECT_TRUE(buf.mirrored());
+
+  scoped_array<char> in(new char[kSize]);
+  scoped_array<char> out(new char[kSize]);
+  for (size_t i = 0; i < kSize; ++i) {
+    in[i] = static_cast<char>(i * 7);
+  }
+
+  // Move the read position near the end, then fill the buffer.
+  EXPECT_EQ(SR_SUCCESS, buf.Write(in.get(), kSize - 100, NULL, NULL));
+  buf.ConsumeReadData(kSize - 100);
+  EXPECT_EQ(SR_SUCCESS, buf.Write(in.get(), kSize, NULL, NULL));
+
+  // The whole wrapped region is contiguous.
+  size_t size;
+  const void* p = buf.GetReadData(&size);
+  EXPECT_EQ(kSize, size);
+  EXPECT_EQ(0, memcmp(p, in.get(), kSize));
+  const void* r1;
+  const void* r2;
+  size_t rlen1, rlen2;
+  EXPECT_EQ(kSize, buf.GetReadDataSpans(&r1, &rlen1, &r2, &rlen2));
+  EXPECT_EQ(kSize, rlen1);
+  EXPECT_EQ(0u, rlen2);
+
+  EXPECT_EQ(SR_SUCCESS, buf.ReadOffset(out.get(), kSize - 50, 50, NULL));
+  EXPECT_EQ(0, memcmp(out.get(), in.get() + 50, kSize - 50));
+  // The free space wraps too, and is also contiguous.
+  buf.ConsumeReadData(200);
+  EXPECT_TRUE(buf.GetWriteBuffer(&size) != NULL);
+  EXPECT_EQ(200u, size);
+
+  // Resizing keeps the data and the mapping.
+  EXPECT_TRUE(buf.SetCapacity(2 * kSize));
+  EXPECT_TRUE(buf.mirrored());
+  EXPECT_EQ(SR_SUCCESS, buf.Read(out.get(), kSize - 200, NULL, NULL));
+  EXPECT_EQ(0, memcmp(out.get(), in.get() + 200, kSize - 200));
+  EXPECT_TRUE(buf.SetCapacity(kSize + 1));
+  EXPECT_TRUE(buf.mirrored());
+
+  EXPECT_TRUE(buf.SetCapacity(kSize));
+  EXPECT_TRUE(buf.SetMirrored(true));
+  EXPECT_TRUE(buf.SetMirrored(false));
+  EXPECT_FALSE(buf.mirrored());
+}
+
 TEST(AsyncWriteTest, TestWrite) {
   FifoBuffer* buf = new FifoBuffer(100);
   AsyncWriteStream stream(buf, Thread::Current());
@@ -32,8 +32,14 @@
 
 #include "talk/base/basictypes.h"
 #include "talk/base/common.h"
+#include "talk/base/cpufeatures.h"
 #include "talk/base/stringutils.h"
 
+#ifdef HAVE_X86_INTRINSICS
+#include <immintrin.h>
+#include <tmmintrin.h>
+#endif
+
 namespace talk_base {
 
 /////////////////////////////////////////////////////////////////////////////
@@ -136,10 +142,9 @@ const char* unsafe_filename_characters() {
 #ifdef WIN32
   return "\\/:*?\"<>|";
 #else  // !WIN32
-  // TODO
-  ASSERT(false);
-  return "";
-#endif  // !WIN23
+  // Only the separator is special; NUL can't appear in a C string anyway.
+  return "/";
+#endif  // !WIN32
 }
 
 const unsigned char URL_UNSAFE  = 0x1; // 0-33 "#$%&+,/:;<=>?@[\]^`{|} 127
@@ -434,9 +439,9 @@ char hex_encode(unsigned char val) {
 bool hex_decode(char ch, unsigned char* val) {
   if ((ch >= '0') && (ch <= '9')) {
     *val = ch - '0';
-  } else if ((ch >= 'A') && (ch <= 'Z')) {
+  } else if ((ch >= 'A') && (ch <= 'F')) {
     *val = (ch - 'A') + 10;
-  } else if ((ch >= 'a') && (ch <= 'z')) {
+  } else if ((ch >= 'a') && (ch <= 'f')) {
     *val = (ch - 'a') + 10;
   } else {
     return false;
@@ -444,6 +449,139 @@ bool hex_decode(char ch, unsigned char* val) {
   return true;
 }
 
+#ifdef HAVE_X86_INTRINSICS
+// Vectorized versions of the undelimited hex loops.  Each returns the number
+// of source bytes it handled; the scalar loops do the rest.
+
+// Looks each nibble up in HEX and interleaves the high and low digits.
+X86_TARGET("ssse3")
+static size_t HexEncodeSsse3(char* buffer, const unsigned char* source,
+                             size_t srclen) {
+  const __m128i digits =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX));
+  const __m128i mask = _mm_set1_epi8(0x0F);
+  size_t i = 0;
+  for (; srclen - i >= 16; i += 16, buffer += 32) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+    __m128i hi = _mm_shuffle_epi8(digits,
+        _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+    __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(in, mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer),
+                     _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer + 16),
+                     _mm_unpackhi_epi8(hi, lo));
+  }
+  return i;
+}
+
+X86_TARGET("avx2")
+static size_t HexEncodeAvx2(char* buffer, const unsigned char* source,
+                            size_t srclen) {
+  const __m256i digits = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(HEX)));
+  const __m256i mask = _mm256_set1_epi8(0x0F);
+  size_t i = 0;
+  for (; srclen - i >= 32; i += 32, buffer += 64) {
+    __m256i in = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(source + i));
+    __m256i hi = _mm256_shuffle_epi8(digits,
+        _mm256_and_si256(_mm256_srli_epi16(in, 4), mask));
+    __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(in, mask));
+    // unpack works within 128-bit lanes, so put the lanes back in order.
+    __m256i a = _mm256_unpacklo_epi8(hi, lo);
+    __m256i b = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer),
+                        _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer + 32),
+                        _mm256_permute2x128_si256(a, b, 0x31));
+  }
+  return i;
+}
+
+// Converts 16 hex digits to nibble values; |valid| is cleared if any
+// character is not a hex digit.
+X86_TARGET("ssse3")
+static inline __m128i HexDigitsSsse3(__m128i in, bool* valid) {
+  __m128i digit = _mm_sub_epi8(in, _mm_set1_epi8('0'));
+  __m128i is_digit = _mm_cmpeq_epi8(
+      _mm_max_epu8(digit, _mm_set1_epi8(9)), _mm_set1_epi8(9));
+  // Folds 'a'-'f' onto 'A'-'F'.
+  __m128i letter = _mm_sub_epi8(_mm_and_si128(in, _mm_set1_epi8(~0x20)),
+                                _mm_set1_epi8('A'));
+  __m128i is_letter = _mm_cmpeq_epi8(
+      _mm_max_epu8(letter, _mm_set1_epi8(5)), _mm_set1_epi8(5));
+  if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xFFFF)
+    *valid = false;
+  return _mm_or_si128(
+      _mm_and_si128(is_digit, digit),
+      _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+// Decodes 32 digits into 16 bytes at a time, stopping at the first block
+// that isn't entirely hex digits.
+X86_TARGET("ssse3")
+static size_t HexDecodeSsse3(unsigned char* buffer, const char* source,
+                             size_t srclen) {
+  size_t i = 0;
+  for (; srclen - i >= 32; i += 32, buffer += 16) {
+    bool valid = true;
+    __m128i a = HexDigitsSsse3(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(source + i)), &valid);
+    __m128i b = HexDigitsSsse3(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(source + i + 16)), &valid);
+    if (!valid)
+      break;
+    // (high << 4) | low for each pair of digits, as 16-bit words.
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    a = _mm_maddubs_epi16(a, weights);
+    b = _mm_maddubs_epi16(b, weights);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer),
+                     _mm_packus_epi16(a, b));
+  }
+  return i / 2;
+}
+
+X86_TARGET("avx2")
+static inline __m256i HexDigitsAvx2(__m256i in, bool* valid) {
+  __m256i digit = _mm256_sub_epi8(in, _mm256_set1_epi8('0'));
+  __m256i is_digit = _mm256_cmpeq_epi8(
+      _mm256_max_epu8(digit, _mm256_set1_epi8(9)), _mm256_set1_epi8(9));
+  __m256i letter = _mm256_sub_epi8(
+      _mm256_and_si256(in, _mm256_set1_epi8(~0x20)), _mm256_set1_epi8('A'));
+  __m256i is_letter = _mm256_cmpeq_epi8(
+      _mm256_max_epu8(letter, _mm256_set1_epi8(5)), _mm256_set1_epi8(5));
+  if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) != -1)
+    *valid = false;
+  return _mm256_or_si256(
+      _mm256_and_si256(is_digit, digit),
+      _mm256_and_si256(is_letter,
+                       _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+X86_TARGET("avx2")
+static size_t HexDecodeAvx2(unsigned char* buffer, const char* source,
+                            size_t srclen) {
+  size_t i = 0;
+  for (; srclen - i >= 64; i += 64, buffer += 32) {
+    bool valid = true;
+    __m256i a = HexDigitsAvx2(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(source + i)), &valid);
+    __m256i b = HexDigitsAvx2(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(source + i + 32)), &valid);
+    if (!valid)
+      break;
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    a = _mm256_maddubs_epi16(a, weights);
+    b = _mm256_maddubs_epi16(b, weights);
+    // packus works within 128-bit lanes, so put the quadwords back in order.
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(buffer),
+                        _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b),
+                                                 0xD8));
+  }
+  return i / 2;
+}
+#endif  // HAVE_X86_INTRINSICS
+
 size_t hex_encode(char* buffer, size_t buflen,
                   const char* csource, size_t srclen) {
   return hex_encode_with_delimiter(buffer, buflen, csource, srclen, 0);
@@ -464,6 +602,19 @@ size_t hex_encode_with_delimiter(char* buffer, size_t buflen,
   if (buflen < needed)
     return 0;
 
+#ifdef HAVE_X86_INTRINSICS
+  if (!delimiter) {
+    if (CpuFeatures::Has(CpuFeatures::kAVX2)) {
+      srcpos = HexEncodeAvx2(buffer, bsource, srclen);
+    }
+    if (CpuFeatures::Has(CpuFeatures::kSSSE3)) {
+      srcpos += HexEncodeSsse3(buffer + srcpos * 2, bsource + srcpos,
+                               srclen - srcpos);
+    }
+    bufpos = srcpos * 2;
+  }
+#endif
+
   while (srcpos < srclen) {
     unsigned char ch = bsource[srcpos++];
     buffer[bufpos  ] = hex_encode((ch >> 4) & 0xF);
@@ -488,12 +639,25 @@ std::string hex_encode(const char* source, size_t srclen) {
 
 std::string hex_encode_with_delimiter(const char* source, size_t srclen,
                                       char delimiter) {
-  const size_t kBufferSize = srclen * 3;
-  char* buffer = STACK_ARRAY(char, kBufferSize);
-  size_t length = hex_encode_with_delimiter(buffer, kBufferSize,
+  std::string result;
+  hex_encode_with_delimiter(source, srclen, delimiter, &result);
+  return result;
+}
+
+void hex_encode_with_delimiter(const char* source, size_t srclen,
+                               char delimiter, std::string* result) {
+  ASSERT(NULL != result);
+  if (srclen == 0)
+    return;
+  // Encode straight into the string; the extra byte is for the terminator
+  // written by the buffer version, and is trimmed off again.
+  const size_t offset = result->size();
+  const size_t needed = delimiter ? (srclen * 3) : (srclen * 2 + 1);
+  result->resize(offset + needed);
+  size_t length = hex_encode_with_delimiter(&(*result)[offset], needed,
                                             source, srclen, delimiter);
-  ASSERT(srclen == 0 || length > 0);
-  return std::string(buffer, length);
+  ASSERT(length > 0);
+  result->resize(offset + length);
 }
 
 size_t hex_decode(char * cbuffer, size_t buflen,
@@ -515,6 +679,19 @@ size_t hex_decode_with_delimiter(char* cbuffer, size_t buflen,
   if (buflen < needed)
     return 0;
 
+#ifdef HAVE_X86_INTRINSICS
+  if (!delimiter) {
+    if (CpuFeatures::Has(CpuFeatures::kAVX2)) {
+      bufpos = HexDecodeAvx2(bbuffer, source, srclen);
+    }
+    if (CpuFeatures::Has(CpuFeatures::kSSSE3)) {
+      bufpos += HexDecodeSsse3(bbuffer + bufpos, source + bufpos * 2,
+                               srclen - bufpos * 2);
+    }
+    srcpos = bufpos * 2;
+  }
+#endif
+
   while (srcpos < srclen) {
     if ((srclen - srcpos) < 2) {
       // This means we have an odd number of bytes.
@@ -113,6 +113,9 @@ size_t hex_encode_with_delimiter(char* buffer, size_t buflen,
 std::string hex_encode(const char* source, size_t srclen);
 std::string hex_encode_with_delimiter(const char* source, size_t srclen,
                                       char delimiter);
+// Appends the encoding to |result|, without a temporary buffer.
+void hex_encode_with_delimiter(const char* source, size_t srclen,
+                               char delimiter, std::string* result);
 
 // hex_decode converts ascii hex to binary.
 size_t hex_decode(char* buffer, size_t buflen,
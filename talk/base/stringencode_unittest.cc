@@ -26,9 +26,12 @@
  */
 
 #include "talk/base/common.h"
+#include "talk/base/cpufeatures.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
 #include "talk/base/stringencode.h"
 #include "talk/base/stringutils.h"
+#include "talk/base/timeutils.h"
 
 namespace talk_base {
 
@@ -229,6 +232,94 @@ TEST_F(HexEncodeTest, TestDecodeWithDelimiterTrailingDelimiter) {
   ASSERT_EQ(0U, dec_res_);
 }
 
+// Test that only 0-9, a-f and A-F are accepted as hex digits.
+TEST_F(HexEncodeTest, TestDecodeNonHexLetters) {
+  unsigned char val;
+  EXPECT_TRUE(hex_decode('F', &val));
+  EXPECT_EQ(15, val);
+  EXPECT_FALSE(hex_decode('G', &val));
+  EXPECT_FALSE(hex_decode('g', &val));
+  EXPECT_FALSE(hex_decode('z', &val));
+  dec_res_ = hex_decode(decoded_, sizeof(decoded_), "0g", 2);
+  ASSERT_EQ(0U, dec_res_);
+}
+
+// Test that the std::string encoder appends to the result.
+TEST_F(HexEncodeTest, TestAppend) {
+  std::string result("x");
+  hex_encode_with_delimiter(data_, 2, ':', &result);
+  EXPECT_EQ("x80:81", result);
+  hex_encode_with_delimiter(data_, 0, ':', &result);
+  EXPECT_EQ("x80:81", result);
+  hex_encode_with_delimiter(data_ + 2, 2, 0, &result);
+  EXPECT_EQ("x80:818283", result);
+}
+
+// Test that the vectorized code agrees with the scalar code for every length
+// up to a few vector blocks, and with a bad digit at every position.
+TEST_F(HexEncodeTest, TestImplementationsMatch) {
+  char data[160];
+  for (size_t i = 0; i < sizeof(data); ++i) {
+    data[i] = static_cast<char>(i * 37 + 11);
+  }
+  for (size_t len = 0; len <= sizeof(data); ++len) {
+    CpuFeatures::MaskForTest(0);
+    std::string expected = hex_encode(data, len);
+    CpuFeatures::MaskForTest(CpuFeatures::kAll);
+    std::string encoded = hex_encode(data, len);
+    ASSERT_EQ(expected, encoded) << "len " << len;
+    char decoded[sizeof(data)];
+    ASSERT_EQ(len, hex_decode(decoded, sizeof(decoded), encoded));
+    ASSERT_EQ(0, memcmp(data, decoded, len));
+  }
+
+  std::string encoded = hex_encode(data, sizeof(data));
+  for (size_t pos = 0; pos < encoded.size(); ++pos) {
+    std::string damaged = encoded;
+    damaged[pos] = (pos & 1) ? 'g' : '/';
+    char decoded[sizeof(data)];
+    ASSERT_EQ(0U, hex_decode(decoded, sizeof(decoded), damaged))
+        << "pos " << pos;
+    // Upper case digits decode the same as lower case.
+    std::string upper = encoded;
+    upper[pos] = toupper(upper[pos]);
+    ASSERT_EQ(sizeof(data), hex_decode(decoded, sizeof(decoded), upper));
+    ASSERT_EQ(0, memcmp(data, decoded, sizeof(data)));
+  }
+}
+
+// Test the throughput of hex encoding and decoding 1KB to 1MB inputs.
+TEST_F(HexEncodeTest, DISABLED_Perf) {
+  for (size_t size = 1024; size <= 1024 * 1024; size *= 32) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<char>(i * 7);
+    }
+    std::string encoded, decoded(size, '\0');
+    const int kIterations = static_cast<int>(32 * 1024 * 1024 / size);
+    for (int accelerated = 0; accelerated < 2; ++accelerated) {
+      CpuFeatures::MaskForTest(accelerated ? CpuFeatures::kAll : 0);
+      uint32 start = Time();
+      for (int i = 0; i < kIterations; ++i) {
+        encoded.clear();
+        hex_encode_with_delimiter(data.data(), data.size(), 0, &encoded);
+      }
+      int encode_ms = TimeSince(start);
+      start = Time();
+      for (int i = 0; i < kIterations; ++i) {
+        hex_decode(&decoded[0], decoded.size(), encoded);
+      }
+      int decode_ms = TimeSince(start);
+      EXPECT_EQ(data, decoded);
+      LOG(LS_INFO) << "Hex of 32 MB in " << size << " byte blocks, "
+                   << (accelerated ? "best available" : "portable")
+                   << ": encode " << encode_ms << " ms, decode "
+                   << decode_ms << " ms";
+    }
+  }
+  CpuFeatures::MaskForTest(CpuFeatures::kAll);
+}
+
 // Tests counting substrings.
 TEST(TokenizeTest, CountSubstrings) {
   std::vector<std::string> fields;
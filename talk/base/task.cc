@@ -44,7 +44,10 @@ Task::Task(TaskParent *parent)
       start_time_(0),
       timeout_time_(0),
       timeout_seconds_(0),
-      timeout_suspended_(false)  {
+      timeout_suspended_(false),
+      runner_index_(TaskRunner::kNoIndex),
+      timeout_index_(TaskRunner::kNoIndex),
+      queued_(false) {
   unique_id_ = unique_id_seed_++;
 
   // sanity check that we didn't roll-over our id seed
@@ -171,6 +174,8 @@ void Task::Abort(bool nowake) {
     // verify that stop removed this from its parent
     ASSERT(!parent()->IsChildTask(this));
 #endif
+    // Queue the task to be deleted by the next run.
+    GetRunner()->QueueTask(this);
     if (!nowake) {
       // WakeTasks to self-delete.
       // Don't call Wake() because it is a no-op after "done_" is set.
@@ -185,6 +190,7 @@ void Task::Wake() {
     return;
   if (blocked_) {
     blocked_ = false;
+    GetRunner()->QueueTask(this);
     GetRunner()->WakeTasks();
   }
 }
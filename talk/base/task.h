@@ -172,6 +172,8 @@ class Task : public TaskParent {
   }
 
  private:
+  friend class TaskRunner;
+
   void Done();
 
   int state_;
@@ -185,7 +187,14 @@ class Task : public TaskParent {
   int timeout_seconds_;
   bool timeout_suspended_;
   int32 unique_id_;
-  
+
+  // Bookkeeping for the TaskRunner: where the task lives in its task list
+  // and timeout heap (TaskRunner::kNoIndex if it isn't there) and whether
+  // it's waiting in the runnable queue.
+  size_t runner_index_;
+  size_t timeout_index_;
+  bool queued_;
+
   static int32 unique_id_seed_;
 };
 
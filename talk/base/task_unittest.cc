@@ -559,4 +559,57 @@ TEST(unstarted_task_test, DoNotDeleteTask2) {
   task_runner.RunTasks();
 }
 
+class PerfTask : public Task {
+ public:
+  explicit PerfTask(TaskParent *parent) : Task(parent), steps_(0) {}
+  virtual int ProcessStart() {
+    ++steps_;
+    return STATE_BLOCKED;
+  }
+  int steps() const { return steps_; }
+
+ private:
+  int steps_;
+};
+
+// Measures the cost of waking and running one task, and of moving one
+// task's timeout, with 10000 blocked tasks in the runner.
+TEST(start_task_test, DISABLED_Perf) {
+  const int kTaskCount = 10000;
+  const int kIterations = 10000;
+  DeleteTestTaskRunner task_runner;
+  std::vector<PerfTask*> tasks;
+  for (int i = 0; i < kTaskCount; ++i) {
+    PerfTask* task = new PerfTask(&task_runner);
+    task->set_timeout_seconds(60 + rand() % 600);
+    task->Start();
+    tasks.push_back(task);
+  }
+  task_runner.RunTasks();
+
+  uint32 start = Time();
+  int expected_steps = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    PerfTask* task = tasks[rand() % kTaskCount];
+    expected_steps += task->steps() + 1;
+    task->Wake();
+    task_runner.RunTasks();
+    expected_steps -= task->steps();
+  }
+  uint32 run_time = TimeSince(start);
+  EXPECT_EQ(0, expected_steps);
+
+  start = Time();
+  for (int i = 0; i < kIterations; ++i) {
+    tasks[rand() % kTaskCount]->set_timeout_seconds(60 + rand() % 600);
+  }
+  uint32 timeout_time = TimeSince(start);
+  EXPECT_NE(0, task_runner.next_task_timeout());
+
+  LOG(LS_INFO) << "Wake and run one of " << kTaskCount << " tasks: "
+               << run_time * 1000.0 / kIterations << " us";
+  LOG(LS_INFO) << "Reset one of " << kTaskCount << " timeouts: "
+               << timeout_time * 1000.0 / kIterations << " us";
+}
+
 }  // namespace talk_base
@@ -38,7 +38,6 @@ namespace talk_base {
 
 TaskRunner::TaskRunner()
   : TaskParent(this),
-    next_timeout_task_(NULL),
     tasks_running_(false)
 #ifdef _DEBUG
     , abort_count_(0),
@@ -54,7 +53,9 @@ TaskRunner::~TaskRunner() {
 }
 
 void TaskRunner::StartTask(Task * task) {
+  task->runner_index_ = tasks_.size();
   tasks_.push_back(task);
+  QueueTask(task);
 
   // the task we just started could be about to timeout --
   // make sure our "next timeout task" is correct
@@ -67,6 +68,17 @@ void TaskRunner::RunTasks() {
   InternalRunTasks(false);
 }
 
+void TaskRunner::QueueTask(Task* task) {
+  // Tasks that were never started aren't ours to run or delete.
+  if (task->runner_index_ == kNoIndex || task->queued_)
+    return;
+  // A finished task can't time out any more.
+  if (task->IsDone() && task->timeout_index_ != kNoIndex)
+    RemoveTimeout(task);
+  task->queued_ = true;
+  runnable_.push_back(task);
+}
+
 void TaskRunner::InternalRunTasks(bool in_destructor) {
   // This shouldn't run while an abort is happening.
   // If that occurs, then tasks may be deleted in this method,
@@ -74,7 +86,7 @@ void TaskRunner::InternalRunTasks(bool in_destructor) {
   // "ChildSet copy" in TaskParent::AbortAllChildren.
   // Subsequent use of those task may cause data corruption or crashes.  
   ASSERT(!abort_count_);
-  // Running continues until all tasks are Blocked (ok for a small # of tasks)
+  // Running continues until all tasks are Blocked
   if (tasks_running_) {
     return;  // don't reenter
   }
@@ -83,48 +95,29 @@ void TaskRunner::InternalRunTasks(bool in_destructor) {
 
   int64 previous_timeout_time = next_task_timeout();
 
-  int did_run = true;
-  while (did_run) {
-    did_run = false;
-    // use indexing instead of iterators because tasks_ may grow
-    for (size_t i = 0; i < tasks_.size(); ++i) {
-      while (!tasks_[i]->Blocked()) {
-        tasks_[i]->Step();
-        did_run = true;
-      }
+  // Tasks that are woken while this runs are appended to the queue and
+  // run in turn.
+  std::vector<Task *> finished;
+  while (!runnable_.empty()) {
+    Task* task = runnable_.front();
+    runnable_.pop_front();
+    task->queued_ = false;
+    while (!task->Blocked()) {
+      task->Step();
     }
-  }
-  // Tasks are deleted when running has paused
-  bool need_timeout_recalc = false;
-  for (size_t i = 0; i < tasks_.size(); ++i) {
-    if (tasks_[i]->IsDone()) {
-      Task* task = tasks_[i];
-      if (next_timeout_task_ &&
-          task->unique_id() == next_timeout_task_->unique_id()) {
-        next_timeout_task_ = NULL;
-        need_timeout_recalc = true;
-      }
-
-#ifdef _DEBUG
-      deleting_task_ = task;
-#endif
-      delete task;
-#ifdef _DEBUG
-      deleting_task_ = NULL;
-#endif
-      tasks_[i] = NULL;
+    // A task that aborts while it's busy queues itself again; collect it
+    // when that entry comes up so it's only deleted once.
+    if (task->IsDone() && !task->queued_) {
+      // Keep it off the queue; it's deleted below.
+      task->queued_ = true;
+      finished.push_back(task);
     }
   }
-  // Finally, remove nulls
-  std::vector<Task *>::iterator it;
-  it = std::remove(tasks_.begin(),
-                   tasks_.end(),
-                   reinterpret_cast<Task *>(NULL));
-
-  tasks_.erase(it, tasks_.end());
 
-  if (need_timeout_recalc)
-    RecalcNextTimeout(NULL);
+  // Tasks are deleted when running has paused
+  for (size_t i = 0; i < finished.size(); ++i) {
+    DeleteTask(finished[i]);
+  }
 
   // Make sure that adjustments are done to account
   // for any timeout changes (but don't call this
@@ -135,26 +128,49 @@ void TaskRunner::InternalRunTasks(bool in_destructor) {
   tasks_running_ = false;
 }
 
+void TaskRunner::DeleteTask(Task* task) {
+  ASSERT(task->IsDone());
+  if (task->timeout_index_ != kNoIndex)
+    RemoveTimeout(task);
+
+  // Swap the last task into this one's slot.
+  size_t index = task->runner_index_;
+  ASSERT(index < tasks_.size() && tasks_[index] == task);
+  tasks_[index] = tasks_.back();
+  tasks_[index]->runner_index_ = index;
+  tasks_.pop_back();
+  task->runner_index_ = kNoIndex;
+
+#ifdef _DEBUG
+  deleting_task_ = task;
+#endif
+  delete task;
+#ifdef _DEBUG
+  deleting_task_ = NULL;
+#endif
+}
+
 void TaskRunner::PollTasks() {
   // see if our "next potentially timed-out task" has indeed timed out.
   // If it has, wake it up, then queue up the next task in line
   // Repeat while we have new timed-out tasks.
   // TODO: We need to guard against WakeTasks not updating
-  // next_timeout_task_. Maybe also add documentation in the header file once
-  // we understand this code better.
+  // next_timeout_task(). Maybe also add documentation in the header file
+  // once we understand this code better.
   Task* old_timeout_task = NULL;
-  while (next_timeout_task_ &&
-      old_timeout_task != next_timeout_task_ &&
-      next_timeout_task_->TimedOut()) {
-    old_timeout_task = next_timeout_task_;
-    next_timeout_task_->Wake();
+  while (next_timeout_task() &&
+      old_timeout_task != next_timeout_task() &&
+      next_timeout_task()->TimedOut()) {
+    old_timeout_task = next_timeout_task();
+    old_timeout_task->Wake();
     WakeTasks();
   }
 }
 
 int64 TaskRunner::next_task_timeout() const {
-  if (next_timeout_task_) {
-    return next_timeout_task_->timeout_time();
+  Task* task = next_timeout_task();
+  if (task) {
+    return task->timeout_time();
   }
   return 0;
 }
@@ -162,34 +178,27 @@ int64 TaskRunner::next_task_timeout() const {
 // this function gets called frequently -- when each task changes
 // state to something other than DONE, ERROR or BLOCKED, it calls
 // ResetTimeout(), which will call this function to make sure that
-// the next timeout-able task hasn't changed.  The logic in this function
-// prevents RecalcNextTimeout() from getting called in most cases,
-// effectively making the task scheduler O-1 instead of O-N
+// the next timeout-able task hasn't changed.  Each call is O(log n)
+// in the number of tasks with a timeout.
 
 void TaskRunner::UpdateTaskTimeout(Task* task,
                                    int64 previous_task_timeout_time) {
   ASSERT(task != NULL);
   int64 previous_timeout_time = next_task_timeout();
-  bool task_is_timeout_task = next_timeout_task_ != NULL &&
-      task->unique_id() == next_timeout_task_->unique_id();
-  if (task_is_timeout_task) {
+  if (task == next_timeout_task()) {
     previous_timeout_time = previous_task_timeout_time;
   }
 
-  // if the relevant task has a timeout, then
-  // check to see if it's closer than the current
-  // "about to timeout" task
-  if (task->timeout_time()) {
-    if (next_timeout_task_ == NULL ||
-        (task->timeout_time() <= next_timeout_task_->timeout_time())) {
-      next_timeout_task_ = task;
+  // Only tasks that are ours and have a timeout live in the heap.
+  if (task->timeout_time() && !task->IsDone() &&
+      task->runner_index_ != kNoIndex) {
+    if (task->timeout_index_ == kNoIndex) {
+      AddTimeout(task);
+    } else {
+      MoveTimeout(task);
     }
-  } else if (task_is_timeout_task) {
-    // otherwise, if the task doesn't have a timeout,
-    // and it used to be our "about to timeout" task,
-    // walk through all the tasks looking for the real
-    // "about to timeout" task
-    RecalcNextTimeout(task);
+  } else if (task->timeout_index_ != kNoIndex) {
+    RemoveTimeout(task);
   }
 
   // Note when task_running_, then the running routine
@@ -200,31 +209,65 @@ void TaskRunner::UpdateTaskTimeout(Task* task,
   }
 }
 
-void TaskRunner::RecalcNextTimeout(Task *exclude_task) {
-  // walk through all the tasks looking for the one
-  // which satisfies the following:
-  //   it's not finished already
-  //   we're not excluding it
-  //   it has the closest timeout time
-
-  int64 next_timeout_time = 0;
-  next_timeout_task_ = NULL;
-
-  for (size_t i = 0; i < tasks_.size(); ++i) {
-    Task *task = tasks_[i];
-    // if the task isn't complete, and it actually has a timeout time
-    if (!task->IsDone() && (task->timeout_time() > 0))
-      // if it doesn't match our "exclude" task
-      if (exclude_task == NULL ||
-          exclude_task->unique_id() != task->unique_id())
-        // if its timeout time is sooner than our current timeout time
-        if (next_timeout_time == 0 ||
-            task->timeout_time() <= next_timeout_time) {
-          // set this task as our next-to-timeout
-          next_timeout_time = task->timeout_time();
-          next_timeout_task_ = task;
-        }
+void TaskRunner::AddTimeout(Task* task) {
+  timeouts_.push_back(task);
+  task->timeout_index_ = timeouts_.size() - 1;
+  SiftUp(task->timeout_index_);
+}
+
+void TaskRunner::RemoveTimeout(Task* task) {
+  size_t index = task->timeout_index_;
+  ASSERT(index < timeouts_.size() && timeouts_[index] == task);
+  task->timeout_index_ = kNoIndex;
+  Task* last = timeouts_.back();
+  timeouts_.pop_back();
+  if (last != task) {
+    SetTimeoutAt(index, last);
+    MoveTimeout(last);
+  }
+}
+
+void TaskRunner::MoveTimeout(Task* task) {
+  size_t index = task->timeout_index_;
+  SiftUp(index);
+  // If it didn't move up, it may need to move down.
+  if (task->timeout_index_ == index)
+    SiftDown(index);
+}
+
+void TaskRunner::SiftUp(size_t index) {
+  Task* task = timeouts_[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (timeouts_[parent]->timeout_time() <= task->timeout_time())
+      break;
+    SetTimeoutAt(index, timeouts_[parent]);
+    index = parent;
+  }
+  SetTimeoutAt(index, task);
+}
+
+void TaskRunner::SiftDown(size_t index) {
+  Task* task = timeouts_[index];
+  size_t size = timeouts_.size();
+  while (true) {
+    size_t child = index * 2 + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size &&
+        timeouts_[child + 1]->timeout_time() < timeouts_[child]->timeout_time())
+      ++child;
+    if (task->timeout_time() <= timeouts_[child]->timeout_time())
+      break;
+    SetTimeoutAt(index, timeouts_[child]);
+    index = child;
   }
+  SetTimeoutAt(index, task);
+}
+
+void TaskRunner::SetTimeoutAt(size_t index, Task* task) {
+  timeouts_[index] = task;
+  task->timeout_index_ = index;
 }
 
 void TaskRunner::CheckForTimeoutChange(int64 previous_timeout_time) {
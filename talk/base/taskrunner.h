@@ -28,6 +28,7 @@
 #ifndef TALK_BASE_TASKRUNNER_H__
 #define TALK_BASE_TASKRUNNER_H__
 
+#include <deque>
 #include <vector>
 
 #include "talk/base/basictypes.h"
@@ -41,8 +42,15 @@ const int64 kSecToMsec = 1000;
 const int64 kMsecTo100ns = 10000;
 const int64 kSecTo100ns = kSecToMsec * kMsecTo100ns;
 
+// Runs Tasks.  Only tasks that have been woken are stepped: Wake() puts a
+// task on a runnable queue that RunTasks() drains, and finished tasks are
+// queued for deletion the same way.  Timeouts are kept in a binary heap, so
+// finding the next one is O(1) and updating one is O(log n).
 class TaskRunner : public TaskParent, public sigslot::has_slots<> {
  public:
+  // Marks a Task that isn't in the runner's task list or timeout heap.
+  static const size_t kNoIndex = static_cast<size_t>(-1);
+
   TaskRunner();
   virtual ~TaskRunner();
 
@@ -98,18 +106,39 @@ class TaskRunner : public TaskParent, public sigslot::has_slots<> {
   }
 
  private:
+  friend class Task;
+
   void InternalRunTasks(bool in_destructor);
   void CheckForTimeoutChange(int64 previous_timeout_time);
 
+  // Puts a started task on the runnable queue, unless it's already there.
+  // Doesn't call WakeTasks().
+  void QueueTask(Task* task);
+  // Removes a finished task from the runner and deletes it.
+  void DeleteTask(Task* task);
+
+  Task* next_timeout_task() const {
+    return timeouts_.empty() ? NULL : timeouts_[0];
+  }
+  void AddTimeout(Task* task);
+  void RemoveTimeout(Task* task);
+  void MoveTimeout(Task* task);
+  // Restore the heap property for the task at |index|.
+  void SiftUp(size_t index);
+  void SiftDown(size_t index);
+  void SetTimeoutAt(size_t index, Task* task);
+
+  // Every started task that hasn't been deleted yet, in no particular order.
   std::vector<Task *> tasks_;
-  Task *next_timeout_task_;
+  // Tasks that have been woken (or have finished) since the last run.
+  std::deque<Task *> runnable_;
+  // Min-heap of the tasks with a timeout, ordered by timeout_time().
+  std::vector<Task *> timeouts_;
   bool tasks_running_;
 #ifdef _DEBUG
   int abort_count_;
   Task* deleting_task_;
 #endif
-
-  void RecalcNextTimeout(Task *exclude_task);
 };
 
 } // namespace talk_base
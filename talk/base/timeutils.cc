@@ -39,8 +39,13 @@
 #endif
 
 #include "talk/base/common.h"
+#include "talk/base/cpufeatures.h"
 #include "talk/base/timeutils.h"
 
+#if defined(CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #define EFFICIENT_IMPLEMENTATION 1
 
 namespace talk_base {
@@ -48,7 +53,27 @@ namespace talk_base {
 const uint32 LAST = 0xFFFFFFFF;
 const uint32 HALF = 0x80000000;
 
-uint64 TimeNanos() {
+#if defined(CPU_X86)
+static inline uint64 ReadTsc() {
+#if defined(_MSC_VER)
+  return __rdtsc();
+#else
+  uint32 lo, hi;
+  __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));  // NOLINT
+  return (static_cast<uint64>(hi) << 32) | lo;
+#endif
+}
+
+// TimeNanos() is |tsc_base_nanos| plus the TSC ticks since |tsc_base| scaled
+// by |tsc_nanos_per_tick|, once |tsc_enabled| is set.
+static bool tsc_enabled = false;
+static bool tsc_calibrated = false;
+static uint64 tsc_base = 0;
+static uint64 tsc_base_nanos = 0;
+static double tsc_nanos_per_tick = 0;
+#endif
+
+static uint64 SystemTimeNanos() {
   int64 ticks = 0;
 #if defined(OSX) || defined(IOS)
   static mach_timebase_info_data_t timebase;
@@ -90,6 +115,88 @@ uint64 TimeNanos() {
   return ticks;
 }
 
+// Overrides all of the above when set; see SetClock().
+static ClockInterface* g_clock = NULL;
+
+ClockInterface* SetClock(ClockInterface* clock) {
+  ClockInterface* prev = g_clock;
+  g_clock = clock;
+  return prev;
+}
+
+uint64 SimulatedClock::TimeNanos() const {
+  CritScope cs(&crit_);
+  return nanos_;
+}
+
+void SimulatedClock::AdvanceTime(uint64 nanos) {
+  CritScope cs(&crit_);
+  nanos_ += nanos;
+}
+
+void SimulatedClock::SetTime(uint64 nanos) {
+  CritScope cs(&crit_);
+  ASSERT(nanos >= nanos_);
+  nanos_ = nanos;
+}
+
+uint64 TimeNanos() {
+  if (g_clock) {
+    return g_clock->TimeNanos();
+  }
+#if defined(CPU_X86)
+  if (tsc_enabled) {
+    // Another core's TSC may read slightly behind |tsc_base|; clamp rather
+    // than let the unsigned difference wrap.
+    int64 ticks = static_cast<int64>(ReadTsc() - tsc_base);
+    if (ticks < 0)
+      ticks = 0;
+    return tsc_base_nanos + static_cast<uint64>(ticks * tsc_nanos_per_tick);
+  }
+#endif
+  return SystemTimeNanos();
+}
+
+int64 TimeMicros() {
+  return static_cast<int64>(TimeNanos() / kNumNanosecsPerMicrosec);
+}
+
+int64 TimeMillis() {
+  return static_cast<int64>(TimeNanos() / kNumNanosecsPerMillisec);
+}
+
+bool EnableTscClock(bool enable) {
+#if defined(CPU_X86)
+  if (!enable || !CpuFeatures::Has(CpuFeatures::kInvariantTSC)) {
+    tsc_enabled = false;
+    return false;
+  }
+  if (!tsc_calibrated) {
+    // Measure the TSC rate over at least 50 ms of the OS clock, bracketing
+    // each OS clock read with TSC reads to bound the error. A shorter window
+    // leaves the rate off by enough to show up over a few hundred ms.
+    uint64 start_tsc = ReadTsc();
+    uint64 start_nanos = SystemTimeNanos();
+    start_tsc = (start_tsc + ReadTsc()) / 2;
+    uint64 end_tsc, end_nanos;
+    do {
+      end_tsc = ReadTsc();
+      end_nanos = SystemTimeNanos();
+      end_tsc = (end_tsc + ReadTsc()) / 2;
+    } while (end_nanos - start_nanos < 50 * kNumNanosecsPerMillisec);
+    tsc_nanos_per_tick = static_cast<double>(end_nanos - start_nanos) /
+        static_cast<double>(end_tsc - start_tsc);
+    tsc_base = end_tsc;
+    tsc_base_nanos = end_nanos;
+    tsc_calibrated = true;
+  }
+  tsc_enabled = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
 uint32 Time() {
   return static_cast<uint32>(TimeNanos() / kNumNanosecsPerMillisec);
 }
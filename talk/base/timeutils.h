@@ -33,6 +33,7 @@
 #endif
 
 #include "talk/base/basictypes.h"
+#include "talk/base/criticalsection.h"
 
 namespace talk_base {
 
@@ -44,6 +45,8 @@ static const int64 kNumMicrosecsPerMillisec = kNumMicrosecsPerSec /
     kNumMillisecsPerSec;
 static const int64 kNumNanosecsPerMillisec =  kNumNanosecsPerSec /
     kNumMillisecsPerSec;
+static const int64 kNumNanosecsPerMicrosec = kNumNanosecsPerSec /
+    kNumMicrosecsPerSec;
 
 typedef uint32 TimeStamp;
 
@@ -51,6 +54,52 @@ typedef uint32 TimeStamp;
 uint32 Time();
 // Returns the current time in nanoseconds.
 uint64 TimeNanos();
+// Returns the current time in microseconds and milliseconds.  Unlike Time(),
+// these are 64 bits wide and don't wrap, so they can be compared and
+// subtracted directly.  All of these use the same monotonic clock.
+int64 TimeMicros();
+int64 TimeMillis();
+
+// On x86 processors with an invariant TSC, makes TimeNanos() and the
+// functions based on it read the TSC instead of calling into the OS, after
+// calibrating it against the OS clock (which blocks for about 50 ms the
+// first time).  Returns true if the TSC is now in use.  The TSC clock isn't
+// slewed by NTP, so it slowly drifts from the OS clock; don't mix their
+// readings.  Call this early, before any timestamps have been taken.
+bool EnableTscClock(bool enable);
+
+// A source of time for TimeNanos() and everything built on it.
+class ClockInterface {
+ public:
+  virtual ~ClockInterface() {}
+  virtual uint64 TimeNanos() const = 0;
+};
+
+// Makes TimeNanos(), Time() and friends read |clock| instead of the system
+// (or TSC) clock, in every thread; NULL restores the default.  Returns the
+// previously installed clock.  The caller keeps ownership, and must restore
+// the previous clock before deleting |clock|.  Meant for tests and
+// simulations; install the clock before any timestamps are taken.
+ClockInterface* SetClock(ClockInterface* clock);
+
+// A clock that only moves when told to.  Combined with SetClock(), this lets
+// a simulation run through minutes of timers in milliseconds of real time.
+class SimulatedClock : public ClockInterface {
+ public:
+  explicit SimulatedClock(uint64 start_nanos) : nanos_(start_nanos) {}
+
+  virtual uint64 TimeNanos() const;
+
+  // Moves the clock forward by |nanos|.
+  void AdvanceTime(uint64 nanos);
+  // Sets the clock to |nanos|, which must not be in the past.
+  void SetTime(uint64 nanos);
+
+ private:
+  mutable CriticalSection crit_;
+  uint64 nanos_;
+  DISALLOW_COPY_AND_ASSIGN(SimulatedClock);
+};
 
 // Returns a future timestamp, 'elapsed' milliseconds from now.
 uint32 TimeAfter(int32 elapsed);
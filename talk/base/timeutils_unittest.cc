@@ -27,6 +27,7 @@
 
 #include "talk/base/common.h"
 #include "talk/base/gunit.h"
+#include "talk/base/logging.h"
 #include "talk/base/thread.h"
 #include "talk/base/timeutils.h"
 
@@ -143,4 +144,88 @@ TEST(TimeTest, BoundaryComparison) {
   EXPECT_EQ(-100, TimeDiff(ts_earlier, ts_later));
 }
 
+TEST(TimeTest, HighResolutionClocks) {
+  // The 64-bit clocks are scalings of each other, and Time() is the low 32
+  // bits of TimeMillis().
+  int64 ms = TimeMillis();
+  int64 us = TimeMicros();
+  uint64 ns = TimeNanos();
+  int64 ms_after = TimeMillis();
+  EXPECT_LE(ms, us / kNumMicrosecsPerMillisec);
+  EXPECT_LE(us, static_cast<int64>(ns / kNumNanosecsPerMicrosec));
+  EXPECT_LE(static_cast<int64>(ns / kNumNanosecsPerMillisec), ms_after);
+  uint32 ts = Time();
+  EXPECT_LE(TimeDiff(ts, static_cast<uint32>(ms_after)), 1000);
+  EXPECT_GE(TimeDiff(ts, static_cast<uint32>(ms_after)), 0);
+
+  // And they see sub-millisecond intervals.
+  int64 start = TimeMicros();
+  int64 now;
+  while ((now = TimeMicros()) == start) {}
+  EXPECT_LT(now - start, kNumMicrosecsPerMillisec);
+}
+
+TEST(TimeTest, TscClock) {
+  if (!EnableTscClock(true)) {
+    LOG(LS_INFO) << "No invariant TSC, skipping";
+    return;
+  }
+  // The calibrated TSC clock should track the OS clock, to within a small
+  // calibration error (0.1%) below and the scheduling noise of a sleeping
+  // thread above. The TSC interval brackets the OS one.
+  int64 tsc_start = TimeMicros();
+  EnableTscClock(false);
+  int64 os_start = TimeMicros();
+  Thread::SleepMs(100);
+  int64 os_elapsed = TimeMicros() - os_start;
+  EnableTscClock(true);
+  int64 tsc_elapsed = TimeMicros() - tsc_start;
+  EnableTscClock(false);
+  EXPECT_GE(tsc_elapsed, os_elapsed - os_elapsed / 1000);
+  EXPECT_LT(tsc_elapsed, os_elapsed + 20 * kNumMicrosecsPerMillisec);
+}
+
+TEST(TimeTest, SimulatedClock) {
+  SimulatedClock clock(5 * kNumNanosecsPerSec);
+  ClockInterface* prev = SetClock(&clock);
+  EXPECT_EQ(5000, TimeMillis());
+  EXPECT_EQ(5000u, Time());
+  EXPECT_EQ(1000, TimeUntil(TimeAfter(1000)));
+
+  // Time stands still until the clock is moved.
+  clock.AdvanceTime(1500 * kNumNanosecsPerMicrosec);
+  EXPECT_EQ(5001500, TimeMicros());
+  clock.SetTime(7 * kNumNanosecsPerSec);
+  EXPECT_EQ(7000u, Time());
+
+  EXPECT_EQ(&clock, SetClock(prev));
+  EXPECT_NE(7000u, Time());
+}
+
+// Test the cost of reading each of the clocks.
+TEST(TimeTest, DISABLED_Perf) {
+  const int kIterations = 1000000;
+  uint64 sum = 0;
+  for (int tsc = 0; tsc < 2; ++tsc) {
+    if (tsc && !EnableTscClock(true)) {
+      break;
+    }
+    uint64 start = TimeNanos();
+    for (int i = 0; i < kIterations; ++i) {
+      sum += TimeNanos();
+    }
+    uint64 nanos_ns = TimeNanos() - start;
+    start = TimeNanos();
+    for (int i = 0; i < kIterations; ++i) {
+      sum += Time();
+    }
+    uint64 time_ns = TimeNanos() - start;
+    LOG(LS_INFO) << (tsc ? "TSC" : "OS") << " clock: TimeNanos "
+                 << nanos_ns / kIterations << " ns, Time "
+                 << time_ns / kIterations << " ns per call";
+  }
+  EnableTscClock(false);
+  EXPECT_NE(0U, sum);
+}
+
 } // namespace talk_base
@@ -70,6 +70,7 @@ enum {
   MSG_ID_PACKET,
   MSG_ID_CONNECT,
   MSG_ID_DISCONNECT,
+  MSG_ID_CONNECT_ARRIVED,
 };
 
 // Packets are passed between sockets as messages.  We copy the data just like
@@ -402,11 +403,27 @@ class VirtualSocket : public AsyncSocket, public MessageHandler {
         }
       } else if ((SOCK_STREAM == type_) && (CS_CONNECTING == state_)) {
         CompleteConnect(data->addr, true);
+      } else if ((SOCK_STREAM == type_) && (CS_CONNECTED == state_) &&
+                 (data->addr == remote_addr_)) {
+        // Our peer's request crossed ours in flight, and we're already
+        // connected to it (simultaneous open).
       } else {
         LOG(LS_VERBOSE) << "Socket at " << local_addr_ << " is not listening";
         server_->Disconnect(server_->LookupBinding(data->addr));
       }
       delete data;
+    } else if (pmsg->message_id == MSG_ID_CONNECT_ARRIVED) {
+      // Our connection request has crossed the network; hand it to whoever
+      // is bound at the far end now.  If the peer's request reached us first,
+      // we're already connected, but the peer is still waiting for ours.
+      ASSERT(NULL != pmsg->pdata);
+      MessageAddress* data = static_cast<MessageAddress*>(pmsg->pdata);
+      bool crossed = (CS_CONNECTED == state_) && (data->addr == remote_addr_);
+      if ((CS_CONNECTING == state_ || crossed) &&
+          (server_->Connect(this, data->addr, false) != 0)) {
+        server_->msg_queue_->Post(this, MSG_ID_DISCONNECT);
+      }
+      delete data;
     } else if (pmsg->message_id == MSG_ID_DISCONNECT) {
       ASSERT(SOCK_STREAM == type_);
       if (CS_CLOSED != state_) {
@@ -560,7 +577,8 @@ VirtualSocketServer::VirtualSocketServer(SocketServer* ss)
       send_buffer_capacity_(kDefaultTcpBufferSize),
       recv_buffer_capacity_(kDefaultTcpBufferSize),
       delay_mean_(0), delay_stddev_(0), delay_samples_(NUM_SAMPLES),
-      delay_dist_(NULL), drop_prob_(0.0) {
+      delay_dist_(NULL), drop_prob_(0.0), links_(new LinkMap()),
+      prev_clock_(NULL) {
   if (!server_) {
     server_ = new PhysicalSocketServer();
     server_owned_ = true;
@@ -572,9 +590,30 @@ VirtualSocketServer::~VirtualSocketServer() {
   delete bindings_;
   delete connections_;
   delete delay_dist_;
+  ClearLinkModels();
+  delete links_;
   if (server_owned_) {
     delete server_;
   }
+  if (clock_) {
+    int64 simulated_now = TimeMillis();
+    SetClock(prev_clock_);
+    // Simulated time runs ahead of the real clock, so move the messages
+    // still waiting in our queue back by the same amount; they then fire
+    // after the delays they were posted with, not the time skipped.
+    if (msg_queue_) {
+      msg_queue_->ShiftDelayedMessages(TimeMillis() - simulated_now);
+    }
+  }
+}
+
+void VirtualSocketServer::EnableSimulatedTime() {
+  if (clock_) {
+    return;
+  }
+  // Start from the current time, so timestamps taken so far stay in the past.
+  clock_.reset(new SimulatedClock(TimeNanos()));
+  prev_clock_ = SetClock(clock_.get());
 }
 
 IPAddress VirtualSocketServer::GetNextIP(int family) {
@@ -635,6 +674,23 @@ bool VirtualSocketServer::Wait(int cmsWait, bool process_io) {
   if (stop_on_idle_ && Thread::Current()->empty()) {
     return false;
   }
+  if (clock_ && cmsWait != kForever) {
+    // Everything on this network happens through the message queue, which
+    // asks us to wait no longer than its next delayed message, so nothing
+    // can change before then.  Still poll the real server, so that wakeups
+    // and real sockets are serviced, then move time forward instead of
+    // sleeping.  Something the poll let in, like a message posted from
+    // another thread, may be due sooner; don't move past it.
+    if (!socketserver()->Wait(0, process_io)) {
+      return false;
+    }
+    int delay = msg_queue_->GetDelay();
+    if (delay != kForever && delay < cmsWait) {
+      cmsWait = delay;
+    }
+    clock_->AdvanceTime(cmsWait * kNumNanosecsPerMillisec);
+    return true;
+  }
   return socketserver()->Wait(cmsWait, process_io);
 }
 
@@ -753,6 +809,14 @@ int VirtualSocketServer::Connect(VirtualSocket* socket,
                                  bool use_delay) {
   uint32 delay = use_delay ? GetRandomTransitDelay() : 0;
   VirtualSocket* remote = LookupBinding(remote_addr);
+  if (delay > 0 && (remote == NULL || CanInteractWith(socket, remote))) {
+    // Like a SYN, the request finds its peer when it arrives rather than when
+    // it's sent, so that two requests crossing in flight meet, as in a TCP
+    // simultaneous open.
+    msg_queue_->PostDelayed(delay, socket, MSG_ID_CONNECT_ARRIVED,
+                            new MessageAddress(remote_addr));
+    return 0;
+  }
   if (!CanInteractWith(socket, remote)) {
     LOG(LS_INFO) << "Address family mismatch between "
                  << socket->GetLocalAddress() << " and " << remote_addr;
@@ -778,6 +842,74 @@ bool VirtualSocketServer::Disconnect(VirtualSocket* socket) {
   return false;
 }
 
+void VirtualSocketServer::SetLinkModel(const SocketAddress& from,
+                                       const SocketAddress& to,
+                                       const LinkModel& model) {
+  EmulatedLink*& link = (*links_)[SocketAddressPair(from, to)];
+  delete link;
+  link = new EmulatedLink(model);
+}
+
+void VirtualSocketServer::SetLinkScenario(const SocketAddress& client,
+                                          const SocketAddress& server,
+                                          LinkScenario scenario) {
+  LinkModel uplink, downlink;
+  GetLinkScenario(scenario, &uplink, &downlink);
+  SetLinkModel(client, server, uplink);
+  SetLinkModel(server, client, downlink);
+}
+
+void VirtualSocketServer::ClearLinkModel(const SocketAddress& from,
+                                         const SocketAddress& to) {
+  LinkMap::iterator it = links_->find(SocketAddressPair(from, to));
+  if (it != links_->end()) {
+    delete it->second;
+    links_->erase(it);
+  }
+}
+
+void VirtualSocketServer::ClearLinkModels() {
+  for (LinkMap::iterator it = links_->begin(); it != links_->end(); ++it) {
+    delete it->second;
+  }
+  links_->clear();
+}
+
+bool VirtualSocketServer::GetLinkStats(const SocketAddress& from,
+                                       const SocketAddress& to,
+                                       LinkStats* stats) const {
+  LinkMap::const_iterator it = links_->find(SocketAddressPair(from, to));
+  if (it == links_->end()) {
+    return false;
+  }
+  *stats = it->second->stats();
+  return true;
+}
+
+EmulatedLink* VirtualSocketServer::LookupLink(const SocketAddress& from,
+                                              const SocketAddress& to) const {
+  if (links_->empty()) {
+    return NULL;
+  }
+  // Try the exact pair first, then with the destination port, the source
+  // port and finally both ports wildcarded.
+  const SocketAddress from_any(from.ipaddr(), 0);
+  const SocketAddress to_any(to.ipaddr(), 0);
+  const SocketAddressPair keys[] = {
+    SocketAddressPair(from, to),
+    SocketAddressPair(from, to_any),
+    SocketAddressPair(from_any, to),
+    SocketAddressPair(from_any, to_any),
+  };
+  for (int i = 0; i < ARRAY_SIZE(keys); ++i) {
+    LinkMap::const_iterator it = links_->find(keys[i]);
+    if (it != links_->end()) {
+      return it->second;
+    }
+  }
+  return NULL;
+}
+
 int VirtualSocketServer::SendUdp(VirtualSocket* socket,
                                  const char* data, size_t data_size,
                                  const SocketAddress& remote_addr) {
@@ -810,6 +942,13 @@ int VirtualSocketServer::SendUdp(VirtualSocket* socket,
 
   CritScope cs(&socket->crit_);
 
+  EmulatedLink* link = LookupLink(socket->local_addr_, recipient->local_addr_);
+  if (link) {
+    AddPacketToLink(link, socket, recipient, data, data_size, UDP_HEADER_SIZE,
+                    false);
+    return static_cast<int>(data_size);
+  }
+
   uint32 cur_time = Time();
   PurgeNetworkPackets(socket, cur_time);
 
@@ -850,6 +989,7 @@ void VirtualSocketServer::SendTcp(VirtualSocket* socket) {
 
   CritScope cs(&socket->crit_);
 
+  EmulatedLink* link = LookupLink(socket->local_addr_, socket->remote_addr_);
   uint32 cur_time = Time();
   PurgeNetworkPackets(socket, cur_time);
 
@@ -860,8 +1000,13 @@ void VirtualSocketServer::SendTcp(VirtualSocket* socket) {
     if (0 == data_size)
       break;
 
-    AddPacketToNetwork(socket, recipient, cur_time, &socket->send_buffer_[0],
-                       data_size, TCP_HEADER_SIZE, true);
+    if (link) {
+      AddPacketToLink(link, socket, recipient, &socket->send_buffer_[0],
+                      data_size, TCP_HEADER_SIZE, true);
+    } else {
+      AddPacketToNetwork(socket, recipient, cur_time, &socket->send_buffer_[0],
+                         data_size, TCP_HEADER_SIZE, true);
+    }
     recipient->recv_buffer_size_ += data_size;
 
     size_t new_buffer_size = socket->send_buffer_.size() - data_size;
@@ -913,6 +1058,28 @@ void VirtualSocketServer::AddPacketToNetwork(VirtualSocket* sender,
   network_delay_ = TimeMax(ts, network_delay_);
 }
 
+bool VirtualSocketServer::AddPacketToLink(EmulatedLink* link,
+                                          VirtualSocket* sender,
+                                          VirtualSocket* recipient,
+                                          const char* data,
+                                          size_t data_size,
+                                          size_t header_size,
+                                          bool ordered) {
+  int64 now = TimeMicros();
+  int64 arrival = link->Transmit(now, data_size + header_size, ordered);
+  if (arrival < 0) {
+    LOG(LS_VERBOSE) << "Dropping packet: link model";
+    return false;
+  }
+  // Round up to the message queue's resolution.  PostAt() is exact, so
+  // packets leave the link in the order it gave them.
+  int64 ms = (arrival + kNumMicrosecsPerMillisec - 1) /
+      kNumMicrosecsPerMillisec;
+  Packet* p = new Packet(data, data_size, sender->local_addr_);
+  msg_queue_->PostAt(static_cast<uint32>(ms), recipient, MSG_ID_PACKET, p);
+  return true;
+}
+
 void VirtualSocketServer::PurgeNetworkPackets(VirtualSocket* socket,
                                               uint32 cur_time) {
   while (!socket->network_.empty() &&
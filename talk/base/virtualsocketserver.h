@@ -32,8 +32,11 @@
 #include <deque>
 #include <map>
 
+#include "talk/base/linkmodel.h"
 #include "talk/base/messagequeue.h"
+#include "talk/base/scoped_ptr.h"
 #include "talk/base/socketserver.h"
+#include "talk/base/timeutils.h"
 
 namespace talk_base {
 
@@ -103,6 +106,36 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
     drop_prob_ = drop_prob;
   }
 
+  // Gives packets from |from| to |to| their own network model, instead of
+  // the server-wide bandwidth, capacity, delay and drop settings above.  A
+  // port of 0 in either address matches every port on that IP.  An exact
+  // match takes precedence, then a wildcard destination port, then a
+  // wildcard source port, then both.  Links are one-way, so asymmetric
+  // paths take two calls.  TCP segments are rate limited and delayed but
+  // never dropped or reordered, since VirtualSocket doesn't retransmit.
+  void SetLinkModel(const SocketAddress& from, const SocketAddress& to,
+                    const LinkModel& model);
+  // Sets up both directions between |client| and |server| from the scenario
+  // library; see linkmodel.h.
+  void SetLinkScenario(const SocketAddress& client,
+                       const SocketAddress& server, LinkScenario scenario);
+  void ClearLinkModel(const SocketAddress& from, const SocketAddress& to);
+  void ClearLinkModels();
+  // Returns false if there is no link from |from| to |to|.
+  bool GetLinkStats(const SocketAddress& from, const SocketAddress& to,
+                    LinkStats* stats) const;
+
+  // Switches the whole process to simulated time: TimeNanos() and everything
+  // based on it, including MessageQueue delays and this network's transit
+  // and bandwidth delays, follow a SimulatedClock which jumps straight to the
+  // next due message instead of waiting for it.  A timed wait in this
+  // server's thread returns at once; other threads still sleep in real time,
+  // so this is only useful for single-threaded simulations.  The previous
+  // clock is restored when the server is destroyed, and the delayed messages
+  // still queued on its thread are rebased onto it.
+  void EnableSimulatedTime();
+  bool simulated_time() const { return clock_.get() != NULL; }
+
   // SocketFactory:
   virtual Socket* CreateSocket(int type);
   virtual Socket* CreateSocket(int family, int type);
@@ -170,6 +203,15 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
   // Moves as much data as possible from the sender's buffer to the network
   void SendTcp(VirtualSocket* socket);
 
+  // Finds the link model for packets from |from| to |to|, if there is one.
+  EmulatedLink* LookupLink(const SocketAddress& from,
+                           const SocketAddress& to) const;
+
+  // Places a packet on the given link.  Returns false if the link dropped it.
+  bool AddPacketToLink(EmulatedLink* link, VirtualSocket* sender,
+                       VirtualSocket* recipient, const char* data,
+                       size_t data_size, size_t header_size, bool ordered);
+
   // Places a packet on the network.
   void AddPacketToNetwork(VirtualSocket* socket, VirtualSocket* recipient,
                           uint32 cur_time, const char* data, size_t data_size,
@@ -219,6 +261,7 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
 
   typedef std::map<SocketAddress, VirtualSocket*> AddressMap;
   typedef std::map<SocketAddressPair, VirtualSocket*> ConnectionMap;
+  typedef std::map<SocketAddressPair, EmulatedLink*> LinkMap;
 
   SocketServer* server_;
   bool server_owned_;
@@ -242,6 +285,10 @@ class VirtualSocketServer : public SocketServer, public sigslot::has_slots<> {
   CriticalSection delay_crit_;
 
   double drop_prob_;
+  LinkMap* links_;
+
+  scoped_ptr<SimulatedClock> clock_;
+  ClockInterface* prev_clock_;
   DISALLOW_EVIL_CONSTRUCTORS(VirtualSocketServer);
 };
 
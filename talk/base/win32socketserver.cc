@@ -620,6 +620,9 @@ int Win32Socket::TranslateOption(Option opt, int* slevel, int* sopt) {
       *slevel = IPPROTO_TCP;
       *sopt = TCP_NODELAY;
       break;
+    case OPT_PACING_RATE:
+      LOG(LS_WARNING) << "Socket::OPT_PACING_RATE not supported.";
+      return -1;
     default:
       ASSERT(false);
       return -1;
@@ -0,0 +1,114 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/windowedratetracker.h"
+
+#include <string.h>
+
+#include "talk/base/common.h"
+#include "talk/base/timeutils.h"
+
+namespace talk_base {
+
+const int WindowedRateTracker::kDefaultBucketMs;
+const int WindowedRateTracker::kDefaultBucketCount;
+const int WindowedRateTracker::kMaxBucketCount;
+
+WindowedRateTracker::WindowedRateTracker()
+    : bucket_ms_(kDefaultBucketMs), bucket_count_(kDefaultBucketCount) {
+  memset(buckets_.BeginWrite(), 0, sizeof(Buckets));
+  buckets_.EndWrite();
+}
+
+WindowedRateTracker::WindowedRateTracker(int bucket_ms, int bucket_count)
+    : bucket_ms_(bucket_ms), bucket_count_(bucket_count) {
+  ASSERT(bucket_ms > 0);
+  ASSERT(bucket_count > 0 && bucket_count <= kMaxBucketCount);
+  memset(buckets_.BeginWrite(), 0, sizeof(Buckets));
+  buckets_.EndWrite();
+}
+
+size_t WindowedRateTracker::total_units() const {
+  return buckets_.Read().total_units;
+}
+
+size_t WindowedRateTracker::units_second() const {
+  Buckets buckets = buckets_.Read();
+  if (buckets.total_units == 0) {
+    return 0;
+  }
+  uint32 now = Time();
+  Advance(&buckets, now);
+
+  // The window is the part of the current bucket that has gone by plus the
+  // full buckets before it, but no more than we have been counting for.  It
+  // is never taken as shorter than one bucket, so that a burst right at the
+  // start doesn't read as an enormous rate.
+  int window = (bucket_count_ - 1) * bucket_ms_ +
+      TimeDiff(now, buckets.bucket_time);
+  window = _min(window, TimeDiff(now, buckets.first_time));
+  window = _max(window, bucket_ms_);
+
+  size_t units = 0;
+  for (int i = 0; i < bucket_count_; ++i) {
+    units += buckets.units[i];
+  }
+  return static_cast<size_t>(static_cast<uint64>(units) * 1000 / window);
+}
+
+void WindowedRateTracker::Update(size_t units) {
+  uint32 now = Time();
+  Buckets* buckets = buckets_.BeginWrite();
+  if (buckets->total_units == 0) {
+    buckets->first_time = now;
+    buckets->bucket_time = now;
+  }
+  Advance(buckets, now);
+  buckets->units[buckets->current] += units;
+  buckets->total_units += units;
+  buckets_.EndWrite();
+}
+
+void WindowedRateTracker::Advance(Buckets* buckets, uint32 now) const {
+  int elapsed = TimeDiff(now, buckets->bucket_time);
+  if (elapsed < bucket_ms_) {
+    return;
+  }
+  int steps = elapsed / bucket_ms_;
+  for (int i = 0; i < _min(steps, bucket_count_); ++i) {
+    buckets->current = (buckets->current + 1) % bucket_count_;
+    buckets->units[buckets->current] = 0;
+  }
+  buckets->bucket_time += steps * bucket_ms_;
+}
+
+uint32 WindowedRateTracker::Time() const {
+  return talk_base::Time();
+}
+
+}  // namespace talk_base
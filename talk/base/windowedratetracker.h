@@ -0,0 +1,82 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_BASE_WINDOWEDRATETRACKER_H_
+#define TALK_BASE_WINDOWEDRATETRACKER_H_
+
+#include <stdlib.h>
+#include "talk/base/basictypes.h"
+#include "talk/base/seqlock.h"
+
+namespace talk_base {
+
+// Computes units per second over a sliding window made of fixed-size
+// buckets, so that units_second() always reflects the last window rather
+// than whichever whole second happened to be sampled last, as RateTracker
+// does.  Update() must always be called from the same thread, typically the
+// one the packets are handled on; total_units() and units_second() may be
+// called from any thread and never block it.
+class WindowedRateTracker {
+ public:
+  static const int kDefaultBucketMs = 100;
+  static const int kDefaultBucketCount = 10;
+  static const int kMaxBucketCount = 32;
+
+  WindowedRateTracker();
+  WindowedRateTracker(int bucket_ms, int bucket_count);
+  virtual ~WindowedRateTracker() {}
+
+  size_t total_units() const;
+  size_t units_second() const;
+  void Update(size_t units);
+
+ protected:
+  // overrideable for tests
+  virtual uint32 Time() const;
+
+ private:
+  struct Buckets {
+    size_t total_units;
+    uint32 first_time;    // When the first units were counted.
+    uint32 bucket_time;   // When the current bucket began.
+    int current;          // Index of the current bucket.
+    size_t units[kMaxBucketCount];
+  };
+
+  // Moves |buckets| forward to |now|, emptying the buckets that fall out of
+  // the window on the way.
+  void Advance(Buckets* buckets, uint32 now) const;
+
+  const int bucket_ms_;
+  const int bucket_count_;
+  SeqLock<Buckets> buckets_;
+};
+
+}  // namespace talk_base
+
+#endif  // TALK_BASE_WINDOWEDRATETRACKER_H_
@@ -0,0 +1,149 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/gunit.h"
+#include "talk/base/thread.h"
+#include "talk/base/windowedratetracker.h"
+
+namespace talk_base {
+
+class WindowedRateTrackerForTest : public WindowedRateTracker {
+ public:
+  WindowedRateTrackerForTest() : time_(0) {}
+  WindowedRateTrackerForTest(int bucket_ms, int bucket_count)
+      : WindowedRateTracker(bucket_ms, bucket_count), time_(0) {}
+  virtual uint32 Time() const { return time_; }
+  void AdvanceTime(uint32 delta) { time_ += delta; }
+
+ private:
+  uint32 time_;
+};
+
+TEST(WindowedRateTrackerTest, TestBasics) {
+  WindowedRateTrackerForTest tracker;
+  EXPECT_EQ(0U, tracker.total_units());
+  EXPECT_EQ(0U, tracker.units_second());
+
+  // 1000 units every 100 ms for a second is 10000 units per second, and
+  // the rate is available as soon as the units are, not a second later.
+  for (int i = 0; i < 10; ++i) {
+    tracker.Update(1000);
+    tracker.AdvanceTime(100);
+    EXPECT_EQ(10000U, tracker.units_second());
+  }
+  EXPECT_EQ(10000U, tracker.total_units());
+
+  // Keep going at half the rate; after a full window the rate has halved.
+  for (int i = 0; i < 10; ++i) {
+    tracker.Update(500);
+    tracker.AdvanceTime(100);
+  }
+  EXPECT_EQ(5000U, tracker.units_second());
+  EXPECT_EQ(15000U, tracker.total_units());
+
+  // The window is the nine buckets before the current one plus as much of
+  // the current one as has gone by, so half a second later four buckets of
+  // 500 are left in it.
+  tracker.AdvanceTime(500);
+  EXPECT_EQ(2000U * 1000 / 900, tracker.units_second());
+
+  // Go quiet for longer than the window.
+  tracker.AdvanceTime(5000);
+  EXPECT_EQ(0U, tracker.units_second());
+  EXPECT_EQ(15000U, tracker.total_units());
+
+  // And start again.
+  tracker.Update(100);
+  tracker.AdvanceTime(150);
+  EXPECT_EQ(100U * 1000 / 950, tracker.units_second());
+}
+
+// The rate is taken over the time since the first units, once that is
+// longer than a bucket, rather than over the whole window.
+TEST(WindowedRateTrackerTest, TestStartup) {
+  WindowedRateTrackerForTest tracker;
+  tracker.AdvanceTime(12345);
+  tracker.Update(100);
+  EXPECT_EQ(1000U, tracker.units_second());
+  tracker.AdvanceTime(200);
+  EXPECT_EQ(500U, tracker.units_second());
+}
+
+TEST(WindowedRateTrackerTest, TestSmallWindow) {
+  WindowedRateTrackerForTest tracker(10, 5);
+  for (int i = 0; i < 100; ++i) {
+    tracker.Update(10);
+    tracker.AdvanceTime(10);
+  }
+  EXPECT_EQ(1000U, tracker.units_second());
+  tracker.AdvanceTime(50);
+  EXPECT_EQ(0U, tracker.units_second());
+}
+
+// Readers on another thread see the totals go up without ever blocking the
+// writer.
+class RateReader : public Thread {
+ public:
+  RateReader(const WindowedRateTracker* tracker, size_t total)
+      : tracker_(tracker), total_(total), backward_reads_(0) {}
+  virtual ~RateReader() { Stop(); }
+
+  virtual void Run() {
+    size_t last = 0;
+    while (last < total_) {
+      size_t current = tracker_->total_units();
+      tracker_->units_second();
+      if (current < last) {
+        ++backward_reads_;
+      }
+      last = current;
+    }
+  }
+
+  int backward_reads() const { return backward_reads_; }
+
+ private:
+  const WindowedRateTracker* tracker_;
+  size_t total_;
+  int backward_reads_;
+};
+
+TEST(WindowedRateTrackerTest, TestConcurrentReaders) {
+  static const size_t kUpdates = 1000000;
+  WindowedRateTracker tracker;
+  RateReader reader(&tracker, kUpdates);
+  reader.Start();
+  for (size_t i = 0; i < kUpdates; ++i) {
+    tracker.Update(1);
+  }
+  reader.Stop();
+  EXPECT_EQ(kUpdates, tracker.total_units());
+  EXPECT_EQ(0, reader.backward_reads());
+}
+
+}  // namespace talk_base
@@ -0,0 +1,667 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// A headless load client for the call stack. Where CallClient runs a single
+// interactive call per process, this runs many calls at once in one process.
+// Every call is placed between a caller and a callee endpoint, and each
+// endpoint has its own SessionManager and MediaSessionClient (and so its own
+// ChannelManager) set up the way CallClient sets them up. The difference is
+// that the Jingle stanzas CallClient would send over XMPP are routed
+// in-process, the transports run over a single local address, and all the
+// ChannelManagers share a small pool of worker threads instead of starting
+// one each.
+//
+// Calls are started at a fixed rate and hung up after a fixed duration. At
+// the end the client reports call setup time percentiles, the rate of media
+// packets received, and the CPU time spent per call. Media comes from a
+// FileMediaEngine, so give it RTP dumps with --voiceinput/--videoinput to
+// have the calls carry packets.
+
+#include <stdio.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "talk/base/basicpacketsocketfactory.h"
+#include "talk/base/common.h"
+#include "talk/base/fakenetwork.h"
+#include "talk/base/flags.h"
+#include "talk/base/logging.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/stringencode.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+#include "talk/examples/call/mediaenginefactory.h"
+#include "talk/media/base/rtpdataengine.h"
+#include "talk/media/devices/fakedevicemanager.h"
+#include "talk/p2p/base/constants.h"
+#include "talk/p2p/base/sessionmanager.h"
+#include "talk/p2p/base/transportchannel.h"
+#include "talk/p2p/client/basicportallocator.h"
+#include "talk/session/media/call.h"
+#include "talk/session/media/mediasessionclient.h"
+#include "talk/xmllite/xmlelement.h"
+#include "talk/xmpp/constants.h"
+
+DEFINE_bool(help, false, "Prints this message");
+DEFINE_int(calls, 100, "The total number of calls to place.");
+DEFINE_int(concurrent, 100, "The maximum number of calls up at once.");
+DEFINE_int(rate, 10, "The number of calls to start per second.");
+DEFINE_int(duration, 10, "The number of seconds each call stays up.");
+DEFINE_int(workers, 4, "The number of worker threads shared by all the "
+           "ChannelManagers.");
+DEFINE_bool(video, false, "Place video calls.");
+DEFINE_string(ip, "127.0.0.1", "The local address the transports use.");
+DEFINE_string(voiceinput, NULL, "RTP dump file every endpoint sends as "
+              "voice.");
+DEFINE_string(videoinput, NULL, "RTP dump file every endpoint sends as "
+              "video.");
+DEFINE_int(timeout, 600, "Give up after this many seconds.");
+DEFINE_bool(d, false, "Turn on debugging.");
+
+static const char kDomain[] = "load.test";
+
+// FileMediaEngine creates no channels without a dump to read or write, so
+// received media goes here when nothing is being sent.
+#ifdef WIN32
+static const char kNullDevice[] = "NUL";
+#else
+static const char kNullDevice[] = "/dev/null";
+#endif
+
+// How often the main loop checks whether more calls are due.
+static const int kTickMs = 10;
+
+// Returns the CPU time used by the whole process so far.
+static int64 CpuMicros() {
+#ifdef WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    return 0;
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  // FILETIMEs are in 100 ns units.
+  return static_cast<int64>((k.QuadPart + u.QuadPart) / 10);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return static_cast<int64>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+      talk_base::kNumMicrosecsPerSec +
+      usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+// Prints the percentiles of a set of durations given in microseconds.
+static void PrintPercentiles(const char* label, std::vector<int64> values) {
+  if (values.empty()) {
+    printf("%s: none\n", label);
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  printf("%s: %d, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+         label, static_cast<int>(n),
+         values[(n - 1) * 50 / 100] / 1000.0,
+         values[(n - 1) * 90 / 100] / 1000.0,
+         values[(n - 1) * 99 / 100] / 1000.0,
+         values[n - 1] / 1000.0);
+}
+
+// Everything one worker thread needs to host transports. The network manager
+// delivers its updates on the thread that created it and the port allocator
+// sessions run on the worker thread, so both are created on the worker.
+class LoadWorker : public talk_base::MessageHandler {
+ public:
+  explicit LoadWorker(const talk_base::IPAddress& ip) : ip_(ip) {
+    thread_.Start();
+    thread_.Send(this, MSG_INIT);
+  }
+
+  ~LoadWorker() {
+    thread_.Send(this, MSG_TERMINATE);
+    thread_.Stop();
+  }
+
+  talk_base::Thread* thread() { return &thread_; }
+  cricket::PortAllocator* allocator() { return allocator_.get(); }
+
+ private:
+  enum { MSG_INIT, MSG_TERMINATE };
+
+  virtual void OnMessage(talk_base::Message* msg) {
+    if (msg->message_id == MSG_INIT) {
+      network_manager_.reset(new talk_base::FakeNetworkManager());
+      network_manager_->AddInterface(talk_base::SocketAddress(ip_, 0));
+      socket_factory_.reset(new talk_base::BasicPacketSocketFactory(&thread_));
+      // Everything is local, so host candidates are all we need.
+      allocator_.reset(new cricket::BasicPortAllocator(
+          network_manager_.get(), socket_factory_.get()));
+      allocator_->set_flags(cricket::PORTALLOCATOR_DISABLE_STUN |
+                            cricket::PORTALLOCATOR_DISABLE_RELAY |
+                            cricket::PORTALLOCATOR_DISABLE_TCP);
+    } else {
+      allocator_.reset();
+      socket_factory_.reset();
+      network_manager_.reset();
+    }
+  }
+
+  talk_base::IPAddress ip_;
+  talk_base::Thread thread_;
+  talk_base::scoped_ptr<talk_base::FakeNetworkManager> network_manager_;
+  talk_base::scoped_ptr<talk_base::BasicPacketSocketFactory> socket_factory_;
+  talk_base::scoped_ptr<cricket::BasicPortAllocator> allocator_;
+};
+
+// What happened to one call. The packet counters and the writable time are
+// updated on the worker threads of the two endpoints and only read once the
+// call's channels have been destroyed.
+struct LoadEndpoint;
+
+struct LoadCall : public sigslot::has_slots<> {
+  explicit LoadCall(LoadEndpoint* caller)
+      : caller(caller), endpoints(0), start_us(0), accept_us(0),
+        writable_us(0), end_us(0), caller_packets(0), callee_packets(0),
+        failed(false) {
+  }
+
+  void OnCallerWritableState(cricket::TransportChannel* channel) {
+    if (channel->writable() && !writable_us)
+      writable_us = talk_base::TimeMicros();
+  }
+  void OnCallerReadPacket(cricket::TransportChannel* channel,
+                          const char* data, size_t len, int flags) {
+    ++caller_packets;
+  }
+  void OnCalleeReadPacket(cricket::TransportChannel* channel,
+                          const char* data, size_t len, int flags) {
+    ++callee_packets;
+  }
+
+  LoadEndpoint* caller;
+  // The number of endpoints still in this call.
+  int endpoints;
+  int64 start_us;
+  int64 accept_us;
+  int64 writable_us;
+  int64 end_us;
+  int64 caller_packets;
+  int64 callee_packets;
+  bool failed;
+};
+
+// One side of a call: what CallClient::InitMedia() sets up, minus XMPP.
+struct LoadEndpoint {
+  LoadEndpoint(const std::string& name, LoadWorker* worker)
+      : jid(name + "@" + kDomain + "/load"),
+        worker(worker),
+        session_manager(worker->allocator(), worker->thread()),
+        media_client(jid, &session_manager,
+                     MediaEngineFactory::CreateFileMediaEngine(
+                         FLAG_voiceinput, FLAG_voiceinput ? NULL : kNullDevice,
+                         FLAG_videoinput, FLAG_videoinput ? NULL : kNullDevice),
+                     new cricket::RtpDataEngine(),
+                     new cricket::FakeDeviceManager()),
+        call(NULL),
+        load_call(NULL) {
+  }
+
+  buzz::Jid jid;
+  LoadWorker* worker;
+  cricket::SessionManager session_manager;
+  cricket::MediaSessionClient media_client;
+  // The call this endpoint is in, if any.
+  cricket::Call* call;
+  LoadCall* load_call;
+};
+
+class LoadClient : public talk_base::MessageHandler,
+                   public sigslot::has_slots<> {
+ public:
+  LoadClient()
+      : started_(0), active_(0), start_us_(0), end_us_(0), start_cpu_us_(0),
+        end_cpu_us_(0), next_id_(0) {
+    talk_base::IPAddress ip;
+    if (!talk_base::IPFromString(FLAG_ip, &ip)) {
+      LOG(LS_WARNING) << "Bad --ip " << FLAG_ip << ", using 127.0.0.1";
+      ip = talk_base::IPAddress(INADDR_LOOPBACK);
+    }
+    for (int i = 0; i < FLAG_workers; ++i)
+      workers_.push_back(new LoadWorker(ip));
+    for (int i = 0; i < FLAG_concurrent; ++i) {
+      LoadEndpoint* caller = AddEndpoint(
+          "caller" + talk_base::ToString(i), workers_[(2 * i) % FLAG_workers]);
+      LoadEndpoint* callee = AddEndpoint(
+          "callee" + talk_base::ToString(i),
+          workers_[(2 * i + 1) % FLAG_workers]);
+      pairs_.push_back(std::make_pair(caller, callee));
+    }
+  }
+
+  ~LoadClient() {
+    // The endpoints must go before the workers whose threads they use.
+    for (size_t i = 0; i < endpoints_.size(); ++i)
+      delete endpoints_[i];
+    for (size_t i = 0; i < workers_.size(); ++i)
+      delete workers_[i];
+    for (size_t i = 0; i < calls_.size(); ++i)
+      delete calls_[i];
+    for (PendingMap::iterator it = pending_.begin(); it != pending_.end(); ++it)
+      delete it->second;
+  }
+
+  // Places all the calls and waits for them to end. Returns false on timeout.
+  bool Run(int timeout_secs) {
+    start_us_ = talk_base::TimeMicros();
+    start_cpu_us_ = CpuMicros();
+    talk_base::Thread* thread = talk_base::Thread::Current();
+    thread->Post(this, MSG_TICK);
+    uint32 deadline = talk_base::TimeAfter(timeout_secs * 1000);
+    while (started_ < FLAG_calls || active_ > 0) {
+      int remaining = talk_base::TimeUntil(deadline);
+      if (remaining <= 0)
+        break;
+      thread->ProcessMessages(std::min(remaining, 1000));
+    }
+    end_us_ = talk_base::TimeMicros();
+    end_cpu_us_ = CpuMicros();
+    thread->Clear(this);
+    return started_ == FLAG_calls && active_ == 0;
+  }
+
+  void Print() const {
+    std::vector<int64> accept_times, writable_times;
+    int failed = 0;
+    int64 packets = 0;
+    int64 call_us = 0;
+    for (size_t i = 0; i < calls_.size(); ++i) {
+      const LoadCall* call = calls_[i];
+      if (call->failed || !call->accept_us) {
+        ++failed;
+        continue;
+      }
+      accept_times.push_back(call->accept_us - call->start_us);
+      if (call->writable_us)
+        writable_times.push_back(call->writable_us - call->start_us);
+      packets += call->caller_packets + call->callee_packets;
+      call_us += (call->end_us ? call->end_us : end_us_) - call->start_us;
+    }
+    double elapsed_secs = (end_us_ - start_us_) /
+        static_cast<double>(talk_base::kNumMicrosecsPerSec);
+    double call_secs = call_us /
+        static_cast<double>(talk_base::kNumMicrosecsPerSec);
+    double cpu_ms = (end_cpu_us_ - start_cpu_us_) /
+        static_cast<double>(talk_base::kNumMicrosecsPerMillisec);
+
+    printf("Calls: %d placed, %d failed, in %.1f s\n",
+           static_cast<int>(calls_.size()), failed, elapsed_secs);
+    PrintPercentiles("Setup until accepted", accept_times);
+    PrintPercentiles("Setup until writable", writable_times);
+    printf("Packets: %lld received, %.0f/s overall, %.1f/s per call\n",
+           static_cast<long long>(packets),
+           elapsed_secs > 0 ? packets / elapsed_secs : 0.0,
+           call_secs > 0 ? packets / call_secs : 0.0);
+    // A call-second of CPU is what one call costs per second it is up.
+    printf("CPU: %.0f ms total, %.2f ms per call-second (%.2f%% of a core "
+           "per call)\n",
+           cpu_ms, call_secs > 0 ? cpu_ms / call_secs : 0.0,
+           call_secs > 0 ? cpu_ms / call_secs / 10.0 : 0.0);
+  }
+
+ private:
+  enum { MSG_TICK, MSG_HANGUP, MSG_ACCEPT, MSG_SIGNAL };
+
+  typedef std::map<std::string, buzz::XmlElement*> PendingMap;
+
+  struct SignalData : public talk_base::MessageData {
+    SignalData(LoadEndpoint* to, buzz::XmlElement* stanza)
+        : to(to), stanza(stanza) {
+    }
+    LoadEndpoint* to;
+    talk_base::scoped_ptr<buzz::XmlElement> stanza;
+  };
+
+  LoadEndpoint* AddEndpoint(const std::string& name, LoadWorker* worker) {
+    LoadEndpoint* endpoint = new LoadEndpoint(name, worker);
+    endpoint->session_manager.SignalRequestSignaling.connect(
+        &endpoint->session_manager, &cricket::SessionManager::OnSignalingReady);
+    endpoint->session_manager.SignalOutgoingMessage.connect(
+        this, &LoadClient::OnOutgoingMessage);
+    endpoint->session_manager.OnSignalingReady();
+    endpoint->media_client.SignalCallCreate.connect(
+        this, &LoadClient::OnCallCreate);
+    endpoint->media_client.SignalCallDestroy.connect(
+        this, &LoadClient::OnCallDestroy);
+    endpoints_.push_back(endpoint);
+    by_manager_[&endpoint->session_manager] = endpoint;
+    by_jid_[endpoint->jid.Str()] = endpoint;
+    return endpoint;
+  }
+
+  LoadEndpoint* FindEndpoint(cricket::Call* call) {
+    std::map<cricket::Call*, LoadEndpoint*>::iterator it = by_call_.find(call);
+    return it != by_call_.end() ? it->second : NULL;
+  }
+
+  LoadEndpoint* FindEndpoint(const std::string& jid) {
+    std::map<std::string, LoadEndpoint*>::iterator it = by_jid_.find(jid);
+    return it != by_jid_.end() ? it->second : NULL;
+  }
+
+  void Join(LoadEndpoint* endpoint, cricket::Call* call, LoadCall* load_call) {
+    endpoint->call = call;
+    endpoint->load_call = load_call;
+    // Channels stay disabled, and so send nothing, until their call has
+    // the focus.
+    endpoint->media_client.SetFocus(call);
+    ++load_call->endpoints;
+    by_call_[call] = endpoint;
+  }
+
+  virtual void OnMessage(talk_base::Message* msg) {
+    switch (msg->message_id) {
+      case MSG_TICK:
+        StartDueCalls();
+        break;
+      case MSG_HANGUP: {
+        talk_base::TypedMessageData<LoadCall*>* data =
+            static_cast<talk_base::TypedMessageData<LoadCall*>*>(msg->pdata);
+        // The call may already be over, and the caller in a new one.
+        LoadEndpoint* caller = data->data()->caller;
+        if (caller->load_call == data->data())
+          caller->call->Terminate();
+        delete data;
+        break;
+      }
+      case MSG_ACCEPT: {
+        talk_base::TypedMessageData<LoadEndpoint*>* data =
+            static_cast<talk_base::TypedMessageData<LoadEndpoint*>*>(
+                msg->pdata);
+        Accept(data->data());
+        delete data;
+        break;
+      }
+      case MSG_SIGNAL: {
+        SignalData* data = static_cast<SignalData*>(msg->pdata);
+        Deliver(data->to, data->stanza.release());
+        delete data;
+        break;
+      }
+    }
+  }
+
+  // Starts as many calls as the rate says should have been started by now,
+  // as long as there are idle endpoints to place them.
+  void StartDueCalls() {
+    int64 elapsed_ms = (talk_base::TimeMicros() - start_us_) /
+        talk_base::kNumMicrosecsPerMillisec;
+    int64 due = std::min<int64>(FLAG_calls,
+        elapsed_ms * FLAG_rate / talk_base::kNumMillisecsPerSec + 1);
+    for (size_t i = 0; i < pairs_.size() && started_ < due; ++i) {
+      if (!pairs_[i].first->call && !pairs_[i].second->call)
+        StartCall(pairs_[i].first, pairs_[i].second);
+    }
+    if (started_ < FLAG_calls)
+      talk_base::Thread::Current()->PostDelayed(kTickMs, this, MSG_TICK);
+  }
+
+  void StartCall(LoadEndpoint* caller, LoadEndpoint* callee) {
+    LoadCall* load_call = new LoadCall(caller);
+    calls_.push_back(load_call);
+    ++started_;
+    ++active_;
+    load_call->start_us = talk_base::TimeMicros();
+
+    cricket::CallOptions options;
+    options.has_video = FLAG_video;
+    // Video calls gather RTCP candidates before rtcp-mux is negotiated, and
+    // a peer that has already muxed rejects the transport-info carrying
+    // them, so keep RTCP on its own channel.
+    options.rtcp_mux_enabled = !FLAG_video;
+    cricket::Call* call = caller->media_client.CreateCall();
+    Join(caller, call, load_call);
+    cricket::Session* session = call->InitiateSession(callee->jid, caller->jid,
+                                                      options);
+    if (!session) {
+      load_call->failed = true;
+      caller->media_client.DestroyCall(call);
+      return;
+    }
+    Watch(caller, session, true);
+    talk_base::Thread::Current()->PostDelayed(
+        FLAG_duration * 1000, this, MSG_HANGUP,
+        new talk_base::TypedMessageData<LoadCall*>(load_call));
+  }
+
+  // Counts the packets the endpoint receives on its RTP channels. The
+  // channels signal on the worker thread, so connect to them there.
+  void Watch(LoadEndpoint* endpoint, cricket::Session* session, bool caller) {
+    WatchData data(endpoint->load_call, session, caller);
+    endpoint->worker->thread()->Send(&watcher_, 0, &data);
+  }
+
+  struct WatchData : public talk_base::MessageData {
+    WatchData(LoadCall* call, cricket::Session* session, bool caller)
+        : call(call), session(session), caller(caller) {
+    }
+    LoadCall* call;
+    cricket::Session* session;
+    bool caller;
+  };
+
+  class Watcher : public talk_base::MessageHandler {
+    virtual void OnMessage(talk_base::Message* msg) {
+      WatchData* data = static_cast<WatchData*>(msg->pdata);
+      const char* contents[] = { cricket::CN_AUDIO, cricket::CN_VIDEO };
+      for (size_t i = 0; i < ARRAY_SIZE(contents); ++i) {
+        cricket::TransportChannel* channel = data->session->GetChannel(
+            contents[i], cricket::ICE_CANDIDATE_COMPONENT_RTP);
+        if (!channel)
+          continue;
+        if (data->caller) {
+          channel->SignalReadPacket.connect(data->call,
+                                            &LoadCall::OnCallerReadPacket);
+          // Audio is always present, so it tells us when media can flow.
+          if (i == 0) {
+            channel->SignalWritableState.connect(
+                data->call, &LoadCall::OnCallerWritableState);
+          }
+        } else {
+          channel->SignalReadPacket.connect(data->call,
+                                            &LoadCall::OnCalleeReadPacket);
+        }
+      }
+    }
+  };
+
+  // Outgoing calls are joined by StartCall() and incoming ones by
+  // OnSessionState().
+  void OnCallCreate(cricket::Call* call) {
+    call->SignalSessionState.connect(this, &LoadClient::OnSessionState);
+    call->SignalSessionError.connect(this, &LoadClient::OnSessionError);
+  }
+
+  void OnCallDestroy(cricket::Call* call) {
+    LoadEndpoint* endpoint = FindEndpoint(call);
+    if (!endpoint)
+      return;
+    by_call_.erase(call);
+    endpoint->call = NULL;
+    LoadCall* load_call = endpoint->load_call;
+    endpoint->load_call = NULL;
+    // The call is over once both sides are gone.
+    if (--load_call->endpoints == 0) {
+      load_call->end_us = talk_base::TimeMicros();
+      --active_;
+    }
+  }
+
+  void OnSessionState(cricket::Call* call, cricket::Session* session,
+                      cricket::Session::State state) {
+    if (state == cricket::Session::STATE_RECEIVEDINITIATE) {
+      LoadEndpoint* callee = FindEndpoint(session->local_name());
+      LoadEndpoint* caller = FindEndpoint(session->remote_name());
+      if (!callee || callee->call || !caller || !caller->load_call) {
+        call->RejectSession(session, true);
+        return;
+      }
+      Join(callee, call, caller->load_call);
+      // The session isn't in STATE_RECEIVEDINITIATE until this signal
+      // returns, so answer from the next turn of the loop.
+      talk_base::Thread::Current()->Post(this, MSG_ACCEPT,
+          new talk_base::TypedMessageData<LoadEndpoint*>(callee));
+    } else if (state == cricket::Session::STATE_RECEIVEDACCEPT) {
+      LoadEndpoint* caller = FindEndpoint(call);
+      if (caller && caller->load_call)
+        caller->load_call->accept_us = talk_base::TimeMicros();
+    } else if (state == cricket::Session::STATE_RECEIVEDREJECT) {
+      LoadEndpoint* caller = FindEndpoint(call);
+      if (caller && caller->load_call)
+        caller->load_call->failed = true;
+    }
+  }
+
+  void Accept(LoadEndpoint* callee) {
+    // The caller may have hung up in the meantime.
+    if (!callee->call || callee->call->sessions().empty())
+      return;
+    cricket::Session* session = callee->call->sessions()[0];
+    cricket::CallOptions options;
+    options.has_video = callee->call->has_video();
+    options.rtcp_mux_enabled = !options.has_video;
+    callee->call->AcceptSession(session, options);
+    Watch(callee, session, false);
+  }
+
+  void OnSessionError(cricket::Call* call, cricket::Session* session,
+                      cricket::Session::Error error) {
+    LOG(LS_WARNING) << "Session " << session->id() << " error " << error;
+    LoadEndpoint* endpoint = FindEndpoint(call);
+    if (endpoint && endpoint->load_call)
+      endpoint->load_call->failed = true;
+  }
+
+  // Plays the part of the XMPP server: stamps the sender, matches responses
+  // with the requests they answer, and delivers asynchronously so that a
+  // SessionManager is never reentered from its own send.
+  void OnOutgoingMessage(cricket::SessionManager* manager,
+                         const buzz::XmlElement* stanza) {
+    LoadEndpoint* from = by_manager_[manager];
+    LoadEndpoint* to = FindEndpoint(stanza->Attr(buzz::QN_TO));
+    if (!from || !to) {
+      LOG(LS_WARNING) << "Dropping stanza to " << stanza->Attr(buzz::QN_TO);
+      return;
+    }
+    buzz::XmlElement* copy = new buzz::XmlElement(*stanza);
+    copy->SetAttr(buzz::QN_FROM, from->jid.Str());
+    if (copy->Attr(buzz::QN_TYPE) == buzz::STR_SET) {
+      std::string id = talk_base::ToString(++next_id_);
+      copy->SetAttr(buzz::QN_ID, id);
+      pending_[id] = new buzz::XmlElement(*copy);
+    }
+    talk_base::Thread::Current()->Post(this, MSG_SIGNAL,
+                                       new SignalData(to, copy));
+  }
+
+  void Deliver(LoadEndpoint* to, buzz::XmlElement* stanza) {
+    talk_base::scoped_ptr<buzz::XmlElement> owned(stanza);
+    const std::string& type = stanza->Attr(buzz::QN_TYPE);
+    if (type != buzz::STR_RESULT && type != buzz::STR_ERROR) {
+      to->session_manager.OnIncomingMessage(stanza);
+      return;
+    }
+    PendingMap::iterator it = pending_.find(stanza->Attr(buzz::QN_ID));
+    if (it == pending_.end())
+      return;
+    talk_base::scoped_ptr<buzz::XmlElement> orig(it->second);
+    pending_.erase(it);
+    if (type == buzz::STR_RESULT)
+      to->session_manager.OnIncomingResponse(orig.get(), stanza);
+    else
+      to->session_manager.OnFailedSend(orig.get(), stanza);
+  }
+
+  std::vector<LoadWorker*> workers_;
+  std::vector<LoadEndpoint*> endpoints_;
+  std::vector<std::pair<LoadEndpoint*, LoadEndpoint*> > pairs_;
+  std::map<cricket::SessionManager*, LoadEndpoint*> by_manager_;
+  std::map<std::string, LoadEndpoint*> by_jid_;
+  std::map<cricket::Call*, LoadEndpoint*> by_call_;
+  std::vector<LoadCall*> calls_;
+  PendingMap pending_;
+  Watcher watcher_;
+  int started_;
+  int active_;
+  int64 start_us_;
+  int64 end_us_;
+  int64 start_cpu_us_;
+  int64 end_cpu_us_;
+  int next_id_;
+};
+
+int main(int argc, char** argv) {
+  FlagList::SetFlagsFromCommandLine(&argc, argv, true);
+  if (FLAG_help) {
+    FlagList::Print(NULL, false);
+    return 0;
+  }
+
+  if (FLAG_calls < 1 || FLAG_concurrent < 1 || FLAG_rate < 1 ||
+      FLAG_duration < 0 || FLAG_workers < 1) {
+    printf("Error: --calls, --concurrent, --rate and --workers must be "
+           "positive.\n");
+    return -1;
+  }
+
+  if (FLAG_d) {
+    talk_base::LogMessage::LogToDebug(talk_base::LS_VERBOSE);
+  } else {
+    talk_base::LogMessage::LogToDebug(talk_base::LS_WARNING);
+  }
+
+  bool completed;
+  {
+    LoadClient client;
+    completed = client.Run(FLAG_timeout);
+    client.Print();
+  }
+  return completed ? 0 : 1;
+}
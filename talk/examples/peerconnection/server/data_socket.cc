@@ -27,10 +27,17 @@
 
 #include "talk/examples/peerconnection/server/data_socket.h"
 
+#include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+
+#include <algorithm>
+
 #if defined(POSIX)
+#include <sys/resource.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -39,6 +46,15 @@
 static const char kHeaderTerminator[] = "\r\n\r\n";
 static const int kHeaderTerminatorLength = sizeof(kHeaderTerminator) - 1;
 
+// Case insensitive check for whether |str| begins with |prefix|.
+static bool StartsWithNoCase(const char* str, const char* prefix) {
+  for (; *prefix; ++str, ++prefix) {
+    if (tolower(*str) != tolower(*prefix))
+      return false;
+  }
+  return true;
+}
+
 // static
 const char DataSocket::kCrossOriginAllowHeaders[] =
     "Access-Control-Allow-Origin: *\r\n"
@@ -110,6 +126,11 @@ bool DataSocket::OnDataAvailable(bool* close_socket) {
 
   *close_socket = false;
 
+  if (response_sent_) {
+    // A new request on a kept-alive connection.
+    Clear();
+  }
+
   bool ret = true;
   if (headers_received()) {
     if (method_ != POST) {
@@ -140,18 +161,25 @@ bool DataSocket::Send(const std::string& status, bool connection_close,
                       const std::string& data) const {
   assert(valid());
   assert(!status.empty());
-  std::string buffer("HTTP/1.1 " + status + "\r\n");
+  if (connection_close)
+    keep_alive_ = false;
+
+  std::string buffer;
+  buffer.reserve(sizeof(kCrossOriginAllowHeaders) + 256 +
+                 extra_headers.length());
+  buffer.append("HTTP/1.1 ").append(status).append("\r\n");
 
   buffer += "Server: PeerConnectionTestServer/0.1\r\n"
             "Cache-Control: no-cache\r\n";
 
-  if (connection_close)
+  if (!keep_alive_)
     buffer += "Connection: close\r\n";
 
   if (!content_type.empty())
-    buffer += "Content-Type: " + content_type + "\r\n";
+    buffer.append("Content-Type: ").append(content_type).append("\r\n");
 
-  buffer += "Content-Length: " + int2str(data.size()) + "\r\n";
+  buffer.append("Content-Length: ").append(int2str(data.size()))
+        .append("\r\n");
 
   if (!extra_headers.empty()) {
     buffer += extra_headers;
@@ -161,14 +189,64 @@ bool DataSocket::Send(const std::string& status, bool connection_close,
   buffer += kCrossOriginAllowHeaders;
 
   buffer += "\r\n";
-  buffer += data;
 
-  return Send(buffer);
+  response_sent_ = true;
+  return SendBuffers(buffer, data);
+}
+
+bool DataSocket::SendBuffers(const std::string& header,
+                             const std::string& body) const {
+  size_t total = header.length() + body.length();
+  size_t sent = 0;
+#if defined(WIN32)
+  WSABUF buffers[2];
+  buffers[0].buf = const_cast<char*>(header.data());
+  buffers[0].len = static_cast<ULONG>(header.length());
+  buffers[1].buf = const_cast<char*>(body.data());
+  buffers[1].len = static_cast<ULONG>(body.length());
+  DWORD bytes = 0;
+  if (WSASend(socket_, buffers, body.empty() ? 1 : 2, &bytes, 0, NULL,
+              NULL) == SOCKET_ERROR) {
+    return false;
+  }
+  sent = bytes;
+#else
+  struct iovec buffers[2];
+  buffers[0].iov_base = const_cast<char*>(header.data());
+  buffers[0].iov_len = header.length();
+  buffers[1].iov_base = const_cast<char*>(body.data());
+  buffers[1].iov_len = body.length();
+  ssize_t bytes = writev(socket_, buffers, body.empty() ? 1 : 2);
+  if (bytes < 0)
+    return false;
+  sent = bytes;
+#endif
+
+  // The socket is blocking, so a short write is rare (e.g. an interrupted
+  // call).  Push out whatever is left piece by piece.
+  while (sent < total) {
+    const char* data;
+    size_t len;
+    if (sent < header.length()) {
+      data = header.data() + sent;
+      len = header.length() - sent;
+    } else {
+      data = body.data() + (sent - header.length());
+      len = total - sent;
+    }
+    int written = send(socket_, data, static_cast<int>(len), 0);
+    if (written == SOCKET_ERROR || written == 0)
+      return false;
+    sent += written;
+  }
+  return true;
 }
 
 void DataSocket::Clear() {
   method_ = INVALID;
   content_length_ = 0;
+  keep_alive_ = false;
+  response_sent_ = false;
   content_type_.clear();
   request_path_.clear();
   request_headers_.clear();
@@ -188,9 +266,14 @@ bool DataSocket::ParseHeaders() {
   assert(method_ != INVALID);
   assert(!request_path_.empty());
 
+  // HTTP/1.1 connections are persistent unless the client says otherwise.
+  keep_alive_ = request_headers_.rfind("HTTP/1.0", i) == std::string::npos;
+
+  const char* headers = request_headers_.data() + i + 2;
+  size_t len = request_headers_.length() - i - 2;
+  ParseConnection(headers, len);
+
   if (method_ == POST) {
-    const char* headers = request_headers_.data() + i + 2;
-    size_t len = request_headers_.length() - i - 2;
     if (!ParseContentLengthAndType(headers, len))
       return false;
   }
@@ -273,6 +356,27 @@ bool DataSocket::ParseContentLengthAndType(const char* headers, size_t length) {
   return !content_type_.empty() && content_length_ != 0;
 }
 
+void DataSocket::ParseConnection(const char* headers, size_t length) {
+  static const char kConnection[] = "Connection:";
+  const char* end = headers + length;
+  while (headers && headers < end) {
+    if ((headers + ARRAYSIZE(kConnection)) < end &&
+        StartsWithNoCase(headers, kConnection)) {
+      headers += ARRAYSIZE(kConnection) - 1;
+      while (headers[0] == ' ')
+        ++headers;
+      if (StartsWithNoCase(headers, "close")) {
+        keep_alive_ = false;
+      } else if (StartsWithNoCase(headers, "keep-alive")) {
+        keep_alive_ = true;
+      }
+    }
+    headers = strstr(headers, "\r\n");
+    if (headers)
+      headers += 2;
+  }
+}
+
 //
 // ListeningSocket
 //
@@ -291,7 +395,7 @@ bool ListeningSocket::Listen(unsigned short port) {
     printf("bind failed\n");
     return false;
   }
-  return listen(socket_, 5) != SOCKET_ERROR;
+  return listen(socket_, SOMAXCONN) != SOCKET_ERROR;
 }
 
 DataSocket* ListeningSocket::Accept() const {
@@ -304,3 +408,119 @@ DataSocket* ListeningSocket::Accept() const {
 
   return new DataSocket(client);
 }
+
+//
+// SocketPoller
+//
+
+#if defined(LINUX)
+
+SocketPoller::SocketPoller() : epoll_fd_(epoll_create(1024)), events_(256) {
+  // Each hanging get holds a socket open, so allow as many descriptors as
+  // the hard limit permits.
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+SocketPoller::~SocketPoller() {
+  if (epoll_fd_ != -1)
+    close(epoll_fd_);
+}
+
+// static
+size_t SocketPoller::max_sockets() {
+  // Leave room for stdio, the listening socket and the epoll descriptor.
+  static const size_t kReservedDescriptors = 8;
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0 ||
+      limit.rlim_cur <= kReservedDescriptors) {
+    return FD_SETSIZE - 2;
+  }
+  return static_cast<size_t>(limit.rlim_cur) - kReservedDescriptors;
+}
+
+bool SocketPoller::Add(SocketBase* socket) {
+  assert(socket && socket->valid());
+  struct epoll_event event = {0};
+  event.events = EPOLLIN;
+  event.data.ptr = socket;
+  return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket->socket(), &event) == 0;
+}
+
+void SocketPoller::Remove(SocketBase* socket) {
+  assert(socket && socket->valid());
+  // Kernels before 2.6.9 require a non-NULL event even for EPOLL_CTL_DEL.
+  struct epoll_event event = {0};
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket->socket(), &event);
+}
+
+bool SocketPoller::Wait(int timeout_ms, std::vector<SocketBase*>* ready) {
+  assert(ready);
+  ready->clear();
+  int count = epoll_wait(epoll_fd_, &events_[0],
+                         static_cast<int>(events_.size()), timeout_ms);
+  if (count < 0)
+    return errno == EINTR;
+
+  for (int i = 0; i < count; ++i)
+    ready->push_back(static_cast<SocketBase*>(events_[i].data.ptr));
+
+  // Busy servers get a bigger batch next time around.
+  if (static_cast<size_t>(count) == events_.size())
+    events_.resize(events_.size() * 2);
+  return true;
+}
+
+#else  // !LINUX
+
+SocketPoller::SocketPoller() {
+}
+
+SocketPoller::~SocketPoller() {
+}
+
+// static
+size_t SocketPoller::max_sockets() {
+  return FD_SETSIZE - 2;
+}
+
+bool SocketPoller::Add(SocketBase* socket) {
+  assert(socket && socket->valid());
+  if (sockets_.size() >= max_sockets())
+    return false;
+  sockets_.push_back(socket);
+  return true;
+}
+
+void SocketPoller::Remove(SocketBase* socket) {
+  std::vector<SocketBase*>::iterator i =
+      std::find(sockets_.begin(), sockets_.end(), socket);
+  if (i != sockets_.end())
+    sockets_.erase(i);
+}
+
+bool SocketPoller::Wait(int timeout_ms, std::vector<SocketBase*>* ready) {
+  assert(ready);
+  ready->clear();
+  fd_set socket_set;
+  FD_ZERO(&socket_set);
+  std::vector<SocketBase*>::iterator i;
+  for (i = sockets_.begin(); i != sockets_.end(); ++i)
+    FD_SET((*i)->socket(), &socket_set);
+
+  struct timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+  if (select(FD_SETSIZE, &socket_set, NULL, NULL, &timeout) == SOCKET_ERROR)
+    return false;
+
+  for (i = sockets_.begin(); i != sockets_.end(); ++i) {
+    if (FD_ISSET((*i)->socket(), &socket_set))
+      ready->push_back(*i);
+  }
+  return true;
+}
+
+#endif  // LINUX
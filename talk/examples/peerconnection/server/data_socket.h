@@ -39,7 +39,12 @@ typedef int socklen_t;
 #define closesocket close
 #endif
 
+#if defined(LINUX)
+#include <sys/epoll.h>
+#endif
+
 #include <string>
+#include <vector>
 
 #ifndef SOCKET_ERROR
 #define SOCKET_ERROR (-1)
@@ -78,7 +83,9 @@ class DataSocket : public SocketBase {
   explicit DataSocket(int socket)
       : SocketBase(socket),
         method_(INVALID),
-        content_length_(0) {
+        content_length_(0),
+        keep_alive_(false),
+        response_sent_(false) {
   }
 
   ~DataSocket() {
@@ -99,6 +106,16 @@ class DataSocket : public SocketBase {
 
   size_t content_length() const { return content_length_; }
 
+  // True if the client asked for the connection to be kept open after the
+  // response (HTTP/1.1 without "Connection: close", or HTTP/1.0 with
+  // "Connection: keep-alive").  Cleared once a response that closes the
+  // connection has been sent.
+  bool keep_alive() const { return keep_alive_; }
+
+  // True once a response to the current request has been sent.  The next
+  // request on a kept-alive connection resets the socket state.
+  bool response_sent() const { return response_sent_; }
+
   bool request_received() const {
     return headers_received() && (method_ != POST || data_received());
   }
@@ -119,13 +136,15 @@ class DataSocket : public SocketBase {
 
   // Send an HTTP response.  The |status| should start with a valid HTTP
   // response code, followed by a string.  E.g. "200 OK".
-  // If |connection_close| is set to true, an extra "Connection: close" HTTP
-  // header will be included.  |content_type| is the mime content type, not
+  // If |connection_close| is set to true, or the client didn't ask for the
+  // connection to be kept alive, an extra "Connection: close" HTTP header
+  // will be included.  |content_type| is the mime content type, not
   // including the "Content-Type: " string.
   // |extra_headers| should be either empty or a list of headers where each
   // header terminates with "\r\n".
   // |data| is the body of the message.  It's length will be specified via
-  // a "Content-Length" header.
+  // a "Content-Length" header.  The headers and |data| are handed to the
+  // kernel in a single gathering write, so the body is never copied.
   bool Send(const std::string& status, bool connection_close,
             const std::string& content_type,
             const std::string& extra_headers, const std::string& data) const;
@@ -146,9 +165,18 @@ class DataSocket : public SocketBase {
   // Determines the length of the body and it's mime type.
   bool ParseContentLengthAndType(const char* headers, size_t length);
 
+  // Determines whether the client wants a persistent connection based on
+  // the "Connection" header.
+  void ParseConnection(const char* headers, size_t length);
+
+  // Sends |header| followed by |body| with as few system calls as possible.
+  bool SendBuffers(const std::string& header, const std::string& body) const;
+
  protected:
   RequestMethod method_;
   size_t content_length_;
+  mutable bool keep_alive_;
+  mutable bool response_sent_;
   std::string content_type_;
   std::string request_path_;
   std::string request_headers_;
@@ -165,4 +193,33 @@ class ListeningSocket : public SocketBase {
   DataSocket* Accept() const;
 };
 
+// Waits for a set of sockets to become readable.  Uses epoll on Linux so that
+// the cost of a wait depends on the number of active sockets rather than on
+// the number of idle hanging gets, and falls back to select() elsewhere.
+class SocketPoller {
+ public:
+  SocketPoller();
+  ~SocketPoller();
+
+  // The maximum number of sockets that can be watched at the same time.
+  static size_t max_sockets();
+
+  bool Add(SocketBase* socket);
+  // Must be called before |socket| is closed.
+  void Remove(SocketBase* socket);
+
+  // Waits up to |timeout_ms| milliseconds and fills |ready| with the sockets
+  // that have data (or a pending connection) to read.  Returns false if the
+  // wait failed.
+  bool Wait(int timeout_ms, std::vector<SocketBase*>* ready);
+
+ private:
+#if defined(LINUX)
+  int epoll_fd_;
+  std::vector<struct epoll_event> events_;
+#else
+  std::vector<SocketBase*> sockets_;
+#endif
+};
+
 #endif  // TALK_EXAMPLES_PEERCONNECTION_SERVER_DATA_SOCKET_H_
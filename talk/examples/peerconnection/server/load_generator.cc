@@ -0,0 +1,468 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// A load generator for peerconnection_server.  Simulates a number of peers
+// that sign in and keep a hanging get open on a persistent connection, waits
+// until every peer has been told about every other peer, and then has each
+// peer send messages to randomly chosen peers.  Reports the rate at which the
+// server delivered presence notifications and messages and the latency of
+// each.
+//
+// Note that presence is broadcast to every connected peer, so signing in N
+// peers costs N * (N - 1) / 2 notifications.  With the default of 10000
+// peers that's about 50 million hanging get round trips.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <arpa/inet.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/flags.h"
+#include "talk/examples/peerconnection/server/data_socket.h"
+#include "talk/examples/peerconnection/server/utils.h"
+
+DEFINE_bool(help, false, "Prints this message");
+DEFINE_string(server, "127.0.0.1", "The IPv4 address of the server.");
+DEFINE_int(port, 8888, "The port the server listens on.");
+DEFINE_int(peers, 10000, "The number of peers to simulate.");
+DEFINE_int(messages, 1, "The number of messages each peer sends once all "
+           "peers are signed in.");
+DEFINE_int(timeout, 3600, "Give up after this many seconds.");
+
+// The number of sign in requests allowed to be outstanding at once.
+static const int kMaxPendingSignIns = 100;
+
+static const char kPeerNamePrefix[] = "loadgen_";
+
+static int64 NowMicros() {
+#ifdef WIN32
+  return static_cast<int64>(GetTickCount()) * 1000;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<int64>(tv.tv_sec) * 1000000 + tv.tv_usec;
+#endif
+}
+
+// Keeps a histogram of latencies with one millisecond resolution.
+class LatencyStats {
+ public:
+  LatencyStats() : count_(0), total_us_(0), max_us_(0), buckets_(kBuckets) {
+  }
+
+  int64 count() const { return count_; }
+
+  void Add(int64 latency_us) {
+    if (latency_us < 0)
+      latency_us = 0;
+    ++count_;
+    total_us_ += latency_us;
+    if (latency_us > max_us_)
+      max_us_ = latency_us;
+    size_t bucket = static_cast<size_t>(latency_us / 1000);
+    ++buckets_[bucket < kBuckets ? bucket : kBuckets - 1];
+  }
+
+  void Print(const char* label) const {
+    if (!count_) {
+      printf("%s: none\n", label);
+      return;
+    }
+    printf("%s: %lld, avg %.2f ms, p50 %d ms, p99 %d ms, max %.2f ms\n",
+           label, static_cast<long long>(count_),
+           total_us_ / 1000.0 / count_, Percentile(50), Percentile(99),
+           max_us_ / 1000.0);
+  }
+
+ private:
+  static const size_t kBuckets = 60000;
+
+  int Percentile(int percent) const {
+    int64 target = (count_ * percent + 99) / 100;
+    int64 seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= target)
+        return static_cast<int>(i);
+    }
+    return static_cast<int>(kBuckets);
+  }
+
+  int64 count_;
+  int64 total_us_;
+  int64 max_us_;
+  std::vector<int64> buckets_;
+};
+
+struct Peer;
+
+// A persistent HTTP connection to the server.
+class PeerSocket : public SocketBase {
+ public:
+  struct Response {
+    int status;
+    int peer_id;  // The value of the "Pragma" header.
+    std::string body;
+  };
+
+  PeerSocket(Peer* peer, bool hanging_get)
+      : peer_(peer), hanging_get_(hanging_get) {
+  }
+
+  Peer* peer() const { return peer_; }
+  bool hanging_get() const { return hanging_get_; }
+
+  bool Connect(const struct sockaddr_in& addr) {
+    return Create() &&
+        connect(socket_, reinterpret_cast<const sockaddr*>(&addr),
+                sizeof(addr)) != SOCKET_ERROR;
+  }
+
+  bool Request(const std::string& request) {
+    return send(socket_, request.data(), static_cast<int>(request.length()),
+                0) == static_cast<int>(request.length());
+  }
+
+  // Reads whatever is available and appends complete responses to
+  // |responses|.  Returns false if the connection was closed.
+  bool Read(std::vector<Response>* responses) {
+    char buffer[0xffff];
+    int bytes = recv(socket_, buffer, sizeof(buffer), 0);
+    if (bytes == SOCKET_ERROR || bytes == 0)
+      return false;
+    in_.append(buffer, bytes);
+
+    size_t start = 0;
+    while (true) {
+      size_t end = in_.find("\r\n\r\n", start);
+      if (end == std::string::npos)
+        break;
+      size_t length = HeaderValue(start, end, "Content-Length: ");
+      size_t body = end + 4;
+      if (in_.length() - body < length)
+        break;
+      Response response;
+      response.status = atoi(in_.c_str() + start + 9);  // "HTTP/1.1 "
+      response.peer_id = static_cast<int>(HeaderValue(start, end, "Pragma: "));
+      response.body.assign(in_, body, length);
+      responses->push_back(response);
+      start = body + length;
+    }
+    in_.erase(0, start);
+    return true;
+  }
+
+ private:
+  size_t HeaderValue(size_t start, size_t end, const char* name) const {
+    size_t found = in_.find(name, start);
+    if (found == std::string::npos || found > end)
+      return 0;
+    return atoi(in_.c_str() + found + strlen(name));
+  }
+
+  Peer* peer_;
+  bool hanging_get_;
+  std::string in_;
+};
+
+struct Peer {
+  Peer() : id(0), sign_in_us(0), messages_left(0), control(NULL),
+           hanging_get(NULL) {
+  }
+
+  std::string name;
+  int id;
+  int64 sign_in_us;
+  int messages_left;
+  PeerSocket* control;
+  PeerSocket* hanging_get;
+};
+
+class LoadGenerator {
+ public:
+  LoadGenerator(const struct sockaddr_in& server, int peers, int messages)
+      : server_(server), peers_(peers), messages_per_peer_(messages),
+        next_sign_in_(0), pending_sign_ins_(0), signed_in_(0),
+        expected_notifications_(static_cast<int64>(peers) * (peers - 1) / 2),
+        messages_acked_(0), failures_(0), start_us_(0), presence_done_us_(0) {
+  }
+
+  ~LoadGenerator() {
+    for (size_t i = 0; i < peers_.size(); ++i) {
+      delete peers_[i].control;
+      delete peers_[i].hanging_get;
+    }
+  }
+
+  // Runs until all messages have been delivered or |timeout_s| has passed.
+  // Returns false if the run didn't complete.
+  bool Run(int timeout_s) {
+    start_us_ = NowMicros();
+    int64 deadline = start_us_ + static_cast<int64>(timeout_s) * 1000000;
+    std::vector<SocketBase*> ready;
+    std::vector<PeerSocket::Response> responses;
+    while (!Done()) {
+      StartSignIns();
+      if (NowMicros() > deadline) {
+        printf("Timed out\n");
+        return false;
+      }
+      if (!poller_.Wait(100, &ready)) {
+        printf("wait failed\n");
+        return false;
+      }
+      for (size_t i = 0; i < ready.size(); ++i) {
+        PeerSocket* s = static_cast<PeerSocket*>(ready[i]);
+        responses.clear();
+        bool open = s->Read(&responses);
+        for (size_t j = 0; j < responses.size(); ++j)
+          OnResponse(s, responses[j]);
+        if (!open)
+          OnClosed(s);
+      }
+      if (!presence_done_us_ && signed_in_ == static_cast<int>(peers_.size())
+          && presence_latency_.count() == expected_notifications_) {
+        presence_done_us_ = NowMicros();
+        StartMessages();
+      }
+    }
+    return true;
+  }
+
+  void Print() const {
+    int64 now = NowMicros();
+    int64 presence_done = presence_done_us_ ? presence_done_us_ : now;
+    double presence_s = (presence_done - start_us_) / 1000000.0;
+    double messages_s = (now - presence_done) / 1000000.0;
+    printf("Signed in %d peers, presence settled after %.2f s\n",
+           signed_in_, presence_s);
+    presence_latency_.Print("Presence notifications");
+    printf("  %.0f notifications/s\n",
+           presence_s > 0 ? presence_latency_.count() / presence_s : 0);
+    message_latency_.Print("Messages");
+    printf("  %.0f messages/s\n",
+           messages_s > 0 ? message_latency_.count() / messages_s : 0);
+    printf("Failed requests: %d\n", failures_);
+  }
+
+ private:
+  bool Done() const {
+    return presence_done_us_ &&
+        message_latency_.count() == static_cast<int64>(peers_.size()) * messages_per_peer_ &&
+        messages_acked_ == message_latency_.count();
+  }
+
+  PeerSocket* Connect(Peer* peer, bool hanging_get) {
+    PeerSocket* s = new PeerSocket(peer, hanging_get);
+    if (!s->Connect(server_) || !poller_.Add(s)) {
+      delete s;
+      return NULL;
+    }
+    return s;
+  }
+
+  void Reconnect(PeerSocket** s) {
+    Peer* peer = (*s)->peer();
+    bool hanging_get = (*s)->hanging_get();
+    poller_.Remove(*s);
+    delete *s;
+    *s = Connect(peer, hanging_get);
+  }
+
+  void StartSignIns() {
+    while (pending_sign_ins_ < kMaxPendingSignIns &&
+           next_sign_in_ < peers_.size()) {
+      Peer* peer = &peers_[next_sign_in_];
+      peer->name = kPeerNamePrefix + size_t2str(next_sign_in_++);
+      peer->sign_in_us = NowMicros();
+      peer->control = Connect(peer, false);
+      if (!peer->control || !peer->control->Request(
+              "GET /sign_in?" + peer->name + " HTTP/1.1\r\n\r\n")) {
+        printf("Failed to sign in %s\n", peer->name.c_str());
+        ++failures_;
+        continue;
+      }
+      ++pending_sign_ins_;
+    }
+  }
+
+  void SendWait(Peer* peer) {
+    if (!peer->hanging_get ||
+        !peer->hanging_get->Request("GET /wait?peer_id=" + int2str(peer->id) +
+                                    " HTTP/1.1\r\n\r\n")) {
+      printf("Failed to send hanging get for %s\n", peer->name.c_str());
+      ++failures_;
+    }
+  }
+
+  void SendMessage(Peer* peer) {
+    int target;
+    do {
+      target = peers_[rand() % peers_.size()].id;
+    } while (target == peer->id && peers_.size() > 1);
+
+    char body[32];
+    sprintf(body, "%lld", static_cast<long long>(NowMicros()));  // NOLINT
+    std::string request("POST /message?peer_id=" + int2str(peer->id) +
+                        "&to=" + int2str(target) + " HTTP/1.1\r\n"
+                        "Content-Type: text/plain\r\n"
+                        "Content-Length: " + size_t2str(strlen(body)) +
+                        "\r\n\r\n" + body);
+    --peer->messages_left;
+    if (!peer->control || !peer->control->Request(request)) {
+      printf("Failed to send message from %s\n", peer->name.c_str());
+      ++failures_;
+    }
+  }
+
+  void StartMessages() {
+    for (size_t i = 0; i < peers_.size(); ++i) {
+      peers_[i].messages_left = messages_per_peer_;
+      if (peers_[i].messages_left > 0)
+        SendMessage(&peers_[i]);
+    }
+  }
+
+  void OnResponse(PeerSocket* s, const PeerSocket::Response& response) {
+    Peer* peer = s->peer();
+    if (response.status != 200) {
+      printf("%s got status %d\n", peer->name.c_str(), response.status);
+      ++failures_;
+    }
+
+    if (!s->hanging_get()) {
+      if (!peer->id) {
+        peer->id = response.peer_id;
+        ++signed_in_;
+        --pending_sign_ins_;
+        peer->hanging_get = Connect(peer, true);
+        SendWait(peer);
+      } else {
+        ++messages_acked_;
+        if (peer->messages_left > 0)
+          SendMessage(peer);
+      }
+      return;
+    }
+
+    if (response.peer_id == peer->id) {
+      // A presence notification in the form "name,id,connected\n".  Our
+      // peers are named after their index, which may arrive before the
+      // sign in response does.
+      const char* name = response.body.c_str();
+      if (strncmp(name, kPeerNamePrefix, strlen(kPeerNamePrefix)) == 0) {
+        size_t other = atoi(name + strlen(kPeerNamePrefix));
+        if (other < peers_.size()) {
+          presence_latency_.Add(NowMicros() - peers_[other].sign_in_us);
+        }
+      }
+    } else {
+      long long sent_us = 0;  // NOLINT
+      sscanf(response.body.c_str(), "%lld", &sent_us);  // NOLINT
+      message_latency_.Add(NowMicros() - sent_us);
+    }
+    SendWait(peer);
+  }
+
+  void OnClosed(PeerSocket* s) {
+    // The server closes connections that it doesn't keep alive; reopen the
+    // hanging get so that the peer doesn't time out.
+    Peer* peer = s->peer();
+    if (s->hanging_get()) {
+      Reconnect(&peer->hanging_get);
+      SendWait(peer);
+    } else {
+      Reconnect(&peer->control);
+    }
+  }
+
+  struct sockaddr_in server_;
+  SocketPoller poller_;
+  std::vector<Peer> peers_;
+  int messages_per_peer_;
+  size_t next_sign_in_;
+  int pending_sign_ins_;
+  int signed_in_;
+  int64 expected_notifications_;
+  LatencyStats presence_latency_;
+  LatencyStats message_latency_;
+  int64 messages_acked_;
+  int failures_;
+  int64 start_us_;
+  int64 presence_done_us_;
+};
+
+int main(int argc, char** argv) {
+  FlagList::SetFlagsFromCommandLine(&argc, argv, true);
+  if (FLAG_help) {
+    FlagList::Print(NULL, false);
+    return 0;
+  }
+
+  if ((FLAG_port < 1) || (FLAG_port > 65535)) {
+    printf("Error: %i is not a valid port.\n", FLAG_port);
+    return -1;
+  }
+
+  if (FLAG_peers < 1) {
+    printf("Error: %i is not a valid number of peers.\n", FLAG_peers);
+    return -1;
+  }
+
+#if defined(POSIX)
+  signal(SIGPIPE, SIG_IGN);
+#endif
+
+  struct sockaddr_in server = {0};
+  server.sin_family = AF_INET;
+  server.sin_addr.s_addr = inet_addr(FLAG_server);
+  server.sin_port = htons(FLAG_port);
+
+  srand(1);
+  LoadGenerator generator(server, FLAG_peers, FLAG_messages);
+  // Each peer holds a control connection and a hanging get.
+  if (static_cast<size_t>(FLAG_peers) * 2 > SocketPoller::max_sockets()) {
+    printf("Error: can't simulate %i peers with %s sockets.\n", FLAG_peers,
+           size_t2str(SocketPoller::max_sockets()).c_str());
+    return -1;
+  }
+  bool completed = generator.Run(FLAG_timeout);
+  generator.Print();
+  return completed ? 0 : 1;
+}
@@ -25,10 +25,13 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include <set>
 #include <vector>
 
 #include "talk/base/flags.h"
@@ -39,7 +42,8 @@
 DEFINE_bool(help, false, "Prints this message");
 DEFINE_int(port, 8888, "The port on which to listen.");
 
-static const size_t kMaxConnections = (FD_SETSIZE - 2);
+// How often (in seconds) to look for peers whose hanging get has timed out.
+static const time_t kTimeoutCheckInterval = 1;
 
 void HandleBrowserRequest(DataSocket* ds, bool* quit) {
   assert(ds && ds->valid());
@@ -56,7 +60,7 @@ void HandleBrowserRequest(DataSocket* ds, bool* quit) {
     // We'll get this when a browsers do cross-resource-sharing requests.
     // The headers to allow cross-origin script support will be set inside
     // Send.
-    ds->Send("200 OK", true, "", "", "");
+    ds->Send("200 OK", false, "", "", "");
   } else {
     // Here we could write some useful output back to the browser depending on
     // the path.
@@ -91,98 +95,111 @@ int main(int argc, char** argv) {
 
   printf("Server listening on port %i\n", FLAG_port);
 
+#if defined(POSIX)
+  // A peer going away mid-response must not take the server down with it.
+  signal(SIGPIPE, SIG_IGN);
+#endif
+
+  SocketPoller poller;
+  if (!poller.Add(&listener)) {
+    printf("Failed to watch server socket\n");
+    return -1;
+  }
+  const size_t max_connections = SocketPoller::max_sockets();
+
   PeerChannel clients;
-  typedef std::vector<DataSocket*> SocketArray;
-  SocketArray sockets;
+  typedef std::set<DataSocket*> SocketSet;
+  SocketSet sockets;
+  std::vector<SocketBase*> ready;
+  time_t last_timeout_check = time(NULL);
   bool quit = false;
   while (!quit) {
-    fd_set socket_set;
-    FD_ZERO(&socket_set);
-    if (listener.valid())
-      FD_SET(listener.socket(), &socket_set);
-
-    for (SocketArray::iterator i = sockets.begin(); i != sockets.end(); ++i)
-      FD_SET((*i)->socket(), &socket_set);
-
-    struct timeval timeout = { 10, 0 };
-    if (select(FD_SETSIZE, &socket_set, NULL, NULL, &timeout) == SOCKET_ERROR) {
-      printf("select failed\n");
+    if (!poller.Wait(10000, &ready)) {
+      printf("wait failed\n");
       break;
     }
 
-    for (SocketArray::iterator i = sockets.begin(); i != sockets.end(); ++i) {
-      DataSocket* s = *i;
+    bool accept = false;
+    for (size_t i = 0; i < ready.size(); ++i) {
+      if (ready[i] == &listener) {
+        accept = true;
+        continue;
+      }
+
+      DataSocket* s = static_cast<DataSocket*>(ready[i]);
       bool socket_done = true;
-      if (FD_ISSET(s->socket(), &socket_set)) {
-        if (s->OnDataAvailable(&socket_done) && s->request_received()) {
-          ChannelMember* member = clients.Lookup(s);
-          if (member || PeerChannel::IsPeerConnection(s)) {
-            if (!member) {
-              if (s->PathEquals("/sign_in")) {
-                clients.AddMember(s);
-              } else {
-                printf("No member found for: %s\n",
-                    s->request_path().c_str());
-                s->Send("500 Error", true, "text/plain", "",
-                        "Peer most likely gone.");
-              }
-            } else if (member->is_wait_request(s)) {
-              // no need to do anything.
-              socket_done = false;
+      if (s->OnDataAvailable(&socket_done) && s->request_received()) {
+        ChannelMember* member = clients.Lookup(s);
+        if (member || PeerChannel::IsPeerConnection(s)) {
+          if (!member) {
+            if (s->PathEquals("/sign_in")) {
+              clients.AddMember(s);
             } else {
-              ChannelMember* target = clients.IsTargetedRequest(s);
-              if (target) {
-                member->ForwardRequestToPeer(s, target);
-              } else if (s->PathEquals("/sign_out")) {
-                s->Send("200 OK", true, "text/plain", "", "");
-              } else {
-                printf("Couldn't find target for request: %s\n",
-                    s->request_path().c_str());
-                s->Send("500 Error", true, "text/plain", "",
-                        "Peer most likely gone.");
-              }
+              printf("No member found for: %s\n",
+                  s->request_path().c_str());
+              s->Send("500 Error", true, "text/plain", "",
+                      "Peer most likely gone.");
             }
+          } else if (member->is_wait_request(s)) {
+            // no need to do anything.
           } else {
-            HandleBrowserRequest(s, &quit);
-            if (quit) {
-              printf("Quitting...\n");
-              FD_CLR(listener.socket(), &socket_set);
-              listener.Close();
-              clients.CloseAll();
+            ChannelMember* target = clients.IsTargetedRequest(s);
+            if (target) {
+              member->ForwardRequestToPeer(s, target);
+            } else if (s->PathEquals("/sign_out")) {
+              s->Send("200 OK", false, "text/plain", "", "");
+            } else {
+              printf("Couldn't find target for request: %s\n",
+                  s->request_path().c_str());
+              s->Send("500 Error", true, "text/plain", "",
+                      "Peer most likely gone.");
             }
           }
+        } else {
+          HandleBrowserRequest(s, &quit);
+          if (quit) {
+            printf("Quitting...\n");
+            poller.Remove(&listener);
+            listener.Close();
+            clients.CloseAll();
+          }
         }
-      } else {
-        socket_done = false;
+        // Hanging gets stay open until they're answered, and answered
+        // requests stay open if the client asked for keep-alive.
+        socket_done = s->response_sent() && !s->keep_alive();
       }
 
       if (socket_done) {
         printf("Disconnecting socket\n");
         clients.OnClosing(s);
         assert(s->valid());  // Close must not have been called yet.
-        FD_CLR(s->socket(), &socket_set);
-        delete (*i);
-        i = sockets.erase(i);
-        if (i == sockets.end())
-          break;
+        poller.Remove(s);
+        sockets.erase(s);
+        delete s;
       }
     }
 
-    clients.CheckForTimeout();
+    time_t now = time(NULL);
+    if (now - last_timeout_check >= kTimeoutCheckInterval) {
+      clients.CheckForTimeout();
+      last_timeout_check = now;
+    }
 
-    if (FD_ISSET(listener.socket(), &socket_set)) {
+    if (accept && listener.valid()) {
       DataSocket* s = listener.Accept();
-      if (sockets.size() >= kMaxConnections) {
+      if (!s) {
+        printf("Accept failed\n");
+      } else if (sockets.size() >= max_connections || !poller.Add(s)) {
         delete s;  // sorry, that's all we can take.
         printf("Connection limit reached\n");
       } else {
-        sockets.push_back(s);
+        sockets.insert(s);
         printf("New connection...\n");
       }
     }
   }
 
-  for (SocketArray::iterator i = sockets.begin(); i != sockets.end(); ++i)
+  for (SocketSet::iterator i = sockets.begin(); i != sockets.end(); ++i)
     delete (*i);
   sockets.clear();
 
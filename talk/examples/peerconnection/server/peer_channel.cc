@@ -75,6 +75,7 @@ ChannelMember::ChannelMember(DataSocket* socket)
   if (!name_.length())
     name_ = "peer_" + int2str(id_);
   std::replace(name_.begin(), name_.end(), ',', '_');
+  peer_id_header_ = kPeerIdHeader + int2str(id_) + "\r\n";
 }
 
 ChannelMember::~ChannelMember() {
@@ -88,15 +89,10 @@ bool ChannelMember::TimedOut() {
   return waiting_socket_ == NULL && (time(NULL) - timestamp_) > 30;
 }
 
-std::string ChannelMember::GetPeerIdHeader() const {
-  std::string ret(kPeerIdHeader + int2str(id_) + "\r\n");
-  return ret;
-}
-
-bool ChannelMember::NotifyOfOtherMember(const ChannelMember& other) {
+bool ChannelMember::NotifyOfOtherMember(const ChannelMember& other,
+                                        const std::string& entry) {
   assert(&other != this);
-  QueueResponse("200 OK", "text/plain", GetPeerIdHeader(),
-                other.GetEntry());
+  QueueResponse("200 OK", "text/plain", GetPeerIdHeader(), entry);
   return true;
 }
 
@@ -111,17 +107,17 @@ void ChannelMember::ForwardRequestToPeer(DataSocket* ds, ChannelMember* peer) {
   assert(peer);
   assert(ds);
 
-  std::string extra_headers(GetPeerIdHeader());
+  const std::string& extra_headers = GetPeerIdHeader();
 
   if (peer == this) {
-    ds->Send("200 OK", true, ds->content_type(), extra_headers,
+    ds->Send("200 OK", false, ds->content_type(), extra_headers,
              ds->data());
   } else {
     printf("Client %s sending to %s\n",
         name_.c_str(), peer->name().c_str());
     peer->QueueResponse("200 OK", ds->content_type(), extra_headers,
                         ds->data());
-    ds->Send("200 OK", true, "text/plain", "", "");
+    ds->Send("200 OK", false, "text/plain", "", "");
   }
 }
 
@@ -139,20 +135,21 @@ void ChannelMember::QueueResponse(const std::string& status,
   if (waiting_socket_) {
     assert(queue_.size() == 0);
     assert(waiting_socket_->method() == DataSocket::GET);
-    bool ok = waiting_socket_->Send(status, true, content_type, extra_headers,
-                                    data);
+    bool ok = waiting_socket_->Send(status, false, content_type,
+                                    extra_headers, data);
     if (!ok) {
       printf("Failed to deliver data to waiting socket\n");
     }
     waiting_socket_ = NULL;
     timestamp_ = time(NULL);
   } else {
-    QueuedResponse qr;
+    // Fill in the response in place to avoid copying it twice.
+    queue_.push(QueuedResponse());
+    QueuedResponse& qr = queue_.back();
     qr.status = status;
     qr.content_type = content_type;
     qr.extra_headers = extra_headers;
     qr.data = data;
-    queue_.push(qr);
   }
 }
 
@@ -161,7 +158,7 @@ void ChannelMember::SetWaitingSocket(DataSocket* ds) {
   if (ds && !queue_.empty()) {
     assert(waiting_socket_ == NULL);
     const QueuedResponse& response = queue_.front();
-    ds->Send(response.status, true, response.content_type,
+    ds->Send(response.status, false, response.content_type,
              response.extra_headers, response.data);
     queue_.pop();
   } else {
@@ -203,18 +200,14 @@ ChannelMember* PeerChannel::Lookup(DataSocket* ds) const {
     return NULL;
 
   int id = atoi(&args[found + ARRAYSIZE(kPeerId) - 1]);
-  Members::const_iterator iter = members_.begin();
-  for (; iter != members_.end(); ++iter) {
-    if (id == (*iter)->id()) {
-      if (i == kWait)
-        (*iter)->SetWaitingSocket(ds);
-      if (i == kSignOut)
-        (*iter)->set_disconnected();
-      return *iter;
-    }
+  ChannelMember* member = Find(id);
+  if (member) {
+    if (i == kWait)
+      member->SetWaitingSocket(ds);
+    if (i == kSignOut)
+      member->set_disconnected();
   }
-
-  return NULL;
+  return member;
 }
 
 ChannelMember* PeerChannel::IsTargetedRequest(const DataSocket* ds) const {
@@ -237,14 +230,7 @@ ChannelMember* PeerChannel::IsTargetedRequest(const DataSocket* ds) const {
     }
     args = found + ARRAYSIZE(kTargetPeerIdParam) - 1;
   } while (true);
-  int id = atoi(&path[found]);
-  Members::const_iterator i = members_.begin();
-  for (; i != members_.end(); ++i) {
-    if ((*i)->id() == id) {
-      return *i;
-    }
-  }
-  return NULL;
+  return Find(atoi(&path[found]));
 }
 
 bool PeerChannel::AddMember(DataSocket* ds) {
@@ -254,6 +240,7 @@ bool PeerChannel::AddMember(DataSocket* ds) {
   BroadcastChangedState(*new_guy, &failures);
   HandleDeliveryFailures(&failures);
   members_.push_back(new_guy);
+  index_[new_guy->id()] = new_guy;
 
   printf("New member added (total=%s): %s\n",
       size_t2str(members_.size()).c_str(), new_guy->name().c_str());
@@ -261,7 +248,7 @@ bool PeerChannel::AddMember(DataSocket* ds) {
   // Let the newly connected peer know about other members of the channel.
   std::string content_type;
   std::string response = BuildResponseForNewMember(*new_guy, &content_type);
-  ds->Send("200 Added", true, content_type, new_guy->GetPeerIdHeader(),
+  ds->Send("200 Added", false, content_type, new_guy->GetPeerIdHeader(),
            response);
   return true;
 }
@@ -279,7 +266,7 @@ void PeerChannel::OnClosing(DataSocket* ds) {
     ChannelMember* m = (*i);
     m->OnClosing(ds);
     if (!m->connected()) {
-      i = members_.erase(i);
+      i = Erase(i);
       Members failures;
       BroadcastChangedState(*m, &failures);
       HandleDeliveryFailures(&failures);
@@ -297,7 +284,7 @@ void PeerChannel::CheckForTimeout() {
     if (m->TimedOut()) {
       printf("Timeout: %s\n", m->name().c_str());
       m->set_disconnected();
-      i = members_.erase(i);
+      i = Erase(i);
       Members failures;
       BroadcastChangedState(*m, &failures);
       HandleDeliveryFailures(&failures);
@@ -308,10 +295,21 @@ void PeerChannel::CheckForTimeout() {
   }
 }
 
+ChannelMember* PeerChannel::Find(int id) const {
+  MemberIndex::const_iterator i = index_.find(id);
+  return i == index_.end() ? NULL : i->second;
+}
+
+PeerChannel::Members::iterator PeerChannel::Erase(Members::iterator i) {
+  index_.erase((*i)->id());
+  return members_.erase(i);
+}
+
 void PeerChannel::DeleteAll() {
   for (Members::iterator i = members_.begin(); i != members_.end(); ++i)
     delete (*i);
   members_.clear();
+  index_.clear();
 }
 
 void PeerChannel::BroadcastChangedState(const ChannelMember& member,
@@ -323,13 +321,14 @@ void PeerChannel::BroadcastChangedState(const ChannelMember& member,
     printf("Member disconnected: %s\n", member.name().c_str());
   }
 
+  const std::string entry(member.GetEntry());
   Members::iterator i = members_.begin();
   for (; i != members_.end(); ++i) {
     if (&member != (*i)) {
-      if (!(*i)->NotifyOfOtherMember(member)) {
+      if (!(*i)->NotifyOfOtherMember(member, entry)) {
         (*i)->set_disconnected();
         delivery_failures->push_back(*i);
-        i = members_.erase(i);
+        i = Erase(i);
         if (i == members_.end())
           break;
       }
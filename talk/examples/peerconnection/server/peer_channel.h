@@ -31,6 +31,7 @@
 
 #include <time.h>
 
+#include <map>
 #include <queue>
 #include <string>
 #include <vector>
@@ -51,9 +52,11 @@ class ChannelMember {
 
   bool TimedOut();
 
-  std::string GetPeerIdHeader() const;
+  const std::string& GetPeerIdHeader() const { return peer_id_header_; }
 
-  bool NotifyOfOtherMember(const ChannelMember& other);
+  // |entry| is |other|'s GetEntry(), computed once per broadcast.
+  bool NotifyOfOtherMember(const ChannelMember& other,
+                           const std::string& entry);
 
   // Returns a string in the form "name,id\n".
   std::string GetEntry() const;
@@ -77,6 +80,7 @@ class ChannelMember {
   bool connected_;
   time_t timestamp_;
   std::string name_;
+  std::string peer_id_header_;
   std::queue<QueuedResponse> queue_;
   static int s_member_id_;
 };
@@ -85,6 +89,7 @@ class ChannelMember {
 class PeerChannel {
  public:
   typedef std::vector<ChannelMember*> Members;
+  typedef std::map<int, ChannelMember*> MemberIndex;
 
   PeerChannel() {
   }
@@ -121,6 +126,12 @@ class PeerChannel {
   void CheckForTimeout();
 
  protected:
+  // Returns the member with the given id or NULL.
+  ChannelMember* Find(int id) const;
+
+  // Removes the member at |i| from |members_| and the id index.
+  Members::iterator Erase(Members::iterator i);
+
   void DeleteAll();
   void BroadcastChangedState(const ChannelMember& member,
                              Members* delivery_failures);
@@ -132,6 +143,9 @@ class PeerChannel {
 
  protected:
   Members members_;
+  // Id to member lookup for the requests that name a peer, which are the
+  // bulk of the server's traffic.
+  MemberIndex index_;
 };
 
 #endif  // TALK_EXAMPLES_PEERCONNECTION_SERVER_PEER_CHANNEL_H_
@@ -28,6 +28,13 @@
 {
   'includes': ['build/common.gypi'],
 
+  'variables': {
+    # Builds LinuxScreenCapturer, the XDamage and MIT-SHM screencast
+    # capturer, and has LinuxDeviceManager hand it out for window and desktop
+    # capture. Needs the Xdamage and Xfixes development packages.
+    'linux_screencast%': 0,
+  },
+
   'conditions': [
     [ 'os_posix == 1 and OS != "mac" and OS != "ios"', {
       'conditions': [
@@ -59,6 +66,7 @@
         'base/asyncfile.cc',
         'base/asynchttprequest.cc',
         'base/asyncsocket.cc',
+        'base/asyncstuntcpsocket.cc',
         'base/asynctcpsocket.cc',
         'base/asyncudpsocket.cc',
         'base/autodetectproxy.cc',
@@ -68,6 +76,7 @@
         'base/bytebuffer.cc',
         'base/checks.cc',
         'base/common.cc',
+        'base/cpufeatures.cc',
         'base/cpumonitor.cc',
         'base/crc32.cc',
         'base/diskcache.cc',
@@ -77,6 +86,7 @@
         'base/firewallsocketserver.cc',
         'base/flags.cc',
         'base/helpers.cc',
+        'base/histogram.cc',
         'base/host.cc',
         'base/httpbase.cc',
         'base/httpclient.cc',
@@ -84,6 +94,7 @@
         'base/httprequest.cc',
         'base/httpserver.cc',
         'base/ipaddress.cc',
+        'base/linkmodel.cc',
         'base/logging.cc',
         'base/md5.cc',
         'base/messagedigest.cc',
@@ -98,6 +109,7 @@
         'base/nssidentity.cc',
         'base/nssstreamadapter.cc',
         'base/optionsfile.cc',
+        'base/packettrace.cc',
         'base/pathutils.cc',
         'base/physicalsocketserver.cc',
         'base/proxydetect.cc',
@@ -133,6 +145,7 @@
         'base/urlencode.cc',
         'base/versionparsing.cc',
         'base/virtualsocketserver.cc',
+        'base/windowedratetracker.cc',
         'base/worker.cc',
         'xmllite/qname.cc',
         'xmllite/xmlbuilder.cc',
@@ -295,6 +308,7 @@
         'libjingle',
       ],
       'sources': [
+        'sound/latencytracker.cc',
         'sound/nullsoundsystem.cc',
         'sound/nullsoundsystemfactory.cc',
         'sound/platformsoundsystem.cc',
@@ -380,6 +394,20 @@
             '-lXext',
             '-lX11',
           ],
+          'conditions': [
+            ['linux_screencast==1', {
+              'sources': [
+                'media/devices/linuxscreencapturer.cc',
+              ],
+              'defines': [
+                'HAVE_XDAMAGE',
+              ],
+              'libraries': [
+                '-lXdamage',
+                '-lXfixes',
+              ],
+            }],
+          ],
         }],
         ['OS=="win"', {
           'sources': [
@@ -445,6 +473,7 @@
         'p2p/base/dtlstransportchannel.cc',
         'p2p/base/p2ptransport.cc',
         'p2p/base/p2ptransportchannel.cc',
+        'p2p/base/packetpacer.cc',
         'p2p/base/parsing.cc',
         'p2p/base/port.cc',
         'p2p/base/portallocator.cc',
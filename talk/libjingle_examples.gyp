@@ -117,7 +117,17 @@
             },
           }],
         ],
-      }],  # target call
+      }, {
+        'target_name': 'call_load',
+        'type': 'executable',
+        'dependencies': [
+          'libjingle.gyp:libjingle_p2p',
+        ],
+        'sources': [
+          'examples/call/callload_main.cc',
+          'examples/call/mediaenginefactory.cc',
+        ],
+      }],  # targets call, call_load
     }],
   ],
 }
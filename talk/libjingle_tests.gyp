@@ -72,6 +72,8 @@
       ],
       'sources': [
         'base/asynchttprequest_unittest.cc',
+        'base/asyncstuntcpsocket_unittest.cc',
+        'base/asynctcpsocket_unittest.cc',
         'base/atomicops_unittest.cc',
         'base/autodetectproxy_unittest.cc',
         'base/bandwidthsmoother_unittest.cc',
@@ -82,15 +84,18 @@
         'base/byteorder_unittest.cc',
         'base/cpumonitor_unittest.cc',
         'base/crc32_unittest.cc',
+        'base/diskcache_unittest.cc',
         'base/event_unittest.cc',
         'base/filelock_unittest.cc',
         'base/fileutils_unittest.cc',
         'base/helpers_unittest.cc',
+        'base/histogram_unittest.cc',
         'base/host_unittest.cc',
         'base/httpbase_unittest.cc',
         'base/httpcommon_unittest.cc',
         'base/httpserver_unittest.cc',
         'base/ipaddress_unittest.cc',
+        'base/linkmodel_unittest.cc',
         'base/logging_unittest.cc',
         'base/md5digest_unittest.cc',
         'base/messagedigest_unittest.cc',
@@ -100,6 +105,7 @@
         'base/network_unittest.cc',
         'base/nullsocketserver_unittest.cc',
         'base/optionsfile_unittest.cc',
+        'base/packettrace_unittest.cc',
         'base/pathutils_unittest.cc',
         'base/physicalsocketserver_unittest.cc',
         'base/proxy_unittest.cc',
@@ -108,10 +114,12 @@
         'base/ratetracker_unittest.cc',
         'base/referencecountedsingletonfactory_unittest.cc',
         'base/rollingaccumulator_unittest.cc',
+        'base/seqlock_unittest.cc',
         'base/sha1digest_unittest.cc',
         'base/sharedexclusivelock_unittest.cc',
         'base/signalthread_unittest.cc',
         'base/sigslot_unittest.cc',
+        'base/socketadapters_unittest.cc',
         'base/socket_unittest.cc',
         'base/socketaddress_unittest.cc',
         'base/stream_unittest.cc',
@@ -126,6 +134,7 @@
         'base/urlencode_unittest.cc',
         'base/versionparsing_unittest.cc',
         'base/virtualsocket_unittest.cc',
+        'base/windowedratetracker_unittest.cc',
         # TODO(ronghuawu): Reenable this test.
         # 'base/windowpicker_unittest.cc',
         'xmllite/qname_unittest.cc',
@@ -194,6 +203,7 @@
       ],
       'sources': [
         'sound/automaticallychosensoundsystem_unittest.cc',
+        'sound/latencytracker_unittest.cc',
       ],
     },  # target libjingle_sound_unittest    
     {
@@ -267,6 +277,7 @@
         'media/base/testutils.cc',
         'p2p/base/dtlstransportchannel_unittest.cc',
         'p2p/base/p2ptransportchannel_unittest.cc',
+        'p2p/base/packetpacer_unittest.cc',
         'p2p/base/port_unittest.cc',
         'p2p/base/portallocatorsessionproxy_unittest.cc',
         'p2p/base/pseudotcp_unittest.cc',
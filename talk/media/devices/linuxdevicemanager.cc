@@ -38,6 +38,7 @@
 #include "talk/base/thread.h"
 #include "talk/media/base/mediacommon.h"
 #include "talk/media/devices/libudevsymboltable.h"
+#include "talk/media/devices/linuxscreencapturer.h"
 #include "talk/media/devices/v4llookup.h"
 #include "talk/sound/platformsoundsystem.h"
 #include "talk/sound/platformsoundsystemfactory.h"
@@ -291,6 +292,28 @@ bool LinuxDeviceManager::GetVideoCaptureDevices(std::vector<Device>* devices) {
   return FilterDevices(devices, kFilteredVideoDevicesName);
 }
 
+#ifdef HAVE_XDAMAGE
+VideoCapturer* LinuxDeviceManager::CreateWindowCapturer(
+    talk_base::WindowId window) {
+  LinuxScreenCapturer* window_capturer = new LinuxScreenCapturer();
+  if (!window_capturer->Init(window)) {
+    delete window_capturer;
+    return NULL;
+  }
+  return window_capturer;
+}
+
+VideoCapturer* LinuxDeviceManager::CreateDesktopCapturer(
+    talk_base::DesktopId desktop) {
+  LinuxScreenCapturer* desktop_capturer = new LinuxScreenCapturer();
+  if (!desktop_capturer->Init(desktop.index())) {
+    delete desktop_capturer;
+    return NULL;
+  }
+  return desktop_capturer;
+}
+#endif  // HAVE_XDAMAGE
+
 LinuxDeviceWatcher::LinuxDeviceWatcher(DeviceManagerInterface* dm)
     : DeviceWatcher(dm),
       manager_(dm),
@@ -44,6 +44,10 @@ class LinuxDeviceManager : public DeviceManager {
   virtual ~LinuxDeviceManager();
 
   virtual bool GetVideoCaptureDevices(std::vector<Device>* devs);
+#ifdef HAVE_XDAMAGE
+  virtual VideoCapturer* CreateWindowCapturer(talk_base::WindowId window);
+  virtual VideoCapturer* CreateDesktopCapturer(talk_base::DesktopId desktop);
+#endif
 
  private:
   virtual bool GetAudioDevices(bool input, std::vector<Device>* devs);
@@ -0,0 +1,666 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/media/devices/linuxscreencapturer.h"
+
+#ifdef HAVE_XDAMAGE
+
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+
+#include "talk/base/criticalsection.h"
+#include "talk/base/logging.h"
+#include "talk/base/stringencode.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace cricket {
+
+static const int64 kNumNanoSecsPerMilliSec = 1000000;
+
+// Catches the X errors raised by requests on one display while it is in
+// scope, instead of letting the default handler exit the process. Xlib only
+// has a process-wide error handler, and swapping it from the capture thread
+// would race with other Xlib users such as LinuxWindowPicker. So one
+// dispatching handler is installed the first time and never removed; it
+// records errors for displays that have a trap in scope and passes all others
+// on to the handler it replaced. X requests are asynchronous, so errors are
+// only known for sure after a round trip, which GetLastError() makes.
+class XErrorTrap {
+ public:
+  explicit XErrorTrap(Display* display)
+      : display_(display), last_error_(0), next_(NULL) {
+    InstallHandler();
+    XSync(display_, False);
+    talk_base::CritScope cs(&crit_);
+    next_ = traps_;
+    traps_ = this;
+  }
+  ~XErrorTrap() {
+    XSync(display_, False);
+    talk_base::CritScope cs(&crit_);
+    for (XErrorTrap** trap = &traps_; *trap; trap = &(*trap)->next_) {
+      if (*trap == this) {
+        *trap = next_;
+        break;
+      }
+    }
+  }
+
+  int GetLastError() {
+    XSync(display_, False);
+    talk_base::CritScope cs(&crit_);
+    return last_error_;
+  }
+
+ private:
+  static void InstallHandler() {
+    talk_base::CritScope cs(&install_crit_);
+    if (!installed_) {
+      previous_handler_ = XSetErrorHandler(&XErrorTrap::OnError);
+      installed_ = true;
+    }
+  }
+
+  static int OnError(Display* display, XErrorEvent* e) {
+    {
+      talk_base::CritScope cs(&crit_);
+      // The innermost trap on this display gets the error.
+      for (XErrorTrap* trap = traps_; trap; trap = trap->next_) {
+        if (trap->display_ == display) {
+          trap->last_error_ = e->error_code;
+          return 0;
+        }
+      }
+    }
+    return previous_handler_ ? previous_handler_(display, e) : 0;
+  }
+
+  // Guards |traps_| and the |last_error_| of every trap in it.
+  static talk_base::CriticalSection crit_;
+  static XErrorTrap* traps_;
+  static talk_base::CriticalSection install_crit_;
+  static bool installed_;
+  static XErrorHandler previous_handler_;
+
+  Display* display_;
+  int last_error_;
+  XErrorTrap* next_;
+
+  DISALLOW_COPY_AND_ASSIGN(XErrorTrap);
+};
+
+talk_base::CriticalSection XErrorTrap::crit_;
+XErrorTrap* XErrorTrap::traps_ = NULL;
+talk_base::CriticalSection XErrorTrap::install_crit_;
+bool XErrorTrap::installed_ = false;
+XErrorHandler XErrorTrap::previous_handler_ = NULL;
+
+// Hides all X11 specifics from the header. The frame lives in image_, in
+// shared memory when MIT-SHM works. With shared pixmaps the changed
+// rectangles are copied into it by the server, otherwise we fall back to
+// XShmGetImage of the whole frame, or XGetSubImage of each rectangle.
+class XScreenGrabber {
+ public:
+  XScreenGrabber()
+      : display_(NULL),
+        window_(0),
+        width_(0),
+        height_(0),
+        image_(NULL),
+        shm_pixmap_(0),
+        gc_(NULL),
+        damage_(0),
+        damage_region_(0),
+        use_shm_(false),
+        full_frame_(true) {
+    memset(&shm_info_, 0, sizeof(shm_info_));
+    shm_info_.shmid = -1;
+  }
+
+  ~XScreenGrabber() {
+    Stop();
+    if (display_) {
+      XCloseDisplay(display_);
+    }
+  }
+
+  // Opens the display and picks the window to capture, |window| if it is set
+  // or the root window of |screen| otherwise.
+  bool Open(Window window, int screen) {
+    display_ = XOpenDisplay(NULL);
+    if (!display_) {
+      LOG(LS_ERROR) << "Failed to open display.";
+      return false;
+    }
+    if (!window) {
+      if (screen < 0 || screen >= XScreenCount(display_)) {
+        LOG(LS_ERROR) << "No screen " << screen << " on the display.";
+        return false;
+      }
+      window = XRootWindow(display_, screen);
+    }
+    window_ = window;
+
+    XErrorTrap error_trap(display_);
+    XWindowAttributes attr;
+    if (!XGetWindowAttributes(display_, window_, &attr)) {
+      LOG(LS_ERROR) << "XGetWindowAttributes() failed";
+      return false;
+    }
+    width_ = attr.width;
+    height_ = attr.height;
+    return true;
+  }
+
+  bool Start(bool use_shm, bool use_damage) {
+    use_shm_ = use_shm;
+    XSelectInput(display_, window_, StructureNotifyMask);
+    if (!InitImage()) {
+      return false;
+    }
+    if (use_damage) {
+      InitDamage();
+    }
+    full_frame_ = true;
+    return true;
+  }
+
+  void Stop() {
+    ReleaseDamage();
+    ReleaseImage();
+    if (display_ && window_) {
+      XSelectInput(display_, window_, NoEventMask);
+    }
+  }
+
+  // Brings the frame up to date and sets |rects| to the parts that changed.
+  // Returns false if the window can no longer be captured.
+  bool Capture(LinuxScreenCapturer::DirtyRects* rects) {
+    rects->clear();
+    if (!HandleEvents()) {
+      return false;
+    }
+
+    if (damage_) {
+      // Take everything that was damaged since the last frame. Anything
+      // damaged after this point is reported next time.
+      XDamageSubtract(display_, damage_, None, damage_region_);
+    }
+    if (full_frame_ || !damage_) {
+      full_frame_ = false;
+      AddRect(0, 0, width_, height_, rects);
+    } else {
+      int count = 0;
+      XRectangle* xrects = XFixesFetchRegion(display_, damage_region_,
+                                             &count);
+      for (int i = 0; i < count; ++i) {
+        AddRect(xrects[i].x, xrects[i].y, xrects[i].width, xrects[i].height,
+                rects);
+      }
+      if (xrects) {
+        XFree(xrects);
+      }
+    }
+    if (rects->empty()) {
+      return true;
+    }
+
+    XErrorTrap error_trap(display_);
+    if (shm_pixmap_) {
+      for (size_t i = 0; i < rects->size(); ++i) {
+        const LinuxScreenCapturer::DirtyRect& r = (*rects)[i];
+        XCopyArea(display_, window_, shm_pixmap_, gc_, r.x, r.y, r.width,
+                  r.height, r.x, r.y);
+      }
+      // The pixmap shares its memory with image_, so once the copies are
+      // done the frame is up to date.
+      XSync(display_, False);
+    } else if (shm_info_.shmid != -1) {
+      // Without shared pixmaps, MIT-SHM can only read the whole frame.
+      XShmGetImage(display_, window_, image_, 0, 0, AllPlanes);
+    } else {
+      for (size_t i = 0; i < rects->size(); ++i) {
+        const LinuxScreenCapturer::DirtyRect& r = (*rects)[i];
+        XGetSubImage(display_, window_, r.x, r.y, r.width, r.height,
+                     AllPlanes, ZPixmap, image_, r.x, r.y);
+      }
+    }
+    if (error_trap.GetLastError() != 0) {
+      LOG(LS_WARNING) << "Failed to read the window contents.";
+      return false;
+    }
+    return true;
+  }
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  uint8* data() const { return reinterpret_cast<uint8*>(image_->data); }
+  uint32 data_size() const { return image_->bytes_per_line * height_; }
+
+ private:
+  // Drops the pending events, picking up resizes on the way.
+  bool HandleEvents() {
+    bool resized = false;
+    while (XPending(display_)) {
+      XEvent event;
+      XNextEvent(display_, &event);
+      if (event.type == DestroyNotify &&
+          event.xdestroywindow.window == window_) {
+        LOG(LS_INFO) << "Captured window was destroyed.";
+        return false;
+      }
+      if (event.type == ConfigureNotify &&
+          event.xconfigure.window == window_ &&
+          (event.xconfigure.width != width_ ||
+           event.xconfigure.height != height_)) {
+        width_ = event.xconfigure.width;
+        height_ = event.xconfigure.height;
+        resized = true;
+      }
+    }
+    if (resized) {
+      ReleaseImage();
+      if (!InitImage()) {
+        return false;
+      }
+      full_frame_ = true;
+    }
+    return true;
+  }
+
+  void AddRect(int x, int y, int width, int height,
+               LinuxScreenCapturer::DirtyRects* rects) {
+    // Damage may run past the edges of the window; clip it.
+    int right = talk_base::_min(x + width, width_);
+    int bottom = talk_base::_min(y + height, height_);
+    x = talk_base::_max(x, 0);
+    y = talk_base::_max(y, 0);
+    if (right <= x || bottom <= y) {
+      return;
+    }
+    LinuxScreenCapturer::DirtyRect rect = { x, y, right - x, bottom - y };
+    rects->push_back(rect);
+  }
+
+  bool InitImage() {
+    XWindowAttributes attr;
+    if (!XGetWindowAttributes(display_, window_, &attr)) {
+      LOG(LS_ERROR) << "XGetWindowAttributes() failed";
+      return false;
+    }
+    width_ = attr.width;
+    height_ = attr.height;
+
+    if (!use_shm_ || !InitShmImage(attr)) {
+      image_ = XCreateImage(display_, attr.visual, attr.depth, ZPixmap, 0,
+                            NULL, width_, height_, 32, 0);
+      if (!image_) {
+        LOG(LS_ERROR) << "XCreateImage() failed";
+        return false;
+      }
+      // XDestroyImage() frees this.
+      image_->data =
+          static_cast<char*>(malloc(image_->bytes_per_line * height_));
+    }
+
+    // We only handle the 32 bit BGRX layout that practically every desktop
+    // uses, which is FOURCC_ARGB in memory.
+    if (image_->bits_per_pixel != 32 ||
+        image_->bytes_per_line != width_ * 4 ||
+        image_->red_mask != 0xff0000 || image_->green_mask != 0xff00 ||
+        image_->blue_mask != 0xff) {
+      LOG(LS_ERROR) << "Unsupported pixel format, " << image_->bits_per_pixel
+                    << " bits per pixel.";
+      ReleaseImage();
+      return false;
+    }
+    return true;
+  }
+
+  bool InitShmImage(const XWindowAttributes& attr) {
+    int major, minor;
+    Bool have_pixmaps;
+    if (!XShmQueryVersion(display_, &major, &minor, &have_pixmaps)) {
+      LOG(LS_INFO) << "MIT-SHM extension not available.";
+      return false;
+    }
+
+    image_ = XShmCreateImage(display_, attr.visual, attr.depth, ZPixmap, NULL,
+                             &shm_info_, width_, height_);
+    if (!image_) {
+      LOG(LS_WARNING) << "XShmCreateImage() failed";
+      return false;
+    }
+    shm_info_.shmid = shmget(IPC_PRIVATE, image_->bytes_per_line * height_,
+                             IPC_CREAT | 0600);
+    if (shm_info_.shmid == -1) {
+      LOG_ERR(LS_WARNING) << "shmget() failed";
+      ReleaseImage();
+      return false;
+    }
+    shm_info_.shmaddr = static_cast<char*>(shmat(shm_info_.shmid, NULL, 0));
+    shm_info_.readOnly = False;
+    if (shm_info_.shmaddr == reinterpret_cast<char*>(-1)) {
+      LOG_ERR(LS_WARNING) << "shmat() failed";
+      shm_info_.shmaddr = NULL;
+      ReleaseImage();
+      return false;
+    }
+    image_->data = shm_info_.shmaddr;
+
+    {
+      // Attaching fails on remote displays, which can't share our memory.
+      XErrorTrap error_trap(display_);
+      XShmAttach(display_, &shm_info_);
+      if (error_trap.GetLastError() != 0) {
+        LOG(LS_INFO) << "XShmAttach() failed, not using MIT-SHM.";
+        shmdt(shm_info_.shmaddr);
+        shm_info_.shmaddr = NULL;
+        ReleaseImage();
+        return false;
+      }
+    }
+    // The segment goes away once both we and the server have detached.
+    shmctl(shm_info_.shmid, IPC_RMID, NULL);
+
+    if (have_pixmaps && XShmPixmapFormat(display_) == ZPixmap) {
+      XErrorTrap error_trap(display_);
+      shm_pixmap_ = XShmCreatePixmap(display_, window_, shm_info_.shmaddr,
+                                     &shm_info_, width_, height_, attr.depth);
+      if (error_trap.GetLastError() != 0) {
+        shm_pixmap_ = 0;
+      } else {
+        // Include child windows, and don't ask for expose events for the
+        // parts of the source that aren't visible.
+        XGCValues values;
+        values.subwindow_mode = IncludeInferiors;
+        values.graphics_exposures = False;
+        gc_ = XCreateGC(display_, shm_pixmap_,
+                        GCSubwindowMode | GCGraphicsExposures, &values);
+      }
+    }
+    if (!shm_pixmap_) {
+      LOG(LS_INFO) << "No MIT-SHM pixmaps, reading whole frames.";
+    }
+    return true;
+  }
+
+  void ReleaseImage() {
+    if (gc_) {
+      XFreeGC(display_, gc_);
+      gc_ = NULL;
+    }
+    if (shm_pixmap_) {
+      XFreePixmap(display_, shm_pixmap_);
+      shm_pixmap_ = 0;
+    }
+    if (shm_info_.shmaddr) {
+      XShmDetach(display_, &shm_info_);
+      XSync(display_, False);
+      shmdt(shm_info_.shmaddr);
+      shm_info_.shmaddr = NULL;
+    }
+    if (shm_info_.shmid != -1) {
+      shmctl(shm_info_.shmid, IPC_RMID, NULL);
+      shm_info_.shmid = -1;
+      // The shared memory is not XDestroyImage()'s to free.
+      if (image_) {
+        image_->data = NULL;
+      }
+    }
+    if (image_) {
+      XDestroyImage(image_);
+      image_ = NULL;
+    }
+  }
+
+  void InitDamage() {
+    int event_base, error_base, major_version, minor_version;
+    if (!XDamageQueryExtension(display_, &event_base, &error_base) ||
+        !XDamageQueryVersion(display_, &major_version, &minor_version) ||
+        !XFixesQueryExtension(display_, &event_base, &error_base) ||
+        !XFixesQueryVersion(display_, &major_version, &minor_version)) {
+      LOG(LS_INFO) << "XDamage extension not available.";
+      return;
+    }
+    XErrorTrap error_trap(display_);
+    damage_ = XDamageCreate(display_, window_, XDamageReportNonEmpty);
+    damage_region_ = XFixesCreateRegion(display_, NULL, 0);
+    if (error_trap.GetLastError() != 0) {
+      LOG(LS_WARNING) << "Failed to set up XDamage, capturing whole frames.";
+      ReleaseDamage();
+    }
+  }
+
+  void ReleaseDamage() {
+    if (damage_region_) {
+      XFixesDestroyRegion(display_, damage_region_);
+      damage_region_ = 0;
+    }
+    if (damage_) {
+      XDamageDestroy(display_, damage_);
+      damage_ = 0;
+    }
+  }
+
+  Display* display_;
+  Window window_;
+  int width_;
+  int height_;
+  XImage* image_;
+  XShmSegmentInfo shm_info_;
+  Pixmap shm_pixmap_;
+  GC gc_;
+  Damage damage_;
+  XserverRegion damage_region_;
+  bool use_shm_;
+  bool full_frame_;
+
+  DISALLOW_COPY_AND_ASSIGN(XScreenGrabber);
+};
+
+///////////////////////////////////////////////////////////////////////
+// Definition of private class CaptureThread that periodically captures
+// the screen.
+///////////////////////////////////////////////////////////////////////
+class LinuxScreenCapturer::CaptureThread
+    : public talk_base::Thread, public talk_base::MessageHandler {
+ public:
+  explicit CaptureThread(LinuxScreenCapturer* capturer)
+      : capturer_(capturer),
+        finished_(false) {
+  }
+
+  // Override virtual method of parent Thread. Context: Capture Thread.
+  virtual void Run() {
+    int waiting_time_ms = 0;
+    if (capturer_->CaptureFrame(&waiting_time_ms)) {
+      PostDelayed(waiting_time_ms, this);
+      Thread::Run();
+    }
+    finished_ = true;
+  }
+
+  // Override virtual method of parent MessageHandler. Context: Capture Thread.
+  virtual void OnMessage(talk_base::Message* /*pmsg*/) {
+    int waiting_time_ms = 0;
+    if (capturer_->CaptureFrame(&waiting_time_ms)) {
+      PostDelayed(waiting_time_ms, this);
+    } else {
+      Quit();
+    }
+  }
+
+  bool Finished() const { return finished_; }
+
+ private:
+  LinuxScreenCapturer* capturer_;
+  bool finished_;
+
+  DISALLOW_COPY_AND_ASSIGN(CaptureThread);
+};
+
+/////////////////////////////////////////////////////////////////////
+// Implementation of class LinuxScreenCapturer
+/////////////////////////////////////////////////////////////////////
+LinuxScreenCapturer::LinuxScreenCapturer()
+    : capture_thread_(NULL),
+      start_time_ns_(0),
+      use_shm_(true),
+      use_damage_(true) {
+}
+
+LinuxScreenCapturer::~LinuxScreenCapturer() {
+  Stop();
+}
+
+bool LinuxScreenCapturer::Init(const talk_base::WindowId& window) {
+  return InitGrabber(window.id(), 0,
+                     "window:" + talk_base::ToString(window.id()));
+}
+
+bool LinuxScreenCapturer::Init(int desktop_index) {
+  return InitGrabber(0, desktop_index,
+                     "desktop:" + talk_base::ToString(desktop_index));
+}
+
+bool LinuxScreenCapturer::InitGrabber(Window window, int screen,
+                                      const std::string& id) {
+  if (IsRunning()) {
+    LOG(LS_ERROR) << "The screen capturer is already running";
+    return false;
+  }
+  grabber_.reset(new XScreenGrabber());
+  if (!grabber_->Open(window, screen)) {
+    grabber_.reset();
+    return false;
+  }
+
+  // The frame is the size of the window. Frames are captured as fast as the
+  // capture format's interval asks for.
+  std::vector<VideoFormat> supported;
+  supported.push_back(VideoFormat(grabber_->width(), grabber_->height(),
+                                  VideoFormat::kMinimumInterval,
+                                  FOURCC_ARGB));
+  SetId(id);
+  SetSupportedFormats(supported);
+  return true;
+}
+
+CaptureState LinuxScreenCapturer::Start(const VideoFormat& capture_format) {
+  if (IsRunning()) {
+    LOG(LS_ERROR) << "The screen capturer is already running";
+    return CS_FAILED;
+  }
+  if (!grabber_) {
+    LOG(LS_ERROR) << "The screen capturer is not initialized";
+    return CS_NO_DEVICE;
+  }
+  if (!grabber_->Start(use_shm_, use_damage_)) {
+    return CS_FAILED;
+  }
+
+  SetCaptureFormat(&capture_format);
+  start_time_ns_ = kNumNanoSecsPerMilliSec *
+      static_cast<int64>(talk_base::Time());
+  capture_thread_ = new CaptureThread(this);
+  if (!capture_thread_->Start()) {
+    LOG(LS_ERROR) << "Screen capturer '" << GetId() << "' failed to start";
+    delete capture_thread_;
+    capture_thread_ = NULL;
+    grabber_->Stop();
+    return CS_FAILED;
+  }
+  LOG(LS_INFO) << "Screen capturer '" << GetId() << "' started";
+  return CS_RUNNING;
+}
+
+bool LinuxScreenCapturer::IsRunning() {
+  return capture_thread_ && !capture_thread_->Finished();
+}
+
+void LinuxScreenCapturer::Stop() {
+  if (capture_thread_) {
+    capture_thread_->Stop();
+    delete capture_thread_;
+    capture_thread_ = NULL;
+    grabber_->Stop();
+    LOG(LS_INFO) << "Screen capturer '" << GetId() << "' stopped";
+  }
+  SetCaptureFormat(NULL);
+}
+
+bool LinuxScreenCapturer::GetPreferredFourccs(std::vector<uint32>* fourccs) {
+  if (!fourccs) {
+    return false;
+  }
+  fourccs->push_back(FOURCC_ARGB);
+  return true;
+}
+
+// Executed in the context of CaptureThread.
+bool LinuxScreenCapturer::CaptureFrame(int* wait_time_ms) {
+  uint32 start_capture_time_ms = talk_base::Time();
+  if (!grabber_->Capture(&dirty_rects_)) {
+    return false;
+  }
+
+  // The frame points straight at the grabber's buffer, which stays the same
+  // until the next capture or a resize.
+  captured_frame_.width = grabber_->width();
+  captured_frame_.height = grabber_->height();
+  captured_frame_.fourcc = FOURCC_ARGB;
+  captured_frame_.pixel_width = 1;
+  captured_frame_.pixel_height = 1;
+  captured_frame_.time_stamp = kNumNanoSecsPerMilliSec *
+      static_cast<int64>(start_capture_time_ms);
+  captured_frame_.elapsed_time = captured_frame_.time_stamp - start_time_ns_;
+  captured_frame_.data_size = grabber_->data_size();
+  captured_frame_.data = grabber_->data();
+  SignalDirtyRects(this, &captured_frame_, dirty_rects_);
+  SignalFrameCaptured(this, &captured_frame_);
+
+  // Wait out the rest of the capture format's interval.
+  int interval_ms = static_cast<int>(
+      GetCaptureFormat()->interval / kNumNanoSecsPerMilliSec);
+  interval_ms -= talk_base::TimeSince(start_capture_time_ms);
+  *wait_time_ms = talk_base::_max(interval_ms, 0);
+  return true;
+}
+
+}  // namespace cricket
+
+#endif  // HAVE_XDAMAGE
@@ -0,0 +1,119 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// LinuxScreenCapturer captures a desktop or a window from the X server. It
+// reads pixels through MIT-SHM shared memory when the server supports it, and
+// uses XDamage to read back only the parts of the screen that changed since
+// the previous frame. The frame is assembled in place in one buffer that is
+// reused for every frame.
+
+#ifndef TALK_MEDIA_DEVICES_LINUXSCREENCAPTURER_H_
+#define TALK_MEDIA_DEVICES_LINUXSCREENCAPTURER_H_
+
+#ifdef HAVE_XDAMAGE
+
+#include <string>
+#include <vector>
+
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/sigslot.h"
+#include "talk/base/window.h"
+#include "talk/media/base/videocapturer.h"
+
+namespace cricket {
+
+class XScreenGrabber;
+
+class LinuxScreenCapturer : public VideoCapturer {
+ public:
+  // A part of the frame that changed since the previous frame.
+  struct DirtyRect {
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+  typedef std::vector<DirtyRect> DirtyRects;
+
+  LinuxScreenCapturer();
+  virtual ~LinuxScreenCapturer();
+
+  // Initializes the capturer with a window or with the screen at
+  // |desktop_index|.
+  bool Init(const talk_base::WindowId& window);
+  bool Init(int desktop_index);
+
+  // XShm and XDamage are used when the X server has them. Turning them off
+  // falls back to XGetImage of the whole frame, which is mostly useful to
+  // compare the two. Takes effect at the next Start().
+  void set_use_shm(bool use_shm) { use_shm_ = use_shm; }
+  void set_use_damage(bool use_damage) { use_damage_ = use_damage; }
+
+  // Override virtual methods of parent class VideoCapturer.
+  virtual CaptureState Start(const VideoFormat& capture_format);
+  virtual void Stop();
+  virtual bool IsRunning();
+  virtual bool IsScreencast() { return true; }
+
+  // Signalled on the capture thread right before SignalFrameCaptured, with the
+  // parts of the frame that changed. The whole frame is dirty for the first
+  // frame, after a resize, and on every frame when XDamage isn't in use. The
+  // list is empty if nothing changed.
+  sigslot::signal3<LinuxScreenCapturer*, const CapturedFrame*,
+                   const DirtyRects&> SignalDirtyRects;
+
+ protected:
+  // Override virtual methods of parent class VideoCapturer.
+  virtual bool GetPreferredFourccs(std::vector<uint32>* fourccs);
+
+  // Reads the changed parts of the screen, signals the frame and determines
+  // how long to wait for the next one. Returns false if the capture failed,
+  // e.g., because the window went away.
+  bool CaptureFrame(int* wait_time_ms);
+
+ private:
+  class CaptureThread;  // Forward declaration, defined in .cc.
+
+  bool InitGrabber(Window window, int screen, const std::string& id);
+
+  talk_base::scoped_ptr<XScreenGrabber> grabber_;
+  CaptureThread* capture_thread_;
+  CapturedFrame captured_frame_;
+  DirtyRects dirty_rects_;
+  int64 start_time_ns_;  // Time when the capturer starts.
+  bool use_shm_;
+  bool use_damage_;
+
+  DISALLOW_COPY_AND_ASSIGN(LinuxScreenCapturer);
+};
+
+}  // namespace cricket
+
+#endif  // HAVE_XDAMAGE
+
+#endif  // TALK_MEDIA_DEVICES_LINUXSCREENCAPTURER_H_
@@ -0,0 +1,174 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_XDAMAGE
+
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+#include "talk/media/devices/linuxscreencapturer.h"
+
+// After gunit.h, whose None and Bool the X11 macros would clobber.
+#include <X11/Xlib.h>
+
+#ifndef LINUX
+#error Only for Linux
+#endif
+
+// These tests need an X display, e.g. Xvfb with the MIT-SHM and DAMAGE
+// extensions, which it has by default.
+
+namespace {
+
+static const int kTimeout = 5000;
+
+class LinuxScreenCapturerTest : public testing::Test,
+                                public sigslot::has_slots<> {
+ public:
+  LinuxScreenCapturerTest()
+      : frame_count_(0), full_frames_(0), dirty_pixels_(0) {
+  }
+
+  virtual void SetUp() {
+    capturer_.reset(new cricket::LinuxScreenCapturer);
+    capturer_->SignalDirtyRects.connect(
+        this, &LinuxScreenCapturerTest::OnDirtyRects);
+  }
+
+ protected:
+  // Context: capture thread.
+  void OnDirtyRects(cricket::LinuxScreenCapturer* capturer,
+                    const cricket::CapturedFrame* frame,
+                    const cricket::LinuxScreenCapturer::DirtyRects& rects) {
+    ++frame_count_;
+    for (size_t i = 0; i < rects.size(); ++i) {
+      dirty_pixels_ += rects[i].width * rects[i].height;
+      if (rects[i].width == frame->width && rects[i].height == frame->height) {
+        ++full_frames_;
+      }
+    }
+  }
+
+  // Captures the desktop as fast as possible for |duration_ms| while a
+  // square moves across the screen, and logs the frame rate.
+  void RunPerf(const char* name, bool use_shm, bool use_damage,
+               int duration_ms) {
+    Display* display = XOpenDisplay(NULL);
+    ASSERT_TRUE(display != NULL);
+    Window root = XDefaultRootWindow(display);
+    GC gc = XCreateGC(display, root, 0, NULL);
+    XSetSubwindowMode(display, gc, IncludeInferiors);
+
+    ASSERT_TRUE(capturer_->Init(0));
+    capturer_->set_use_shm(use_shm);
+    capturer_->set_use_damage(use_damage);
+    const cricket::VideoFormat& format = capturer_->GetSupportedFormats()->at(0);
+    frame_count_ = 0;
+    dirty_pixels_ = 0;
+    EXPECT_EQ(cricket::CS_RUNNING, capturer_->Start(format));
+    uint32 start = talk_base::Time();
+    for (int i = 0; talk_base::TimeSince(start) < duration_ms; ++i) {
+      XSetForeground(display, gc, (i & 1) ? 0xffffff : 0x000000);
+      XFillRectangle(display, root, gc, (i * 8) % (format.width - 64),
+                     (i * 4) % (format.height - 64), 64, 64);
+      XFlush(display);
+      talk_base::Thread::SleepMs(10);
+    }
+    capturer_->Stop();
+    uint32 elapsed = talk_base::TimeSince(start);
+    LOG(LS_INFO) << name << ": " << frame_count_ * 1000 / elapsed
+                 << " fps at " << format.width << "x" << format.height
+                 << ", " << dirty_pixels_ / talk_base::_max(frame_count_, 1)
+                 << " pixels read per frame";
+    EXPECT_GT(frame_count_, 0);
+
+    XFreeGC(display, gc);
+    XCloseDisplay(display);
+  }
+
+  talk_base::scoped_ptr<cricket::LinuxScreenCapturer> capturer_;
+  int frame_count_;
+  int full_frames_;
+  int64 dirty_pixels_;
+};
+
+TEST_F(LinuxScreenCapturerTest, TestInitDesktop) {
+  EXPECT_TRUE(capturer_->Init(0));
+  EXPECT_EQ("desktop:0", capturer_->GetId());
+  ASSERT_TRUE(NULL != capturer_->GetSupportedFormats());
+  ASSERT_EQ(1U, capturer_->GetSupportedFormats()->size());
+  EXPECT_EQ(static_cast<uint32>(cricket::FOURCC_ARGB),
+            capturer_->GetSupportedFormats()->at(0).fourcc);
+  EXPECT_TRUE(capturer_->IsScreencast());
+  EXPECT_FALSE(capturer_->IsRunning());
+}
+
+TEST_F(LinuxScreenCapturerTest, TestInvalidDesktop) {
+  EXPECT_FALSE(capturer_->Init(100));
+}
+
+// The first frame is dirty all over. With XDamage, later frames are only
+// dirty where something was drawn.
+TEST_F(LinuxScreenCapturerTest, TestCaptureDesktop) {
+  ASSERT_TRUE(capturer_->Init(0));
+  const cricket::VideoFormat format(capturer_->GetSupportedFormats()->at(0));
+  EXPECT_EQ(cricket::CS_RUNNING, capturer_->Start(format));
+  EXPECT_TRUE(capturer_->IsRunning());
+  EXPECT_TRUE_WAIT(frame_count_ >= 10, kTimeout);
+  capturer_->Stop();
+  EXPECT_FALSE(capturer_->IsRunning());
+  EXPECT_EQ(1, full_frames_);
+}
+
+TEST_F(LinuxScreenCapturerTest, TestCaptureWithoutDamage) {
+  ASSERT_TRUE(capturer_->Init(0));
+  capturer_->set_use_damage(false);
+  const cricket::VideoFormat format(capturer_->GetSupportedFormats()->at(0));
+  EXPECT_EQ(cricket::CS_RUNNING, capturer_->Start(format));
+  EXPECT_TRUE_WAIT(frame_count_ >= 10, kTimeout);
+  capturer_->Stop();
+  EXPECT_EQ(frame_count_, full_frames_);
+}
+
+TEST_F(LinuxScreenCapturerTest, DISABLED_PerfXGetImage) {
+  RunPerf("XGetImage", false, false, 1000);
+}
+
+TEST_F(LinuxScreenCapturerTest, DISABLED_PerfXShm) {
+  RunPerf("XShm", true, false, 1000);
+}
+
+TEST_F(LinuxScreenCapturerTest, DISABLED_PerfXShmDamage) {
+  RunPerf("XShm+XDamage", true, true, 1000);
+}
+
+}  // namespace
+
+#endif  // HAVE_XDAMAGE
@@ -138,6 +138,13 @@ class Candidate {
     related_address_ = related_address;
   }
 
+  // The RFC 6544 type of a TCP candidate: TCPTYPE_ACTIVE_STR,
+  // TCPTYPE_PASSIVE_STR or TCPTYPE_SIMOPEN_STR.  Empty for UDP candidates
+  // and for TCP candidates from peers that don't type them, which both
+  // accept and make connections.
+  const std::string& tcptype() const { return tcptype_; }
+  void set_tcptype(const std::string& tcptype) { tcptype_ = tcptype; }
+
   // Determines whether this candidate is equivalent to the given one.
   bool IsEquivalent(const Candidate& c) const {
     // We ignore the network name, since that is just debug information, and
@@ -152,7 +159,8 @@ class Candidate {
            (type_ == c.type_) &&
            (generation_ == c.generation_) &&
            (foundation_ == c.foundation_) &&
-           (related_address_ == c.related_address_);
+           (related_address_ == c.related_address_) &&
+           (tcptype_ == c.tcptype_);
   }
 
   std::string ToString() const {
@@ -160,7 +168,10 @@ class Candidate {
     ost << "Cand[" << id_ << ":" << component_ << ":"
         << type_ << ":" << protocol_ << ":"
         << network_name_ << ":" << address_.ToString() << ":"
-        << username_ << ":" << password_ << "]";
+        << username_ << ":" << password_;
+    if (!tcptype_.empty())
+      ost << ":" << tcptype_;
+    ost << "]";
     return ost.str();
   }
 
@@ -170,7 +181,20 @@ class Candidate {
     //            (2^8)*(local preference) +
     //            (2^0)*(256 - component ID)
     int addr_pref = IPAddressPrecedence(address_.ipaddr());
-    return (type_preference << 24) | (addr_pref << 8) | (256 - component_);
+    // RFC 6544 - 4.2.  TCP candidates of each type get their own range of
+    // local preferences; active ones, which don't need the NAT to let
+    // connections in, come first.
+    // local preference = (2^13)*(direction preference) + (other preference)
+    int direction_pref = 0;
+    if (tcptype_ == TCPTYPE_ACTIVE_STR) {
+      direction_pref = 6;
+    } else if (tcptype_ == TCPTYPE_PASSIVE_STR) {
+      direction_pref = 4;
+    } else if (tcptype_ == TCPTYPE_SIMOPEN_STR) {
+      direction_pref = 2;
+    }
+    int local_pref = (direction_pref << 13) | addr_pref;
+    return (type_preference << 24) | (local_pref << 8) | (256 - component_);
   }
 
  private:
@@ -186,6 +210,7 @@ class Candidate {
   uint32 generation_;
   std::string foundation_;
   talk_base::SocketAddress related_address_;
+  std::string tcptype_;
 };
 
 }  // namespace cricket
@@ -160,6 +160,10 @@ const buzz::StaticQName QN_PRIORITY = { cricket::NS_EMPTY, "priority" };
 const buzz::StaticQName QN_PROTOCOL = { cricket::NS_EMPTY, "protocol" };
 const char ICE_CANDIDATE_TYPE_PEER_STUN[] = "prflx";
 const char ICE_CANDIDATE_TYPE_SERVER_STUN[] = "srflx";
+const buzz::StaticQName QN_TCPTYPE = { cricket::NS_EMPTY, "tcptype" };
+const char TCPTYPE_ACTIVE_STR[] = "active";
+const char TCPTYPE_PASSIVE_STR[] = "passive";
+const char TCPTYPE_SIMOPEN_STR[] = "so";
 // Minimum ufrag length is 4 characters as per RFC5245. We chose 16 because
 // some internal systems expect username to be 16 bytes.
 const int ICE_UFRAG_LENGTH = 16;
@@ -169,6 +169,13 @@ extern const buzz::StaticQName QN_PRIORITY;
 extern const buzz::StaticQName QN_PROTOCOL;
 extern const char ICE_CANDIDATE_TYPE_PEER_STUN[];
 extern const char ICE_CANDIDATE_TYPE_SERVER_STUN[];
+// TCP candidate types (RFC 6544): active candidates only make outgoing
+// connections, passive ones only accept them, and simultaneous-open ones
+// connect to each other at the same time.
+extern const buzz::StaticQName QN_TCPTYPE;
+extern const char TCPTYPE_ACTIVE_STR[];
+extern const char TCPTYPE_PASSIVE_STR[];
+extern const char TCPTYPE_SIMOPEN_STR[];
 extern const int ICE_UFRAG_LENGTH;
 extern const int ICE_PWD_LENGTH;
 extern const int ICE_CANDIDATE_COMPONENT_RTP;
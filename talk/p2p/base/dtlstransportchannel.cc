@@ -282,7 +282,7 @@ int DtlsTransportChannelWrapper::SendPacket(const char* data, size_t size,
           break;
         }
 
-        result = channel_->SendPacket(data, size);
+        result = channel_->SendPacket(data, size, flags & PF_PRIORITY);
       } else {
         result = (dtls_->WriteAll(data, size, NULL, NULL) ==
           talk_base::SR_SUCCESS) ? static_cast<int>(size) : -1;
@@ -290,7 +290,7 @@ int DtlsTransportChannelWrapper::SendPacket(const char* data, size_t size,
       break;
       // Not doing DTLS.
     case STATE_NONE:
-      result = channel_->SendPacket(data, size);
+      result = channel_->SendPacket(data, size, flags & PF_PRIORITY);
       break;
 
     case STATE_CLOSED:  // Can't send anything when we're closed.
@@ -202,6 +202,9 @@ class DtlsTransportChannelWrapper : public TransportChannelImpl {
   virtual void OnCandidate(const Candidate& candidate) {
     channel_->OnCandidate(candidate);
   }
+  virtual void OnCandidates(const Candidates& candidates) {
+    channel_->OnCandidates(candidates);
+  }
 
   // Needed by DtlsTransport.
   TransportChannelImpl* channel() { return channel_; }
@@ -70,7 +70,8 @@ class FakeTransportChannel : public TransportChannelImpl,
         role_(ROLE_UNKNOWN),
         tiebreaker_(0),
         ice_proto_(ICEPROTO_HYBRID),
-        dtls_fingerprint_("", NULL, 0) {
+        dtls_fingerprint_("", NULL, 0),
+        num_candidate_batches_(0) {
   }
   ~FakeTransportChannel() {
     Reset();
@@ -84,6 +85,8 @@ class FakeTransportChannel : public TransportChannelImpl,
   const talk_base::SSLFingerprint& dtls_fingerprint() const {
     return dtls_fingerprint_;
   }
+  const Candidates& remote_candidates() const { return remote_candidates_; }
+  int num_candidate_batches() const { return num_candidate_batches_; }
 
   void SetAsync(bool async) {
     async_ = async;
@@ -151,7 +154,7 @@ class FakeTransportChannel : public TransportChannelImpl,
       return -1;
     }
 
-    if (flags != PF_SRTP_BYPASS && flags != 0) {
+    if ((flags & ~(PF_SRTP_BYPASS | PF_PRIORITY)) != 0) {
       return -1;
     }
 
@@ -173,6 +176,11 @@ class FakeTransportChannel : public TransportChannelImpl,
   virtual void OnSignalingReady() {
   }
   virtual void OnCandidate(const Candidate& candidate) {
+    remote_candidates_.push_back(candidate);
+  }
+  virtual void OnCandidates(const Candidates& candidates) {
+    ++num_candidate_batches_;
+    TransportChannelImpl::OnCandidates(candidates);
   }
 
   virtual void OnMessage(talk_base::Message* msg) {
@@ -251,6 +259,8 @@ class FakeTransportChannel : public TransportChannelImpl,
   std::string ice_ufrag_;
   std::string ice_pwd_;
   talk_base::SSLFingerprint dtls_fingerprint_;
+  Candidates remote_candidates_;
+  int num_candidate_batches_;
 };
 
 // Fake transport class, which can be passed to anything that needs a Transport.
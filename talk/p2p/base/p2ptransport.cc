@@ -137,6 +137,8 @@ bool P2PTransportParser::ParseCandidate(const buzz::XmlElement* elem,
     candidate->set_type(elem->Attr(buzz::QN_TYPE));
   if (elem->HasAttr(QN_NETWORK))
     candidate->set_network_name(elem->Attr(QN_NETWORK));
+  if (elem->HasAttr(QN_TCPTYPE))
+    candidate->set_tcptype(elem->Attr(QN_TCPTYPE));
 
   if (!VerifyUsernameFormat(candidate->username(), error))
     return false;
@@ -207,6 +209,8 @@ bool P2PTransportParser::WriteCandidate(const Candidate& candidate,
     elem->SetAttr(buzz::QN_TYPE, candidate.type());
   if (candidate.network_name().size() > 0)
     elem->SetAttr(QN_NETWORK, candidate.network_name());
+  if (candidate.tcptype().size() > 0)
+    elem->SetAttr(QN_TCPTYPE, candidate.tcptype());
   return true;
 }
 
@@ -31,6 +31,7 @@
 #include "talk/base/common.h"
 #include "talk/base/crc32.h"
 #include "talk/base/logging.h"
+#include "talk/base/packettrace.h"
 #include "talk/base/stringencode.h"
 #include "talk/p2p/base/timeouts.h"
 #include "talk/p2p/base/common.h"
@@ -54,9 +55,26 @@ static const uint32 UNWRITABLE_DELAY = cricket::kPingTimeoutUnWritableDelay;
 // make sure it is pinged at this rate.
 static const uint32 MAX_CURRENT_WRITABLE_DELAY = cricket::kPingMaxCurrentWritableDelay;
 
+// Writable connections other than the current one are only kept as backups,
+// so the delay between their pings doubles, from WRITABLE_DELAY up to this,
+// for as long as they keep answering.
+static const uint32 MAX_BACKUP_WRITABLE_DELAY =
+    cricket::kPingMaxBackupWritableDelay;
+
 // The minimum improvement in RTT that justifies a switch.
 static const double kMinImprovement = 10;
 
+// With latency switching, a writable connection takes over from the best one
+// only if its smoothed RTT, plus its variance, beats the best one's by
+// kMinLatencyImprovement ms and by 1/kLatencyImprovementDivisor of it.  The
+// margin keeps the choice from flapping between paths of similar latency.
+static const uint32 kMinLatencyImprovement = 20;
+static const uint32 kLatencyImprovementDivisor = 4;
+// It also needs this many RTT samples, and may not be losing more than this
+// much more of its pings than the best one.
+static const size_t kMinLatencySamples = 3;
+static const double kMaxLatencyLossIncrease = 0.05;
+
 cricket::PortInterface::CandidateOrigin GetOrigin(cricket::PortInterface* port,
                                          cricket::PortInterface* origin_port) {
   if (!origin_port)
@@ -158,12 +176,14 @@ P2PTransportChannel::P2PTransportChannel(const std::string& content_name,
     allocator_(allocator),
     worker_thread_(talk_base::Thread::Current()),
     incoming_only_(false),
+    latency_switching_(false),
     waiting_for_signaling_(false),
     error_(0),
     best_connection_(NULL),
     sort_dirty_(false),
     was_writable_(false),
     was_timed_out_(true),
+    pacer_(worker_thread_, this),
     protocol_type_(ICEPROTO_GOOGLE),
     role_(ROLE_UNKNOWN),
     tiebreaker_(0) {
@@ -410,6 +430,9 @@ void P2PTransportChannel::OnUnknownAddress(
     new_remote_candidate = *candidate;
     if (ufrag_per_port) {
       new_remote_candidate.set_address(address);
+      // A TCP request comes from wherever the peer connected from, not from
+      // the candidate it advertised as active.
+      new_remote_candidate.set_tcptype("");
     }
   } else {
     // Create a new candidate with this address.
@@ -493,6 +516,22 @@ void P2PTransportChannel::OnCandidate(const Candidate& candidate) {
   SortConnections();
 }
 
+void P2PTransportChannel::OnCandidates(const Candidates& candidates) {
+  ASSERT(worker_thread_ == talk_base::Thread::Current());
+
+  // Pair all of the candidates with our ports before sorting, so that the
+  // sort, the pruning and the channel state update that follow it run once
+  // for the batch rather than once per candidate.
+  connections_.reserve(connections_.size() + candidates.size() * ports_.size());
+  remote_candidates_.reserve(remote_candidates_.size() + candidates.size());
+  for (Candidates::const_iterator it = candidates.begin();
+       it != candidates.end(); ++it) {
+    CreateConnections(*it, NULL, false);
+  }
+
+  SortConnections();
+}
+
 // Creates connections from all of the ports that we care about to the given
 // remote candidate.  The return value is true if we created a connection from
 // the origin port.
@@ -637,6 +676,12 @@ int P2PTransportChannel::SetOption(talk_base::Socket::Option opt, int value) {
     it->second = value;
   }
 
+  // The pacer does the pacing; the option is still passed on, so that the
+  // kernel smooths out the pacer's bursts where it can.
+  if (opt == talk_base::Socket::OPT_PACING_RATE) {
+    pacer_.set_rate(value);
+  }
+
   for (uint32 i = 0; i < ports_.size(); ++i) {
     int val = ports_[i]->SetOption(opt, value);
     if (val < 0) {
@@ -652,7 +697,7 @@ int P2PTransportChannel::SetOption(talk_base::Socket::Option opt, int value) {
 // Send data to the other side, using our best connection.
 int P2PTransportChannel::SendPacket(const char *data, size_t len, int flags) {
   ASSERT(worker_thread_ == talk_base::Thread::Current());
-  if (flags != 0) {
+  if ((flags & ~PF_PRIORITY) != 0) {
     error_ = EINVAL;
     return -1;
   }
@@ -660,10 +705,20 @@ int P2PTransportChannel::SendPacket(const char *data, size_t len, int flags) {
     error_ = EWOULDBLOCK;
     return -1;
   }
+  return pacer_.Send(data, len, (flags & PF_PRIORITY) != 0, &error_);
+}
+
+int P2PTransportChannel::PacerSendPacket(PacketPacer* pacer, const char* data,
+                                         size_t len, int* error) {
+  // The best connection may have gone away while the packet was queued.
+  if (best_connection_ == NULL) {
+    *error = EWOULDBLOCK;
+    return -1;
+  }
   int sent = best_connection_->Send(data, len);
   if (sent <= 0) {
     ASSERT(sent < 0);
-    error_ = best_connection_->GetError();
+    *error = best_connection_->GetError();
   }
   return sent;
 }
@@ -687,6 +742,14 @@ bool P2PTransportChannel::GetStats(ConnectionInfos *infos) {
     info.new_connection = !connection->reported();
     connection->set_reported(true);
     info.rtt = connection->rtt();
+    info.smoothed_rtt = connection->smoothed_rtt();
+    info.rtt_variance = connection->rtt_variance();
+    info.ping_loss = connection->ping_loss();
+    talk_base::Histogram rtt_histogram = connection->rtt_histogram();
+    info.rtt_median = rtt_histogram.ComputePercentile(50);
+    info.rtt_95th_percentile = rtt_histogram.ComputePercentile(95);
+    info.sent_ping_requests = connection->num_pings_sent();
+    info.recv_ping_responses = connection->num_ping_responses();
     info.sent_total_bytes = connection->sent_total_bytes();
     info.sent_bytes_second = connection->sent_bytes_second();
     info.recv_total_bytes = connection->recv_total_bytes();
@@ -760,9 +823,18 @@ void P2PTransportChannel::SortConnections() {
   if (connections_.size() > 0)
     top_connection = connections_[0];
 
-  // If necessary, switch to the new choice.
-  if (ShouldSwitch(best_connection_, top_connection))
+  // If necessary, switch to the new choice.  With latency switching, once
+  // the best connection is writable, other writable connections only take
+  // over from it by being measurably faster.
+  if (latency_switching_ && best_connection_ &&
+      best_connection_->write_state() == Connection::STATE_WRITABLE &&
+      top_connection->write_state() == Connection::STATE_WRITABLE) {
+    Connection* faster_connection = FindFasterConnection();
+    if (faster_connection)
+      SwitchBestConnectionTo(faster_connection);
+  } else if (ShouldSwitch(best_connection_, top_connection)) {
     SwitchBestConnectionTo(top_connection);
+  }
 
   // We can prune any connection for which there is a writable connection on
   // the same network with better or equal prefences.  We leave those with
@@ -970,16 +1042,50 @@ void P2PTransportChannel::OnPing() {
   // which ones are pingable).
   UpdateConnectionStates();
 
-  // Find the oldest pingable connection and have it do a ping.
-  Connection* conn = FindNextPingableConnection();
-  if (conn)
-    conn->Ping(talk_base::Time());
+  // Find the oldest pingable connection that is due and have it do a ping.
+  uint32 now = talk_base::Time();
+  Connection* conn = FindNextPingableConnection(now);
+  if (conn) {
+    UpdatePingInterval(conn);
+    conn->Ping(now);
+    ping_rate_.Update(1);
+  }
+
+  // Ping responses don't change connection states, so with latency switching
+  // look at the new RTT estimates regularly.
+  if (latency_switching_ && writable())
+    RequestSort();
 
   // Post ourselves a message to perform the next ping.
   uint32 delay = writable() ? WRITABLE_DELAY : UNWRITABLE_DELAY;
   thread()->PostDelayed(delay, this, MSG_PING);
 }
 
+// Returns the writable connection with the lowest smoothed RTT that is enough
+// faster than the best connection to be worth switching to, if there is one.
+Connection* P2PTransportChannel::FindFasterConnection() {
+  uint32 best_rtt = best_connection_->smoothed_rtt();
+  uint32 margin = talk_base::_max(kMinLatencyImprovement,
+                                  best_rtt / kLatencyImprovementDivisor);
+  Connection* faster_connection = NULL;
+  for (uint32 i = 0; i < connections_.size(); ++i) {
+    Connection* conn = connections_[i];
+    if (conn == best_connection_ ||
+        conn->write_state() != Connection::STATE_WRITABLE ||
+        conn->num_ping_responses() < kMinLatencySamples ||
+        conn->ping_loss() >
+            best_connection_->ping_loss() + kMaxLatencyLossIncrease ||
+        conn->smoothed_rtt() + conn->rtt_variance() + margin > best_rtt) {
+      continue;
+    }
+    if (!faster_connection ||
+        conn->smoothed_rtt() < faster_connection->smoothed_rtt()) {
+      faster_connection = conn;
+    }
+  }
+  return faster_connection;
+}
+
 // Is the connection in a state for us to even consider pinging the other side?
 bool P2PTransportChannel::IsPingable(Connection* conn) {
   // An unconnected connection cannot be written to at all, so pinging is out
@@ -1002,26 +1108,64 @@ bool P2PTransportChannel::IsPingable(Connection* conn) {
   }
 }
 
-// Returns the next pingable connection to ping.  This will be the oldest
-// pingable connection unless we have a writable connection that is past the
-// maximum acceptable ping delay.
-Connection* P2PTransportChannel::FindNextPingableConnection() {
-  uint32 now = talk_base::Time();
+// Returns how long to wait after the last ping on |conn| before pinging it
+// again.  The best connection is pinged at a steady rate to keep consent
+// fresh, and faster once a ping goes unanswered so that a failure is still
+// detected quickly; other writable connections are backups and are pinged
+// ever more rarely; anything not yet writable may be checked on every tick.
+uint32 P2PTransportChannel::GetPingDelay(Connection* conn) const {
+  if (conn->write_state() != Connection::STATE_WRITABLE)
+    return 0;
+  if (conn == best_connection_) {
+    return (conn->last_ping_response_received() >= conn->last_ping_sent()) ?
+        MAX_CURRENT_WRITABLE_DELAY : WRITABLE_DELAY;
+  }
+  return talk_base::_max(conn->ping_interval(), WRITABLE_DELAY);
+}
+
+// Doubles the delay before the next ping on a backup connection if it
+// answered its last one, and starts over otherwise, so that a failing
+// backup is noticed as quickly as before.
+void P2PTransportChannel::UpdatePingInterval(Connection* conn) {
+  if (conn == best_connection_ ||
+      conn->write_state() != Connection::STATE_WRITABLE) {
+    conn->set_ping_interval(0);
+  } else if (conn->last_ping_response_received() >= conn->last_ping_sent()) {
+    conn->set_ping_interval(
+        talk_base::_min(2 * GetPingDelay(conn), MAX_BACKUP_WRITABLE_DELAY));
+  } else {
+    conn->set_ping_interval(WRITABLE_DELAY);
+  }
+
+  if (conn == best_connection_) {
+    ++ping_counts_.consent;
+  } else if (conn->write_state() == Connection::STATE_WRITABLE) {
+    ++ping_counts_.backup;
+  } else {
+    ++ping_counts_.check;
+  }
+}
+
+// Returns the next pingable connection to ping.  This will be the writable
+// best connection if it is due, and otherwise the oldest pingable connection
+// that is due.
+Connection* P2PTransportChannel::FindNextPingableConnection(uint32 now) {
   if (best_connection_ &&
       (best_connection_->write_state() == Connection::STATE_WRITABLE) &&
       (best_connection_->last_ping_sent()
-       + MAX_CURRENT_WRITABLE_DELAY <= now)) {
+       + GetPingDelay(best_connection_) <= now)) {
     return best_connection_;
   }
 
   Connection* oldest_conn = NULL;
   uint32 oldest_time = 0xFFFFFFFF;
   for (uint32 i = 0; i < connections_.size(); ++i) {
-    if (IsPingable(connections_[i])) {
-      if (connections_[i]->last_ping_sent() < oldest_time) {
-        oldest_time = connections_[i]->last_ping_sent();
-        oldest_conn = connections_[i];
-      }
+    Connection* conn = connections_[i];
+    if (IsPingable(conn) &&
+        conn->last_ping_sent() < oldest_time &&
+        conn->last_ping_sent() + GetPingDelay(conn) <= now) {
+      oldest_time = conn->last_ping_sent();
+      oldest_conn = conn;
     }
   }
   return oldest_conn;
@@ -1094,6 +1238,7 @@ void P2PTransportChannel::OnPortDestroyed(PortInterface* port) {
 void P2PTransportChannel::OnReadPacket(Connection *connection, const char *data,
                                        size_t len) {
   ASSERT(worker_thread_ == talk_base::Thread::Current());
+  talk_base::PacketTrace::Mark(talk_base::PS_RECV_CONNECTION);
 
   // Do not deliver, if packet doesn't belong to the correct transport channel.
   if (!FindConnection(connection))
@@ -40,8 +40,10 @@
 #include <map>
 #include <vector>
 #include <string>
+#include "talk/base/ratetracker.h"
 #include "talk/base/sigslot.h"
 #include "talk/p2p/base/candidate.h"
+#include "talk/p2p/base/packetpacer.h"
 #include "talk/p2p/base/portinterface.h"
 #include "talk/p2p/base/portallocator.h"
 #include "talk/p2p/base/transport.h"
@@ -66,8 +68,18 @@ class RemoteCandidate : public Candidate {
 // P2PTransportChannel manages the candidates and connection process to keep
 // two P2P clients connected to each other.
 class P2PTransportChannel : public TransportChannelImpl,
-                            public talk_base::MessageHandler {
+                            public talk_base::MessageHandler,
+                            public IPacketPacerNotify {
  public:
+  // Pings sent so far, by what they were for: keeping consent on the best
+  // connection, keeping backup connections alive, or checking connectivity.
+  struct PingCounts {
+    PingCounts() : consent(0), backup(0), check(0) {}
+    size_t consent;
+    size_t backup;
+    size_t check;
+  };
+
   P2PTransportChannel(const std::string& content_name,
                       int component,
                       P2PTransport* transport,
@@ -86,15 +98,24 @@ class P2PTransportChannel : public TransportChannelImpl,
   virtual void Reset();
   virtual void OnSignalingReady();
   virtual void OnCandidate(const Candidate& candidate);
+  virtual void OnCandidates(const Candidates& candidates);
 
   // From TransportChannel:
+  // Packets are paced when OPT_PACING_RATE is set; see PacketPacer.
   virtual int SendPacket(const char *data, size_t len, int flags);
   virtual int SetOption(talk_base::Socket::Option opt, int value);
   virtual int GetError() { return error_; }
   virtual bool GetStats(std::vector<ConnectionInfo>* stats);
 
   const Connection* best_connection() const { return best_connection_; }
+  const PacketPacer* pacer() const { return &pacer_; }
+  const PingCounts& ping_counts() const { return ping_counts_; }
+  // Pings sent per second, over the last second.
+  size_t ping_rate() { return ping_rate_.units_second(); }
   void set_incoming_only(bool value) { incoming_only_ = value; }
+  // When set, a writable connection with a clearly lower smoothed RTT takes
+  // over from the best connection even if its candidates are less preferred.
+  void set_latency_switching(bool value) { latency_switching_ = value; }
 
   // Note: This is only for testing purpose.
   // |ports_| should not be changed from outside.
@@ -124,7 +145,10 @@ class P2PTransportChannel : public TransportChannelImpl,
   void RememberRemoteCandidate(const Candidate& remote_candidate,
                                PortInterface* origin_port);
   bool IsPingable(Connection* conn);
-  Connection* FindNextPingableConnection();
+  uint32 GetPingDelay(Connection* conn) const;
+  void UpdatePingInterval(Connection* conn);
+  Connection* FindNextPingableConnection(uint32 now);
+  Connection* FindFasterConnection();
   int NumPingableConnections();
   void AddAllocatorSession(PortAllocatorSession* session);
 
@@ -149,6 +173,8 @@ class P2PTransportChannel : public TransportChannelImpl,
   void OnUseCandidate(Connection* conn);
 
   virtual void OnMessage(talk_base::Message *pmsg);
+  virtual int PacerSendPacket(PacketPacer* pacer, const char* data,
+                              size_t len, int* error);
   void OnSort();
   void OnPing();
 
@@ -156,6 +182,7 @@ class P2PTransportChannel : public TransportChannelImpl,
   PortAllocator *allocator_;
   talk_base::Thread *worker_thread_;
   bool incoming_only_;
+  bool latency_switching_;
   bool waiting_for_signaling_;
   int error_;
   std::vector<PortAllocatorSession*> allocator_sessions_;
@@ -166,6 +193,9 @@ class P2PTransportChannel : public TransportChannelImpl,
   bool sort_dirty_;  // indicates whether another sort is needed right now
   bool was_writable_;
   bool was_timed_out_;
+  PacketPacer pacer_;
+  PingCounts ping_counts_;
+  talk_base::RateTracker ping_rate_;
   typedef std::map<talk_base::Socket::Option, int> OptionMap;
   OptionMap options_;
   std::string ice_ufrag_;
@@ -35,11 +35,13 @@
 #include "talk/base/physicalsocketserver.h"
 #include "talk/base/proxyserver.h"
 #include "talk/base/socketaddress.h"
+#include "talk/base/stringutils.h"
 #include "talk/base/thread.h"
 #include "talk/base/virtualsocketserver.h"
 #include "talk/p2p/base/p2ptransportchannel.h"
 #include "talk/p2p/base/testrelayserver.h"
 #include "talk/p2p/base/teststunserver.h"
+#include "talk/p2p/base/timeouts.h"
 #include "talk/p2p/client/basicportallocator.h"
 
 using cricket::kDefaultPortAllocatorFlags;
@@ -51,6 +53,10 @@ static const int kDefaultTimeout = 1000;
 static const int kOnlyLocalPorts = cricket::PORTALLOCATOR_DISABLE_STUN |
                                    cricket::PORTALLOCATOR_DISABLE_RELAY |
                                    cricket::PORTALLOCATOR_DISABLE_TCP;
+static const int kOnlyIceTcpPorts = cricket::PORTALLOCATOR_DISABLE_UDP |
+                                    cricket::PORTALLOCATOR_DISABLE_STUN |
+                                    cricket::PORTALLOCATOR_DISABLE_RELAY |
+                                    cricket::PORTALLOCATOR_ENABLE_ICE_TCP;
 // Addresses on the public internet.
 static const SocketAddress kPublicAddrs[2] =
     { SocketAddress("11.11.11.11", 0), SocketAddress("22.22.22.22", 0) };
@@ -308,6 +314,7 @@ class P2PTransportChannelTestBase : public testing::Test,
     talk_base::InitRandom(NULL, 0);
   }
 
+  talk_base::VirtualSocketServer* virtual_socket_server() { return vss_.get(); }
   talk_base::NATSocketServer* nat() { return nss_.get(); }
   talk_base::FirewallSocketServer* fw() { return ss_.get(); }
 
@@ -905,6 +912,7 @@ TEST_F(P2PTransportChannelTest, GetStats) {
   EXPECT_EQ(10 * 36U, infos[0].sent_total_bytes);
   EXPECT_EQ(10 * 36U, infos[0].recv_total_bytes);
   EXPECT_GT(infos[0].rtt, 0U);
+  EXPECT_GT(infos[0].sent_ping_requests, 0U);
   DestroyChannels();
 }
 
@@ -972,6 +980,150 @@ TEST_F(P2PTransportChannelTest, IncomingOnlyOpen) {
   DestroyChannels();
 }
 
+// Test that with ICE-TCP, peers connect from an active candidate to a passive
+// one, and see the connection accepted on the other end as coming from an
+// untyped candidate at the address it was made from.
+TEST_F(P2PTransportChannelTest, TestIceTcpActivePassive) {
+  AddAddress(0, kPublicAddrs[0]);
+  AddAddress(1, kPublicAddrs[1]);
+  SetAllocatorFlags(0, kOnlyIceTcpPorts);
+  SetAllocatorFlags(1, kOnlyIceTcpPorts);
+
+  CreateChannels(1);
+  EXPECT_TRUE_WAIT(ep1_ch1()->readable() && ep1_ch1()->writable() &&
+                   ep2_ch1()->readable() && ep2_ch1()->writable(),
+                   3000);
+  ASSERT_TRUE(ep1_ch1()->best_connection() != NULL);
+  const cricket::Candidate* local = LocalCandidate(ep1_ch1());
+  const cricket::Candidate* remote = RemoteCandidate(ep1_ch1());
+  EXPECT_EQ("tcp", local->protocol());
+  if (local->tcptype() == cricket::TCPTYPE_ACTIVE_STR) {
+    EXPECT_EQ(cricket::TCPTYPE_PASSIVE_STR, remote->tcptype());
+  } else {
+    EXPECT_EQ(cricket::TCPTYPE_PASSIVE_STR, local->tcptype());
+    EXPECT_EQ("", remote->tcptype());
+  }
+
+  DestroyChannels();
+}
+
+// Test that with ICE-TCP, peers that can't accept connections from each
+// other still connect, by opening one simultaneously from both ends.
+TEST_F(P2PTransportChannelTest, TestIceTcpSimultaneousOpen) {
+  const int kMinPort = 10000;
+  AddAddress(0, kPublicAddrs[0]);
+  AddAddress(1, kPublicAddrs[1]);
+  SetAllocatorFlags(0, kOnlyIceTcpPorts);
+  SetAllocatorFlags(1, kOnlyIceTcpPorts);
+  // The listening socket takes the first port of the range.  Nothing gets
+  // through to it.
+  GetAllocator(0)->SetPortRange(kMinPort, kMinPort + 10);
+  GetAllocator(1)->SetPortRange(kMinPort, kMinPort + 10);
+  fw()->AddRule(false, talk_base::FP_TCP, SocketAddress(),
+                SocketAddress(kPublicAddrs[0].ipaddr(), kMinPort));
+  fw()->AddRule(false, talk_base::FP_TCP, SocketAddress(),
+                SocketAddress(kPublicAddrs[1].ipaddr(), kMinPort));
+  // The connection requests need to cross in flight.
+  virtual_socket_server()->EnableSimulatedTime();
+  virtual_socket_server()->set_delay_mean(20);
+  virtual_socket_server()->UpdateDelayDistribution();
+
+  CreateChannels(1);
+  EXPECT_TRUE_WAIT(ep1_ch1()->readable() && ep1_ch1()->writable() &&
+                   ep2_ch1()->readable() && ep2_ch1()->writable(),
+                   5000);
+  ASSERT_TRUE(ep1_ch1()->best_connection() != NULL);
+  ASSERT_TRUE(ep2_ch1()->best_connection() != NULL);
+  EXPECT_EQ(cricket::TCPTYPE_SIMOPEN_STR, LocalCandidate(ep1_ch1())->tcptype());
+  EXPECT_EQ(cricket::TCPTYPE_SIMOPEN_STR,
+            RemoteCandidate(ep1_ch1())->tcptype());
+  EXPECT_EQ(cricket::TCPTYPE_SIMOPEN_STR, LocalCandidate(ep2_ch1())->tcptype());
+
+  DestroyChannels();
+}
+
+// Test that a burst of remote candidates handed to a channel at once gets
+// paired with every port.
+TEST_F(P2PTransportChannelTest, TestRemoteCandidateBatch) {
+  const int kNumLocal = 3;
+  const int kNumRemote = 4;
+  for (int i = 0; i < kNumLocal; ++i) {
+    AddAddress(0, SocketAddress(talk_base::IPAddress(0x0B0B0C00 + i), 0));
+  }
+  SetAllocatorFlags(0, kOnlyLocalPorts);
+  SetAllocatorFlags(1, kOnlyLocalPorts);
+  CreateChannels(1);
+  EXPECT_EQ_WAIT(static_cast<size_t>(kNumLocal), ep1_ch1()->ports().size(),
+                 5000);
+
+  cricket::Candidates candidates;
+  for (int i = 0; i < kNumRemote; ++i) {
+    candidates.push_back(cricket::Candidate(
+        "", ep1_ch1()->component(), "udp",
+        SocketAddress(talk_base::IPAddress(0x2C2C2C00 + i), 1000),
+        2130706432 - i, "remoteuser", "remotepass", cricket::LOCAL_PORT_TYPE,
+        "", 0, talk_base::ToString(i)));
+  }
+  ep1_ch1()->OnCandidates(candidates);
+
+  std::vector<cricket::ConnectionInfo> infos;
+  ASSERT_TRUE(ep1_ch1()->GetStats(&infos));
+  EXPECT_EQ(static_cast<size_t>(kNumLocal * kNumRemote), infos.size());
+
+  DestroyChannels();
+}
+
+// Test that a burst of remote candidates handed to a channel at once gets
+// paired with every port, and compare the time that takes with handing them
+// over one at a time.
+TEST_F(P2PTransportChannelTest, DISABLED_TestRemoteCandidateBatchPerf) {
+  const int kNumLocal = 50;
+  const int kNumRemote = 50;
+  for (int i = 0; i < kNumLocal; ++i) {
+    AddAddress(0, SocketAddress(talk_base::IPAddress(0x0B0B0C00 + i), 0));
+  }
+  // The callee has no addresses, so only our candidates get paired.
+  SetAllocatorFlags(0, kOnlyLocalPorts);
+  SetAllocatorFlags(1, kOnlyLocalPorts);
+  CreateChannels(2);
+  EXPECT_EQ_WAIT(static_cast<size_t>(kNumLocal), ep1_ch1()->ports().size(),
+                 5000);
+  EXPECT_EQ_WAIT(static_cast<size_t>(kNumLocal), ep1_ch2()->ports().size(),
+                 5000);
+
+  cricket::Candidates candidates1, candidates2;
+  for (int i = 0; i < kNumRemote; ++i) {
+    cricket::Candidate candidate(
+        "", ep1_ch1()->component(), "udp",
+        SocketAddress(talk_base::IPAddress(0x2C2C2C00 + i), 1000),
+        2130706432 - i, "remoteuser", "remotepass", cricket::LOCAL_PORT_TYPE,
+        "", 0, talk_base::ToString(i));
+    candidates1.push_back(candidate);
+    candidate.set_component(ep1_ch2()->component());
+    candidates2.push_back(candidate);
+  }
+
+  uint32 start = talk_base::Time();
+  for (size_t i = 0; i < candidates1.size(); ++i) {
+    ep1_ch1()->OnCandidate(candidates1[i]);
+  }
+  uint32 one_at_a_time = talk_base::TimeSince(start);
+  start = talk_base::Time();
+  ep1_ch2()->OnCandidates(candidates2);
+  uint32 batched = talk_base::TimeSince(start);
+
+  std::vector<cricket::ConnectionInfo> infos1, infos2;
+  ASSERT_TRUE(ep1_ch1()->GetStats(&infos1));
+  ASSERT_TRUE(ep1_ch2()->GetStats(&infos2));
+  EXPECT_EQ(static_cast<size_t>(kNumLocal * kNumRemote), infos1.size());
+  EXPECT_EQ(infos1.size(), infos2.size());
+  LOG(LS_INFO) << "Pairing " << kNumLocal << "x" << kNumRemote
+               << " candidates took " << one_at_a_time
+               << " ms one at a time, " << batched << " ms batched";
+
+  DestroyChannels();
+}
+
 // Test what happens when we have 2 users behind the same NAT. This can lead
 // to interesting behavior because the STUN server will only give out the
 // address of the outermost NAT.
@@ -1009,6 +1161,137 @@ TEST_F(P2PTransportChannelSameNatTest, TestConesBehindSameCone) {
 // In the future we will try different RTTs and configs for the different
 // interfaces, so that we can simulate a user with Ethernet and VPN networks.
 class P2PTransportChannelMultihomedTest : public P2PTransportChannelTestBase {
+ protected:
+  // Gives each of the caller's two networks its own path to the callee, and
+  // waits for the channels to go writable, in simulated time.
+  void CreateTwoPathChannels() {
+    AddAddress(0, kPublicAddrs[0]);
+    AddAddress(0, kAlternateAddrs[0]);
+    AddAddress(1, kPublicAddrs[1]);
+    // Use only local ports for simplicity.
+    SetAllocatorFlags(0, kOnlyLocalPorts);
+    SetAllocatorFlags(1, kOnlyLocalPorts);
+    virtual_socket_server()->EnableSimulatedTime();
+
+    CreateChannels(1);
+    EXPECT_TRUE_WAIT(ep1_ch1()->readable() && ep1_ch1()->writable() &&
+                     ep2_ch1()->readable() && ep2_ch1()->writable(),
+                     1000);
+  }
+
+  // Returns the caller's local address that is not |addr|.
+  static SocketAddress OtherCallerAddress(const SocketAddress& addr) {
+    return addr.EqualIPs(kPublicAddrs[0]) ? kAlternateAddrs[0] :
+                                            kPublicAddrs[0];
+  }
+
+  // Sets the one-way delay, and optionally loss, in both directions between
+  // the caller's |addr| and the callee.
+  void SetPath(const SocketAddress& addr, uint32 delay, double loss) {
+    talk_base::LinkModel model;
+    model.delay_mean = delay;
+    model.loss_in_good = loss;
+    SocketAddress local(addr.ipaddr(), 0);
+    SocketAddress remote(kPublicAddrs[1].ipaddr(), 0);
+    virtual_socket_server()->SetLinkModel(local, remote, model);
+    virtual_socket_server()->SetLinkModel(remote, local, model);
+  }
+
+  void RunFor(int ms) {
+    uint32 start = talk_base::Time();
+    while (talk_base::TimeSince(start) < ms) {
+      talk_base::Thread::Current()->ProcessMessages(1000);
+    }
+  }
+
+  // Returns the stats of the caller's connection from |addr|.
+  cricket::ConnectionInfo GetCallerInfo(const SocketAddress& addr) {
+    cricket::ConnectionInfos infos;
+    EXPECT_TRUE(ep1_ch1()->GetStats(&infos));
+    for (size_t i = 0; i < infos.size(); ++i) {
+      if (infos[i].local_candidate.address().EqualIPs(addr))
+        return infos[i];
+    }
+    ADD_FAILURE() << "No connection from " << addr.ToString();
+    return cricket::ConnectionInfo();
+  }
+
+  // A call between the two endpoints on a pair of channels of its own, for
+  // tests that need more calls than the fixture's two channels. Candidates
+  // are passed straight across, without a signaling delay.
+  class IdleCall : public talk_base::MessageHandler,
+                   public sigslot::has_slots<> {
+   public:
+    IdleCall(P2PTransportChannelMultihomedTest* test, int index) {
+      char ufrag[17], pwd[25];
+      talk_base::sprintfn(ufrag, sizeof(ufrag), "IDLECALLERUF%04d", index);
+      talk_base::sprintfn(pwd, sizeof(pwd), "IDLECALLERPASSWORD%06d", index);
+      caller_.reset(CreateChannel(test, 0, ufrag, pwd));
+      talk_base::sprintfn(ufrag, sizeof(ufrag), "IDLECALLEEUF%04d", index);
+      talk_base::sprintfn(pwd, sizeof(pwd), "IDLECALLEEPASSWORD%06d", index);
+      callee_.reset(CreateChannel(test, 1, ufrag, pwd));
+    }
+
+    cricket::P2PTransportChannel* caller() { return caller_.get(); }
+    cricket::P2PTransportChannel* callee() { return callee_.get(); }
+    bool writable() const {
+      return caller_->writable() && callee_->writable();
+    }
+
+   private:
+    struct CandidateData : public talk_base::MessageData {
+      CandidateData(cricket::P2PTransportChannel* ch,
+                    const cricket::Candidate& c)
+          : channel(ch), candidate(c) {
+      }
+      cricket::P2PTransportChannel* channel;
+      cricket::Candidate candidate;
+    };
+
+    cricket::P2PTransportChannel* CreateChannel(
+        P2PTransportChannelMultihomedTest* test, int endpoint,
+        const std::string& ice_ufrag, const std::string& ice_pwd) {
+      cricket::P2PTransportChannel* channel = new cricket::P2PTransportChannel(
+          "idle call", cricket::ICE_CANDIDATE_COMPONENT_DEFAULT, NULL,
+          test->GetAllocator(endpoint));
+      channel->SignalRequestSignaling.connect(
+          this, &IdleCall::OnRequestSignaling);
+      channel->SignalCandidateReady.connect(this, &IdleCall::OnCandidate);
+      Endpoint* ep = test->GetEndpoint(endpoint);
+      channel->SetIceProtocolType(ep->protocol_type());
+      channel->SetIceUfrag(ice_ufrag);
+      channel->SetIcePwd(ice_pwd);
+      channel->SetRole(ep->role());
+      channel->SetTiebreaker(ep->GetTiebreaker());
+      channel->Connect();
+      return channel;
+    }
+    void OnRequestSignaling(cricket::TransportChannelImpl* channel) {
+      channel->OnSignalingReady();
+    }
+    void OnCandidate(cricket::TransportChannelImpl* ch,
+                     const cricket::Candidate& c) {
+      cricket::P2PTransportChannel* remote =
+          (ch == caller_.get()) ? callee_.get() : caller_.get();
+      talk_base::Thread::Current()->Post(this, 0,
+                                         new CandidateData(remote, c));
+    }
+    virtual void OnMessage(talk_base::Message* msg) {
+      talk_base::scoped_ptr<CandidateData> data(
+          static_cast<CandidateData*>(msg->pdata));
+      data->channel->OnCandidate(data->candidate);
+    }
+
+    talk_base::scoped_ptr<cricket::P2PTransportChannel> caller_;
+    talk_base::scoped_ptr<cricket::P2PTransportChannel> callee_;
+  };
+
+  // Returns all of the pings |channel| has sent so far.
+  static size_t TotalPings(const cricket::P2PTransportChannel* channel) {
+    const cricket::P2PTransportChannel::PingCounts& counts =
+        channel->ping_counts();
+    return counts.consent + counts.backup + counts.check;
+  }
 };
 
 // Test that we can establish connectivity when both peers are multihomed.
@@ -1058,6 +1341,165 @@ TEST_F(P2PTransportChannelMultihomedTest, TestFailover) {
   DestroyChannels();
 }
 
+// Test that an idle multihomed call keeps consent fresh on the best connection
+// and its backup alive on the other network, while pinging the backup less
+// and less often.
+TEST_F(P2PTransportChannelMultihomedTest, TestIdlePingBackoff) {
+  CreateTwoPathChannels();
+  const cricket::Connection* best_connection = ep1_ch1()->best_connection();
+  ASSERT_TRUE(best_connection != NULL);
+  cricket::P2PTransportChannel::PingCounts start = ep1_ch1()->ping_counts();
+
+  // Let a minute go by without any media.
+  const int kIdleTime = 60000;
+  RunFor(kIdleTime);
+
+  EXPECT_TRUE(ep1_ch1()->writable() && ep2_ch1()->writable());
+  EXPECT_EQ(best_connection, ep1_ch1()->best_connection());
+  // Both of the caller's connections, one per network, are still writable,
+  // and the callee still hears from both.
+  cricket::ConnectionInfos infos;
+  ASSERT_TRUE(ep1_ch1()->GetStats(&infos));
+  ASSERT_EQ(2U, infos.size());
+  for (size_t i = 0; i < infos.size(); ++i) {
+    EXPECT_TRUE(infos[i].writable);
+  }
+  ASSERT_TRUE(ep2_ch1()->GetStats(&infos));
+  ASSERT_EQ(2U, infos.size());
+  for (size_t i = 0; i < infos.size(); ++i) {
+    EXPECT_TRUE(infos[i].readable);
+  }
+
+  // The best connection is pinged about once every
+  // kPingMaxCurrentWritableDelay; a fixed schedule would have pinged
+  // something on every kPingTimeoutWritableDelay tick.
+  const cricket::P2PTransportChannel::PingCounts& end =
+      ep1_ch1()->ping_counts();
+  size_t consent = end.consent - start.consent;
+  size_t backup = end.backup - start.backup;
+  LOG(LS_INFO) << "Idle pings: consent=" << consent << " backup=" << backup;
+  EXPECT_GE(consent, kIdleTime / cricket::kPingMaxCurrentWritableDelay - 10U);
+  EXPECT_GE(backup, kIdleTime / cricket::kPingMaxBackupWritableDelay - 1U);
+  EXPECT_LE(backup, kIdleTime / cricket::kPingMaxCurrentWritableDelay / 4U);
+  EXPECT_LT(consent + backup,
+            kIdleTime / cricket::kPingTimeoutWritableDelay * 2U / 3U);
+  DestroyChannels();
+}
+
+// Test that a media server's worth of idle calls, each with a backup path,
+// keeps the total ping rate well under what pinging on every tick of every
+// channel would cost, while every call stays writable.
+TEST_F(P2PTransportChannelMultihomedTest, TestManyIdleCallsPingRate) {
+  CreateTwoPathChannels();
+  const int kNumCalls = 20;
+  std::vector<IdleCall*> calls;
+  for (int i = 0; i < kNumCalls; ++i) {
+    calls.push_back(new IdleCall(this, i));
+  }
+  for (int i = 0; i < kNumCalls; ++i) {
+    EXPECT_TRUE_WAIT(calls[i]->writable(), 1000);
+  }
+  size_t start = 0;
+  for (int i = 0; i < kNumCalls; ++i) {
+    start += TotalPings(calls[i]->caller()) + TotalPings(calls[i]->callee());
+  }
+
+  const int kIdleTime = 60000;
+  RunFor(kIdleTime);
+
+  size_t pings = 0;
+  for (int i = 0; i < kNumCalls; ++i) {
+    EXPECT_TRUE(calls[i]->writable());
+    cricket::ConnectionInfos infos;
+    ASSERT_TRUE(calls[i]->caller()->GetStats(&infos));
+    EXPECT_EQ(2U, infos.size());
+    pings += TotalPings(calls[i]->caller()) + TotalPings(calls[i]->callee());
+  }
+  pings -= start;
+  // Each of the 2 * kNumCalls channels must keep consent fresh on its best
+  // connection; on a fixed schedule each would also ping on every tick.
+  const size_t kChannels = 2 * kNumCalls;
+  LOG(LS_INFO) << "Idle pings for " << kNumCalls << " calls: " << pings;
+  EXPECT_GE(pings,
+            kChannels * (kIdleTime / cricket::kPingMaxCurrentWritableDelay - 10));
+  EXPECT_LT(pings,
+            kChannels * (kIdleTime / cricket::kPingTimeoutWritableDelay) * 2 / 3);
+
+  for (int i = 0; i < kNumCalls; ++i) {
+    delete calls[i];
+  }
+  DestroyChannels();
+}
+
+// Test that the preferred path is kept, however slow, unless latency
+// switching is turned on.
+TEST_F(P2PTransportChannelMultihomedTest, TestNoLatencySwitchingByDefault) {
+  CreateTwoPathChannels();
+  SocketAddress slow = LocalCandidate(ep1_ch1())->address();
+  SocketAddress fast = OtherCallerAddress(slow);
+  SetPath(slow, 100, 0);
+  SetPath(fast, 10, 0);
+
+  RunFor(20000);
+  EXPECT_TRUE(LocalCandidate(ep1_ch1())->address().EqualIPs(slow));
+  EXPECT_NEAR(200, GetCallerInfo(slow).smoothed_rtt, 20);
+  EXPECT_NEAR(20, GetCallerInfo(fast).smoothed_rtt, 10);
+  DestroyChannels();
+}
+
+// Test that with latency switching, media moves to a clearly faster path, but
+// not to one that is only slightly faster, and moves back when the faster
+// path slows down.
+TEST_F(P2PTransportChannelMultihomedTest, TestLatencySwitching) {
+  CreateTwoPathChannels();
+  ep1_ch1()->set_latency_switching(true);
+  SocketAddress first = LocalCandidate(ep1_ch1())->address();
+  SocketAddress second = OtherCallerAddress(first);
+
+  // 200 ms against 20 ms round trips.
+  SetPath(first, 100, 0);
+  SetPath(second, 10, 0);
+  EXPECT_TRUE_WAIT(LocalCandidate(ep1_ch1())->address().EqualIPs(second),
+                   20000);
+  EXPECT_TRUE(ep1_ch1()->writable());
+  cricket::ConnectionInfo info = GetCallerInfo(second);
+  EXPECT_TRUE(info.best_connection);
+  EXPECT_NEAR(20, info.smoothed_rtt, 10);
+  EXPECT_GE(info.recv_ping_responses, 3U);
+  EXPECT_EQ(0, info.ping_loss);
+
+  // 30 ms against 20 ms isn't enough of a difference to switch back.
+  SetPath(first, 15, 0);
+  RunFor(60000);
+  EXPECT_TRUE(LocalCandidate(ep1_ch1())->address().EqualIPs(second));
+
+  // 30 ms against 300 ms is.
+  SetPath(second, 150, 0);
+  EXPECT_TRUE_WAIT(LocalCandidate(ep1_ch1())->address().EqualIPs(first),
+                   60000);
+  EXPECT_TRUE(ep1_ch1()->writable());
+  DestroyChannels();
+}
+
+// Test that latency switching doesn't move media to a faster path that loses
+// pings.
+TEST_F(P2PTransportChannelMultihomedTest, TestLatencySwitchingAvoidsLoss) {
+  CreateTwoPathChannels();
+  ep1_ch1()->set_latency_switching(true);
+  SocketAddress slow = LocalCandidate(ep1_ch1())->address();
+  SocketAddress lossy = OtherCallerAddress(slow);
+  SetPath(slow, 100, 0);
+  SetPath(lossy, 10, 0.3);
+
+  RunFor(60000);
+  EXPECT_TRUE(LocalCandidate(ep1_ch1())->address().EqualIPs(slow));
+  cricket::ConnectionInfo info = GetCallerInfo(lossy);
+  EXPECT_GT(info.ping_loss, 0);
+  EXPECT_LT(info.recv_ping_responses, info.sent_ping_requests);
+  EXPECT_EQ(0, GetCallerInfo(slow).ping_loss);
+  DestroyChannels();
+}
+
 // Test that we can switch links in a coordinated fashion.
 TEST_F(P2PTransportChannelMultihomedTest, TestDrain) {
   AddAddress(0, kPublicAddrs[0]);
@@ -0,0 +1,178 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/p2p/base/packetpacer.h"
+
+#include <errno.h>
+
+#include "talk/base/common.h"
+#include "talk/base/logging.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+
+namespace cricket {
+
+enum {
+  MSG_SEND_QUEUED = 1
+};
+
+// The bucket holds this much of the rate, so that the timer doesn't have to
+// release packets one at a time...
+const int kBurstMs = 5;
+// ...but never less than a couple of full-sized packets.
+const int64 kMinBurstBytes = 3000;
+
+const int kDefaultMaxQueueDelayMs = 2000;
+
+PacketPacer::PacketPacer(talk_base::Thread* thread,
+                         IPacketPacerNotify* notify)
+    : thread_(thread),
+      notify_(notify),
+      rate_(0),
+      max_queue_delay_ms_(kDefaultMaxQueueDelayMs),
+      burst_bytes_(kMinBurstBytes),
+      tokens_(kMinBurstBytes),
+      last_refill_us_(talk_base::TimeMicros()),
+      queued_bytes_(0),
+      send_pending_(false) {
+}
+
+PacketPacer::~PacketPacer() {
+  thread_->Clear(this);
+  while (!queue_.empty()) {
+    delete queue_.front();
+    queue_.pop_front();
+  }
+}
+
+void PacketPacer::set_rate(int bytes_per_sec) {
+  ASSERT(thread_->IsCurrent());
+  ASSERT(bytes_per_sec >= 0);
+  Refill();
+  rate_ = bytes_per_sec;
+  burst_bytes_ = talk_base::_max(
+      static_cast<int64>(rate_) * kBurstMs / talk_base::kNumMillisecsPerSec,
+      kMinBurstBytes);
+  tokens_ = talk_base::_min(tokens_, burst_bytes_);
+  if (rate_ == 0) {
+    // Nothing holds packets back any more.
+    tokens_ = burst_bytes_;
+    SendQueued();
+  } else if (!queue_.empty()) {
+    thread_->Clear(this, MSG_SEND_QUEUED);
+    send_pending_ = false;
+    ScheduleSend();
+  }
+}
+
+int PacketPacer::Send(const char* data, size_t len, bool priority,
+                      int* error) {
+  ASSERT(thread_->IsCurrent());
+  if (rate_ == 0) {
+    return notify_->PacerSendPacket(this, data, len, error);
+  }
+
+  Refill();
+  if (priority || (queue_.empty() && tokens_ > 0)) {
+    tokens_ -= len;
+    return notify_->PacerSendPacket(this, data, len, error);
+  }
+
+  if (QueueDelay() >= max_queue_delay_ms_) {
+    LOG(LS_VERBOSE) << "Pacer queue full, dropping " << len << " bytes";
+    *error = EWOULDBLOCK;
+    return -1;
+  }
+  queue_.push_back(new talk_base::Buffer(data, len));
+  queued_bytes_ += len;
+  ScheduleSend();
+  return static_cast<int>(len);
+}
+
+int PacketPacer::QueueDelay() {
+  if (rate_ == 0) {
+    return 0;
+  }
+  Refill();
+  int64 debt = static_cast<int64>(queued_bytes_) - tokens_;
+  if (debt <= 0) {
+    return 0;
+  }
+  return static_cast<int>(debt * talk_base::kNumMillisecsPerSec / rate_);
+}
+
+void PacketPacer::OnMessage(talk_base::Message* pmsg) {
+  ASSERT(pmsg->message_id == MSG_SEND_QUEUED);
+  send_pending_ = false;
+  Refill();
+  SendQueued();
+  ScheduleSend();
+}
+
+void PacketPacer::Refill() {
+  int64 now = talk_base::TimeMicros();
+  int64 elapsed_us = now - last_refill_us_;
+  last_refill_us_ = now;
+  tokens_ = talk_base::_min(burst_bytes_,
+      tokens_ + elapsed_us * rate_ / talk_base::kNumMicrosecsPerSec);
+}
+
+void PacketPacer::SendQueued() {
+  while (!queue_.empty() && (rate_ == 0 || tokens_ > 0)) {
+    talk_base::Buffer* packet = queue_.front();
+    queue_.pop_front();
+    queued_bytes_ -= packet->length();
+    tokens_ -= packet->length();
+    int error;
+    if (notify_->PacerSendPacket(this, packet->data(), packet->length(),
+                                 &error) < 0) {
+      // The caller was told this packet was sent, so treat it like a packet
+      // lost in the network.
+      LOG(LS_VERBOSE) << "Dropping paced packet, error " << error;
+    }
+    delete packet;
+  }
+}
+
+void PacketPacer::ScheduleSend() {
+  if (queue_.empty() || send_pending_ || rate_ == 0) {
+    return;
+  }
+  // Wake up when the bucket has refilled enough to release the next packet.
+  int64 wait_us = 0;
+  if (tokens_ <= 0) {
+    wait_us = (1 - tokens_) * talk_base::kNumMicrosecsPerSec / rate_;
+  }
+  int delay_ms = static_cast<int>(
+      (wait_us + talk_base::kNumMicrosecsPerMillisec - 1) /
+      talk_base::kNumMicrosecsPerMillisec);
+  thread_->PostDelayed(talk_base::_max(delay_ms, 1), this, MSG_SEND_QUEUED);
+  send_pending_ = true;
+}
+
+}  // namespace cricket
@@ -0,0 +1,113 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_P2P_BASE_PACKETPACER_H_
+#define TALK_P2P_BASE_PACKETPACER_H_
+
+#include <deque>
+
+#include "talk/base/basictypes.h"
+#include "talk/base/buffer.h"
+#include "talk/base/messagehandler.h"
+
+namespace talk_base {
+class Thread;
+}
+
+namespace cricket {
+
+class PacketPacer;
+
+class IPacketPacerNotify {
+ public:
+  virtual ~IPacketPacerNotify() {}
+
+  // Writes a packet onto the network now.  Returns the number of bytes sent,
+  // or -1 with the reason in |*error|.
+  virtual int PacerSendPacket(PacketPacer* pacer, const char* data,
+                              size_t len, int* error) = 0;
+};
+
+// PacketPacer spreads the packets of a transport channel out over time, so
+// that bursts such as video keyframes don't overflow the shallow buffers of
+// consumer routers.  Packets are released by a token bucket that fills at the
+// pacing rate and holds a few milliseconds' worth of data.  Priority packets
+// (audio and RTCP) are never queued: they go out immediately, but are charged
+// to the bucket, which delays the queued packets instead.  With a rate of 0,
+// which is the default, all packets go straight out.
+//
+// All methods must be called on |thread|, which runs the release timer.
+class PacketPacer : public talk_base::MessageHandler {
+ public:
+  PacketPacer(talk_base::Thread* thread, IPacketPacerNotify* notify);
+  virtual ~PacketPacer();
+
+  // Sets the pacing rate in bytes per second; 0 turns pacing off and
+  // flushes the queue.
+  void set_rate(int bytes_per_sec);
+  int rate() const { return rate_; }
+
+  // Sets how long a packet may wait in the queue.  Packets that would have
+  // to wait longer are rejected with EWOULDBLOCK, like a full socket buffer.
+  void set_max_queue_delay(int delay_ms) { max_queue_delay_ms_ = delay_ms; }
+  int max_queue_delay() const { return max_queue_delay_ms_; }
+
+  // Sends or queues a packet.  Returns |len| if the packet was sent or
+  // queued, or -1 with the reason in |*error|.
+  int Send(const char* data, size_t len, bool priority, int* error);
+
+  size_t queued_packets() const { return queue_.size(); }
+  size_t queued_bytes() const { return queued_bytes_; }
+  // How long a packet sent now would wait in the queue, in milliseconds.
+  int QueueDelay();
+
+  virtual void OnMessage(talk_base::Message* pmsg);
+
+ private:
+  void Refill();
+  void SendQueued();
+  void ScheduleSend();
+
+  talk_base::Thread* thread_;
+  IPacketPacerNotify* notify_;
+  int rate_;
+  int max_queue_delay_ms_;
+  int64 burst_bytes_;
+  // The bucket goes into debt when priority packets are sent.
+  int64 tokens_;
+  int64 last_refill_us_;
+  std::deque<talk_base::Buffer*> queue_;
+  size_t queued_bytes_;
+  bool send_pending_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(PacketPacer);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_P2P_BASE_PACKETPACER_H_
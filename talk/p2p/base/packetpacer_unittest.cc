@@ -0,0 +1,193 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <vector>
+
+#include "talk/base/asyncudpsocket.h"
+#include "talk/base/gunit.h"
+#include "talk/base/logging.h"
+#include "talk/base/physicalsocketserver.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/base/socketaddress.h"
+#include "talk/base/thread.h"
+#include "talk/base/timeutils.h"
+#include "talk/base/virtualsocketserver.h"
+#include "talk/p2p/base/packetpacer.h"
+
+using talk_base::SocketAddress;
+
+static const SocketAddress kSendAddr("11.11.11.11", 0);
+static const SocketAddress kRecvAddr("22.22.22.22", 0);
+
+static const size_t kPacketSize = 1000;
+static const int kRate = 100000;  // bytes per second, 100 packets per second.
+static const int kTimeoutMs = 5000;
+
+// Tests PacketPacer by pacing packets over a UDP socket on a
+// VirtualSocketServer, and recording when they arrive.
+class PacketPacerTest : public testing::Test,
+                        public cricket::IPacketPacerNotify,
+                        public sigslot::has_slots<> {
+ public:
+  PacketPacerTest()
+      : pss_(new talk_base::PhysicalSocketServer),
+        vss_(new talk_base::VirtualSocketServer(pss_.get())),
+        ss_scope_(vss_.get()),
+        pacer_(talk_base::Thread::Current(), this) {
+  }
+
+  virtual void SetUp() {
+    send_socket_.reset(talk_base::AsyncUDPSocket::Create(vss_.get(),
+                                                         kSendAddr));
+    recv_socket_.reset(talk_base::AsyncUDPSocket::Create(vss_.get(),
+                                                         kRecvAddr));
+    ASSERT_TRUE(send_socket_.get() != NULL);
+    ASSERT_TRUE(recv_socket_.get() != NULL);
+    recv_socket_->SignalReadPacket.connect(this,
+                                           &PacketPacerTest::OnReadPacket);
+  }
+
+  virtual int PacerSendPacket(cricket::PacketPacer* pacer, const char* data,
+                              size_t len, int* error) {
+    int sent = send_socket_->SendTo(data, len,
+                                    recv_socket_->GetLocalAddress());
+    if (sent < 0) {
+      *error = send_socket_->GetError();
+    }
+    return sent;
+  }
+
+  void OnReadPacket(talk_base::AsyncPacketSocket* socket, const char* data,
+                    size_t size, const SocketAddress& remote_addr) {
+    arrivals_.push_back(Arrival(data[0], talk_base::TimeMillis()));
+  }
+
+  // Sends |count| packets tagged with |tag|, and returns how many the pacer
+  // accepted.
+  int SendPackets(int count, char tag, bool priority) {
+    char packet[kPacketSize];
+    memset(packet, tag, sizeof(packet));
+    int accepted = 0;
+    for (int i = 0; i < count; ++i) {
+      int error = 0;
+      int sent = pacer_.Send(packet, sizeof(packet), priority, &error);
+      if (sent == static_cast<int>(sizeof(packet))) {
+        ++accepted;
+      } else {
+        EXPECT_EQ(-1, sent);
+        EXPECT_EQ(EWOULDBLOCK, error);
+      }
+    }
+    return accepted;
+  }
+
+  size_t arrivals() const { return arrivals_.size(); }
+  int64 ArrivalSpread() const {
+    return arrivals_.back().time - arrivals_.front().time;
+  }
+
+ protected:
+  struct Arrival {
+    Arrival(char t, int64 ms) : tag(t), time(ms) {}
+    char tag;
+    int64 time;
+  };
+
+  talk_base::scoped_ptr<talk_base::PhysicalSocketServer> pss_;
+  talk_base::scoped_ptr<talk_base::VirtualSocketServer> vss_;
+  talk_base::SocketServerScope ss_scope_;
+  cricket::PacketPacer pacer_;
+  talk_base::scoped_ptr<talk_base::AsyncUDPSocket> send_socket_;
+  talk_base::scoped_ptr<talk_base::AsyncUDPSocket> recv_socket_;
+  std::vector<Arrival> arrivals_;
+};
+
+// Without a rate, a burst goes out all at once.
+TEST_F(PacketPacerTest, TestUnpaced) {
+  EXPECT_EQ(50, SendPackets(50, 'v', false));
+  EXPECT_EQ(0U, pacer_.queued_packets());
+  EXPECT_EQ_WAIT(50U, arrivals(), kTimeoutMs);
+  EXPECT_LT(ArrivalSpread(), 50);
+}
+
+// A 50-packet burst at 100 packets per second is spread over half a second.
+TEST_F(PacketPacerTest, TestBurstIsSpread) {
+  pacer_.set_rate(kRate);
+  EXPECT_EQ(50, SendPackets(50, 'v', false));
+  EXPECT_GT(pacer_.queued_packets(), 40U);
+  EXPECT_GE(pacer_.QueueDelay(), 400);
+  EXPECT_EQ_WAIT(50U, arrivals(), kTimeoutMs);
+  EXPECT_GE(ArrivalSpread(), 400);
+  EXPECT_LT(ArrivalSpread(), 1000);
+  EXPECT_EQ(0U, pacer_.queued_bytes());
+}
+
+// Priority packets skip the queue, and delay the queued packets instead.
+TEST_F(PacketPacerTest, TestPriorityIsNotQueued) {
+  pacer_.set_rate(kRate);
+  EXPECT_EQ(20, SendPackets(20, 'v', false));
+  int64 start = talk_base::TimeMillis();
+  EXPECT_EQ(5, SendPackets(5, 'a', true));
+  EXPECT_EQ_WAIT(25U, arrivals(), kTimeoutMs);
+
+  int audio_seen = 0;
+  for (size_t i = 0; i < arrivals_.size(); ++i) {
+    if (arrivals_[i].tag == 'a') {
+      EXPECT_LT(arrivals_[i].time - start, 50);
+      ++audio_seen;
+    } else if (audio_seen < 5) {
+      // Only the first packets of the burst can go out ahead of the audio.
+      EXPECT_LT(i, 5U);
+    }
+  }
+  EXPECT_EQ(5, audio_seen);
+  // The queued video waited for the audio: 25 packets at 100 per second.
+  EXPECT_GE(ArrivalSpread(), 180);
+}
+
+// Packets that would wait too long are rejected like a full socket buffer.
+TEST_F(PacketPacerTest, TestQueueLimit) {
+  pacer_.set_rate(kRate);
+  pacer_.set_max_queue_delay(100);
+  int accepted = SendPackets(50, 'v', false);
+  EXPECT_GE(accepted, 10);
+  EXPECT_LE(accepted, 15);
+  EXPECT_LE(pacer_.QueueDelay(), 110);
+  EXPECT_EQ_WAIT(static_cast<size_t>(accepted), arrivals(), kTimeoutMs);
+}
+
+// Turning pacing off flushes the queue.
+TEST_F(PacketPacerTest, TestDisableFlushes) {
+  pacer_.set_rate(kRate);
+  EXPECT_EQ(50, SendPackets(50, 'v', false));
+  EXPECT_GT(pacer_.queued_packets(), 0U);
+  pacer_.set_rate(0);
+  EXPECT_EQ(0U, pacer_.queued_packets());
+  EXPECT_EQ_WAIT(50U, arrivals(), kTimeoutMs);
+  EXPECT_LT(ArrivalSpread(), 50);
+}
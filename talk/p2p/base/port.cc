@@ -35,6 +35,7 @@
 #include "talk/base/helpers.h"
 #include "talk/base/logging.h"
 #include "talk/base/messagedigest.h"
+#include "talk/base/packettrace.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/stringencode.h"
 #include "talk/base/stringutils.h"
@@ -109,6 +110,13 @@ inline uint32 ConservativeRTTEstimate(uint32 rtt) {
 // Weighting of the old rtt value to new data.
 const int RTT_RATIO = 3;  // 3 : 1
 
+// Weighting of the smoothed rtt and its variance to new data (RFC 6298).
+const int SMOOTHED_RTT_RATIO = 7;  // 7 : 1
+const int RTT_VARIANCE_RATIO = 3;  // 3 : 1
+
+// Weight of each ping's outcome in the ping loss estimate.
+const double PING_LOSS_WEIGHT = 1.0 / 8;
+
 // The delay before we begin checking if this port is useless.
 const int kPortTimeoutDelay = 30 * 1000;  // 30 seconds
 
@@ -245,11 +253,23 @@ void Port::AddAddress(const talk_base::SocketAddress& address,
                       const std::string& type,
                       uint32 type_preference,
                       bool final) {
+  AddAddress(address, base_address, protocol, "", type, type_preference,
+             final);
+}
+
+void Port::AddAddress(const talk_base::SocketAddress& address,
+                      const talk_base::SocketAddress& base_address,
+                      const std::string& protocol,
+                      const std::string& tcptype,
+                      const std::string& type,
+                      uint32 type_preference,
+                      bool final) {
   Candidate c;
   c.set_id(talk_base::CreateRandomString(8));
   c.set_component(component_);
   c.set_type(type);
   c.set_protocol(protocol);
+  c.set_tcptype(tcptype);
   c.set_address(address);
   c.set_priority(c.GetPriority(type_preference));
   c.set_username(username_fragment());
@@ -803,8 +823,9 @@ Connection::Connection(Port* port, size_t index,
     write_state_(STATE_WRITE_INIT), connected_(true), pruned_(false),
     requests_(port->thread()), rtt_(DEFAULT_RTT),
     last_ping_sent_(0), last_ping_received_(0), last_data_received_(0),
-    last_ping_response_received_(0), reported_(false), nominated_(false),
-    state_(STATE_WAITING) {
+    last_ping_response_received_(0), num_pings_sent_(0), ping_interval_(0),
+    smoothed_rtt_(0), rtt_variance_(0), num_ping_responses_(0),
+    ping_loss_(0), reported_(false), nominated_(false), state_(STATE_WAITING) {
   // All of our connections start in WAITING state.
   // TODO(mallinath) - Start connections from STATE_FROZEN.
   // Wire up to send stun packets
@@ -891,6 +912,7 @@ void Connection::OnSendStunPacket(const void* data, size_t size,
 }
 
 void Connection::OnReadPacket(const char* data, size_t size) {
+  talk_base::PacketTrace::Mark(talk_base::PS_RECV_PORT);
   talk_base::scoped_ptr<IceMessage> msg;
   std::string remote_ufrag;
   const talk_base::SocketAddress& addr(remote_candidate_.address());
@@ -1093,6 +1115,7 @@ void Connection::Ping(uint32 now) {
   ASSERT(connected_);
   last_ping_sent_ = now;
   pings_since_last_response_.push_back(now);
+  ++num_pings_sent_;
   ConnectionRequest *req = new ConnectionRequest(this);
   LOG_J(LS_VERBOSE, this) << "Sending STUN ping " << req->id() << " at " << now;
   requests_.Send(req);
@@ -1182,6 +1205,25 @@ void Connection::OnConnectionRequestResponse(ConnectionRequest* request,
   pings_since_last_response_.clear();
   last_ping_response_received_ = talk_base::Time();
   rtt_ = (RTT_RATIO * rtt_ + rtt) / (RTT_RATIO + 1);
+  UpdateRttStats(rtt);
+  ping_loss_ *= 1 - PING_LOSS_WEIGHT;
+}
+
+void Connection::UpdateRttStats(uint32 rtt) {
+  rtt_histogram_.BeginWrite()->AddSample(rtt);
+  rtt_histogram_.EndWrite();
+
+  if (num_ping_responses_++ == 0) {
+    smoothed_rtt_ = rtt;
+    rtt_variance_ = rtt / 2;
+    return;
+  }
+  uint32 deviation = (rtt > smoothed_rtt_) ?
+      rtt - smoothed_rtt_ : smoothed_rtt_ - rtt;
+  rtt_variance_ = (RTT_VARIANCE_RATIO * rtt_variance_ + deviation) /
+      (RTT_VARIANCE_RATIO + 1);
+  smoothed_rtt_ = (SMOOTHED_RTT_RATIO * smoothed_rtt_ + rtt) /
+      (SMOOTHED_RTT_RATIO + 1);
 }
 
 void Connection::OnConnectionRequestErrorResponse(ConnectionRequest* request,
@@ -1221,6 +1263,7 @@ void Connection::OnConnectionRequestTimeout(ConnectionRequest* request) {
       talk_base::LS_INFO : talk_base::LS_VERBOSE;
   LOG_JV(sev, this) << "Timing-out STUN ping " << request->id()
                     << " after " << request->Elapsed() << " ms";
+  ping_loss_ = ping_loss_ * (1 - PING_LOSS_WEIGHT) + PING_LOSS_WEIGHT;
 }
 
 void Connection::CheckTimeout() {
@@ -1251,19 +1294,19 @@ void Connection::OnMessage(talk_base::Message *pmsg) {
   delete this;
 }
 
-size_t Connection::recv_bytes_second() {
+size_t Connection::recv_bytes_second() const {
   return recv_rate_tracker_.units_second();
 }
 
-size_t Connection::recv_total_bytes() {
+size_t Connection::recv_total_bytes() const {
   return recv_rate_tracker_.total_units();
 }
 
-size_t Connection::sent_bytes_second() {
+size_t Connection::sent_bytes_second() const {
   return send_rate_tracker_.units_second();
 }
 
-size_t Connection::sent_total_bytes() {
+size_t Connection::sent_total_bytes() const {
   return send_rate_tracker_.total_units();
 }
 
@@ -1273,6 +1316,7 @@ ProxyConnection::ProxyConnection(Port* port, size_t index,
 }
 
 int ProxyConnection::Send(const void* data, size_t size) {
+  talk_base::PacketTrace::Mark(talk_base::PS_SEND_TRANSPORT);
   if (write_state_ == STATE_WRITE_INIT || write_state_ == STATE_WRITE_TIMEOUT) {
     error_ = EWOULDBLOCK;
     return SOCKET_ERROR;
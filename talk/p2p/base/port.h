@@ -32,13 +32,16 @@
 #include <vector>
 #include <map>
 
+#include "talk/base/histogram.h"
 #include "talk/base/network.h"
 #include "talk/base/packetsocketfactory.h"
 #include "talk/base/proxyinfo.h"
 #include "talk/base/ratetracker.h"
+#include "talk/base/seqlock.h"
 #include "talk/base/sigslot.h"
 #include "talk/base/socketaddress.h"
 #include "talk/base/thread.h"
+#include "talk/base/windowedratetracker.h"
 #include "talk/p2p/base/timeouts.h"
 #include "talk/p2p/base/candidate.h"
 #include "talk/p2p/base/portinterface.h"
@@ -291,6 +294,12 @@ class Port : public PortInterface, public talk_base::MessageHandler,
                   const talk_base::SocketAddress& base_address,
                   const std::string& protocol, const std::string& type,
                   uint32 type_preference, bool final);
+  // As above, for a TCP candidate of the given RFC 6544 type.
+  void AddAddress(const talk_base::SocketAddress& address,
+                  const talk_base::SocketAddress& base_address,
+                  const std::string& protocol, const std::string& tcptype,
+                  const std::string& type, uint32 type_preference,
+                  bool final);
 
   // Adds the given connection to the list.  (Deleting removes them.)
   void AddConnection(Connection* conn);
@@ -418,10 +427,25 @@ class Connection : public talk_base::MessageHandler,
   // Estimate of the round-trip time over this connection.
   uint32 rtt() const { return rtt_; }
 
-  size_t sent_total_bytes();
-  size_t sent_bytes_second();
-  size_t recv_total_bytes();
-  size_t recv_bytes_second();
+  // RTT smoothed over the ping responses received so far, and the mean
+  // deviation of the samples from it, as in RFC 6298.  Unlike rtt(), these
+  // start from the first sample rather than a conservative default, so they
+  // are only meaningful once num_ping_responses() is non-zero.
+  uint32 smoothed_rtt() const { return smoothed_rtt_; }
+  uint32 rtt_variance() const { return rtt_variance_; }
+  size_t num_ping_responses() const { return num_ping_responses_; }
+  // Recent fraction of pings that timed out without a response, weighted
+  // towards the latest ones.
+  double ping_loss() const { return ping_loss_; }
+  // Distribution of the RTT samples received so far.  Unlike the values
+  // above, this and the byte counts below may be read from any thread
+  // without holding up the one the connection runs on.
+  talk_base::Histogram rtt_histogram() const { return rtt_histogram_.Read(); }
+
+  size_t sent_total_bytes() const;
+  size_t sent_bytes_second() const;
+  size_t recv_total_bytes() const;
+  size_t recv_bytes_second() const;
   sigslot::signal1<Connection*> SignalStateChange;
 
   // Sent when the connection has decided that it is no longer of value.  It
@@ -436,7 +460,7 @@ class Connection : public talk_base::MessageHandler,
   // Error if Send() returns < 0
   virtual int GetError() = 0;
 
-  sigslot::signal3<Connection*, const char*, size_t> SignalReadPacket;
+  sigslot::flat_signal3<Connection*, const char*, size_t> SignalReadPacket;
 
   // Called when a packet is received on this connection.
   void OnReadPacket(const char* data, size_t size);
@@ -458,6 +482,16 @@ class Connection : public talk_base::MessageHandler,
   // Called when this connection should try checking writability again.
   uint32 last_ping_sent() const { return last_ping_sent_; }
   void Ping(uint32 now);
+  // The number of pings sent so far, and the time the last response arrived.
+  size_t num_pings_sent() const { return num_pings_sent_; }
+  uint32 last_ping_response_received() const {
+    return last_ping_response_received_;
+  }
+
+  // How long the channel waits between pings on this connection while it is
+  // a writable backup; 0 until the channel starts backing off.
+  uint32 ping_interval() const { return ping_interval_; }
+  void set_ping_interval(uint32 interval) { ping_interval_ = interval; }
 
   // Called whenever a valid ping is received on this connection.  This is
   // public because the connection intercepts the first ping for us.
@@ -494,6 +528,8 @@ class Connection : public talk_base::MessageHandler,
   void OnConnectionRequestErrorResponse(ConnectionRequest* req,
                                         StunMessage* response);
   void OnConnectionRequestTimeout(ConnectionRequest* req);
+  // Folds a new RTT sample into smoothed_rtt() and rtt_variance().
+  void UpdateRttStats(uint32 rtt);
 
   // Changes the state and signals if necessary.
   void set_read_state(ReadState value);
@@ -521,9 +557,17 @@ class Connection : public talk_base::MessageHandler,
   uint32 last_data_received_;
   uint32 last_ping_response_received_;
   std::vector<uint32> pings_since_last_response_;
+  size_t num_pings_sent_;
+  uint32 ping_interval_;
+  uint32 smoothed_rtt_;
+  uint32 rtt_variance_;
+  size_t num_ping_responses_;
+  double ping_loss_;
+
+  talk_base::SeqLock<talk_base::Histogram> rtt_histogram_;
 
-  talk_base::RateTracker recv_rate_tracker_;
-  talk_base::RateTracker send_rate_tracker_;
+  talk_base::WindowedRateTracker recv_rate_tracker_;
+  talk_base::WindowedRateTracker send_rate_tracker_;
 
  private:
   bool reported_;
@@ -426,7 +426,9 @@ class PortTest : public testing::Test, public sigslot::has_slots<> {
                            ProtocolType int_proto, ProtocolType ext_proto) {
     TurnPort* port = TurnPort::Create(main_, &socket_factory_, &network_,
                                       addr.ipaddr(), 0, 0,
-                                      username_, password_, kTurnUdpIntAddr,
+                                      username_, password_,
+                                      ProtocolAddress(kTurnUdpIntAddr,
+                                                      PROTO_UDP),
                                       kRelayCredentials);
     port->SetIceProtocolType(ice_protocol_);
     return port;
@@ -691,7 +693,7 @@ class FakePacketSocketFactory : public talk_base::PacketSocketFactory {
 
   virtual AsyncPacketSocket* CreateServerTcpSocket(
       const SocketAddress& local_address, int min_port, int max_port,
-      bool ssl) {
+      int opts) {
     EXPECT_TRUE(next_server_tcp_socket_ != NULL);
     AsyncPacketSocket* result = next_server_tcp_socket_;
     next_server_tcp_socket_ = NULL;
@@ -703,7 +705,7 @@ class FakePacketSocketFactory : public talk_base::PacketSocketFactory {
   virtual AsyncPacketSocket* CreateClientTcpSocket(
       const SocketAddress& local_address, const SocketAddress& remote_address,
       const talk_base::ProxyInfo& proxy_info,
-      const std::string& user_agent, bool ssl) {
+      const std::string& user_agent, int opts) {
     EXPECT_TRUE(next_client_tcp_socket_ != NULL);
     AsyncPacketSocket* result = next_client_tcp_socket_;
     next_client_tcp_socket_ = NULL;
@@ -1083,6 +1085,82 @@ TEST_F(PortTest, TestTcpNoDelay) {
   delete port1;
 }
 
+// Test that an ICE-TCP port gathers typed candidates, and only pairs them
+// the way RFC 6544 allows.
+TEST_F(PortTest, TestIceTcpCandidates) {
+  scoped_ptr<TCPPort> port1(CreateTcpPort(kLocalAddr1));
+  scoped_ptr<TCPPort> port2(CreateTcpPort(kLocalAddr2));
+  port1->set_ice_tcp(true);
+  port2->set_ice_tcp(true);
+  port1->PrepareAddress();
+  port2->PrepareAddress();
+  ASSERT_EQ(3U, port1->Candidates().size());
+  ASSERT_EQ(3U, port2->Candidates().size());
+
+  const Candidate& active = port2->Candidates()[0];
+  const Candidate& simopen = port2->Candidates()[1];
+  const Candidate& passive = port2->Candidates()[2];
+  EXPECT_EQ(TCPTYPE_ACTIVE_STR, active.tcptype());
+  EXPECT_EQ(9, active.address().port());
+  EXPECT_EQ(TCPTYPE_SIMOPEN_STR, simopen.tcptype());
+  EXPECT_NE(0, simopen.address().port());
+  EXPECT_EQ(TCPTYPE_PASSIVE_STR, passive.tcptype());
+  EXPECT_NE(0, passive.address().port());
+  EXPECT_GT(active.priority(), passive.priority());
+  EXPECT_GT(passive.priority(), simopen.priority());
+
+  // Active candidates can't be connected to.
+  EXPECT_TRUE(port1->CreateConnection(active, Port::ORIGIN_MESSAGE) == NULL);
+
+  // We connect to a passive candidate from our active one.
+  Connection* conn = port1->CreateConnection(passive, Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn != NULL);
+  EXPECT_EQ(TCPTYPE_ACTIVE_STR, conn->local_candidate().tcptype());
+
+  // And to a simultaneous-open candidate from ours, but only one at a time.
+  conn = port1->CreateConnection(simopen, Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn != NULL);
+  EXPECT_EQ(TCPTYPE_SIMOPEN_STR, conn->local_candidate().tcptype());
+  Candidate simopen2 = simopen;
+  simopen2.set_address(SocketAddress(kLocalAddr2.ipaddr(),
+                                     simopen.address().port() + 1));
+  EXPECT_TRUE(port1->CreateConnection(simopen2, Port::ORIGIN_MESSAGE) == NULL);
+}
+
+// Test that a simultaneous-open connection fails, rather than retrying, if its
+// port is taken between gathering the candidate and connecting from it.
+TEST_F(PortTest, TestIceTcpSimultaneousOpenPortTaken) {
+  scoped_ptr<TCPPort> port1(CreateTcpPort(kLocalAddr1));
+  scoped_ptr<TCPPort> port2(CreateTcpPort(kLocalAddr2));
+  port1->set_ice_tcp(true);
+  port2->set_ice_tcp(true);
+  port1->PrepareAddress();
+  port2->PrepareAddress();
+  ASSERT_EQ(3U, port1->Candidates().size());
+  ASSERT_EQ(3U, port2->Candidates().size());
+  const Candidate& local_simopen = port1->Candidates()[1];
+  const Candidate& remote_simopen = port2->Candidates()[1];
+  ASSERT_EQ(TCPTYPE_SIMOPEN_STR, local_simopen.tcptype());
+
+  scoped_ptr<talk_base::AsyncSocket> squatter(
+      talk_base::Thread::Current()->socketserver()->CreateAsyncSocket(
+          local_simopen.address().family(), SOCK_STREAM));
+  ASSERT_EQ(0, squatter->Bind(local_simopen.address()));
+
+  Connection* conn = port1->CreateConnection(remote_simopen,
+                                             Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn != NULL);
+  EXPECT_EQ(Connection::STATE_WRITE_TIMEOUT, conn->write_state());
+}
+
+// Test that a port without ICE-TCP keeps gathering a single untyped candidate.
+TEST_F(PortTest, TestTcpCandidateUntypedByDefault) {
+  scoped_ptr<TCPPort> port(CreateTcpPort(kLocalAddr1));
+  port->PrepareAddress();
+  ASSERT_EQ(1U, port->Candidates().size());
+  EXPECT_EQ("", port->Candidates()[0].tcptype());
+}
+
 TEST_F(PortTest, TestDelayedBindingUdp) {
   FakeAsyncPacketSocket *socket = new FakeAsyncPacketSocket();
   FakePacketSocketFactory socket_factory;
@@ -54,6 +54,8 @@ const uint32 PORTALLOCATOR_ENABLE_IPV6 = 0x40;
 const uint32 PORTALLOCATOR_ENABLE_SHARED_UFRAG = 0x80;
 const uint32 PORTALLOCATOR_ENABLE_SHARED_SOCKET = 0x100;
 const uint32 PORTALLOCATOR_ENABLE_STUN_RETRANSMIT_ATTRIBUTE = 0x200;
+// Gathers RFC 6544 active, passive and simultaneous-open TCP candidates.
+const uint32 PORTALLOCATOR_ENABLE_ICE_TCP = 0x400;
 
 enum {
   PORTALLOCATOR_FILTER_ALLOW_NONE = 0,
@@ -127,8 +127,8 @@ class PortInterface {
   // through their respective connection and instead delivers every packet
   // through this port.
   virtual void EnablePortPackets() = 0;
-  sigslot::signal4<PortInterface*, const char*, size_t,
-                   const talk_base::SocketAddress&> SignalReadPacket;
+  sigslot::flat_signal4<PortInterface*, const char*, size_t,
+                        const talk_base::SocketAddress&> SignalReadPacket;
 
   virtual std::string ToString() const = 0;
 
@@ -242,6 +242,15 @@ PseudoTcp::PseudoTcp(IPseudoTcpNotify* notify, uint32 conv)
   // Sanity check on buffer sizes (needed for OnTcpWriteable notification logic)
   ASSERT(m_rbuf_len + MIN_PACKET < m_sbuf_len);
 
+  // Segments are copied in and out of the buffers at arbitrary offsets;
+  // mirroring them lets copies that wrap around be done in one piece.
+  if (!m_rbuf.SetMirrored(true)) {
+    LOG(LS_INFO) << "Receive buffer not mirrored";
+  }
+  if (!m_sbuf.SetMirrored(true)) {
+    LOG(LS_INFO) << "Send buffer not mirrored";
+  }
+
   uint32 now = Now();
 
   m_state = TCP_LISTEN;
@@ -274,7 +283,7 @@ PseudoTcp::PseudoTcp(IPseudoTcpNotify* notify, uint32 conv)
   m_ts_recent = m_ts_lastack = 0;
 
   m_rx_rto = DEF_RTO;
-  m_rx_srtt = m_rx_rttvar = 0;
+  m_rx_srtt_us = m_rx_rttvar_us = 0;
 
   m_use_nagling = true;
   m_ack_delay = DEF_ACK_DELAY;
@@ -432,7 +441,7 @@ uint32 PseudoTcp::GetBytesBufferedNotSent() const {
 }
 
 uint32 PseudoTcp::GetRoundTripTimeEstimateMs() const {
-  return m_rx_srtt;
+  return m_rx_srtt_us / talk_base::kNumMicrosecsPerMillisec;
 }
 
 //
@@ -723,29 +732,6 @@ bool PseudoTcp::process(Segment& seg) {
 
   // Check if this is a valuable ack
   if ((seg.ack > m_snd_una) && (seg.ack <= m_snd_nxt)) {
-    // Calculate round-trip time
-    if (seg.tsecr) {
-      long rtt = talk_base::TimeDiff(now, seg.tsecr);
-      if (rtt >= 0) {
-        if (m_rx_srtt == 0) {
-          m_rx_srtt = rtt;
-          m_rx_rttvar = rtt / 2;
-        } else {
-          m_rx_rttvar = (3 * m_rx_rttvar + abs(long(rtt - m_rx_srtt))) / 4;
-          m_rx_srtt = (7 * m_rx_srtt + rtt) / 8;
-        }
-        m_rx_rto = bound(MIN_RTO, m_rx_srtt +
-            talk_base::_max<uint32>(1, 4 * m_rx_rttvar), MAX_RTO);
-#if _DEBUGMSG >= _DBG_VERBOSE
-        LOG(LS_INFO) << "rtt: " << rtt
-                     << "  srtt: " << m_rx_srtt
-                     << "  rto: " << m_rx_rto;
-#endif // _DEBUGMSG
-      } else {
-        ASSERT(false);
-      }
-    }
-
     m_snd_wnd = static_cast<uint32>(seg.wnd) << m_swnd_scale;
 
     uint32 nAcked = seg.ack - m_snd_una;
@@ -755,6 +741,10 @@ bool PseudoTcp::process(Segment& seg) {
 
     m_sbuf.ConsumeReadData(nAcked);
 
+    // Time the newest fully acked segment that was only sent once (Karn's
+    // algorithm), with the microsecond send time kept in the segment rather
+    // than the millisecond timestamp echoed by the peer.
+    int64 tsent = 0;
     for (uint32 nFree = nAcked; nFree > 0; ) {
       ASSERT(!m_slist.empty());
       if (nFree < m_slist.front().len) {
@@ -764,11 +754,21 @@ bool PseudoTcp::process(Segment& seg) {
         if (m_slist.front().len > m_largest) {
           m_largest = m_slist.front().len;
         }
+        if (m_slist.front().xmit == 1) {
+          tsent = m_slist.front().tstamp;
+        }
         nFree -= m_slist.front().len;
         m_slist.pop_front();
       }
     }
 
+    // Calculate round-trip time
+    if (tsent) {
+      int64 rtt = talk_base::TimeMicros() - tsent;
+      ASSERT(rtt >= 0);
+      updateRtt(static_cast<uint32>(talk_base::_max<int64>(rtt, 0)));
+    }
+
     if (m_dup_acks >= 3) {
       if (m_snd_una >= m_recover) { // NewReno
         uint32 nInFlight = m_snd_nxt - m_snd_una;
@@ -968,6 +968,29 @@ bool PseudoTcp::process(Segment& seg) {
   return true;
 }
 
+void PseudoTcp::updateRtt(uint32 rtt_us) {
+  if (m_rx_srtt_us == 0) {
+    m_rx_srtt_us = rtt_us;
+    m_rx_rttvar_us = rtt_us / 2;
+  } else {
+    m_rx_rttvar_us = (3 * m_rx_rttvar_us +
+        abs(static_cast<long>(rtt_us) - static_cast<long>(m_rx_srtt_us))) / 4;
+    m_rx_srtt_us = (7 * m_rx_srtt_us + rtt_us) / 8;
+  }
+  uint32 rto_us = m_rx_srtt_us +
+      talk_base::_max<uint32>(talk_base::kNumMicrosecsPerMillisec,
+                              4 * m_rx_rttvar_us);
+  m_rx_rto = bound(MIN_RTO,
+      static_cast<uint32>((rto_us + talk_base::kNumMicrosecsPerMillisec - 1) /
+                          talk_base::kNumMicrosecsPerMillisec),
+      MAX_RTO);
+#if _DEBUGMSG >= _DBG_VERBOSE
+  LOG(LS_INFO) << "rtt: " << rtt_us << " us"
+               << "  srtt: " << m_rx_srtt_us << " us"
+               << "  rto: " << m_rx_rto;
+#endif // _DEBUGMSG
+}
+
 bool PseudoTcp::transmit(const SList::iterator& seg, uint32 now) {
   if (seg->xmit >= ((m_state == TCP_ESTABLISHED) ? 15 : 30)) {
     LOG_F(LS_VERBOSE) << "too many retransmits";
@@ -1017,7 +1040,7 @@ bool PseudoTcp::transmit(const SList::iterator& seg, uint32 now) {
     LOG_F(LS_VERBOSE) << "mss reduced to " << m_mss;
 
     SSegment subseg(seg->seq + nTransmit, seg->len - nTransmit, seg->bCtrl);
-    //subseg.tstamp = seg->tstamp;
+    subseg.tstamp = seg->tstamp;
     subseg.xmit = seg->xmit;
     seg->len = nTransmit;
 
@@ -1029,7 +1052,7 @@ bool PseudoTcp::transmit(const SList::iterator& seg, uint32 now) {
     m_snd_nxt += seg->len;
   }
   seg->xmit += 1;
-  //seg->tstamp = now;
+  seg->tstamp = talk_base::TimeMicros();
   if (m_rto_base == 0) {
     m_rto_base = now;
   }
@@ -136,10 +136,10 @@ class PseudoTcp {
 
   struct SSegment {
     SSegment(uint32 s, uint32 l, bool c)
-        : seq(s), len(l), /*tstamp(0),*/ xmit(0), bCtrl(c) {
+        : seq(s), len(l), tstamp(0), xmit(0), bCtrl(c) {
     }
     uint32 seq, len;
-    //uint32 tstamp;
+    int64 tstamp;  // TimeMicros() of the latest transmission.
     uint8 xmit;
     bool bCtrl;
   };
@@ -171,6 +171,8 @@ class PseudoTcp {
 
   bool process(Segment& seg);
   bool transmit(const SList::iterator& seg, uint32 now);
+  // Folds a round-trip sample into the smoothed estimates and the timeout.
+  void updateRtt(uint32 rtt_us);
 
   void adjustMTU();
 
@@ -234,7 +236,8 @@ class PseudoTcp {
   uint32 m_ts_recent, m_ts_lastack;
 
   // Round-trip calculation
-  uint32 m_rx_rttvar, m_rx_srtt, m_rx_rto;
+  // Round-trip estimates are kept in microseconds, the timeout in ms.
+  uint32 m_rx_rttvar_us, m_rx_srtt_us, m_rx_rto;
 
   // Congestion avoidance, Fast retransmit/recovery, Delayed ACKs
   uint32 m_ssthresh, m_cwnd;
@@ -79,7 +79,8 @@ int RawTransportChannel::SendPacket(const char *data, size_t size, int flags) {
     return -1;
   if (remote_address_.IsNil())
     return -1;
-  if (flags != 0)
+  // There is no pacing here, so PF_PRIORITY makes no difference.
+  if ((flags & ~PF_PRIORITY) != 0)
     return -1;
   return port_->SendTo(data, size, remote_address_, true);
 }
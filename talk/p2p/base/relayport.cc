@@ -465,7 +465,9 @@ void RelayEntry::Connect() {
   } else if (ra->proto == PROTO_TCP || ra->proto == PROTO_SSLTCP) {
     socket = port_->socket_factory()->CreateClientTcpSocket(
         talk_base::SocketAddress(port_->ip(), 0), ra->address,
-        port_->proxy(), port_->user_agent(), ra->proto == PROTO_SSLTCP);
+        port_->proxy(), port_->user_agent(),
+        ra->proto == PROTO_SSLTCP ?
+            talk_base::PacketSocketFactory::OPT_SSLTCP : 0);
   } else {
     LOG(LS_WARNING) << "Unknown protocol (" << ra->proto << ")";
   }
@@ -190,8 +190,8 @@ bool StunMessage::ValidateMessageIntegrity(const char* data, size_t size,
 
   // Getting length of the message to calculate Message Integrity.
   size_t mi_pos = current_pos;
-  talk_base::scoped_array<char> temp_data(new char[current_pos]);
-  memcpy(temp_data.get(), data, current_pos);
+  talk_base::Hmac hmac(talk_base::DIGEST_SHA_1,
+                       password.c_str(), password.size());
   if (size > mi_pos + kStunAttributeHeaderSize + kStunMessageIntegritySize) {
     // Stun message has other attributes after message integrity.
     // Adjust the length parameter in stun message to calculate HMAC.
@@ -199,27 +199,31 @@ bool StunMessage::ValidateMessageIntegrity(const char* data, size_t size,
         (mi_pos + kStunAttributeHeaderSize + kStunMessageIntegritySize);
     size_t new_adjusted_len = size - extra_offset - kStunHeaderSize;
 
-    // Writing new length of the STUN message @ Message Length in temp buffer.
+    // Hashing the new length in place of the Message Length, so that the
+    // message doesn't have to be copied.
     //      0                   1                   2                   3
     //      0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
     //     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
     //     |0 0|     STUN Message Type     |         Message Length        |
     //     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-    talk_base::SetBE16(temp_data.get() + 2, new_adjusted_len);
+    char adjusted_len[2];
+    talk_base::SetBE16(adjusted_len, new_adjusted_len);
+    hmac.Update(data, 2);
+    hmac.Update(adjusted_len, sizeof(adjusted_len));
+    hmac.Update(data + 4, mi_pos - 4);
+  } else {
+    hmac.Update(data, mi_pos);
   }
 
-  char hmac[kStunMessageIntegritySize];
-  size_t ret = talk_base::ComputeHmac(talk_base::DIGEST_SHA_1,
-                                      password.c_str(), password.size(),
-                                      temp_data.get(), mi_pos,
-                                      hmac, sizeof(hmac));
-  ASSERT(ret == sizeof(hmac));
-  if (ret != sizeof(hmac))
+  char hmac_value[kStunMessageIntegritySize];
+  size_t ret = hmac.Finish(hmac_value, sizeof(hmac_value));
+  ASSERT(ret == sizeof(hmac_value));
+  if (ret != sizeof(hmac_value))
     return false;
 
   // Comparing the calculated HMAC with the one present in the message.
   return (std::memcmp(data + current_pos + kStunAttributeHeaderSize,
-                      hmac, sizeof(hmac)) == 0);
+                      hmac_value, sizeof(hmac_value)) == 0);
 }
 
 bool StunMessage::AddMessageIntegrity(const std::string& password) {
@@ -28,9 +28,29 @@
 #include "talk/p2p/base/tcpport.h"
 
 #include "talk/base/common.h"
+#include "talk/base/helpers.h"
 #include "talk/base/logging.h"
 #include "talk/p2p/base/common.h"
 
+namespace {
+
+// RFC 6544 - 4.5.  Active candidates don't accept connections, so they are
+// advertised with the discard port.
+const int kActiveTcpPort = 9;
+
+// A simultaneous open only succeeds if both ends are connecting at the same
+// time.  Until the other end starts, our attempts are refused, so we retry,
+// much like a TCP stack retransmits a SYN that got no answer.  The jitter
+// keeps the two ends from retrying in lockstep and always missing each other.
+const int kSimultaneousOpenRetryDelay = 50;  // 0.05 seconds
+const int kSimultaneousOpenRetryJitter = 100;
+const int kMaxSimultaneousOpenAttempts = 50;
+
+// Connection uses 1 for MSG_DELETE.
+const uint32 MSG_RECONNECT = 2;
+
+}  // namespace
+
 namespace cricket {
 
 TCPPort::TCPPort(talk_base::Thread* thread,
@@ -43,6 +63,7 @@ TCPPort::TCPPort(talk_base::Thread* thread,
            username, password),
       incoming_only_(false),
       allow_listen_(allow_listen),
+      ice_tcp_(false),
       socket_(NULL),
       error_(0) {
   // TODO(mallinath) - Set preference value as per RFC 6544.
@@ -55,7 +76,7 @@ bool TCPPort::Init() {
     // should never happen.
     socket_ = socket_factory()->CreateServerTcpSocket(
         talk_base::SocketAddress(ip(), 0), min_port(), max_port(),
-        false /* ssl */);
+        0 /* opts */);
     if (!socket_) {
       LOG_J(LS_ERROR, this) << "TCP socket creation failed.";
       return false;
@@ -92,6 +113,16 @@ Connection* TCPPort::CreateConnection(const Candidate& address,
     return NULL;
   }
 
+  // RFC 6544 - 6.2.  Active candidates don't accept connections; their checks
+  // arrive on the connections they make to our passive candidate, and show up
+  // as peer reflexive.  Simultaneous-open candidates only pair with our own,
+  // whose address only one connection at a time can use.
+  if (address.tcptype() == TCPTYPE_ACTIVE_STR)
+    return NULL;
+  if (address.tcptype() == TCPTYPE_SIMOPEN_STR &&
+      (simopen_address_.IsNil() || HasSimultaneousOpenConnection()))
+    return NULL;
+
   TCPConnection* conn = NULL;
   if (talk_base::AsyncPacketSocket* socket =
       GetIncoming(address.address(), true)) {
@@ -105,6 +136,33 @@ Connection* TCPPort::CreateConnection(const Candidate& address,
 }
 
 void TCPPort::PrepareAddress() {
+  if (ice_tcp_) {
+    // The passive candidate is only added once the listening socket is bound,
+    // so it comes last, either here or in OnAddressReady().  Like the
+    // untyped candidate below, it's added even if Listen() failed.
+    bool listening = socket_ &&
+        (socket_->GetState() == talk_base::AsyncPacketSocket::STATE_BOUND ||
+         socket_->GetState() == talk_base::AsyncPacketSocket::STATE_CLOSED);
+    bool pending = socket_ &&
+        socket_->GetState() == talk_base::AsyncPacketSocket::STATE_BINDING;
+    bool simopen = ReserveSimultaneousOpenAddress();
+    talk_base::SocketAddress active_address(ip(), kActiveTcpPort);
+    AddAddress(active_address, active_address, "tcp", TCPTYPE_ACTIVE_STR,
+               LOCAL_PORT_TYPE, ICE_TYPE_PREFERENCE_HOST_TCP,
+               !simopen && !listening && !pending);
+    if (simopen) {
+      AddAddress(simopen_address_, simopen_address_, "tcp",
+                 TCPTYPE_SIMOPEN_STR, LOCAL_PORT_TYPE,
+                 ICE_TYPE_PREFERENCE_HOST_TCP, !listening && !pending);
+    }
+    if (listening) {
+      AddAddress(socket_->GetLocalAddress(), socket_->GetLocalAddress(), "tcp",
+                 TCPTYPE_PASSIVE_STR, LOCAL_PORT_TYPE,
+                 ICE_TYPE_PREFERENCE_HOST_TCP, true);
+    }
+    return;
+  }
+
   if (socket_) {
     // If socket isn't bound yet the address will be added in
     // OnAddressReady(). Socket may be in the CLOSED state if Listen()
@@ -182,6 +240,50 @@ void TCPPort::OnNewConnection(talk_base::AsyncPacketSocket* socket,
   incoming_.push_back(incoming);
 }
 
+bool TCPPort::ReserveSimultaneousOpenAddress() {
+  // The address has to be advertised before we know where we'll connect to,
+  // so bind a socket to find a free port and let it go again; connections
+  // then bind to that port to connect from it.  Connect() handles the port
+  // having been taken in the meantime.
+  talk_base::scoped_ptr<talk_base::AsyncPacketSocket> socket(
+      socket_factory()->CreateServerTcpSocket(
+          talk_base::SocketAddress(ip(), 0), min_port(), max_port(),
+          0 /* opts */));
+  if (!socket || socket->GetLocalAddress().port() == 0) {
+    LOG_J(LS_WARNING, this) << "No port for a simultaneous-open candidate.";
+    return false;
+  }
+  simopen_address_ = socket->GetLocalAddress();
+  return true;
+}
+
+bool TCPPort::HasSimultaneousOpenConnection() {
+  for (AddressMap::const_iterator it = connections().begin();
+       it != connections().end(); ++it) {
+    if (static_cast<TCPConnection*>(it->second)->simultaneous_open())
+      return true;
+  }
+  return false;
+}
+
+size_t TCPPort::GetLocalCandidateIndex(const Candidate& remote,
+                                       bool incoming) const {
+  std::string tcptype;
+  if (incoming) {
+    tcptype = TCPTYPE_PASSIVE_STR;
+  } else if (remote.tcptype() == TCPTYPE_SIMOPEN_STR) {
+    tcptype = TCPTYPE_SIMOPEN_STR;
+  } else {
+    tcptype = TCPTYPE_ACTIVE_STR;
+  }
+  const std::vector<Candidate>& candidates = Candidates();
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (candidates[i].tcptype() == tcptype)
+      return i;
+  }
+  return 0;
+}
+
 talk_base::AsyncPacketSocket* TCPPort::GetIncoming(
     const talk_base::SocketAddress& addr, bool remove) {
   talk_base::AsyncPacketSocket* socket = NULL;
@@ -206,44 +308,86 @@ void TCPPort::OnReadPacket(talk_base::AsyncPacketSocket* socket,
 void TCPPort::OnAddressReady(talk_base::AsyncPacketSocket* socket,
                              const talk_base::SocketAddress& address) {
   AddAddress(address, address, "tcp",
+             ice_tcp_ ? TCPTYPE_PASSIVE_STR : "",
              LOCAL_PORT_TYPE, ICE_TYPE_PREFERENCE_HOST_TCP,
              true);
 }
 
 TCPConnection::TCPConnection(TCPPort* port, const Candidate& candidate,
                              talk_base::AsyncPacketSocket* socket)
-    : Connection(port, 0, candidate), socket_(socket), error_(0) {
+    : Connection(port, port->GetLocalCandidateIndex(candidate, socket != NULL),
+                 candidate),
+      socket_(socket), error_(0),
+      simultaneous_open_(socket == NULL &&
+                         candidate.tcptype() == TCPTYPE_SIMOPEN_STR),
+      connect_attempts_(0) {
   bool outgoing = (socket_ == NULL);
   if (outgoing) {
-    // TODO: Handle failures here (unlikely since TCP).
-
-    socket_ = port->socket_factory()->CreateClientTcpSocket(
-        talk_base::SocketAddress(port_->Network()->ip(), 0),
-        candidate.address(), port->proxy(), port->user_agent(),
-        candidate.protocol() == "ssltcp");
-    if (socket_) {
-      LOG_J(LS_VERBOSE, this) << "Connecting from "
-                              << socket_->GetLocalAddress().ToString() << " to "
-                              << candidate.address().ToString();
-      set_connected(false);
-      socket_->SignalConnect.connect(this, &TCPConnection::OnConnect);
-    } else {
-      LOG_J(LS_WARNING, this) << "Failed to create connection to "
-                              << candidate.address().ToString();
-    }
+    Connect();
   } else {
     // Incoming connections should match the network address.
     ASSERT(socket_->GetLocalAddress().ipaddr() == port->ip());
+    socket_->SignalReadPacket.connect(this, &TCPConnection::OnReadPacket);
+    socket_->SignalClose.connect(this, &TCPConnection::OnClose);
   }
+}
 
+TCPConnection::~TCPConnection() {
+  port()->thread()->Clear(this, MSG_RECONNECT);
+  delete socket_;
+}
+
+void TCPConnection::Connect() {
+  // TODO: Handle failures here (unlikely since TCP).
+  TCPPort* port = static_cast<TCPPort*>(port_);
+  const Candidate& candidate = remote_candidate();
+  // A simultaneous open connects from the address we advertised for it.
+  talk_base::SocketAddress local_address = simultaneous_open_ ?
+      port->simopen_address_ :
+      talk_base::SocketAddress(port_->Network()->ip(), 0);
+  ++connect_attempts_;
+  socket_ = port->socket_factory()->CreateClientTcpSocket(
+      local_address, candidate.address(), port->proxy(), port->user_agent(),
+      candidate.protocol() == "ssltcp" ?
+          talk_base::PacketSocketFactory::OPT_SSLTCP : 0);
   if (socket_) {
+    LOG_J(LS_VERBOSE, this) << "Connecting from "
+                            << socket_->GetLocalAddress().ToString() << " to "
+                            << candidate.address().ToString();
+    set_connected(false);
+    socket_->SignalConnect.connect(this, &TCPConnection::OnConnect);
     socket_->SignalReadPacket.connect(this, &TCPConnection::OnReadPacket);
     socket_->SignalClose.connect(this, &TCPConnection::OnClose);
+  } else if (simultaneous_open_) {
+    // The port was most likely taken since it was reserved; see
+    // ReserveSimultaneousOpenAddress().  Retrying won't get it back.
+    LOG_J(LS_WARNING, this) << "Failed to connect from "
+                            << local_address.ToString()
+                            << ", the simultaneous-open address";
+    set_write_state(STATE_WRITE_TIMEOUT);
+  } else {
+    LOG_J(LS_WARNING, this) << "Failed to create connection to "
+                            << candidate.address().ToString();
   }
 }
 
-TCPConnection::~TCPConnection() {
+bool TCPConnection::RetryConnect() {
+  if (connect_attempts_ >= kMaxSimultaneousOpenAttempts)
+    return false;
+  int delay = kSimultaneousOpenRetryDelay +
+      talk_base::CreateRandomId() % kSimultaneousOpenRetryJitter;
+  port()->thread()->PostDelayed(delay, this, MSG_RECONNECT);
+  return true;
+}
+
+void TCPConnection::OnMessage(talk_base::Message* pmsg) {
+  if (pmsg->message_id != MSG_RECONNECT) {
+    Connection::OnMessage(pmsg);
+    return;
+  }
   delete socket_;
+  socket_ = NULL;
+  Connect();
 }
 
 int TCPConnection::Send(const void* data, size_t size) {
@@ -280,6 +424,10 @@ void TCPConnection::OnConnect(talk_base::AsyncPacketSocket* socket) {
 void TCPConnection::OnClose(talk_base::AsyncPacketSocket* socket, int error) {
   ASSERT(socket == socket_);
   LOG_J(LS_VERBOSE, this) << "Connection closed with error " << error;
+  // If the other end isn't connecting to us yet, try again in a bit.  The
+  // socket can't be deleted from its own signal, so that's done then too.
+  if (simultaneous_open_ && !connected() && RetryConnect())
+    return;
   set_connected(false);
   set_write_state(STATE_WRITE_TIMEOUT);
 }
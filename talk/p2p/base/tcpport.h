@@ -64,6 +64,14 @@ class TCPPort : public Port {
   }
   virtual ~TCPPort();
 
+  // Makes the port gather RFC 6544 typed candidates: a passive one for the
+  // listening socket, an active one for outgoing connections and a
+  // simultaneous-open one; otherwise it gathers a single untyped candidate,
+  // which both accepts and makes connections.  Must be called before
+  // PrepareAddress().
+  void set_ice_tcp(bool ice_tcp) { ice_tcp_ = ice_tcp; }
+  bool ice_tcp() const { return ice_tcp_; }
+
   virtual Connection* CreateConnection(const Candidate& address,
                                        CandidateOrigin origin);
 
@@ -97,6 +105,19 @@ class TCPPort : public Port {
   talk_base::AsyncPacketSocket* GetIncoming(
       const talk_base::SocketAddress& addr, bool remove = false);
 
+  // Picks an address for the simultaneous-open candidate.  The port is only
+  // known to be free while picking it, so something else may bind it before
+  // a connection is made from it; that connection then fails.  Holding on to
+  // it would take a bound socket that doesn't listen, which
+  // PacketSocketFactory can't make, and a listening one would accept the
+  // very connections that are meant to cross ours.
+  bool ReserveSimultaneousOpenAddress();
+  // Returns true if a connection is already using that address.
+  bool HasSimultaneousOpenConnection();
+  // Returns the index of the local candidate that a connection to |remote|
+  // uses, depending on whether it was accepted or is made by us.
+  size_t GetLocalCandidateIndex(const Candidate& remote, bool incoming) const;
+
   // Receives packet signal from the local TCP Socket.
   void OnReadPacket(talk_base::AsyncPacketSocket* socket,
                     const char* data, size_t size,
@@ -108,7 +129,9 @@ class TCPPort : public Port {
   // TODO: Is this still needed?
   bool incoming_only_;
   bool allow_listen_;
+  bool ice_tcp_;
   talk_base::AsyncPacketSocket* socket_;
+  talk_base::SocketAddress simopen_address_;
   int error_;
   std::list<Incoming> incoming_;
 
@@ -127,7 +150,16 @@ class TCPConnection : public Connection {
 
   talk_base::AsyncPacketSocket* socket() { return socket_; }
 
+  // True if this connection was opened simultaneously from both ends.
+  bool simultaneous_open() const { return simultaneous_open_; }
+
  private:
+  // Opens the outgoing socket.
+  void Connect();
+  // Schedules another attempt at a simultaneous open, unless we've run out.
+  bool RetryConnect();
+
+  virtual void OnMessage(talk_base::Message* pmsg);
   void OnConnect(talk_base::AsyncPacketSocket* socket);
   void OnClose(talk_base::AsyncPacketSocket* socket, int error);
   void OnReadPacket(talk_base::AsyncPacketSocket* socket,
@@ -136,6 +168,8 @@ class TCPConnection : public Connection {
 
   talk_base::AsyncPacketSocket* socket_;
   int error_;
+  bool simultaneous_open_;
+  int connect_attempts_;
 
   friend class TCPPort;
 };
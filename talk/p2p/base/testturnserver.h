@@ -46,9 +46,8 @@ class TestTurnServer : public TurnAuthInterface {
   TestTurnServer(talk_base::Thread* thread,
                  const talk_base::SocketAddress& udp_int_addr,
                  const talk_base::SocketAddress& udp_ext_addr)
-      : server_(thread) {
-    server_.AddInternalServerSocket(talk_base::AsyncUDPSocket::Create(
-        thread->socketserver(), udp_int_addr));
+      : thread_(thread), server_(thread) {
+    AddInternalSocket(udp_int_addr, PROTO_UDP);
     server_.SetExternalSocketFactory(new talk_base::BasicPacketSocketFactory(),
         udp_ext_addr);
     server_.set_realm(kTestRealm);
@@ -56,6 +55,23 @@ class TestTurnServer : public TurnAuthInterface {
     server_.set_auth_hook(this);
   }
 
+  // Adds another address for clients to reach the server at, over UDP or
+  // TCP.
+  void AddInternalSocket(const talk_base::SocketAddress& int_addr,
+                         ProtocolType proto) {
+    if (proto == PROTO_UDP) {
+      server_.AddInternalSocket(talk_base::AsyncUDPSocket::Create(
+          thread_->socketserver(), int_addr), proto);
+    } else if (proto == PROTO_TCP) {
+      talk_base::AsyncSocket* socket =
+          thread_->socketserver()->CreateAsyncSocket(int_addr.family(),
+                                                     SOCK_STREAM);
+      socket->Bind(int_addr);
+      socket->Listen(5);
+      server_.AddInternalServerSocket(socket, proto);
+    }
+  }
+
  private:
   // For this test server, succeed if the password is the same as the username.
   // Obviously, do not use this in a production environment.
@@ -64,6 +80,7 @@ class TestTurnServer : public TurnAuthInterface {
     return ComputeStunCredentialHash(username, realm, username, key);
   }
 
+  talk_base::Thread* thread_;
   TurnServer server_;
 };
 
@@ -63,6 +63,9 @@ enum P2PTransportChannelPingTimeout {
     kPingTimeoutUnWritableDelay = 1000 * kPingPacketSize / 10000,
     //Times out channel if does not receive a writable ping before
     kPingMaxCurrentWritableDelay = 2*kPingTimeoutWritableDelay,
+    //Longest wait between pings on a writable backup connection; well inside
+    //the other side's read timeout, so it stays readable there
+    kPingMaxBackupWritableDelay = 16*kPingTimeoutWritableDelay,
 };
 
 enum BasicPortAllocatorTimeout {
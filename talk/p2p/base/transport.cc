@@ -46,7 +46,7 @@ enum {
   MSG_CONNECTCHANNELS = 4,
   MSG_RESETCHANNELS = 5,
   MSG_ONSIGNALINGREADY = 6,
-  MSG_ONREMOTECANDIDATE = 7,
+  MSG_ONREMOTECANDIDATES = 7,
   MSG_READSTATE = 8,
   MSG_WRITESTATE = 9,
   MSG_REQUESTSIGNALING = 10,
@@ -78,6 +78,10 @@ struct ChannelParams : public talk_base::MessageData {
   Candidate* candidate;
 };
 
+struct CandidatesParams : public talk_base::MessageData {
+  std::vector<Candidate> candidates;
+};
+
 struct TransportDescriptionParams : public talk_base::MessageData {
   TransportDescriptionParams(const TransportDescription& desc,
                              ContentAction action)
@@ -380,33 +384,46 @@ bool Transport::VerifyCandidate(const Candidate& cand, std::string* error) {
 }
 
 void Transport::OnRemoteCandidates(const std::vector<Candidate>& candidates) {
+  ASSERT(signaling_thread()->IsCurrent());
+  if (destroyed_) return;
+
+  // The candidates go to the worker thread in one message, so that each
+  // channel gets all of its candidates at once.
+  CandidatesParams* params = new CandidatesParams();
   for (std::vector<Candidate>::const_iterator iter = candidates.begin();
        iter != candidates.end();
        ++iter) {
-    OnRemoteCandidate(*iter);
+    if (!HasChannel(iter->component())) {
+      LOG(LS_WARNING) << "Ignoring candidate for unknown component "
+                      << iter->component();
+      continue;
+    }
+    params->candidates.push_back(*iter);
   }
-}
 
-void Transport::OnRemoteCandidate(const Candidate& candidate) {
-  ASSERT(signaling_thread()->IsCurrent());
-  if (destroyed_) return;
-
-  if (!HasChannel(candidate.component())) {
-    LOG(LS_WARNING) << "Ignoring candidate for unknown component "
-                    << candidate.component();
+  if (params->candidates.empty()) {
+    delete params;
     return;
   }
-
-  ChannelParams* params = new ChannelParams(new Candidate(candidate));
-  worker_thread()->Post(this, MSG_ONREMOTECANDIDATE, params);
+  worker_thread()->Post(this, MSG_ONREMOTECANDIDATES, params);
 }
 
-void Transport::OnRemoteCandidate_w(const Candidate& candidate) {
+void Transport::OnRemoteCandidates_w(const std::vector<Candidate>& candidates) {
   ASSERT(worker_thread()->IsCurrent());
-  ChannelMap::iterator iter = channels_.find(candidate.component());
-  // It's ok for a channel to go away while this message is in transit.
-  if (iter != channels_.end()) {
-    iter->second->OnCandidate(candidate);
+  std::vector<Candidate> channel_candidates;
+  for (ChannelMap::iterator iter = channels_.begin();
+       iter != channels_.end();
+       ++iter) {
+    // It's ok for a channel to go away while this message is in transit.
+    channel_candidates.clear();
+    for (std::vector<Candidate>::const_iterator it = candidates.begin();
+         it != candidates.end();
+         ++it) {
+      if (it->component() == iter->first)
+        channel_candidates.push_back(*it);
+    }
+    if (!channel_candidates.empty())
+      iter->second->OnCandidates(channel_candidates);
   }
 }
 
@@ -671,9 +688,9 @@ void Transport::OnMessage(talk_base::Message* msg) {
     case MSG_ONSIGNALINGREADY:
       CallChannels_w(&TransportChannelImpl::OnSignalingReady);
       break;
-    case MSG_ONREMOTECANDIDATE: {
-        ChannelParams* params = static_cast<ChannelParams*>(msg->pdata);
-        OnRemoteCandidate_w(*params->candidate);
+    case MSG_ONREMOTECANDIDATES: {
+        CandidatesParams* params = static_cast<CandidatesParams*>(msg->pdata);
+        OnRemoteCandidates_w(params->candidates);
         delete params;
       }
       break;
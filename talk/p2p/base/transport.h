@@ -37,7 +37,7 @@
 // be made on the signaling thread and all channel related calls (including
 // signaling for a channel) will be made on the worker thread.  When
 // information needs to be sent between the two threads, this class should do
-// the work (e.g., OnRemoteCandidate).
+// the work (e.g., OnRemoteCandidates).
 //
 // Note: Subclasses must call DestroyChannels() in their own constructors.
 // It is not possible to do so here because the subclass constructor will
@@ -340,8 +340,6 @@ class Transport : public talk_base::MessageHandler,
   // Called when a channel requests signaling.
   void OnChannelRequestSignaling(TransportChannelImpl* channel);
 
-  // Called when a candidate is ready from remote peer.
-  void OnRemoteCandidate(const Candidate& candidate);
   // Called when a candidate is ready from channel.
   void OnChannelCandidateReady(TransportChannelImpl* channel,
                                const Candidate& candidate);
@@ -362,7 +360,7 @@ class Transport : public talk_base::MessageHandler,
   void ConnectChannels_w();
   void ResetChannels_w();
   void DestroyAllChannels_w();
-  void OnRemoteCandidate_w(const Candidate& candidate);
+  void OnRemoteCandidates_w(const std::vector<Candidate>& candidates);
   void OnChannelReadableState_s();
   void OnChannelWritableState_s();
   void OnChannelRequestSignaling_s(int component);
@@ -25,15 +25,22 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "talk/base/asyncudpsocket.h"
+#include "talk/base/basicpacketsocketfactory.h"
 #include "talk/base/fakesslidentity.h"
 #include "talk/base/gunit.h"
+#include "talk/base/network.h"
 #include "talk/base/thread.h"
+#include "talk/base/virtualsocketserver.h"
 #include "talk/p2p/base/constants.h"
 #include "talk/p2p/base/fakesession.h"
 #include "talk/p2p/base/parsing.h"
 #include "talk/p2p/base/p2ptransport.h"
 #include "talk/p2p/base/rawtransport.h"
+#include "talk/p2p/base/rawtransportchannel.h"
 #include "talk/p2p/base/sessionmessages.h"
+#include "talk/p2p/base/stunport.h"
+#include "talk/p2p/base/teststunserver.h"
 #include "talk/xmllite/xmlelement.h"
 #include "talk/xmpp/constants.h"
 
@@ -143,6 +150,38 @@ TEST_F(TransportTest, TestSetRoleAndTiebreaker) {
   EXPECT_EQ(cricket::ROLE_CONTROLLING, channel_->role());
 }
 
+// Tests that remote candidates reach each channel in one batch, on the worker
+// thread.
+TEST_F(TransportTest, TestRemoteCandidatesAreBatched) {
+  FakeTransportChannel* channel1 = CreateChannel(1);
+  FakeTransportChannel* channel2 = CreateChannel(2);
+  ASSERT_TRUE(channel1 != NULL && channel2 != NULL);
+  Candidates candidates;
+  for (int i = 0; i < 4; ++i) {
+    Candidate candidate;
+    candidate.set_component(1 + i % 2);
+    candidate.set_address(SocketAddress("192.168.1.1", 1000 + i));
+    candidates.push_back(candidate);
+  }
+  // Candidates for unknown components are dropped.
+  Candidate unknown;
+  unknown.set_component(3);
+  candidates.push_back(unknown);
+
+  transport_->OnRemoteCandidates(candidates);
+  EXPECT_EQ(0U, channel1->remote_candidates().size());
+  thread_->ProcessMessages(0);
+
+  EXPECT_EQ(1, channel1->num_candidate_batches());
+  ASSERT_EQ(2U, channel1->remote_candidates().size());
+  EXPECT_EQ(1000, channel1->remote_candidates()[0].address().port());
+  EXPECT_EQ(1002, channel1->remote_candidates()[1].address().port());
+  EXPECT_EQ(1, channel2->num_candidate_batches());
+  ASSERT_EQ(2U, channel2->remote_candidates().size());
+  EXPECT_EQ(1001, channel2->remote_candidates()[0].address().port());
+  EXPECT_EQ(1003, channel2->remote_candidates()[1].address().port());
+}
+
 // Tests that we can properly serialize/deserialize candidates.
 TEST_F(TransportTest, TestP2PTransportWriteAndParseCandidate) {
   Candidate test_candidate(
@@ -153,6 +192,7 @@ TEST_F(TransportTest, TestP2PTransportWriteAndParseCandidate) {
       "", 2, "tcp",
       talk_base::SocketAddress("192.168.7.1", 9999),
       1107296256, "mnopqr", "stuvwx", "bar", "testnet2", 100, "");
+  test_candidate2.set_tcptype(cricket::TCPTYPE_PASSIVE_STR);
   talk_base::SocketAddress host_address("www.google.com", 24601);
   host_address.SetResolvedIP(talk_base::IPAddress(0x0A000001));
   Candidate test_candidate3(
@@ -185,6 +225,7 @@ TEST_F(TransportTest, TestP2PTransportWriteAndParseCandidate) {
   EXPECT_EQ("foo", elem->Attr(cricket::QN_TYPE));
   EXPECT_EQ("testnet", elem->Attr(cricket::QN_NETWORK));
   EXPECT_EQ("50", elem->Attr(cricket::QN_GENERATION));
+  EXPECT_FALSE(elem->HasAttr(cricket::QN_TCPTYPE));
 
   elem = elems[1];
   EXPECT_EQ("test2", elem->Attr(buzz::QN_NAME));
@@ -197,6 +238,7 @@ TEST_F(TransportTest, TestP2PTransportWriteAndParseCandidate) {
   EXPECT_EQ("bar", elem->Attr(cricket::QN_TYPE));
   EXPECT_EQ("testnet2", elem->Attr(cricket::QN_NETWORK));
   EXPECT_EQ("100", elem->Attr(cricket::QN_GENERATION));
+  EXPECT_EQ("passive", elem->Attr(cricket::QN_TCPTYPE));
 
   // Check that an ip is preferred over hostname.
   elem = elems[2];
@@ -321,4 +363,130 @@ TEST_F(TransportTest, TestRawTransportWriteAndParseCandidate) {
   EXPECT_TRUE(expectedCandidate3.IsEquivalent(parsedCandidates.back()));
   dummy_element.ClearChildren();  // Deletes elems[2].
 }
+
+// Hands out a single STUN port, which is what RawTransportChannel wants.
+class StunPortAllocatorSession : public cricket::PortAllocatorSession {
+ public:
+  StunPortAllocatorSession(talk_base::Thread* thread,
+                           talk_base::PacketSocketFactory* factory,
+                           talk_base::Network* network,
+                           const SocketAddress& stun_address,
+                           const std::string& content_name, int component)
+      : cricket::PortAllocatorSession(content_name, component, "", "", 0),
+        thread_(thread), factory_(factory), network_(network),
+        stun_address_(stun_address) {
+  }
+
+  virtual void GetInitialPorts() {
+    port_.reset(cricket::StunPort::Create(
+        thread_, factory_, network_, network_->ip(), 0, 0, username(),
+        password(), stun_address_));
+    port_->SignalAddressReady.connect(
+        this, &StunPortAllocatorSession::OnAddressReady);
+    SignalPortReady(this, port_.get());
+    port_->PrepareAddress();
+  }
+  virtual void StartGetAllPorts() {}
+  virtual void StopGetAllPorts() {}
+  virtual bool IsGettingAllPorts() { return false; }
+
+ private:
+  void OnAddressReady(cricket::Port* port) {
+    SignalCandidatesReady(this, port->Candidates());
+  }
+
+  talk_base::Thread* thread_;
+  talk_base::PacketSocketFactory* factory_;
+  talk_base::Network* network_;
+  SocketAddress stun_address_;
+  talk_base::scoped_ptr<cricket::StunPort> port_;
+};
+
+class StunPortAllocator : public cricket::PortAllocator {
+ public:
+  StunPortAllocator(talk_base::Thread* thread,
+                    talk_base::PacketSocketFactory* factory,
+                    talk_base::Network* network,
+                    const SocketAddress& stun_address)
+      : thread_(thread), factory_(factory), network_(network),
+        stun_address_(stun_address) {
+  }
+
+  virtual cricket::PortAllocatorSession* CreateSessionInternal(
+      const std::string& content_name, int component,
+      const std::string& ice_ufrag, const std::string& ice_pwd) {
+    return new StunPortAllocatorSession(thread_, factory_, network_,
+                                        stun_address_, content_name,
+                                        component);
+  }
+
+ private:
+  talk_base::Thread* thread_;
+  talk_base::PacketSocketFactory* factory_;
+  talk_base::Network* network_;
+  SocketAddress stun_address_;
+};
+
+class RawTransportChannelTest : public testing::Test,
+                                public sigslot::has_slots<> {
+ public:
+  RawTransportChannelTest()
+      : ss_(new talk_base::VirtualSocketServer(NULL)),
+        ss_scope_(ss_.get()),
+        thread_(talk_base::Thread::Current()),
+        factory_(thread_),
+        network_("unittest", "unittest", talk_base::IPAddress(INADDR_ANY), 32),
+        stun_address_("99.99.99.1", cricket::STUN_SERVER_PORT),
+        stun_server_(thread_, stun_address_),
+        allocator_(thread_, &factory_, &network_, stun_address_),
+        received_packets_(0) {
+    network_.AddIP(talk_base::IPAddress(0x01010101));  // 1.1.1.1
+  }
+
+  void CountPackets(talk_base::AsyncPacketSocket* socket) {
+    socket->SignalReadPacket.connect(
+        this, &RawTransportChannelTest::OnReadPacket);
+  }
+  void OnReadPacket(talk_base::AsyncPacketSocket* socket, const char* data,
+                    size_t size, const SocketAddress& remote_addr) {
+    ++received_packets_;
+  }
+
+ protected:
+  talk_base::scoped_ptr<talk_base::VirtualSocketServer> ss_;
+  talk_base::SocketServerScope ss_scope_;
+  talk_base::Thread* thread_;
+  talk_base::BasicPacketSocketFactory factory_;
+  talk_base::Network network_;
+  SocketAddress stun_address_;
+  cricket::TestStunServer stun_server_;
+  StunPortAllocator allocator_;
+  int received_packets_;
+};
+
+// BaseChannel marks RTCP and audio with PF_PRIORITY; the raw channel has no
+// pacing to skip, but it must still send them.
+TEST_F(RawTransportChannelTest, TestSendPriorityPacket) {
+  talk_base::scoped_ptr<talk_base::AsyncUDPSocket> remote(
+      talk_base::AsyncUDPSocket::Create(ss_.get(),
+                                        SocketAddress("2.2.2.2", 5000)));
+  ASSERT_TRUE(remote.get() != NULL);
+  CountPackets(remote.get());
+
+  cricket::RawTransportChannel channel("test content name", 1, NULL, thread_,
+                                       &allocator_);
+  channel.Connect();
+  channel.OnRemoteAddress(remote->GetLocalAddress());
+  EXPECT_TRUE_WAIT(channel.writable(), 1000);
+
+  const char data[] = "RTCP";
+  EXPECT_EQ(static_cast<int>(sizeof(data)),
+            channel.SendPacket(data, sizeof(data), cricket::PF_PRIORITY));
+  EXPECT_EQ(static_cast<int>(sizeof(data)),
+            channel.SendPacket(data, sizeof(data), cricket::PF_NORMAL));
+  // Nothing else is supported.
+  EXPECT_EQ(-1, channel.SendPacket(data, sizeof(data),
+                                   cricket::PF_SRTP_BYPASS));
+  EXPECT_EQ_WAIT(2, received_packets_, 1000);
+}
 #endif  // defined(FEATURE_ENABLE_PSTN)
@@ -51,10 +51,17 @@ struct ConnectionInfo {
   bool timeout;                // Has this connection timed out?
   bool new_connection;         // Is this a newly created connection?
   size_t rtt;                  // The STUN RTT for this connection.
+  size_t smoothed_rtt;         // RTT smoothed over the ping responses.
+  size_t rtt_variance;         // Mean deviation of the RTT samples.
+  double ping_loss;            // Recent fraction of pings left unanswered.
+  size_t rtt_median;           // Median of the RTT samples.
+  size_t rtt_95th_percentile;  // 95th percentile of the RTT samples.
   size_t sent_total_bytes;     // Total bytes sent on this connection.
-  size_t sent_bytes_second;    // Bps over the last measurement interval.
+  size_t sent_bytes_second;    // Bps over the last second.
   size_t recv_total_bytes;     // Total bytes received on this connection.
-  size_t recv_bytes_second;    // Bps over the last measurement interval.
+  size_t recv_bytes_second;    // Bps over the last second.
+  size_t sent_ping_requests;   // STUN pings sent on this connection.
+  size_t recv_ping_responses;  // Responses received to those pings.
   Candidate local_candidate;   // The local candidate for this connection.
   Candidate remote_candidate;  // The remote candidate for this connection.
   void* key;                   // A static value that identifies this conn.
@@ -66,6 +73,7 @@ enum PacketFlags {
   PF_NORMAL       = 0x00,  // A normal packet.
   PF_SRTP_BYPASS  = 0x01,  // An encrypted SRTP packet; bypass any additional
                            // crypto provided by the transport (e.g. DTLS)
+  PF_PRIORITY     = 0x02,  // Audio or RTCP; not held back by send pacing.
 };
 
 // A TransportChannel represents one logical stream of packets that are sent
@@ -138,8 +146,8 @@ class TransportChannel : public sigslot::has_slots<> {
   }
 
   // Signalled each time a packet is received on this channel.
-  sigslot::signal4<TransportChannel*, const char*,
-                   size_t, int> SignalReadPacket;
+  sigslot::flat_signal4<TransportChannel*, const char*,
+                        size_t, int> SignalReadPacket;
 
   // This signal occurs when there is a change in the way that packets are
   // being routed, i.e. to a different remote location. The candidate
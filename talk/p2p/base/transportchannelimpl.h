@@ -83,6 +83,14 @@ class TransportChannelImpl : public TransportChannel {
   sigslot::signal2<TransportChannelImpl*,
                    const Candidate&> SignalCandidateReady;
   virtual void OnCandidate(const Candidate& candidate) = 0;
+  // Handles candidates that arrived together.  Channels that do work after
+  // each candidate can do it once for the whole batch instead.
+  virtual void OnCandidates(const Candidates& candidates) {
+    for (Candidates::const_iterator it = candidates.begin();
+         it != candidates.end(); ++it) {
+      OnCandidate(*it);
+    }
+  }
 
   // DTLS methods
   // Set DTLS local identity.
@@ -53,6 +53,14 @@ static const int TURN_CHANNEL_BINDING_TIMEOUT = 5 * 60 * 1000; // 5 minutes
 
 static const size_t TURN_CHANNEL_HEADER_SIZE = 4U;
 
+// Initial number of buckets in the table of entries by peer address.
+static const size_t TURN_ENTRY_BUCKETS = 16U;
+
+static inline size_t EntryBucket(const talk_base::SocketAddress& addr,
+                                 size_t buckets) {
+  return addr.Hash() & (buckets - 1);
+}
+
 inline bool IsTurnChannelData(uint16 msg_type) {
   return ((msg_type & 0xC000) == 0x4000);  // MSB are 0b01
 }
@@ -149,6 +157,10 @@ class TurnEntry : public sigslot::has_slots<> {
   int channel_id_;
   talk_base::SocketAddress ext_addr_;
   BindState state_;
+  // Chains the entries of a bucket in TurnPort's address table.
+  TurnEntry* next_;
+
+  friend class TurnPort;
 };
 
 TurnPort::TurnPort(talk_base::Thread* thread,
@@ -158,7 +170,7 @@ TurnPort::TurnPort(talk_base::Thread* thread,
                    int min_port, int max_port,
                    const std::string& username,
                    const std::string& password,
-                   const talk_base::SocketAddress& server_address,
+                   const ProtocolAddress& server_address,
                    const RelayCredentials& credentials)
     : Port(thread, RELAY_PORT_TYPE, ICE_TYPE_PREFERENCE_RELAY,
            factory, network, ip, min_port, max_port,
@@ -168,7 +180,9 @@ TurnPort::TurnPort(talk_base::Thread* thread,
       resolver_(NULL),
       error_(0),
       request_manager_(thread),
-      next_channel_number_(TURN_CHANNEL_NUMBER_START) {
+      allocated_(false),
+      next_channel_number_(TURN_CHANNEL_NUMBER_START),
+      address_table_(TURN_ENTRY_BUCKETS) {
   request_manager_.SignalSendPacket.connect(this, &TurnPort::OnSendStunPacket);
 }
 
@@ -180,6 +194,17 @@ TurnPort::~TurnPort() {
 }
 
 bool TurnPort::Init() {
+  if (server_address_.proto == PROTO_TCP ||
+      server_address_.proto == PROTO_SSLTCP) {
+    // The connection is made once the server address is resolved.
+    return true;
+  }
+  if (server_address_.proto != PROTO_UDP) {
+    LOG_J(LS_WARNING, this) << "Unsupported TURN server protocol "
+                            << ProtoToString(server_address_.proto);
+    return false;
+  }
+
   socket_.reset(socket_factory()->CreateUdpSocket(
       talk_base::SocketAddress(ip(), 0), min_port(), max_port()));
   if (!socket_) {
@@ -190,6 +215,30 @@ bool TurnPort::Init() {
   return true;
 }
 
+bool TurnPort::CreateTcpSocket() {
+  // TURN over TLS uses a real TLS handshake rather than the pseudo-SSL one
+  // that PROTO_SSLTCP means elsewhere.
+  int opts = talk_base::PacketSocketFactory::OPT_STUN;
+  if (server_address_.proto == PROTO_SSLTCP) {
+    opts |= talk_base::PacketSocketFactory::OPT_TLS;
+  }
+  socket_.reset(socket_factory()->CreateClientTcpSocket(
+      talk_base::SocketAddress(ip(), 0), server_address_.address,
+      talk_base::ProxyInfo(), std::string(), opts));
+  if (!socket_) {
+    LOG_J(LS_WARNING, this) << "TCP socket creation failed";
+    return false;
+  }
+  for (SocketOptionsMap::const_iterator it = socket_options_.begin();
+       it != socket_options_.end(); ++it) {
+    socket_->SetOption(it->first, it->second);
+  }
+  socket_->SignalReadPacket.connect(this, &TurnPort::OnReadPacket);
+  socket_->SignalConnect.connect(this, &TurnPort::OnSocketConnect);
+  socket_->SignalClose.connect(this, &TurnPort::OnSocketClose);
+  return true;
+}
+
 void TurnPort::PrepareAddress() {
   if (credentials_.username.empty() ||
       credentials_.password.empty()) {
@@ -199,12 +248,16 @@ void TurnPort::PrepareAddress() {
     return;
   }
 
-  if (!server_address_.port()) {
-    server_address_.SetPort(TURN_DEFAULT_PORT);
+  if (!server_address_.address.port()) {
+    server_address_.address.SetPort(TURN_DEFAULT_PORT);
   }
 
-  if (server_address_.IsUnresolved()) {
+  if (server_address_.address.IsUnresolved()) {
     ResolveTurnAddress();
+  } else if (!socket_) {
+    if (!CreateTcpSocket()) {
+      SignalAddressError(this);
+    }
   } else {
     SendRequest(new TurnAllocateRequest(this), 0);
   }
@@ -217,6 +270,12 @@ Connection* TurnPort::CreateConnection(const Candidate& address,
     return NULL;
   }
 
+  // No more connections once the connection to the server is lost.
+  if (socket_ &&
+      socket_->GetState() == talk_base::AsyncPacketSocket::STATE_CLOSED) {
+    return NULL;
+  }
+
   if (!IsCompatibleAddress(address.address())) {
     return NULL;
   }
@@ -232,6 +291,11 @@ Connection* TurnPort::CreateConnection(const Candidate& address,
 }
 
 int TurnPort::SetOption(talk_base::Socket::Option opt, int value) {
+  if (!socket_) {
+    // Applied when the TCP connection is made.
+    socket_options_[opt] = value;
+    return 0;
+  }
   return socket_->SetOption(opt, value);
 }
 
@@ -249,18 +313,6 @@ int TurnPort::SendTo(const void* data, size_t size,
     return 0;
   }
 
-  // TODO(juberti): Wire this up once we support sending over connected
-  // transports (e.g. TCP or TLS)
-  // If the entry is connected, then we can send on it (though wrapping may
-  // still be necessary).  Otherwise, we can't yet use this connection, so we
-  // default to the first one.
-  /*
-  if (!connected()) {
-    error_ = EWOULDBLOCK;
-    return SOCKET_ERROR;
-  }
-  */
-
   // Send the actual contents to the server using the usual mechanism.
   int sent = entry->Send(data, size, payload);
   if (sent <= 0) {
@@ -276,7 +328,7 @@ void TurnPort::OnReadPacket(talk_base::AsyncPacketSocket* socket,
                            const char* data, size_t size,
                            const talk_base::SocketAddress& remote_addr) {
   ASSERT(socket == socket_.get());
-  ASSERT(remote_addr == server_address_);
+  ASSERT(remote_addr == server_address_.address);
 
   // The message must be at least the size of a channel header.
   if (size < TURN_CHANNEL_HEADER_SIZE) {
@@ -311,7 +363,7 @@ void TurnPort::ResolveTurnAddress() {
 
   resolver_ = new talk_base::AsyncResolver();
   resolver_->SignalWorkDone.connect(this, &TurnPort::OnResolveResult);
-  resolver_->set_address(server_address_);
+  resolver_->set_address(server_address_.address);
   resolver_->Start();
 }
 
@@ -324,10 +376,38 @@ void TurnPort::OnResolveResult(talk_base::SignalThread* signal_thread) {
     return;
   }
 
-  server_address_ = resolver_->address();
+  server_address_.address = resolver_->address();
   PrepareAddress();
 }
 
+void TurnPort::OnSocketConnect(talk_base::AsyncPacketSocket* socket) {
+  ASSERT(socket == socket_.get());
+  LOG_J(LS_INFO, this) << "Connected to TURN server "
+                       << server_address_.address.ToString();
+  SendRequest(new TurnAllocateRequest(this), 0);
+}
+
+void TurnPort::OnSocketClose(talk_base::AsyncPacketSocket* socket,
+                             int error) {
+  ASSERT(socket == socket_.get());
+  LOG_J(LS_WARNING, this) << "Connection to TURN server closed, err="
+                          << error;
+  if (!allocated_) {
+    OnAllocateError();
+    return;
+  }
+
+  // The allocation is tied to the connection (RFC 5766, section 2.2), so
+  // it's gone now. Stop refreshing it and destroy the connections made over
+  // it, so that the channel moves to other ones.
+  allocated_ = false;
+  request_manager_.Clear();
+  for (AddressMap::const_iterator it = connections().begin();
+       it != connections().end(); ++it) {
+    it->second->Destroy();
+  }
+}
+
 void TurnPort::OnSendStunPacket(const void* data, size_t size,
                                 StunRequest* request) {
   if (Send(data, size) < 0) {
@@ -342,6 +422,8 @@ void TurnPort::OnStunAddress(const talk_base::SocketAddress& address) {
 }
 
 void TurnPort::OnAllocateSuccess(const talk_base::SocketAddress& address) {
+  allocated_ = true;
+  // The relayed address is always UDP, whatever the transport to the server.
   AddAddress(address, socket_->GetLocalAddress(), "udp",
              RELAY_PORT_TYPE, ICE_TYPE_PREFERENCE_RELAY, true);
 }
@@ -461,7 +543,11 @@ void TurnPort::AddRequestAuthInfo(StunMessage* msg) {
 }
 
 int TurnPort::Send(const void* data, size_t len) {
-  return socket_->SendTo(data, len, server_address_);
+  return socket_->SendTo(data, len, server_address_.address);
+}
+
+int TurnPort::SendV(const talk_base::IoVec* iov, size_t count) {
+  return socket_->SendToV(iov, count, server_address_.address);
 }
 
 void TurnPort::UpdateHash() {
@@ -477,38 +563,61 @@ bool TurnPort::HasPermission(const talk_base::IPAddress& ipaddr) const {
       std::bind2nd(std::ptr_fun(MatchesIP), ipaddr)) != entries_.end());
 }
 
-static bool MatchesAddress(TurnEntry* e, talk_base::SocketAddress addr) {
-  return e->address() == addr;
-}
 TurnEntry* TurnPort::FindEntry(const talk_base::SocketAddress& addr) const {
-  EntryList::const_iterator it = std::find_if(entries_.begin(), entries_.end(),
-      std::bind2nd(std::ptr_fun(MatchesAddress), addr));
-  return (it != entries_.end()) ? *it : NULL;
+  TurnEntry* entry =
+      address_table_[EntryBucket(addr, address_table_.size())];
+  while (entry && entry->address() != addr) {
+    entry = entry->next_;
+  }
+  return entry;
 }
 
-static bool MatchesChannelId(TurnEntry* e, int id) {
-  return e->channel_id() == id;
-}
 TurnEntry* TurnPort::FindEntry(int channel_id) const {
-  EntryList::const_iterator it = std::find_if(entries_.begin(), entries_.end(),
-      std::bind2nd(std::ptr_fun(MatchesChannelId), channel_id));
-  return (it != entries_.end()) ? *it : NULL;
+  size_t index = static_cast<size_t>(channel_id - TURN_CHANNEL_NUMBER_START);
+  return (channel_id >= TURN_CHANNEL_NUMBER_START &&
+          index < channel_table_.size()) ? channel_table_[index] : NULL;
 }
 
 TurnEntry* TurnPort::CreateEntry(const talk_base::SocketAddress& addr) {
   ASSERT(FindEntry(addr) == NULL);
+  if (entries_.size() >= address_table_.size()) {
+    ResizeAddressTable(address_table_.size() * 2);
+  }
   TurnEntry* entry = new TurnEntry(this, next_channel_number_++, addr);
   entries_.push_back(entry);
+  size_t bucket = EntryBucket(addr, address_table_.size());
+  entry->next_ = address_table_[bucket];
+  address_table_[bucket] = entry;
+  // Channel numbers are handed out in order and never reused.
+  ASSERT(entry->channel_id() - TURN_CHANNEL_NUMBER_START ==
+         static_cast<int>(channel_table_.size()));
+  channel_table_.push_back(entry);
   return entry;
 }
 
 void TurnPort::DestroyEntry(const talk_base::SocketAddress& addr) {
   TurnEntry* entry = FindEntry(addr);
   ASSERT(entry != NULL);
+  TurnEntry** link = &address_table_[EntryBucket(addr, address_table_.size())];
+  while (*link != entry) {
+    link = &(*link)->next_;
+  }
+  *link = entry->next_;
+  channel_table_[entry->channel_id() - TURN_CHANNEL_NUMBER_START] = NULL;
   entries_.remove(entry);
   delete entry;
 }
 
+void TurnPort::ResizeAddressTable(size_t buckets) {
+  address_table_.assign(buckets, NULL);
+  for (EntryList::const_iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    size_t bucket = EntryBucket((*it)->address(), buckets);
+    (*it)->next_ = address_table_[bucket];
+    address_table_[bucket] = *it;
+  }
+}
+
 TurnAllocateRequest::TurnAllocateRequest(TurnPort* port)
     : StunRequest(new TurnMessage()),
       port_(port) {
@@ -714,36 +823,45 @@ TurnEntry::TurnEntry(TurnPort* port, int channel_id,
     : port_(port),
       channel_id_(channel_id),
       ext_addr_(ext_addr),
-      state_(STATE_UNBOUND) {
+      state_(STATE_UNBOUND),
+      next_(NULL) {
   port_->SendRequest(new TurnCreatePermissionRequest(
       port_, this, ext_addr_), 0);
 }
 
 int TurnEntry::Send(const void* data, size_t size, bool payload) {
-  talk_base::ByteBuffer buf;
-  if (state_ != STATE_BOUND) {
-    // If we haven't bound the channel yet, we have to use a Send Indication.
-    TurnMessage msg;
-    msg.SetType(TURN_SEND_INDICATION);
-    msg.SetTransactionID(
-        talk_base::CreateRandomString(kStunTransactionIdLength));
-    VERIFY(msg.AddAttribute(new StunXorAddressAttribute(
-        STUN_ATTR_XOR_PEER_ADDRESS, ext_addr_)));
-    VERIFY(msg.AddAttribute(new StunByteStringAttribute(
-        STUN_ATTR_DATA, data, size)));
-    VERIFY(msg.Write(&buf));
-
-    // If we're sending real data, request a channel bind that we can use later.
-    if (state_ == STATE_UNBOUND && payload) {
-      port_->SendRequest(new TurnChannelBindRequest(
-          port_, this, channel_id_, ext_addr_), 0);
-      state_ = STATE_BINDING;
-    }
-  } else {
+  if (state_ == STATE_BOUND) {
     // If the channel is bound, we can send the data as a Channel Message.
-    buf.WriteUInt16(channel_id_);
-    buf.WriteUInt16(size);
-    buf.WriteBytes(reinterpret_cast<const char*>(data), size);
+    // The header goes out ahead of the caller's buffer in a single gathering
+    // send, so the payload isn't copied.
+    char header[TURN_CHANNEL_HEADER_SIZE];
+    talk_base::SetBE16(header, static_cast<uint16>(channel_id_));
+    talk_base::SetBE16(header + 2, static_cast<uint16>(size));
+    talk_base::IoVec iov[2];
+    iov[0].data = header;
+    iov[0].len = sizeof(header);
+    iov[1].data = data;
+    iov[1].len = size;
+    return port_->SendV(iov, 2);
+  }
+
+  // If we haven't bound the channel yet, we have to use a Send Indication.
+  TurnMessage msg;
+  msg.SetType(TURN_SEND_INDICATION);
+  msg.SetTransactionID(
+      talk_base::CreateRandomString(kStunTransactionIdLength));
+  VERIFY(msg.AddAttribute(new StunXorAddressAttribute(
+      STUN_ATTR_XOR_PEER_ADDRESS, ext_addr_)));
+  VERIFY(msg.AddAttribute(new StunByteStringAttribute(
+      STUN_ATTR_DATA, data, size)));
+  talk_base::ByteBuffer buf;
+  VERIFY(msg.Write(&buf));
+
+  // If we're sending real data, request a channel bind that we can use later.
+  if (state_ == STATE_UNBOUND && payload) {
+    port_->SendRequest(new TurnChannelBindRequest(
+        port_, this, channel_id_, ext_addr_), 0);
+    state_ = STATE_BINDING;
   }
   return port_->Send(buf.Data(), buf.Length());
 }
@@ -31,6 +31,8 @@
 #include <stdio.h>
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
 
 #include "talk/p2p/base/port.h"
 #include "talk/p2p/client/basicportallocator.h"
@@ -56,7 +58,7 @@ class TurnPort : public Port {
            int min_port, int max_port,
            const std::string& username,
            const std::string& password,
-           const talk_base::SocketAddress& server_address,
+           const ProtocolAddress& server_address,
            const RelayCredentials& credentials);
 
   bool Init();
@@ -68,7 +70,7 @@ class TurnPort : public Port {
                           int min_port, int max_port,
                           const std::string& username,  // ice username.
                           const std::string& password,  // ice password.
-                          const talk_base::SocketAddress& server_address,
+                          const ProtocolAddress& server_address,
                           const RelayCredentials& credentials){
     TurnPort* port = new TurnPort(thread, factory, network,
                                   ip, min_port, max_port,
@@ -84,9 +86,7 @@ class TurnPort : public Port {
   virtual ~TurnPort();
   virtual std::string GetClassname() const { return "TurnPort"; }
 
-  const talk_base::SocketAddress& server_address() const {
-    return server_address_;
-  }
+  const ProtocolAddress& server_address() const { return server_address_; }
   const RelayCredentials& credentials() const { return credentials_; }
 
   virtual void PrepareAddress();
@@ -106,6 +106,11 @@ class TurnPort : public Port {
 
  private:
   typedef std::list<TurnEntry*> EntryList;
+  // Entries are found by peer address through a chained hash table of
+  // power-of-two size, and by channel number through a table indexed by
+  // the number's offset from the first one.
+  typedef std::vector<TurnEntry*> EntryTable;
+  typedef std::map<talk_base::Socket::Option, int> SocketOptionsMap;
   void set_nonce(const std::string& nonce) { nonce_ = nonce; }
   void set_realm(const std::string& realm) {
     if (realm != realm_) {
@@ -117,6 +122,12 @@ class TurnPort : public Port {
   void ResolveTurnAddress();
   void OnResolveResult(talk_base::SignalThread* signal_thread);
 
+  // Connects to the server over TCP, or TLS for PROTO_SSLTCP. The allocate
+  // request is sent once the connection is up.
+  bool CreateTcpSocket();
+  void OnSocketConnect(talk_base::AsyncPacketSocket* socket);
+  void OnSocketClose(talk_base::AsyncPacketSocket* socket, int error);
+
   void AddRequestAuthInfo(StunMessage* msg);
   void OnSendStunPacket(const void* data, size_t size, StunRequest* request);
   // Stun address from allocate success response.
@@ -133,6 +144,8 @@ class TurnPort : public Port {
   bool ScheduleRefresh(int lifetime);
   void SendRequest(StunRequest* request, int delay);
   int Send(const void* data, size_t size);
+  // Sends |count| buffers to the server as one packet.
+  int SendV(const talk_base::IoVec* iov, size_t count);
   void UpdateHash();
 
   bool HasPermission(const talk_base::IPAddress& ipaddr) const;
@@ -140,11 +153,13 @@ class TurnPort : public Port {
   TurnEntry* FindEntry(int channel_id) const;
   TurnEntry* CreateEntry(const talk_base::SocketAddress& address);
   void DestroyEntry(const talk_base::SocketAddress& address);
+  void ResizeAddressTable(size_t buckets);
 
-  talk_base::SocketAddress server_address_;
+  ProtocolAddress server_address_;
   RelayCredentials credentials_;
 
   talk_base::scoped_ptr<talk_base::AsyncPacketSocket> socket_;
+  SocketOptionsMap socket_options_;
   talk_base::AsyncResolver* resolver_;
   int error_;
 
@@ -153,8 +168,11 @@ class TurnPort : public Port {
   std::string nonce_;       // From 401 response message.
   std::string hash_;        // Digest of username:realm:password
 
+  bool allocated_;
   int next_channel_number_;
   EntryList entries_;
+  EntryTable address_table_;
+  EntryTable channel_table_;
 
   friend class TurnEntry;
   friend class TurnAllocateRequest;
@@ -44,6 +44,7 @@ using talk_base::SocketAddress;
 using cricket::Connection;
 using cricket::Port;
 using cricket::PortInterface;
+using cricket::ProtocolAddress;
 using cricket::TurnPort;
 using cricket::UDPPort;
 
@@ -52,6 +53,12 @@ static const SocketAddress kLocalAddr2("22.22.22.22", 0);
 static const SocketAddress kTurnUdpIntAddr("99.99.99.4",
                                            cricket::TURN_SERVER_PORT);
 static const SocketAddress kTurnUdpExtAddr("99.99.99.5", 0);
+static const SocketAddress kTurnTcpIntAddr("99.99.99.6",
+                                           cricket::TURN_SERVER_PORT);
+static const SocketAddress kTurnUdpIntAddr2("99.99.99.7",
+                                            cricket::TURN_SERVER_PORT);
+static const SocketAddress kTurnTcpIntAddr2("99.99.99.8",
+                                            cricket::TURN_SERVER_PORT);
 
 static const char kIceUfrag1[] = "TESTICEUFRAG0001";
 static const char kIceUfrag2[] = "TESTICEUFRAG0002";
@@ -75,6 +82,7 @@ class TurnPortTest : public testing::Test,
         turn_ready_(false),
         turn_error_(false),
         turn_unknown_address_(false),
+        turn_conn_destroyed_(false),
         udp_ready_(false) {
     network_.AddIP(talk_base::IPAddress(INADDR_ANY));
   }
@@ -93,6 +101,10 @@ class TurnPortTest : public testing::Test,
   }
   void OnTurnReadPacket(Connection* conn, const char* data, size_t size) {
     turn_packets_.push_back(talk_base::Buffer(data, size));
+    turn_packet_conns_.push_back(conn);
+  }
+  void OnTurnConnectionDestroyed(Connection* conn) {
+    turn_conn_destroyed_ = true;
   }
   void OnUdpAddressReady(Port* port) {
     udp_ready_ = true;
@@ -105,6 +117,12 @@ class TurnPortTest : public testing::Test,
   void CreateTurnPort(const SocketAddress& server_address,
                       const std::string& username,
                       const std::string& password) {
+    CreateTurnPort(ProtocolAddress(server_address, cricket::PROTO_UDP),
+                   username, password);
+  }
+  void CreateTurnPort(const ProtocolAddress& server_address,
+                      const std::string& username,
+                      const std::string& password) {
     cricket::RelayCredentials credentials(username, password);
     turn_port_.reset(TurnPort::Create(main_, &socket_factory_, &network_,
                                  kLocalAddr1.ipaddr(), 0, 0,
@@ -117,6 +135,8 @@ class TurnPortTest : public testing::Test,
     turn_port_->SignalUnknownAddress.connect(this,
         &TurnPortTest::OnTurnUnknownAddress);
   }
+  // Prepares turn_port_, created by the caller, and exchanges data over it.
+  void TestTurnSendData();
   void CreateUdpPort() {
     udp_port_.reset(UDPPort::Create(main_, &socket_factory_, &network_,
                                     kLocalAddr2.ipaddr(), 0, 0,
@@ -138,11 +158,59 @@ class TurnPortTest : public testing::Test,
   bool turn_ready_;
   bool turn_error_;
   bool turn_unknown_address_;
+  bool turn_conn_destroyed_;
   bool udp_ready_;
   std::vector<talk_base::Buffer> turn_packets_;
+  std::vector<Connection*> turn_packet_conns_;
   std::vector<talk_base::Buffer> udp_packets_;
 };
 
+void TurnPortTest::TestTurnSendData() {
+  // Prepare addresses.
+  turn_port_->PrepareAddress();
+  EXPECT_TRUE_WAIT(turn_ready_, kTimeout);
+  CreateUdpPort();
+  udp_port_->PrepareAddress();
+  EXPECT_TRUE_WAIT(udp_ready_, kTimeout);
+
+  // Create connections and send pings.
+  Connection* conn1 = turn_port_->CreateConnection(
+      udp_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
+  Connection* conn2 = udp_port_->CreateConnection(
+      turn_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn1 != NULL);
+  ASSERT_TRUE(conn2 != NULL);
+  conn1->SignalReadPacket.connect(static_cast<TurnPortTest*>(this),
+                                  &TurnPortTest::OnTurnReadPacket);
+  conn2->SignalReadPacket.connect(static_cast<TurnPortTest*>(this),
+                                  &TurnPortTest::OnUdpReadPacket);
+  conn1->Ping(0);
+  EXPECT_EQ_WAIT(Connection::STATE_WRITABLE, conn1->write_state(), kTimeout);
+  conn2->Ping(0);
+  EXPECT_EQ_WAIT(Connection::STATE_WRITABLE, conn2->write_state(), kTimeout);
+
+  // Send some data.
+  size_t num_packets = 256;
+  for (size_t i = 0; i < num_packets; ++i) {
+    char buf[256];
+    for (size_t j = 0; j < i + 1; ++j) {
+      buf[j] = 0xFF - j;
+    }
+    conn1->Send(buf, i + 1);
+    conn2->Send(buf, i + 1);
+    main_->ProcessMessages(0);
+  }
+
+  // Check the data.
+  ASSERT_EQ_WAIT(num_packets, turn_packets_.size(), kTimeout);
+  ASSERT_EQ_WAIT(num_packets, udp_packets_.size(), kTimeout);
+  for (size_t i = 0; i < num_packets; ++i) {
+    EXPECT_EQ(i + 1, turn_packets_[i].length());
+    EXPECT_EQ(i + 1, udp_packets_[i].length());
+    EXPECT_EQ(turn_packets_[i], udp_packets_[i]);
+  }
+}
+
 // Do a normal TURN allocation.
 TEST_F(TurnPortTest, TestTurnAllocate) {
   CreateTurnPort(kTurnUdpIntAddr, kTurnUsername, kTurnPassword);
@@ -201,50 +269,171 @@ TEST_F(TurnPortTest, TestTurnConnection) {
   EXPECT_EQ(Connection::STATE_READABLE, conn2->read_state());
 }
 
+// Do a TURN allocation over TCP.
+TEST_F(TurnPortTest, TestTurnTcpAllocate) {
+  turn_server_.AddInternalSocket(kTurnTcpIntAddr, cricket::PROTO_TCP);
+  CreateTurnPort(ProtocolAddress(kTurnTcpIntAddr, cricket::PROTO_TCP),
+                 kTurnUsername, kTurnPassword);
+  turn_port_->PrepareAddress();
+  EXPECT_TRUE_WAIT(turn_ready_, kTimeout);
+  ASSERT_EQ(1U, turn_port_->Candidates().size());
+  EXPECT_EQ(kTurnUdpExtAddr.ipaddr(),
+            turn_port_->Candidates()[0].address().ipaddr());
+  EXPECT_NE(0, turn_port_->Candidates()[0].address().port());
+  EXPECT_EQ("udp", turn_port_->Candidates()[0].protocol());
+}
+
+// Try to do a TURN allocation over TCP when nothing is listening.
+TEST_F(TurnPortTest, TestTurnTcpAllocateNoListener) {
+  CreateTurnPort(ProtocolAddress(kTurnTcpIntAddr, cricket::PROTO_TCP),
+                 kTurnUsername, kTurnPassword);
+  turn_port_->PrepareAddress();
+  EXPECT_TRUE_WAIT(turn_error_, kTimeout);
+  ASSERT_EQ(0U, turn_port_->Candidates().size());
+}
+
 // Do a TURN allocation, establish a connection, and send some data.
 TEST_F(TurnPortTest, TestTurnSendData) {
-  // Create ports and prepare addresses.
   CreateTurnPort(kTurnUdpIntAddr, kTurnUsername, kTurnPassword);
+  TestTurnSendData();
+}
+
+// Do the same with the TURN port talking to the server over TCP.
+TEST_F(TurnPortTest, TestTurnTcpSendData) {
+  turn_server_.AddInternalSocket(kTurnTcpIntAddr, cricket::PROTO_TCP);
+  CreateTurnPort(ProtocolAddress(kTurnTcpIntAddr, cricket::PROTO_TCP),
+                 kTurnUsername, kTurnPassword);
+  TestTurnSendData();
+}
+
+// Lose the TCP connection to the server after the allocation is made. The
+// port's connections should be destroyed, and no new ones made.
+TEST_F(TurnPortTest, TestTurnTcpConnectionLost) {
+  // A server of our own, so that it can be deleted to close the connection.
+  talk_base::scoped_ptr<cricket::TestTurnServer> turn_server(
+      new cricket::TestTurnServer(main_, kTurnUdpIntAddr2, kTurnUdpExtAddr));
+  turn_server->AddInternalSocket(kTurnTcpIntAddr2, cricket::PROTO_TCP);
+  CreateTurnPort(ProtocolAddress(kTurnTcpIntAddr2, cricket::PROTO_TCP),
+                 kTurnUsername, kTurnPassword);
   turn_port_->PrepareAddress();
-  EXPECT_TRUE_WAIT(turn_ready_, kTimeout);
+  ASSERT_TRUE_WAIT(turn_ready_, kTimeout);
   CreateUdpPort();
   udp_port_->PrepareAddress();
-  EXPECT_TRUE_WAIT(udp_ready_, kTimeout);
+  ASSERT_TRUE_WAIT(udp_ready_, kTimeout);
 
-  // Create connections and send pings.
+  Connection* conn = turn_port_->CreateConnection(
+      udp_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
+  ASSERT_TRUE(conn != NULL);
+  conn->SignalDestroyed.connect(static_cast<TurnPortTest*>(this),
+                                &TurnPortTest::OnTurnConnectionDestroyed);
+
+  turn_server.reset();
+  EXPECT_TRUE_WAIT(turn_conn_destroyed_, kTimeout);
+  EXPECT_TRUE(turn_port_->connections().empty());
+  EXPECT_TRUE(turn_port_->CreateConnection(
+      udp_port_->Candidates()[0], Port::ORIGIN_MESSAGE) == NULL);
+}
+
+// Do a TURN allocation and exchange data with more peers than the port's
+// table of entries starts out with. Each peer's packets must reach the
+// connection for that peer, whether they come in data indications or on the
+// peer's channel.
+TEST_F(TurnPortTest, TestTurnSendDataManyPeers) {
+  const size_t kPeers = 20;
+  CreateTurnPort(kTurnUdpIntAddr, kTurnUsername, kTurnPassword);
+  turn_port_->PrepareAddress();
+  ASSERT_TRUE_WAIT(turn_ready_, kTimeout);
+  talk_base::scoped_ptr<UDPPort> peers[kPeers];
+  for (size_t i = 0; i < kPeers; ++i) {
+    peers[i].reset(UDPPort::Create(main_, &socket_factory_, &network_,
+                                   kLocalAddr2.ipaddr(), 0, 0,
+                                   kIceUfrag2, kIcePwd2));
+    peers[i]->PrepareAddress();
+  }
+  Connection* turn_conns[kPeers];
+  Connection* peer_conns[kPeers];
+  for (size_t i = 0; i < kPeers; ++i) {
+    ASSERT_EQ_WAIT(1U, peers[i]->Candidates().size(), kTimeout);
+    turn_conns[i] = turn_port_->CreateConnection(
+        peers[i]->Candidates()[0], Port::ORIGIN_MESSAGE);
+    peer_conns[i] = peers[i]->CreateConnection(
+        turn_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
+    ASSERT_TRUE(turn_conns[i] != NULL);
+    ASSERT_TRUE(peer_conns[i] != NULL);
+    turn_conns[i]->SignalReadPacket.connect(
+        static_cast<TurnPortTest*>(this), &TurnPortTest::OnTurnReadPacket);
+    peer_conns[i]->SignalReadPacket.connect(
+        static_cast<TurnPortTest*>(this), &TurnPortTest::OnUdpReadPacket);
+    turn_conns[i]->Ping(0);
+  }
+  for (size_t i = 0; i < kPeers; ++i) {
+    EXPECT_EQ_WAIT(Connection::STATE_WRITABLE, turn_conns[i]->write_state(),
+                   kTimeout);
+    peer_conns[i]->Ping(0);
+  }
+  for (size_t i = 0; i < kPeers; ++i) {
+    EXPECT_EQ_WAIT(Connection::STATE_WRITABLE, peer_conns[i]->write_state(),
+                   kTimeout);
+  }
+
+  // The first round of data sets up the channels, and the second uses them.
+  for (size_t round = 0; round < 2; ++round) {
+    turn_packets_.clear();
+    turn_packet_conns_.clear();
+    udp_packets_.clear();
+    for (size_t i = 0; i < kPeers; ++i) {
+      char data = static_cast<char>(i);
+      turn_conns[i]->Send(&data, 1);
+      peer_conns[i]->Send(&data, 1);
+    }
+    ASSERT_EQ_WAIT(kPeers, turn_packets_.size(), kTimeout);
+    ASSERT_EQ_WAIT(kPeers, udp_packets_.size(), kTimeout);
+    for (size_t i = 0; i < kPeers; ++i) {
+      size_t peer = static_cast<size_t>(turn_packets_[i].data()[0]);
+      ASSERT_LT(peer, kPeers);
+      EXPECT_EQ(turn_conns[peer], turn_packet_conns_[i]);
+    }
+  }
+}
+
+// Measures how fast packets are relayed from the TURN port to a peer once
+// the channel is bound.
+TEST_F(TurnPortTest, DISABLED_Perf) {
+  CreateTurnPort(kTurnUdpIntAddr, kTurnUsername, kTurnPassword);
+  turn_port_->PrepareAddress();
+  ASSERT_TRUE_WAIT(turn_ready_, kTimeout);
+  CreateUdpPort();
+  udp_port_->PrepareAddress();
+  ASSERT_TRUE_WAIT(udp_ready_, kTimeout);
   Connection* conn1 = turn_port_->CreateConnection(
       udp_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
   Connection* conn2 = udp_port_->CreateConnection(
       turn_port_->Candidates()[0], Port::ORIGIN_MESSAGE);
   ASSERT_TRUE(conn1 != NULL);
   ASSERT_TRUE(conn2 != NULL);
-  conn1->SignalReadPacket.connect(static_cast<TurnPortTest*>(this),
-                                  &TurnPortTest::OnTurnReadPacket);
   conn2->SignalReadPacket.connect(static_cast<TurnPortTest*>(this),
                                   &TurnPortTest::OnUdpReadPacket);
   conn1->Ping(0);
-  EXPECT_EQ_WAIT(Connection::STATE_WRITABLE, conn1->write_state(), kTimeout);
-  conn2->Ping(0);
-  EXPECT_EQ_WAIT(Connection::STATE_WRITABLE, conn2->write_state(), kTimeout);
+  ASSERT_EQ_WAIT(Connection::STATE_WRITABLE, conn1->write_state(), kTimeout);
 
-  // Send some data.
-  size_t num_packets = 256;
-  for (size_t i = 0; i < num_packets; ++i) {
-    char buf[256];
-    for (size_t j = 0; j < i + 1; ++j) {
-      buf[j] = 0xFF - j;
-    }
-    conn1->Send(buf, i + 1);
-    conn2->Send(buf, i + 1);
-    main_->ProcessMessages(0);
-  }
+  // Bind the channel.
+  const std::string packet(1200, 'p');
+  conn1->Send(packet.data(), packet.size());
+  ASSERT_EQ_WAIT(1U, udp_packets_.size(), kTimeout);
+  main_->ProcessMessages(100);
+  udp_packets_.clear();
 
-  // Check the data.
-  ASSERT_EQ_WAIT(num_packets, turn_packets_.size(), kTimeout);
-  ASSERT_EQ_WAIT(num_packets, udp_packets_.size(), kTimeout);
-  for (size_t i = 0; i < num_packets; ++i) {
-    EXPECT_EQ(i + 1, turn_packets_[i].length());
-    EXPECT_EQ(i + 1, udp_packets_[i].length());
-    EXPECT_EQ(turn_packets_[i], udp_packets_[i]);
+  const size_t kPacketCount = 20000;
+  uint32 start = talk_base::Time();
+  for (size_t i = 0; i < kPacketCount; ++i) {
+    conn1->Send(packet.data(), packet.size());
+    if (i % 64 == 63) {
+      main_->ProcessMessages(0);
+    }
   }
+  EXPECT_EQ_WAIT(kPacketCount, udp_packets_.size(), kTimeout);
+  uint32 elapsed = talk_base::_max(talk_base::TimeSince(start), 1);
+  LOG(LS_INFO) << "Relayed " << udp_packets_.size() << " of " << kPacketCount
+               << " packets in " << elapsed << " ms ("
+               << udp_packets_.size() * 1000 / elapsed << " packets/s)";
 }
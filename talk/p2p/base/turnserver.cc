@@ -28,6 +28,7 @@
 #include "talk/p2p/base/turnserver.h"
 
 #include "talk/base/asyncpacketsocket.h"
+#include "talk/base/asyncstuntcpsocket.h"
 #include "talk/base/bytebuffer.h"
 #include "talk/base/helpers.h"
 #include "talk/base/logging.h"
@@ -36,6 +37,7 @@
 #include "talk/base/stringencode.h"
 #include "talk/base/thread.h"
 #include "talk/p2p/base/common.h"
+#include "talk/p2p/base/port.h"
 #include "talk/p2p/base/stun.h"
 
 namespace cricket {
@@ -209,14 +211,35 @@ TurnServer::~TurnServer() {
        it != allocations_.end(); ++it) {
     delete it->second;
   }
+
+  for (InternalSocketMap::iterator it = server_sockets_.begin();
+       it != server_sockets_.end(); ++it) {
+    delete it->first;
+  }
+
+  for (ServerSocketMap::iterator it = server_listen_sockets_.begin();
+       it != server_listen_sockets_.end(); ++it) {
+    delete it->first;
+  }
 }
 
-void TurnServer::AddInternalServerSocket(talk_base::AsyncPacketSocket* socket) {
-  ASSERT(server_socket_ == NULL);
-  server_socket_.reset(socket);
+void TurnServer::AddInternalSocket(talk_base::AsyncPacketSocket* socket,
+                                   ProtocolType proto) {
+  ASSERT(server_sockets_.end() == server_sockets_.find(socket));
+  server_sockets_[socket] = proto;
   socket->SignalReadPacket.connect(this, &TurnServer::OnInternalPacket);
 }
 
+void TurnServer::AddInternalServerSocket(talk_base::AsyncSocket* socket,
+                                         ProtocolType proto) {
+  // There is no server side TLS adapter, so SSLTCP can't be offered.
+  ASSERT(proto == PROTO_TCP);
+  ASSERT(server_listen_sockets_.end() ==
+         server_listen_sockets_.find(socket));
+  server_listen_sockets_[socket] = proto;
+  socket->SignalReadEvent.connect(this, &TurnServer::OnNewInternalConnection);
+}
+
 void TurnServer::SetExternalSocketFactory(
     talk_base::PacketSocketFactory* factory,
     const talk_base::SocketAddress& external_addr) {
@@ -232,7 +255,9 @@ void TurnServer::OnInternalPacket(talk_base::AsyncPacketSocket* socket,
    return;
   }
 
-  Connection conn(addr, socket->GetLocalAddress(), TURNPROTO_UDP);
+  InternalSocketMap::const_iterator iter = server_sockets_.find(socket);
+  ASSERT(iter != server_sockets_.end());
+  Connection conn(addr, iter->second, socket);
   uint16 msg_type = talk_base::GetBE16(data);
   if (!IsTurnChannelData(msg_type)) {
     // This is a STUN message.
@@ -246,6 +271,54 @@ void TurnServer::OnInternalPacket(talk_base::AsyncPacketSocket* socket,
   }
 }
 
+void TurnServer::OnNewInternalConnection(talk_base::AsyncSocket* socket) {
+  ASSERT(server_listen_sockets_.find(socket) != server_listen_sockets_.end());
+  talk_base::SocketAddress accept_addr;
+  talk_base::AsyncSocket* accepted_socket = socket->Accept(&accept_addr);
+  if (accepted_socket == NULL) {
+    LOG(LS_WARNING) << "TCP accept failed with error " << socket->GetError();
+    return;
+  }
+
+  // TURN over TCP frames its messages by their own headers.
+  talk_base::AsyncStunTCPSocket* tcp_socket =
+      new talk_base::AsyncStunTCPSocket(accepted_socket, false);
+  tcp_socket->SignalClose.connect(this, &TurnServer::OnInternalSocketClose);
+  AddInternalSocket(tcp_socket, server_listen_sockets_[socket]);
+
+  // Prime a read event in case data is waiting.
+  accepted_socket->SignalReadEvent(accepted_socket);
+}
+
+void TurnServer::OnInternalSocketClose(talk_base::AsyncPacketSocket* socket,
+                                       int err) {
+  LOG(LS_INFO) << "Connection from " << socket->GetRemoteAddress().ToString()
+               << " closed, err=" << err;
+  DestroyInternalSocket(socket);
+}
+
+void TurnServer::DestroyInternalSocket(talk_base::AsyncPacketSocket* socket) {
+  // Allocations over a connection end with it (RFC 6062 section 5.3).
+  for (AllocationMap::iterator it = allocations_.begin();
+       it != allocations_.end(); ) {
+    if (it->first.socket() == socket) {
+      delete it->second;
+      allocations_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+
+  InternalSocketMap::iterator iter = server_sockets_.find(socket);
+  if (iter != server_sockets_.end()) {
+    server_sockets_.erase(iter);
+    socket->SignalReadPacket.disconnect(this);
+    socket->SignalClose.disconnect(this);
+    // We're inside the socket's close signal, so it can't be deleted yet.
+    thread_->Dispose(socket);
+  }
+}
+
 void TurnServer::HandleStunMessage(const Connection& conn, const char* data,
                                    size_t size) {
   TurnMessage msg;
@@ -498,8 +571,7 @@ void TurnServer::SendStun(const Connection& conn, StunMessage* msg) {
 
 void TurnServer::Send(const Connection& conn,
                       const talk_base::ByteBuffer& buf) {
-  // TODO(juberti): Pick which socket to send on, once we have TCP support.
-  server_socket_->SendTo(buf.Data(), buf.Length(), conn.src());
+  conn.socket()->SendTo(buf.Data(), buf.Length(), conn.src());
 }
 
 void TurnServer::OnAllocationDestroyed(Allocation* allocation) {
@@ -509,9 +581,12 @@ void TurnServer::OnAllocationDestroyed(Allocation* allocation) {
 }
 
 TurnServer::Connection::Connection(const talk_base::SocketAddress& src,
-                                   const talk_base::SocketAddress& dst,
-                                   ProtocolType proto)
-    : src_(src), dst_(dst), proto_(proto) {
+                                   ProtocolType proto,
+                                   talk_base::AsyncPacketSocket* socket)
+    : src_(src),
+      dst_(socket->GetLocalAddress()),
+      proto_(proto),
+      socket_(socket) {
 }
 
 bool TurnServer::Connection::operator==(const Connection& c) const {
@@ -519,15 +594,21 @@ bool TurnServer::Connection::operator==(const Connection& c) const {
 }
 
 bool TurnServer::Connection::operator<(const Connection& c) const {
-  return src_ < c.src_ || dst_ < c.dst_ || proto_ < c.proto_;
+  if (src_ < c.src_)
+    return true;
+  if (c.src_ < src_)
+    return false;
+  if (dst_ < c.dst_)
+    return true;
+  if (c.dst_ < dst_)
+    return false;
+  return proto_ < c.proto_;
 }
 
 std::string TurnServer::Connection::ToString() const {
-  const char* const kProtos[] = {
-      "unknown", "udp", "tcp", "ssltcp"
-  };
   std::ostringstream ost;
-  ost << src_.ToString() << "-" << dst_.ToString() << ":"<< kProtos[proto_];
+  ost << src_.ToString() << "-" << dst_.ToString() << ":"
+      << ProtoToString(proto_);
   return ost.str();
 }
 
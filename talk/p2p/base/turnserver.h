@@ -36,9 +36,11 @@
 #include "talk/base/messagequeue.h"
 #include "talk/base/sigslot.h"
 #include "talk/base/socketaddress.h"
+#include "talk/p2p/base/portinterface.h"
 
 namespace talk_base {
 class AsyncPacketSocket;
+class AsyncSocket;
 class ByteBuffer;
 class PacketSocketFactory;
 class Thread;
@@ -62,10 +64,10 @@ class TurnAuthInterface {
                       std::string* key) = 0;
 };
 
-// The core TURN server class. Give it a socket to listen on via
-// AddInternalServerSocket, and a factory to create external sockets via
-// SetExternalSocketFactory, and it's ready to go.
-// Not yet wired up: TCP support.
+// The core TURN server class. Give it sockets to listen on via
+// AddInternalSocket or AddInternalServerSocket, and a factory to create
+// external sockets via SetExternalSocketFactory, and it's ready to go.
+// Clients may connect over UDP or TCP; TLS isn't supported.
 class TurnServer : public sigslot::has_slots<> {
  public:
   explicit TurnServer(talk_base::Thread* thread);
@@ -82,28 +84,31 @@ class TurnServer : public sigslot::has_slots<> {
   // Sets the authentication callback; does not take ownership.
   void set_auth_hook(TurnAuthInterface* auth_hook) { auth_hook_ = auth_hook; }
 
-  // Starts listening for packets from internal clients.
-  void AddInternalServerSocket(talk_base::AsyncPacketSocket* socket);
+  // Starts listening for packets from internal clients. Takes ownership of
+  // |socket|.
+  void AddInternalSocket(talk_base::AsyncPacketSocket* socket,
+                         ProtocolType proto);
+  // Starts listening for connections from internal clients on a bound and
+  // listening TCP socket. Each accepted connection is added as an internal
+  // socket. Takes ownership of |socket|.
+  void AddInternalServerSocket(talk_base::AsyncSocket* socket,
+                               ProtocolType proto);
   // Specifies the factory to use for creating external sockets.
   void SetExternalSocketFactory(talk_base::PacketSocketFactory* factory,
                                 const talk_base::SocketAddress& address);
 
  private:
-  // The protocol used by the client to connect to the server.
-  enum ProtocolType {
-    TURNPROTO_UNKNOWN,
-    TURNPROTO_UDP,
-    TURNPROTO_TCP,
-    TURNPROTO_SSLTCP
-  };
-  // Encapsulates the client's connection to the server.
+  // Encapsulates the client's connection to the server: its 5-tuple, and
+  // the socket that carries it, which isn't part of the comparison.
   class Connection {
    public:
-    Connection() : proto_(TURNPROTO_UNKNOWN) {}
-    Connection(const talk_base::SocketAddress& src,
-               const talk_base::SocketAddress& dst, ProtocolType proto);
+    Connection() : proto_(PROTO_UDP), socket_(NULL) {}
+    Connection(const talk_base::SocketAddress& src, ProtocolType proto,
+               talk_base::AsyncPacketSocket* socket);
     const talk_base::SocketAddress& src() const { return src_; }
     const talk_base::SocketAddress& dst() const { return dst_; }
+    ProtocolType proto() const { return proto_; }
+    talk_base::AsyncPacketSocket* socket() const { return socket_; }
     bool operator==(const Connection& t) const;
     bool operator<(const Connection& t) const;
     std::string ToString() const;
@@ -112,14 +117,22 @@ class TurnServer : public sigslot::has_slots<> {
     talk_base::SocketAddress src_;
     talk_base::SocketAddress dst_;
     ProtocolType proto_;
+    talk_base::AsyncPacketSocket* socket_;
   };
   class Allocation;
   class Permission;
   class Channel;
   typedef std::map<Connection, Allocation*> AllocationMap;
+  typedef std::map<talk_base::AsyncPacketSocket*,
+                   ProtocolType> InternalSocketMap;
+  typedef std::map<talk_base::AsyncSocket*, ProtocolType> ServerSocketMap;
 
   void OnInternalPacket(talk_base::AsyncPacketSocket* socket, const char* data,
                         size_t size, const talk_base::SocketAddress& address);
+  void OnNewInternalConnection(talk_base::AsyncSocket* socket);
+  void OnInternalSocketClose(talk_base::AsyncPacketSocket* socket, int err);
+  // Destroys the allocations made over |socket|, then the socket itself.
+  void DestroyInternalSocket(talk_base::AsyncPacketSocket* socket);
   void HandleStunMessage(const Connection& conn, const char* data, size_t size);
   void HandleBindingRequest(const Connection& conn, const StunMessage* msg);
   void HandleAllocateRequest(const Connection& conn, const TurnMessage* msg,
@@ -151,7 +164,8 @@ class TurnServer : public sigslot::has_slots<> {
   std::string realm_;
   std::string software_;
   TurnAuthInterface* auth_hook_;
-  talk_base::scoped_ptr<talk_base::AsyncPacketSocket> server_socket_;
+  InternalSocketMap server_sockets_;
+  ServerSocketMap server_listen_sockets_;
   talk_base::scoped_ptr<talk_base::PacketSocketFactory>
       external_socket_factory_;
   talk_base::SocketAddress external_addr_;
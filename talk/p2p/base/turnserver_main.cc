@@ -89,11 +89,24 @@ int main(int argc, char **argv) {
   server.set_realm(argv[3]);
   server.set_software(kSoftware);
   server.set_auth_hook(&auth);
-  server.AddInternalServerSocket(int_socket);
+  server.AddInternalSocket(int_socket, cricket::PROTO_UDP);
   server.SetExternalSocketFactory(new talk_base::BasicPacketSocketFactory(),
                                   talk_base::SocketAddress(ext_addr, 0));
 
-  std::cout << "Listening internally at " << int_addr.ToString() << std::endl;
+  // Accept TURN over TCP at the same address.
+  talk_base::AsyncSocket* tcp_socket =
+      main->socketserver()->CreateAsyncSocket(int_addr.family(), SOCK_STREAM);
+  if (!tcp_socket || tcp_socket->Bind(int_addr) < 0 ||
+      tcp_socket->Listen(5) < 0) {
+    std::cerr << "Failed to create a TCP socket listening at "
+              << int_addr.ToString() << std::endl;
+    delete tcp_socket;
+    return 1;
+  }
+  server.AddInternalServerSocket(tcp_socket, cricket::PROTO_TCP);
+
+  std::cout << "Listening internally at " << int_addr.ToString()
+            << " (udp, tcp)" << std::endl;
 
   main->Run();
   return 0;
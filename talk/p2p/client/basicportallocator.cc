@@ -960,14 +960,15 @@ void AllocationSequence::CreateTCPPorts() {
     return;
   }
 
-  Port* port = TCPPort::Create(session_->network_thread(),
-                               session_->socket_factory(),
-                               network_, ip_,
-                               session_->allocator()->min_port(),
-                               session_->allocator()->max_port(),
-                               session_->username(), session_->password(),
-                               session_->allocator()->allow_tcp_listen());
+  TCPPort* port = TCPPort::Create(session_->network_thread(),
+                                  session_->socket_factory(),
+                                  network_, ip_,
+                                  session_->allocator()->min_port(),
+                                  session_->allocator()->max_port(),
+                                  session_->username(), session_->password(),
+                                  session_->allocator()->allow_tcp_listen());
   if (port) {
+    port->set_ice_tcp(IsFlagSet(PORTALLOCATOR_ENABLE_ICE_TCP));
     session_->AddAllocatedPort(port, this);
     // Since TCPPort is not created using shared socket, |port| will not be
     // added to the dequeue.
@@ -1072,8 +1073,10 @@ void AllocationSequence::CreateTurnPort(const RelayServerConfig& config) {
   PortList::const_iterator relay_port;
   for (relay_port = config.ports.begin();
        relay_port != config.ports.end(); ++relay_port) {
-    if (relay_port->proto == PROTO_UDP) {
-    cricket::RelayCredentials credentials(config.credentials.username, config.credentials.password);
+    // TURN over SSLTCP means TURN over TLS.
+    if (relay_port->proto == PROTO_UDP ||
+        relay_port->proto == PROTO_TCP ||
+        relay_port->proto == PROTO_SSLTCP) {
       TurnPort* port = TurnPort::Create(session_->network_thread(),
                                         session_->socket_factory(),
                                         network_, ip_,
@@ -1081,7 +1084,7 @@ void AllocationSequence::CreateTurnPort(const RelayServerConfig& config) {
                                         session_->allocator()->max_port(),
                                         session_->username(),
                                         session_->password(),
-                                        relay_port->address,
+                                        *relay_port,
                                         config.credentials);
       if (port) {
         session_->AddAllocatedPort(port, this);
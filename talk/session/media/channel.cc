@@ -31,6 +31,7 @@
 #include "talk/base/byteorder.h"
 #include "talk/base/common.h"
 #include "talk/base/logging.h"
+#include "talk/base/packettrace.h"
 #include "talk/media/base/rtputils.h"
 #include "talk/p2p/base/transportchannel.h"
 #include "talk/session/media/channelmanager.h"
@@ -177,7 +178,9 @@ struct VoiceStatsMessageData : public talk_base::MessageData {
 };
 
 struct PacketMessageData : public talk_base::MessageData {
+  PacketMessageData() : trace_mark(0) {}
   talk_base::Buffer packet;
+  uint64 trace_mark;  // For timing the hop to the worker thread.
 };
 
 struct RenderMessageData : public talk_base::MessageData {
@@ -590,9 +593,11 @@ void BaseChannel::OnChannelRead(TransportChannel* channel,
                                 const char* data, size_t len, int flags) {
   // OnChannelRead gets called from P2PSocket; now pass data to MediaEngine
   ASSERT(worker_thread_ == talk_base::Thread::Current());
+  talk_base::PacketTrace::Mark(talk_base::PS_RECV_TRANSPORT);
 
   // When using RTCP multiplexing we might get RTCP packets on the RTP
   // transport. We feed RTP traffic into the demuxer to determine if it is RTCP.
+  recv_rate_tracker_.Update(len);
   bool rtcp = PacketIsRtcp(channel, data, len);
   talk_base::Buffer packet(data, len);
   HandlePacket(rtcp, &packet);
@@ -605,6 +610,8 @@ bool BaseChannel::PacketIsRtcp(const TransportChannel* channel,
 }
 
 bool BaseChannel::SendPacket(bool rtcp, talk_base::Buffer* packet) {
+  talk_base::PacketTraceScope trace(talk_base::PP_SEND);
+
   // Unless we're sending optimistically, we only allow packets through when we
   // are completely writable.
   if (!optimistic_data_send_ && !writable_) {
@@ -623,6 +630,7 @@ bool BaseChannel::SendPacket(bool rtcp, talk_base::Buffer* packet) {
     int message_id = (!rtcp) ? MSG_RTPPACKET : MSG_RTCPPACKET;
     PacketMessageData* data = new PacketMessageData;
     packet->TransferTo(&data->packet);
+    data->trace_mark = talk_base::PacketTrace::Detach(talk_base::PP_SEND);
     worker_thread_->Post(this, message_id, data);
     return true;
   }
@@ -689,6 +697,8 @@ bool BaseChannel::SendPacket(bool rtcp, talk_base::Buffer* packet) {
     return false;
   }
 
+  talk_base::PacketTrace::Mark(talk_base::PS_SEND_SRTP);
+
   // Signal to the media sink after protecting the packet.
   {
     talk_base::CritScope cs(&signal_send_packet_cs_);
@@ -696,9 +706,15 @@ bool BaseChannel::SendPacket(bool rtcp, talk_base::Buffer* packet) {
   }
 
   // Bon voyage.
-  return (channel->SendPacket(packet->data(), packet->length(),
-      (secure() && secure_dtls()) ? PF_SRTP_BYPASS : 0)
-      == static_cast<int>(packet->length()));
+  int flags = (secure() && secure_dtls()) ? PF_SRTP_BYPASS : 0;
+  if (rtcp || HasPriorityRtp()) {
+    flags |= PF_PRIORITY;
+  }
+  int sent = channel->SendPacket(packet->data(), packet->length(), flags);
+  if (sent > 0) {
+    send_rate_tracker_.Update(sent);
+  }
+  return (sent == static_cast<int>(packet->length()));
 }
 
 void BaseChannel::HandlePacket(bool rtcp, talk_base::Buffer* packet) {
@@ -766,6 +782,8 @@ void BaseChannel::HandlePacket(bool rtcp, talk_base::Buffer* packet) {
     return;
   }
 
+  talk_base::PacketTrace::Mark(talk_base::PS_RECV_SRTP);
+
   // Signal to the media sink after unprotecting the packet.
   {
     talk_base::CritScope cs(&signal_recv_packet_cs_);
@@ -778,6 +796,7 @@ void BaseChannel::HandlePacket(bool rtcp, talk_base::Buffer* packet) {
   } else {
     media_channel_->OnRtcpReceived(packet);
   }
+  talk_base::PacketTrace::Mark(talk_base::PS_RECV_MEDIA);
 }
 
 
@@ -1312,6 +1331,8 @@ void BaseChannel::OnMessage(talk_base::Message *pmsg) {
     case MSG_RTPPACKET:
     case MSG_RTCPPACKET: {
       PacketMessageData* data = static_cast<PacketMessageData*>(pmsg->pdata);
+      talk_base::PacketTrace::Attach(talk_base::PP_SEND, data->trace_mark);
+      talk_base::PacketTrace::Mark(talk_base::PS_SEND_QUEUE);
       SendPacket(pmsg->message_id == MSG_RTCPPACKET, &data->packet);
       delete data;  // because it is Posted
       break;
@@ -36,6 +36,7 @@
 #include "talk/base/network.h"
 #include "talk/base/sigslot.h"
 #include "talk/base/window.h"
+#include "talk/base/windowedratetracker.h"
 #include "talk/media/base/mediachannel.h"
 #include "talk/media/base/mediaengine.h"
 #include "talk/media/base/screencastid.h"
@@ -104,6 +105,18 @@ class BaseChannel
   bool writable() const { return writable_; }
   bool IsStreamMuted(uint32 ssrc);
 
+  // Bytes sent and received on this channel, RTP and RTCP together.  These
+  // may be called from any thread; unlike GetStats(), they don't wait for
+  // the worker thread.
+  size_t sent_total_bytes() const { return send_rate_tracker_.total_units(); }
+  size_t sent_bytes_second() const {
+    return send_rate_tracker_.units_second();
+  }
+  size_t recv_total_bytes() const { return recv_rate_tracker_.total_units(); }
+  size_t recv_bytes_second() const {
+    return recv_rate_tracker_.units_second();
+  }
+
   // Channel control
   bool SetLocalContent(const MediaContentDescription* content,
                        ContentAction action);
@@ -284,6 +297,8 @@ class BaseChannel
   // Gets the content info appropriate to the channel (audio or video).
   virtual const ContentInfo* GetFirstContent(
       const SessionDescription* sdesc) = 0;
+  // Whether RTP packets are sent ahead of paced traffic, as RTCP always is.
+  virtual bool HasPriorityRtp() const { return false; }
   bool UpdateLocalStreams_w(const std::vector<StreamParams>& streams,
                             ContentAction action);
   bool UpdateRemoteStreams_w(const std::vector<StreamParams>& streams,
@@ -346,6 +361,9 @@ class BaseChannel
   bool has_received_packet_;
   bool dtls_keyed_;
   bool secure_required_;
+  // Updated on the worker thread only.
+  talk_base::WindowedRateTracker send_rate_tracker_;
+  talk_base::WindowedRateTracker recv_rate_tracker_;
 };
 
 // VoiceChannel is a specialization that adds support for early media, DTMF,
@@ -425,6 +443,7 @@ class VoiceChannel : public BaseChannel {
                              const char* data, size_t len, int flags);
   virtual void ChangeState();
   virtual const ContentInfo* GetFirstContent(const SessionDescription* sdesc);
+  virtual bool HasPriorityRtp() const { return true; }
   virtual bool SetLocalContent_w(const MediaContentDescription* content,
                                  ContentAction action);
   virtual bool SetRemoteContent_w(const MediaContentDescription* content,
@@ -27,12 +27,20 @@
 
 #include "talk/sound/alsasoundsystem.h"
 
+#include <errno.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <vector>
+
 #include "talk/base/common.h"
 #include "talk/base/logging.h"
 #include "talk/base/scoped_ptr.h"
 #include "talk/base/stringutils.h"
+#include "talk/base/thread.h"
 #include "talk/base/timeutils.h"
 #include "talk/base/worker.h"
+#include "talk/sound/latencytracker.h"
 #include "talk/sound/sounddevicelocator.h"
 #include "talk/sound/soundinputstreaminterface.h"
 #include "talk/sound/soundoutputstreaminterface.h"
@@ -83,6 +91,93 @@ class AlsaDeviceLocator : public SoundDeviceLocator {
   }
 };
 
+class AlsaStream;
+
+// A stream that is serviced by an AlsaStreamPoller.
+class AlsaPolledStream {
+ public:
+  virtual ~AlsaPolledStream() {}
+
+  virtual AlsaStream *alsa_stream() = 0;
+
+  // Called on the polling thread when |avail| frames can be read/written.
+  virtual void OnReady(snd_pcm_uframes_t avail) = 0;
+};
+
+// Services every stream started on one thread. Instead of blocking in
+// snd_pcm_wait() on one handle at a time, it first services all streams that
+// are already ready and otherwise sleeps in a single poll() on the descriptors
+// of all of them, so a capture and a playback stream sharing the audio thread
+// never wait behind each other.
+class AlsaStreamPoller : private talk_base::Worker {
+ public:
+  explicit AlsaStreamPoller(AlsaSoundSystem *alsa) : alsa_(alsa) {}
+
+  virtual ~AlsaStreamPoller() {
+    // All streams must have been stopped by now.
+    ASSERT(streams_.empty());
+  }
+
+  // Must be called on the polling thread.
+  bool AddStream(AlsaPolledStream *stream) {
+    if (std::find(streams_.begin(), streams_.end(), stream) !=
+        streams_.end()) {
+      return true;
+    }
+    streams_.push_back(stream);
+    if (streams_.size() == 1 && !StartWork()) {
+      streams_.clear();
+      return false;
+    }
+    return true;
+  }
+
+  // Must be called on the polling thread. Stops polling once the last stream
+  // is removed. This may be called from within OnReady().
+  bool RemoveStream(AlsaPolledStream *stream) {
+    std::vector<AlsaPolledStream *>::iterator it =
+        std::find(streams_.begin(), streams_.end(), stream);
+    if (it == streams_.end()) {
+      return true;
+    }
+    streams_.erase(it);
+    return !streams_.empty() || StopWork();
+  }
+
+ private:
+  bool IsPolling(AlsaPolledStream *stream) const {
+    return std::find(streams_.begin(), streams_.end(), stream) !=
+        streams_.end();
+  }
+
+  // Inherited from Worker.
+  virtual void OnStart() {
+    HaveWork();
+  }
+
+  // Inherited from Worker.
+  virtual void OnHaveWork();
+
+  // Inherited from Worker.
+  virtual void OnStop() {
+    // Nothing to do.
+  }
+
+  // Sleeps until at least one stream is ready or the shortest wait timeout
+  // expires.
+  void Poll();
+
+  AlsaSoundSystem *alsa_;
+  std::vector<AlsaPolledStream *> streams_;
+  // Scratch space reused by every iteration so that the audio thread does not
+  // allocate.
+  std::vector<AlsaPolledStream *> snapshot_;
+  std::vector<struct pollfd> fds_;
+  std::vector<int> fd_counts_;
+
+  DISALLOW_COPY_AND_ASSIGN(AlsaStreamPoller);
+};
+
 // Functionality that is common to both AlsaInputStream and AlsaOutputStream.
 class AlsaStream {
  public:
@@ -97,53 +192,30 @@ class AlsaStream {
         frame_size_(frame_size),
         wait_timeout_ms_(wait_timeout_ms),
         flags_(flags),
-        freq_(freq) {
+        freq_(freq),
+        poller_(NULL),
+        // ALSA cannot resize the buffer of a running stream, so we only count.
+        tracker_(0, 0, 0, 0) {
   }
 
   ~AlsaStream() {
     Close();
   }
 
-  // Waits for the stream to be ready to accept/return more data, and returns
-  // how much can be written/read, or 0 if we need to Wait() again.
-  snd_pcm_uframes_t Wait() {
-    snd_pcm_sframes_t frames;
-    // Ideally we would not use snd_pcm_wait() and instead hook snd_pcm_poll_*
-    // into PhysicalSocketServer, but PhysicalSocketServer is nasty enough
-    // already and the current clients of SoundSystemInterface do not run
-    // anything else on their worker threads, so snd_pcm_wait() is good enough.
-    frames = symbol_table()->snd_pcm_avail_update()(handle_);
-    if (frames < 0) {
-      LOG(LS_ERROR) << "snd_pcm_avail_update(): " << GetError(frames);
-      Recover(frames);
-      return 0;
-    } else if (frames > 0) {
-      // Already ready, so no need to wait.
-      return frames;
-    }
-    // Else no space/data available, so must wait.
-    int ready = symbol_table()->snd_pcm_wait()(handle_, wait_timeout_ms_);
-    if (ready < 0) {
-      LOG(LS_ERROR) << "snd_pcm_wait(): " << GetError(ready);
-      Recover(ready);
-      return 0;
-    } else if (ready == 0) {
-      // Timeout, so nothing can be written/read right now.
-      // We set the timeout to twice the requested latency, so continuous
-      // timeouts are indicative of a problem, so log as a warning.
-      LOG(LS_WARNING) << "Timeout while waiting on stream";
-      return 0;
-    }
-    // Else ready > 0 (i.e., 1), so it's ready. Get count.
-    frames = symbol_table()->snd_pcm_avail_update()(handle_);
+  // Starts servicing |owner| from the current thread's poller. Same semantics
+  // as talk_base::Worker::StartWork().
+  bool StartPolling(AlsaPolledStream *owner);
+  // Same semantics as talk_base::Worker::StopWork().
+  bool StopPolling(AlsaPolledStream *owner);
+
+  // Returns how much can be written/read right now without blocking, or 0 if
+  // the poller needs to wait for the stream.
+  snd_pcm_uframes_t Available() {
+    snd_pcm_sframes_t frames = symbol_table()->snd_pcm_avail_update()(handle_);
     if (frames < 0) {
       LOG(LS_ERROR) << "snd_pcm_avail_update(): " << GetError(frames);
       Recover(frames);
       return 0;
-    } else if (frames == 0) {
-      // wait() said we were ready, so this ought to have been positive. Has
-      // been observed to happen in practice though.
-      LOG(LS_WARNING) << "Spurious wake-up";
     }
     return frames;
   }
@@ -163,7 +235,14 @@ class AlsaStream {
       return 0;
     }
     // The delay is in frames. Convert to microseconds.
-    return delay * talk_base::kNumMicrosecsPerSec / freq_;
+    int delay_usecs = delay * talk_base::kNumMicrosecsPerSec / freq_;
+    tracker_.AddLatencySample(delay_usecs);
+    return delay_usecs;
+  }
+
+  bool GetStats(SoundStreamStats *stats) {
+    tracker_.GetStats(stats);
+    return true;
   }
 
   // Used to recover from certain recoverable errors, principally buffer overrun
@@ -184,7 +263,10 @@ class AlsaStream {
                     << GetError(err);
       return false;
     }
-    if (error == -EPIPE &&  // Buffer underrun/overrun.
+    if (error == -EPIPE) {  // Buffer underrun/overrun.
+      tracker_.OnUnderrun(talk_base::Time());
+    }
+    if (error == -EPIPE &&
         symbol_table()->snd_pcm_stream()(handle_) == SND_PCM_STREAM_CAPTURE) {
       // For capture streams we also have to repeat the explicit start() to get
       // data flowing again.
@@ -231,6 +313,10 @@ class AlsaStream {
     return frame_size_;
   }
 
+  int wait_timeout_ms() {
+    return wait_timeout_ms_;
+  }
+
  private:
   AlsaSoundSystem *alsa_;
   snd_pcm_t *handle_;
@@ -238,6 +324,8 @@ class AlsaStream {
   int wait_timeout_ms_;
   int flags_;
   int freq_;
+  AlsaStreamPoller *poller_;
+  LatencyTracker tracker_;
 
   DISALLOW_COPY_AND_ASSIGN(AlsaStream);
 };
@@ -246,7 +334,7 @@ class AlsaStream {
 // thread-safety.
 class AlsaInputStream :
     public SoundInputStreamInterface,
-    private talk_base::Worker {
+    private AlsaPolledStream {
  public:
   AlsaInputStream(AlsaSoundSystem *alsa,
                   snd_pcm_t *handle,
@@ -265,11 +353,11 @@ class AlsaInputStream :
   }
 
   virtual bool StartReading() {
-    return StartWork();
+    return stream_.StartPolling(this);
   }
 
   virtual bool StopReading() {
-    return StopWork();
+    return stream_.StopPolling(this);
   }
 
   virtual bool GetVolume(int *volume) {
@@ -290,51 +378,43 @@ class AlsaInputStream :
     return stream_.CurrentDelayUsecs();
   }
 
- private:
-  // Inherited from Worker.
-  virtual void OnStart() {
-    HaveWork();
+  virtual bool GetStats(SoundStreamStats *stats) {
+    return stream_.GetStats(stats);
   }
 
-  // Inherited from Worker.
-  virtual void OnHaveWork() {
-    // Block waiting for data.
-    snd_pcm_uframes_t avail = stream_.Wait();
-    if (avail > 0) {
-      // Data is available.
-      size_t size = avail * stream_.frame_size();
-      if (size > buffer_size_) {
-        // Must increase buffer size.
-        buffer_.reset(new char[size]);
-        buffer_size_ = size;
-      }
-      // Read all the data.
-      snd_pcm_sframes_t read = stream_.symbol_table()->snd_pcm_readi()(
-          stream_.handle(),
-          buffer_.get(),
-          avail);
-      if (read < 0) {
-        LOG(LS_ERROR) << "snd_pcm_readi(): " << GetError(read);
-        stream_.Recover(read);
-      } else if (read == 0) {
-        // Docs say this shouldn't happen.
-        ASSERT(false);
-        LOG(LS_ERROR) << "No data?";
-      } else {
-        // Got data. Pass it off to the app.
-        SignalSamplesRead(buffer_.get(),
-                          read * stream_.frame_size(),
-                          this);
-      }
+ private:
+  // Inherited from AlsaPolledStream.
+  virtual AlsaStream *alsa_stream() {
+    return &stream_;
+  }
+
+  // Inherited from AlsaPolledStream.
+  virtual void OnReady(snd_pcm_uframes_t avail) {
+    // Data is available.
+    size_t size = avail * stream_.frame_size();
+    if (size > buffer_size_) {
+      // Must increase buffer size.
+      buffer_.reset(new char[size]);
+      buffer_size_ = size;
+    }
+    // Read all the data.
+    snd_pcm_sframes_t read = stream_.symbol_table()->snd_pcm_readi()(
+        stream_.handle(),
+        buffer_.get(),
+        avail);
+    if (read < 0) {
+      LOG(LS_ERROR) << "snd_pcm_readi(): " << GetError(read);
+      stream_.Recover(read);
+    } else if (read == 0) {
+      // Docs say this shouldn't happen.
+      ASSERT(false);
+      LOG(LS_ERROR) << "No data?";
+    } else {
+      // Got data. Pass it off to the app.
+      SignalSamplesRead(buffer_.get(),
+                        read * stream_.frame_size(),
+                        this);
     }
-    // Check for more data with no delay, after any pending messages are
-    // dispatched.
-    HaveWork();
-  }
-
-  // Inherited from Worker.
-  virtual void OnStop() {
-    // Nothing to do.
   }
 
   const char *GetError(int err) {
@@ -352,7 +432,7 @@ class AlsaInputStream :
 // regarding thread-safety.
 class AlsaOutputStream :
     public SoundOutputStreamInterface,
-    private talk_base::Worker {
+    private AlsaPolledStream {
  public:
   AlsaOutputStream(AlsaSoundSystem *alsa,
                    snd_pcm_t *handle,
@@ -370,11 +450,11 @@ class AlsaOutputStream :
   }
 
   virtual bool EnableBufferMonitoring() {
-    return StartWork();
+    return stream_.StartPolling(this);
   }
 
   virtual bool DisableBufferMonitoring() {
-    return StopWork();
+    return stream_.StopPolling(this);
   }
 
   virtual bool WriteSamples(const void *sample_data,
@@ -423,25 +503,19 @@ class AlsaOutputStream :
     return stream_.CurrentDelayUsecs();
   }
 
- private:
-  // Inherited from Worker.
-  virtual void OnStart() {
-    HaveWork();
+  virtual bool GetStats(SoundStreamStats *stats) {
+    return stream_.GetStats(stats);
   }
 
-  // Inherited from Worker.
-  virtual void OnHaveWork() {
-    snd_pcm_uframes_t avail = stream_.Wait();
-    if (avail > 0) {
-      size_t space = avail * stream_.frame_size();
-      SignalBufferSpace(space, this);
-    }
-    HaveWork();
+ private:
+  // Inherited from AlsaPolledStream.
+  virtual AlsaStream *alsa_stream() {
+    return &stream_;
   }
 
-  // Inherited from Worker.
-  virtual void OnStop() {
-    // Nothing to do.
+  // Inherited from AlsaPolledStream.
+  virtual void OnReady(snd_pcm_uframes_t avail) {
+    SignalBufferSpace(avail * stream_.frame_size(), this);
   }
 
   const char *GetError(int err) {
@@ -453,11 +527,126 @@ class AlsaOutputStream :
   DISALLOW_COPY_AND_ASSIGN(AlsaOutputStream);
 };
 
+void AlsaStreamPoller::OnHaveWork() {
+  // Service whatever is already ready without sleeping. Streams may be
+  // stopped from within their own callbacks, so iterate over a snapshot.
+  snapshot_ = streams_;
+  bool serviced = false;
+  for (size_t i = 0; i < snapshot_.size(); ++i) {
+    AlsaPolledStream *stream = snapshot_[i];
+    if (!IsPolling(stream)) {
+      continue;
+    }
+    snd_pcm_uframes_t avail = stream->alsa_stream()->Available();
+    if (avail > 0) {
+      stream->OnReady(avail);
+      serviced = true;
+    }
+  }
+  if (!serviced && !streams_.empty()) {
+    Poll();
+  }
+  // Check again with no delay, after any pending messages are dispatched.
+  if (!streams_.empty()) {
+    HaveWork();
+  }
+}
+
+void AlsaStreamPoller::Poll() {
+  AlsaSymbolTable *symbol_table = &alsa_->symbol_table_;
+  fds_.clear();
+  fd_counts_.clear();
+  int timeout_ms = -1;
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    AlsaStream *stream = streams_[i]->alsa_stream();
+    int count = symbol_table->snd_pcm_poll_descriptors_count()(
+        stream->handle());
+    if (count < 0) {
+      LOG(LS_ERROR) << "snd_pcm_poll_descriptors_count(): "
+                    << alsa_->GetError(count);
+      count = 0;
+    }
+    size_t offset = fds_.size();
+    fds_.resize(offset + count);
+    if (count > 0) {
+      count = symbol_table->snd_pcm_poll_descriptors()(stream->handle(),
+                                                       &fds_[offset],
+                                                       count);
+      fds_.resize(offset + count);
+    }
+    fd_counts_.push_back(count);
+    if (timeout_ms < 0 || stream->wait_timeout_ms() < timeout_ms) {
+      timeout_ms = stream->wait_timeout_ms();
+    }
+  }
+  if (fds_.empty()) {
+    return;
+  }
+
+  int ready = poll(&fds_[0], fds_.size(), timeout_ms);
+  if (ready < 0) {
+    if (errno != EINTR) {
+      LOG_ERR(LS_ERROR) << "poll()";
+    }
+    return;
+  } else if (ready == 0) {
+    // Timeout, so nothing can be written/read right now.
+    // We set the timeout to twice the requested latency, so continuous
+    // timeouts are indicative of a problem, so log as a warning.
+    LOG(LS_WARNING) << "Timeout while waiting on streams";
+    return;
+  }
+
+  // Some plugins (e.g., dmix) need to translate the raw events before the
+  // stream is really ready, so always let them look at what poll() returned.
+  // Errors such as an xrun are picked up by Available() on the next pass.
+  size_t offset = 0;
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (fd_counts_[i] > 0) {
+      AlsaStream *stream = streams_[i]->alsa_stream();
+      unsigned short revents = 0;
+      int err = symbol_table->snd_pcm_poll_descriptors_revents()(
+          stream->handle(), &fds_[offset], fd_counts_[i], &revents);
+      if (err < 0) {
+        LOG(LS_ERROR) << "snd_pcm_poll_descriptors_revents(): "
+                      << alsa_->GetError(err);
+      }
+    }
+    offset += fd_counts_[i];
+  }
+}
+
+bool AlsaStream::StartPolling(AlsaPolledStream *owner) {
+  if (poller_) {
+    return true;
+  }
+  AlsaStreamPoller *poller = alsa_->GetPoller();
+  if (!poller->AddStream(owner)) {
+    return false;
+  }
+  poller_ = poller;
+  return true;
+}
+
+bool AlsaStream::StopPolling(AlsaPolledStream *owner) {
+  if (!poller_) {
+    return true;
+  }
+  if (!poller_->RemoveStream(owner)) {
+    return false;
+  }
+  poller_ = NULL;
+  return true;
+}
+
 AlsaSoundSystem::AlsaSoundSystem() : initialized_(false) {}
 
 AlsaSoundSystem::~AlsaSoundSystem() {
   // Not really necessary, because Terminate() doesn't really do anything.
   Terminate();
+  for (PollerMap::iterator it = pollers_.begin(); it != pollers_.end(); ++it) {
+    delete it->second;
+  }
 }
 
 bool AlsaSoundSystem::Init() {
@@ -742,8 +931,8 @@ SoundInputStreamInterface *AlsaSoundSystem::StartInputStream(
     int flags,
     int freq) {
   // Output streams start automatically once enough data has been written, but
-  // input streams must be started manually or else snd_pcm_wait() will never
-  // return true.
+  // input streams must be started manually or else poll() will never report
+  // them ready.
   int err;
   err = symbol_table_.snd_pcm_start()(handle);
   if (err != 0) {
@@ -758,4 +947,13 @@ inline const char *AlsaSoundSystem::GetError(int err) {
   return symbol_table_.snd_strerror()(err);
 }
 
+AlsaStreamPoller *AlsaSoundSystem::GetPoller() {
+  talk_base::CritScope cs(&pollers_crit_);
+  AlsaStreamPoller *&poller = pollers_[talk_base::Thread::Current()];
+  if (!poller) {
+    poller = new AlsaStreamPoller(this);
+  }
+  return poller;
+}
+
 }  // namespace cricket
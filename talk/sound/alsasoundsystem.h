@@ -28,20 +28,34 @@
 #ifndef TALK_SOUND_ALSASOUNDSYSTEM_H_
 #define TALK_SOUND_ALSASOUNDSYSTEM_H_
 
+#include <map>
+
 #include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
 #include "talk/sound/alsasymboltable.h"
 #include "talk/sound/soundsysteminterface.h"
 
+namespace talk_base {
+class Thread;
+}
+
 namespace cricket {
 
 class AlsaStream;
+class AlsaStreamPoller;
 class AlsaInputStream;
 class AlsaOutputStream;
 
 // Sound system implementation for ALSA, the predominant sound device API on
 // Linux (but typically not used directly by applications anymore).
+// All streams that are started on the same thread are serviced together by
+// polling their descriptors at once, so a single audio thread can drive both
+// capture and playback without either one starving the other. For the lowest
+// latency, start that thread with talk_base::PRIORITY_HIGH, which gives it a
+// real-time scheduling policy where the OS permits.
 class AlsaSoundSystem : public SoundSystemInterface {
   friend class AlsaStream;
+  friend class AlsaStreamPoller;
   friend class AlsaInputStream;
   friend class AlsaOutputStream;
  public:
@@ -109,8 +123,16 @@ class AlsaSoundSystem : public SoundSystemInterface {
 
   const char *GetError(int err);
 
+  // Returns the poller that services streams started on the current thread.
+  AlsaStreamPoller *GetPoller();
+
   bool initialized_;
   AlsaSymbolTable symbol_table_;
+  // Pollers are kept until we are destroyed, since there is one per audio
+  // thread and they are cheap while idle.
+  typedef std::map<talk_base::Thread *, AlsaStreamPoller *> PollerMap;
+  talk_base::CriticalSection pollers_crit_;
+  PollerMap pollers_;
 
   DISALLOW_COPY_AND_ASSIGN(AlsaSoundSystem);
 };
@@ -0,0 +1,108 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/sound/latencytracker.h"
+
+#include "talk/base/common.h"
+#include "talk/base/timeutils.h"
+
+namespace cricket {
+
+LatencyTracker::LatencyTracker(int minimum, int maximum, int step,
+                               uint32 stable_period_ms)
+    : minimum_(minimum),
+      maximum_(talk_base::_max(minimum, maximum)),
+      step_(step),
+      stable_period_ms_(stable_period_ms),
+      target_(minimum),
+      last_change_(0),
+      started_(false),
+      total_latency_usecs_(0) {
+}
+
+bool LatencyTracker::OnUnderrun(uint32 now) {
+  talk_base::CritScope cs(&crit_);
+  ++stats_.underruns;
+  // Any underrun restarts the stable period, even if we are already at the
+  // maximum.
+  last_change_ = now;
+  started_ = true;
+  if (step_ <= 0 || target_ >= maximum_) {
+    return false;
+  }
+  target_ = talk_base::_min(target_ + step_, maximum_);
+  ++stats_.latency_increases;
+  return true;
+}
+
+bool LatencyTracker::OnTick(uint32 now) {
+  talk_base::CritScope cs(&crit_);
+  if (!started_) {
+    last_change_ = now;
+    started_ = true;
+    return false;
+  }
+  if (step_ <= 0 || target_ <= minimum_ ||
+      talk_base::TimeDiff(now, last_change_) <
+          static_cast<int32>(stable_period_ms_)) {
+    return false;
+  }
+  target_ = talk_base::_max(target_ - step_, minimum_);
+  last_change_ = now;
+  ++stats_.latency_decreases;
+  return true;
+}
+
+void LatencyTracker::AddLatencySample(int latency_usecs) {
+  talk_base::CritScope cs(&crit_);
+  if (stats_.latency_samples == 0 ||
+      latency_usecs < stats_.min_latency_usecs) {
+    stats_.min_latency_usecs = latency_usecs;
+  }
+  if (stats_.latency_samples == 0 ||
+      latency_usecs > stats_.max_latency_usecs) {
+    stats_.max_latency_usecs = latency_usecs;
+  }
+  stats_.last_latency_usecs = latency_usecs;
+  ++stats_.latency_samples;
+  total_latency_usecs_ += latency_usecs;
+  stats_.avg_latency_usecs =
+      static_cast<int>(total_latency_usecs_ / stats_.latency_samples);
+}
+
+int LatencyTracker::target() const {
+  talk_base::CritScope cs(&crit_);
+  return target_;
+}
+
+void LatencyTracker::GetStats(SoundStreamStats* stats) const {
+  talk_base::CritScope cs(&crit_);
+  *stats = stats_;
+}
+
+}  // namespace cricket
@@ -0,0 +1,116 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TALK_SOUND_LATENCYTRACKER_H_
+#define TALK_SOUND_LATENCYTRACKER_H_
+
+#include "talk/base/basictypes.h"
+#include "talk/base/constructormagic.h"
+#include "talk/base/criticalsection.h"
+
+namespace cricket {
+
+// Counters describing how well a sound stream is keeping up. Latencies are
+// the values the stream returned from LatencyUsecs(); they are all zero until
+// the first sample is taken.
+struct SoundStreamStats {
+  SoundStreamStats()
+      : underruns(0),
+        latency_increases(0),
+        latency_decreases(0),
+        target_latency_usecs(0),
+        latency_samples(0),
+        last_latency_usecs(0),
+        min_latency_usecs(0),
+        max_latency_usecs(0),
+        avg_latency_usecs(0) {
+  }
+
+  // Number of buffer underruns (playback) or overruns (capture).
+  int underruns;
+  // How often the stream raised or lowered its target latency in response.
+  int latency_increases;
+  int latency_decreases;
+  // The latency the stream is currently configured for, or 0 if it does not
+  // adapt its latency.
+  int target_latency_usecs;
+  int latency_samples;
+  int last_latency_usecs;
+  int min_latency_usecs;
+  int max_latency_usecs;
+  int avg_latency_usecs;
+};
+
+// Keeps a stream's target latency as low as it can go without underrunning.
+// Each underrun raises the target by one step, and every stable period that
+// passes without an underrun lowers it by one step again, never below the
+// latency that was originally requested. The unit of the latency values is up
+// to the owner (e.g., bytes or microseconds); times are in milliseconds as
+// returned by talk_base::Time(). All methods are thread-safe so that the
+// stream's audio thread can update it while the application reads the stats.
+class LatencyTracker {
+ public:
+  // A |step| of 0 disables adaptation; the tracker then only counts.
+  LatencyTracker(int minimum, int maximum, int step, uint32 stable_period_ms);
+
+  // Records an underrun at |now|. Returns true if the target latency changed
+  // and the stream should be reconfigured.
+  bool OnUnderrun(uint32 now);
+  // Should be called regularly from the audio thread. Returns true if the
+  // target latency was lowered and the stream should be reconfigured.
+  bool OnTick(uint32 now);
+
+  // Records the latency most recently reported by the stream.
+  void AddLatencySample(int latency_usecs);
+
+  int target() const;
+
+  // Fills in everything except target_latency_usecs, whose unit only the
+  // owner can convert.
+  void GetStats(SoundStreamStats* stats) const;
+
+ private:
+  mutable talk_base::CriticalSection crit_;
+  const int minimum_;
+  const int maximum_;
+  const int step_;
+  const uint32 stable_period_ms_;
+  int target_;
+  // Time of the last underrun or adjustment; the stable period counts from
+  // here. Only valid once |started_| is set by the first call.
+  uint32 last_change_;
+  bool started_;
+  SoundStreamStats stats_;
+  int64 total_latency_usecs_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyTracker);
+};
+
+}  // namespace cricket
+
+#endif  // TALK_SOUND_LATENCYTRACKER_H_
@@ -0,0 +1,160 @@
+/*
+ * libjingle
+ * Copyright 2013, Google Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "talk/base/gunit.h"
+#include "talk/base/scoped_ptr.h"
+#include "talk/sound/latencytracker.h"
+#include "talk/sound/nullsoundsystem.h"
+#include "talk/sound/sounddevicelocator.h"
+#include "talk/sound/soundinputstreaminterface.h"
+#include "talk/sound/soundoutputstreaminterface.h"
+
+namespace cricket {
+
+static const int kMinimum = 100;
+static const int kMaximum = 160;
+static const int kStep = 20;
+static const uint32 kStablePeriodMs = 1000;
+
+// Underruns raise the target one step at a time, up to the maximum.
+TEST(LatencyTrackerTest, GrowsOnUnderrun) {
+  LatencyTracker tracker(kMinimum, kMaximum, kStep, kStablePeriodMs);
+  EXPECT_EQ(kMinimum, tracker.target());
+
+  EXPECT_TRUE(tracker.OnUnderrun(10));
+  EXPECT_EQ(kMinimum + kStep, tracker.target());
+  EXPECT_TRUE(tracker.OnUnderrun(20));
+  EXPECT_TRUE(tracker.OnUnderrun(30));
+  EXPECT_EQ(kMaximum, tracker.target());
+  // Already at the maximum, so this is only counted.
+  EXPECT_FALSE(tracker.OnUnderrun(40));
+  EXPECT_EQ(kMaximum, tracker.target());
+
+  SoundStreamStats stats;
+  tracker.GetStats(&stats);
+  EXPECT_EQ(4, stats.underruns);
+  EXPECT_EQ(3, stats.latency_increases);
+  EXPECT_EQ(0, stats.latency_decreases);
+}
+
+// After each stable period without underruns the target drops by one step,
+// but never below the minimum.
+TEST(LatencyTrackerTest, ShrinksAfterStablePeriod) {
+  LatencyTracker tracker(kMinimum, kMaximum, kStep, kStablePeriodMs);
+  uint32 now = 5000;
+  EXPECT_FALSE(tracker.OnTick(now));
+  EXPECT_TRUE(tracker.OnUnderrun(now));
+  EXPECT_TRUE(tracker.OnUnderrun(now));
+  EXPECT_EQ(kMinimum + 2 * kStep, tracker.target());
+
+  EXPECT_FALSE(tracker.OnTick(now + kStablePeriodMs - 1));
+  EXPECT_TRUE(tracker.OnTick(now + kStablePeriodMs));
+  EXPECT_EQ(kMinimum + kStep, tracker.target());
+  // The next step down needs another full stable period.
+  EXPECT_FALSE(tracker.OnTick(now + kStablePeriodMs + 1));
+  EXPECT_TRUE(tracker.OnTick(now + 2 * kStablePeriodMs));
+  EXPECT_EQ(kMinimum, tracker.target());
+  EXPECT_FALSE(tracker.OnTick(now + 10 * kStablePeriodMs));
+  EXPECT_EQ(kMinimum, tracker.target());
+
+  SoundStreamStats stats;
+  tracker.GetStats(&stats);
+  EXPECT_EQ(2, stats.latency_decreases);
+}
+
+// An underrun restarts the stable period.
+TEST(LatencyTrackerTest, UnderrunRestartsStablePeriod) {
+  LatencyTracker tracker(kMinimum, kMaximum, kStep, kStablePeriodMs);
+  EXPECT_TRUE(tracker.OnUnderrun(0));
+  EXPECT_TRUE(tracker.OnUnderrun(kStablePeriodMs - 10));
+  EXPECT_FALSE(tracker.OnTick(kStablePeriodMs + 10));
+  EXPECT_EQ(kMinimum + 2 * kStep, tracker.target());
+  EXPECT_TRUE(tracker.OnTick(2 * kStablePeriodMs - 10));
+  EXPECT_EQ(kMinimum + kStep, tracker.target());
+}
+
+// A tracker with no step never adapts but still counts.
+TEST(LatencyTrackerTest, CountsWithoutAdapting) {
+  LatencyTracker tracker(0, 0, 0, 0);
+  EXPECT_FALSE(tracker.OnUnderrun(0));
+  EXPECT_FALSE(tracker.OnTick(100000));
+  EXPECT_EQ(0, tracker.target());
+
+  SoundStreamStats stats;
+  tracker.GetStats(&stats);
+  EXPECT_EQ(1, stats.underruns);
+  EXPECT_EQ(0, stats.latency_increases);
+}
+
+TEST(LatencyTrackerTest, LatencySamples) {
+  LatencyTracker tracker(0, 0, 0, 0);
+  SoundStreamStats stats;
+  tracker.GetStats(&stats);
+  EXPECT_EQ(0, stats.latency_samples);
+  EXPECT_EQ(0, stats.min_latency_usecs);
+
+  tracker.AddLatencySample(30000);
+  tracker.AddLatencySample(10000);
+  tracker.AddLatencySample(20000);
+  tracker.GetStats(&stats);
+  EXPECT_EQ(3, stats.latency_samples);
+  EXPECT_EQ(20000, stats.last_latency_usecs);
+  EXPECT_EQ(10000, stats.min_latency_usecs);
+  EXPECT_EQ(30000, stats.max_latency_usecs);
+  EXPECT_EQ(20000, stats.avg_latency_usecs);
+}
+
+// The null streams report that they never underrun.
+TEST(LatencyTrackerTest, NullStreamStats) {
+  NullSoundSystem sound_system;
+  ASSERT_TRUE(sound_system.Init());
+  SoundDeviceLocator *device = NULL;
+  ASSERT_TRUE(sound_system.GetDefaultPlaybackDevice(&device));
+  talk_base::scoped_ptr<SoundDeviceLocator> device_deleter(device);
+
+  SoundSystemInterface::OpenParams params = {
+    SoundSystemInterface::FORMAT_S16LE, 16000, 1, 0,
+    SoundSystemInterface::kNoLatencyRequirements
+  };
+  talk_base::scoped_ptr<SoundOutputStreamInterface> output(
+      sound_system.OpenPlaybackDevice(device, params));
+  ASSERT_TRUE(output.get() != NULL);
+  talk_base::scoped_ptr<SoundInputStreamInterface> input(
+      sound_system.OpenCaptureDevice(device, params));
+  ASSERT_TRUE(input.get() != NULL);
+
+  SoundStreamStats stats;
+  stats.underruns = 1;
+  EXPECT_TRUE(output->GetStats(&stats));
+  EXPECT_EQ(0, stats.underruns);
+  stats.underruns = 1;
+  EXPECT_TRUE(input->GetStats(&stats));
+  EXPECT_EQ(0, stats.underruns);
+}
+
+}  // namespace cricket
@@ -78,6 +78,12 @@ class NullSoundInputStream : public SoundInputStreamInterface {
   virtual int LatencyUsecs() {
     return 0;
   }
+
+  virtual bool GetStats(SoundStreamStats *stats) {
+    // Never underruns and has no latency.
+    *stats = SoundStreamStats();
+    return true;
+  }
 };
 
 class NullSoundOutputStream : public SoundOutputStreamInterface {
@@ -112,6 +118,12 @@ class NullSoundOutputStream : public SoundOutputStreamInterface {
   virtual int LatencyUsecs() {
     return 0;
   }
+
+  virtual bool GetStats(SoundStreamStats *stats) {
+    // Never underruns and has no latency.
+    *stats = SoundStreamStats();
+    return true;
+  }
 };
 
 NullSoundSystem::~NullSoundSystem() {
@@ -34,6 +34,7 @@
 #include "talk/base/logging.h"
 #include "talk/base/worker.h"
 #include "talk/base/timeutils.h"
+#include "talk/sound/latencytracker.h"
 #include "talk/sound/sounddevicelocator.h"
 #include "talk/sound/soundinputstreaminterface.h"
 #include "talk/sound/soundoutputstreaminterface.h"
@@ -66,6 +67,12 @@ static const int kPlaybackLatencyMinimumMsecs = 20;
 // Every time a playback stream underflows, we will reconfigure it with target
 // latency that is greater by this amount.
 static const int kPlaybackLatencyIncrementMsecs = 20;
+// An underflow is often caused by a transient hiccup (e.g., a burst of disk
+// I/O), so once the stream has played this long without underflowing we step
+// its latency back down by the same increment, towards what was requested.
+static const int kPlaybackLatencyStablePeriodMsecs = 10000;
+// Never grow the latency beyond this, no matter how often we underflow.
+static const int kPlaybackLatencyMaximumMsecs = 1000;
 // We also need to configure a suitable request size. Too small and we'd burn
 // CPU from the overhead of transfering small amounts of data at once. Too large
 // and the amount of data remaining in the buffer right before refilling it
@@ -246,11 +253,14 @@ class PulseAudioInputStream :
                         pa_stream *stream,
                         int flags)
       : stream_(pulse, stream, flags),
+        // Capture latency never needs raising, so we only count.
+        tracker_(0, 0, 0, 0),
         temp_sample_data_(NULL),
         temp_sample_data_size_(0) {
     // This callback seems to never be issued, but let's set it anyways.
-    symbol_table()->pa_stream_set_overflow_callback()(stream, &OverflowCallback,
-        NULL);
+    symbol_table()->pa_stream_set_overflow_callback()(stream,
+                                                      &OverflowCallbackThunk,
+                                                      this);
   }
 
   virtual ~PulseAudioInputStream() {
@@ -389,6 +399,9 @@ class PulseAudioInputStream :
     bool ret = true;
     if (!stream_.IsClosed()) {
       Lock();
+      symbol_table()->pa_stream_set_overflow_callback()(stream_.stream(),
+                                                        NULL,
+                                                        NULL);
       ret = stream_.Close();
       Unlock();
     }
@@ -396,7 +409,14 @@ class PulseAudioInputStream :
   }
 
   virtual int LatencyUsecs() {
-    return stream_.LatencyUsecs();
+    int latency = stream_.LatencyUsecs();
+    tracker_.AddLatencySample(latency);
+    return latency;
+  }
+
+  virtual bool GetStats(SoundStreamStats *stats) {
+    tracker_.GetStats(stats);
+    return true;
   }
 
  private:
@@ -506,9 +526,11 @@ class PulseAudioInputStream :
     Unlock();
   }
 
-  static void OverflowCallback(pa_stream *stream,
-                               void *userdata) {
+  static void OverflowCallbackThunk(pa_stream *stream,
+                                    void *userdata) {
     LOG(LS_WARNING) << "Buffer overflow on capture stream " << stream;
+    static_cast<PulseAudioInputStream *>(userdata)->tracker_.OnUnderrun(
+        talk_base::Time());
   }
 
   static void GetVolumeCallbackThunk(pa_context *unused,
@@ -582,6 +604,7 @@ class PulseAudioInputStream :
   }
 
   PulseAudioStream stream_;
+  LatencyTracker tracker_;
   // Temporary storage for passing data between threads.
   const void *temp_sample_data_;
   size_t temp_sample_data_size_;
@@ -604,9 +627,22 @@ class PulseAudioOutputStream :
   PulseAudioOutputStream(PulseAudioSoundSystem *pulse,
                          pa_stream *stream,
                          int flags,
-                         int latency)
+                         int latency,
+                         size_t bytes_per_sec)
       : stream_(pulse, stream, flags),
-        configured_latency_(latency),
+        bytes_per_sec_(bytes_per_sec),
+        // If we didn't configure a pa_buffer_attr then switching to one later
+        // would be questionable, so only count underflows in that case.
+        tracker_(latency == SoundSystemInterface::kNoLatencyRequirements ?
+                     0 : latency,
+                 static_cast<int>(bytes_per_sec *
+                     kPlaybackLatencyMaximumMsecs /
+                     talk_base::kNumMillisecsPerSec),
+                 latency == SoundSystemInterface::kNoLatencyRequirements ?
+                     0 : static_cast<int>(bytes_per_sec *
+                         kPlaybackLatencyIncrementMsecs /
+                         talk_base::kNumMillisecsPerSec),
+                 kPlaybackLatencyStablePeriodMsecs),
         temp_buffer_space_(0) {
     symbol_table()->pa_stream_set_underflow_callback()(stream,
                                                        &UnderflowCallbackThunk,
@@ -743,7 +779,19 @@ class PulseAudioOutputStream :
   }
 
   virtual int LatencyUsecs() {
-    return stream_.LatencyUsecs();
+    int latency = stream_.LatencyUsecs();
+    tracker_.AddLatencySample(latency);
+    return latency;
+  }
+
+  virtual bool GetStats(SoundStreamStats *stats) {
+    tracker_.GetStats(stats);
+    if (bytes_per_sec_ > 0) {
+      stats->target_latency_usecs = static_cast<int>(
+          static_cast<int64>(tracker_.target()) *
+          talk_base::kNumMicrosecsPerSec / bytes_per_sec_);
+    }
+    return true;
   }
 
 #if 0
@@ -840,6 +888,13 @@ class PulseAudioOutputStream :
   }
 
   void OnWriteCallback(size_t buffer_space) {
+    // Pulse asks for data every minreq bytes, so this is a cheap place to
+    // notice that we have been stable long enough to lower the latency.
+    if (tracker_.OnTick(talk_base::Time())) {
+      LOG(LS_INFO) << "Lowering latency of playback stream "
+                   << stream_.stream();
+      SetBufferAttr(tracker_.target());
+    }
     temp_buffer_space_ = buffer_space;
     // Since we write the data asynchronously on a different thread, we have
     // to temporarily disable the write callback or else Pulse will call it
@@ -885,29 +940,18 @@ class PulseAudioOutputStream :
     LOG(LS_WARNING) << "Buffer underflow on playback stream "
                     << stream_.stream();
 
-    if (configured_latency_ == SoundSystemInterface::kNoLatencyRequirements) {
-      // We didn't configure a pa_buffer_attr before, so switching to one now
-      // would be questionable.
-      return;
+    // Reconfigure the stream with a higher target latency, unless we are not
+    // adapting it or it is already at the maximum.
+    if (tracker_.OnUnderrun(talk_base::Time())) {
+      SetBufferAttr(tracker_.target());
     }
+  }
 
-    // Otherwise reconfigure the stream with a higher target latency.
-
-    const pa_sample_spec *spec = symbol_table()->pa_stream_get_sample_spec()(
-        stream_.stream());
-    if (!spec) {
-      LOG(LS_ERROR) << "pa_stream_get_sample_spec()";
-      return;
-    }
-
-    size_t bytes_per_sec = symbol_table()->pa_bytes_per_second()(spec);
-
-    int new_latency = configured_latency_ +
-        bytes_per_sec * kPlaybackLatencyIncrementMsecs /
-        talk_base::kNumMicrosecsPerSec;
-
+  // Must be called with the lock held (which is always the case in Pulse
+  // callbacks).
+  void SetBufferAttr(int latency) {
     pa_buffer_attr new_attr = {0};
-    FillPlaybackBufferAttr(new_latency, &new_attr);
+    FillPlaybackBufferAttr(latency, &new_attr);
 
     pa_operation *op = symbol_table()->pa_stream_set_buffer_attr()(
         stream_.stream(),
@@ -921,9 +965,6 @@ class PulseAudioOutputStream :
     }
     // Don't need to wait for this to complete.
     symbol_table()->pa_operation_unref()(op);
-
-    // Save the new latency in case we underflow again.
-    configured_latency_ = new_latency;
   }
 
   static void GetVolumeCallbackThunk(pa_context *unused,
@@ -966,7 +1007,8 @@ class PulseAudioOutputStream :
   }
 
   PulseAudioStream stream_;
-  int configured_latency_;
+  size_t bytes_per_sec_;
+  LatencyTracker tracker_;
   // Temporary storage for passing data between threads.
   size_t temp_buffer_space_;
 
@@ -1455,9 +1497,9 @@ SoundOutputStreamInterface *PulseAudioSoundSystem::ConnectOutputStream(
     const pa_sample_spec &spec) {
   pa_buffer_attr attr = {0};
   pa_buffer_attr *pattr = NULL;
+  size_t bytes_per_sec = symbol_table_.pa_bytes_per_second()(&spec);
   if (latency != kNoLatencyRequirements) {
     // kLowLatency is 0, so we treat it the same as a request for zero latency.
-    ssize_t bytes_per_sec = symbol_table_.pa_bytes_per_second()(&spec);
     latency = talk_base::_max(
         latency,
         static_cast<int>(
@@ -1477,7 +1519,8 @@ SoundOutputStreamInterface *PulseAudioSoundSystem::ConnectOutputStream(
           NULL) != 0) {
     return NULL;
   }
-  return new PulseAudioOutputStream(this, stream, flags, latency);
+  return new PulseAudioOutputStream(this, stream, flags, latency,
+                                    bytes_per_sec);
 }
 
 // Must be called with the lock held.
@@ -43,6 +43,11 @@ class PulseAudioStream;
 // Sound system implementation for PulseAudio, a cross-platform sound server
 // (but commonly used only on Linux, which is the only platform we support
 // it on).
+// Unlike AlsaSoundSystem, streams are not serviced by an AlsaStreamPoller-like
+// loop on the caller's thread. libpulse already runs every stream of our one
+// context from a single event thread (the pa_threaded_mainloop), and stream
+// reads and writes only copy to and from the server's buffers, so there is no
+// per-stream blocking for a shared loop to remove.
 // Init(), Terminate(), and the destructor should never be invoked concurrently,
 // but all other methods are thread-safe.
 class PulseAudioSoundSystem : public SoundSystemInterface {
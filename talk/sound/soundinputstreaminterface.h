@@ -30,6 +30,7 @@
 
 #include "talk/base/constructormagic.h"
 #include "talk/base/sigslot.h"
+#include "talk/sound/latencytracker.h"
 
 namespace cricket {
 
@@ -64,6 +65,13 @@ class SoundInputStreamInterface {
   // Get the latency of the stream.
   virtual int LatencyUsecs() = 0;
 
+  // Retrieves buffer overruns and the latencies this stream has reported from
+  // LatencyUsecs() so far. Returns false if the implementation does not keep
+  // stats. May be called from any thread.
+  virtual bool GetStats(SoundStreamStats *stats) {
+    return false;
+  }
+
   // Notifies the consumer of new data read from the device.
   // The first parameter is a pointer to the data read, and is only valid for
   // the duration of the call.
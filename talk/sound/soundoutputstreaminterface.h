@@ -30,6 +30,7 @@
 
 #include "talk/base/constructormagic.h"
 #include "talk/base/sigslot.h"
+#include "talk/sound/latencytracker.h"
 
 namespace cricket {
 
@@ -69,6 +70,13 @@ class SoundOutputStreamInterface {
   // Get the latency of the stream.
   virtual int LatencyUsecs() = 0;
 
+  // Retrieves buffer underruns and the latencies this stream has reported from
+  // LatencyUsecs() so far. Returns false if the implementation does not keep
+  // stats. May be called from any thread.
+  virtual bool GetStats(SoundStreamStats *stats) {
+    return false;
+  }
+
   // Notifies the producer of the available buffer space for writes.
   // It fires continuously as long as the space is greater than zero.
   // The first parameter is the amount of buffer space available for data to
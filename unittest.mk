@@ -36,6 +36,8 @@ LOCAL_MODULE_TAGS := optional
 #
 LOCAL_BASE_SRC_FILES := \
 	talk/base/asynchttprequest_unittest.cc \
+	talk/base/asyncstuntcpsocket_unittest.cc \
+	talk/base/asynctcpsocket_unittest.cc \
 	talk/base/autodetectproxy_unittest.cc \
 	talk/base/bandwidthsmoother_unittest.cc \
 	talk/base/base64_unittest.cc \
@@ -44,14 +46,17 @@ LOCAL_BASE_SRC_FILES := \
 	talk/base/bytebuffer_unittest.cc \
 	talk/base/byteorder_unittest.cc \
 	talk/base/crc32_unittest.cc \
+	talk/base/diskcache_unittest.cc \
 	talk/base/event_unittest.cc \
 	talk/base/fileutils_unittest.cc \
 	talk/base/helpers_unittest.cc \
+	talk/base/histogram_unittest.cc \
 	talk/base/host_unittest.cc \
 	talk/base/httpbase_unittest.cc \
 	talk/base/httpcommon_unittest.cc \
 	talk/base/httpserver_unittest.cc \
 	talk/base/ipaddress_unittest.cc \
+	talk/base/linkmodel_unittest.cc \
 	talk/base/logging_unittest.cc \
 	talk/base/md5digest_unittest.cc \
 	talk/base/messagedigest_unittest.cc \
@@ -61,6 +66,7 @@ LOCAL_BASE_SRC_FILES := \
 	talk/base/network_unittest.cc \
 	talk/base/nullsocketserver_unittest.cc \
 	talk/base/optionsfile_unittest.cc \
+	talk/base/packettrace_unittest.cc \
 	talk/base/pathutils_unittest.cc \
 	talk/base/physicalsocketserver_unittest.cc \
 	talk/base/proxy_unittest.cc \
@@ -69,10 +75,12 @@ LOCAL_BASE_SRC_FILES := \
 	talk/base/ratetracker_unittest.cc \
 	talk/base/referencecountedsingletonfactory_unittest.cc \
 	talk/base/rollingaccumulator_unittest.cc \
+	talk/base/seqlock_unittest.cc \
 	talk/base/sha1digest_unittest.cc \
 	talk/base/sharedexclusivelock_unittest.cc \
 	talk/base/signalthread_unittest.cc \
 	talk/base/sigslot_unittest.cc \
+	talk/base/socketadapters_unittest.cc \
 	talk/base/socket_unittest.cc \
 	talk/base/socketaddress_unittest.cc \
 	talk/base/stream_unittest.cc \
@@ -85,6 +93,7 @@ LOCAL_BASE_SRC_FILES := \
 	talk/base/urlencode_unittest.cc \
 	talk/base/versionparsing_unittest.cc \
 	talk/base/virtualsocket_unittest.cc \
+	talk/base/windowedratetracker_unittest.cc \
 	talk/xmllite/qname_unittest.cc \
 	talk/xmllite/xmlbuilder_unittest.cc \
 	talk/xmllite/xmlelement_unittest.cc \
@@ -185,6 +194,7 @@ LOCAL_SRC_FILES := \
 	talk/media/base/testutils.cc \
 	talk/p2p/base/dtlstransportchannel_unittest.cc \
 	talk/p2p/base/p2ptransportchannel_unittest.cc \
+	talk/p2p/base/packetpacer_unittest.cc \
 	talk/p2p/base/port_unittest.cc \
 	talk/p2p/base/portallocatorsessionproxy_unittest.cc \
 	talk/p2p/base/pseudotcp_unittest.cc \